@@ -0,0 +1,481 @@
+/**
+ * @file intercom_sim.c
+ * @brief Host Receive-Path Simulator
+ *
+ * Runs a belt pack's receive path - packet parsing, per-sender sequence
+ * tracking, jitter buffer, Opus decode with FEC and concealment - on a
+ * stream of datagrams passed through the impairment model (netsim.h).
+ * The stream is either encoded here from PCM with the firmware's Opus
+ * settings or replayed from a pcap capture. Time is simulated, so a run
+ * is repeatable and as fast as the host, and the code runs under perf or
+ * a debugger like any native program.
+ *
+ * Not simulated: drift correction (it follows the I2S clock), the
+ * sender's VAD/DTX decisions and the base's mixer.
+ */
+
+#include "platform/platform.h"
+#include "config.h"
+#include "audio/audio_opus.h"
+#include "audio/audio_jitter_buffer.h"
+#include "audio/audio_dsp.h"
+#include "network/audio_packet.h"
+#include "netsim.h"
+#include "pcap_trace.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *TAG = "SIM";
+
+#define SIM_FRAME_US        ((int64_t)FRAME_SIZE_MS * 1000)
+#define SIM_DEFAULT_MS      10000           // Synthetic source length
+#define SIM_TAIL_US         500000          // Playout after the last arrival
+#define SIM_SENDER_ADDR     0x0204A8C0u     // 192.168.4.2, network byte order
+#define SIM_SENDER_ID       0x01
+
+typedef struct {
+    int64_t  send_us;
+    int64_t  arrival_us;
+    uint32_t addr;
+    uint32_t index;              // Send order (stable sort)
+    uint16_t size;
+    bool     lost;
+    uint8_t  data[UDP_MAX_PACKET_SIZE];
+} sim_packet_t;
+
+typedef struct {
+    const char *pcm_in;
+    const char *pcap_in;
+    const char *pcap_out;
+    const char *pcm_out;
+    bool compact;
+    bool low_latency;
+    uint32_t bundle;             // Frames per datagram (1 = no bundles)
+    netsim_config_t net;
+} sim_options_t;
+
+typedef struct {
+    uint32_t received;
+    uint32_t lost;               // Sequence gaps seen by the tracker
+    uint32_t repeats;
+    uint32_t malformed;
+    uint32_t frames_played;
+    uint32_t frames_silent;      // Playout slots with no stream
+} sim_stats_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static sim_packet_t *packets = NULL;
+static size_t packet_count = 0;
+static size_t packet_capacity = 0;
+
+static sim_stats_t stats = {0};
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  -i FILE  send 16 kHz mono s16le PCM (default: %d s synthetic speech)\n"
+        "  -p FILE  replay the UDP port %d datagrams of a pcap capture instead\n"
+        "  -w FILE  write the datagrams as sent to a pcap file\n"
+        "  -o FILE  write the playout as 16 kHz mono s16le PCM\n"
+        "  -l PCT   packet loss (default 0)\n"
+        "  -b N     mean loss burst in packets (default 1)\n"
+        "  -d MS    fixed one-way delay (default 2)\n"
+        "  -j MS    mean exponential jitter (default 0)\n"
+        "  -r PCT   packets reordered (default 0)\n"
+        "  -R MS    how far a reordered packet is held back (default 2 frames)\n"
+        "  -s SEED  impairment seed (default 1)\n"
+        "  -B N     send N frames per bundle, no repeats (default 1, max %d)\n"
+        "  -c       compact headers     -L  low-latency jitter buffer\n"
+        "  -v       debug logging\n",
+        argv0, SIM_DEFAULT_MS / 1000, UDP_PORT, UDP_BUNDLE_MAX_FRAMES);
+}
+
+static sim_packet_t *add_packet(void)
+{
+    if (packet_count == packet_capacity) {
+        size_t capacity = packet_capacity ? packet_capacity * 2 : 1024;
+        sim_packet_t *grown = realloc(packets, capacity * sizeof(sim_packet_t));
+        if (!grown) {
+            return NULL;
+        }
+        packets = grown;
+        packet_capacity = capacity;
+    }
+
+    sim_packet_t *packet = &packets[packet_count];
+    memset(packet, 0, sizeof(*packet));
+    packet->index = (uint32_t)packet_count++;
+    return packet;
+}
+
+// Harmonic voice with a slow pitch glide and a 4 Hz syllable envelope
+static void synth_frame(int16_t *pcm, uint32_t frame_index)
+{
+    static float phase = 0.0f;
+
+    for (size_t n = 0; n < SAMPLES_PER_FRAME; n++) {
+        float t = (float)(frame_index * SAMPLES_PER_FRAME + n) / SAMPLE_RATE_HZ;
+        float f0 = 140.0f + 40.0f * sinf(2.0f * (float)M_PI * 0.3f * t);
+        phase += 2.0f * (float)M_PI * f0 / SAMPLE_RATE_HZ;
+        if (phase > 2.0f * (float)M_PI) phase -= 2.0f * (float)M_PI;
+
+        float v = 0.0f;
+        for (int k = 1; k <= 10; k++) {
+            v += sinf(phase * (float)k) / (float)k;
+        }
+        float syllable = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * 4.0f * t);
+        pcm[n] = (int16_t)(v * syllable * 0.4f * 32767.0f / 2.0f);
+    }
+}
+
+// One datagram: a single frame, or a bundle of the frames held (oldest
+// first, ending with `newest`) laid out as udp_transport.c bundle_send does
+static bool emit_datagram(const sim_options_t *opt, uint32_t newest,
+                          uint8_t held[][OPUS_MAX_PACKET_SIZE], const uint16_t *held_size,
+                          size_t count)
+{
+    audio_packet_t packet;
+    uint8_t flags = PACKET_FLAG_PTT;
+    size_t size;
+
+    if (opt->bundle > 1) {
+        size = 1 + count;
+        for (size_t i = 0; i < count; i++) {
+            size += held_size[i];
+        }
+        if (size > sizeof(packet.opus_data)) {
+            ESP_LOGE(TAG, "Bundle of %u frames is %u bytes", (unsigned)count, (unsigned)size);
+            return false;
+        }
+
+        uint8_t *payload = packet.opus_data;
+        payload[0] = (uint8_t)count;             // No repeats in front
+        size = 1 + count;
+        for (size_t i = 0; i < count; i++) {
+            payload[1 + i] = (uint8_t)held_size[i];
+            memcpy(&payload[size], held[i], held_size[i]);
+            size += held_size[i];
+        }
+        flags |= PACKET_FLAG_BUNDLE;
+    } else {
+        size = held_size[0];
+        memcpy(packet.opus_data, held[0], size);
+    }
+
+    sim_packet_t *out = add_packet();
+    if (!out) {
+        return false;
+    }
+    out->send_us = (int64_t)newest * SIM_FRAME_US;
+    out->addr = SIM_SENDER_ADDR;
+
+    const uint8_t *datagram;
+    size_t datagram_size;
+    if (opt->compact) {
+        datagram = audio_packet_write_compact(packet.opus_data, newest, newest, flags,
+                                              INTERCOM_GROUP_ID, SIM_SENDER_ID);
+        datagram_size = AUDIO_PACKET_COMPACT_SIZE + size;
+    } else {
+        datagram = (const uint8_t *)&packet;
+        datagram_size = audio_packet_write_full(&packet, newest, (uint32_t)out->send_us,
+                                                flags, INTERCOM_GROUP_ID, (uint16_t)size);
+    }
+    memcpy(out->data, datagram, datagram_size);
+    out->size = (uint16_t)datagram_size;
+    return true;
+}
+
+// Encode the source as the firmware's sender would, one datagram per
+// frame or per opt->bundle frames
+static bool encode_source(const sim_options_t *opt)
+{
+    FILE *in = NULL;
+    if (opt->pcm_in) {
+        in = fopen(opt->pcm_in, "rb");
+        if (!in) {
+            ESP_LOGE(TAG, "Cannot open %s", opt->pcm_in);
+            return false;
+        }
+    }
+
+    int16_t pcm[SAMPLES_PER_FRAME];
+    uint8_t held[UDP_BUNDLE_MAX_FRAMES][OPUS_MAX_PACKET_SIZE];
+    uint16_t held_size[UDP_BUNDLE_MAX_FRAMES];
+    size_t held_count = 0;
+    uint32_t frames = SIM_DEFAULT_MS / FRAME_SIZE_MS;
+    uint32_t f;
+    bool ok = true;
+
+    for (f = 0; in || f < frames; f++) {
+        if (in) {
+            size_t got = fread(pcm, sizeof(int16_t), SAMPLES_PER_FRAME, in);
+            if (got == 0) break;
+            memset(&pcm[got], 0, (SAMPLES_PER_FRAME - got) * sizeof(int16_t));
+        } else {
+            synth_frame(pcm, f);
+        }
+
+        int size = audio_opus_encode(pcm, SAMPLES_PER_FRAME, held[held_count],
+                                     sizeof(held[held_count]));
+        if (size <= 0 || (opt->bundle > 1 && size > 255)) {
+            ESP_LOGE(TAG, "Encode failed at frame %lu", (unsigned long)f);
+            ok = false;
+            break;
+        }
+        held_size[held_count++] = (uint16_t)size;
+
+        if (held_count == opt->bundle) {
+            ok = emit_datagram(opt, f, held, held_size, held_count);
+            held_count = 0;
+            if (!ok) break;
+        }
+    }
+    if (ok && held_count > 0) {
+        ok = emit_datagram(opt, f - 1, held, held_size, held_count);
+    }
+
+    if (in) fclose(in);
+    return ok && packet_count > 0;
+}
+
+static bool load_capture(const char *path)
+{
+    pcap_trace_t trace;
+    if (!pcap_trace_open_read(&trace, path, UDP_PORT)) {
+        ESP_LOGE(TAG, "Cannot read pcap %s", path);
+        return false;
+    }
+
+    uint8_t data[UDP_MAX_PACKET_SIZE];
+    int64_t time_us, start_us = 0;
+    uint32_t addr;
+    size_t size;
+    while ((size = pcap_trace_read(&trace, &time_us, &addr, data, sizeof(data))) > 0) {
+        sim_packet_t *packet = add_packet();
+        if (!packet) break;
+
+        if (packet_count == 1) start_us = time_us;
+        packet->send_us = time_us - start_us;
+        packet->addr = addr;
+        packet->size = (uint16_t)size;
+        memcpy(packet->data, data, size);
+    }
+    pcap_trace_close(&trace);
+
+    ESP_LOGI(TAG, "%lu datagrams from %s", (unsigned long)packet_count, path);
+    return packet_count > 0;
+}
+
+static int by_arrival(const void *a, const void *b)
+{
+    const sim_packet_t *x = a, *y = b;
+    if (x->lost != y->lost) return x->lost ? 1 : -1;
+    if (x->arrival_us != y->arrival_us) return x->arrival_us < y->arrival_us ? -1 : 1;
+    return x->index < y->index ? -1 : 1;
+}
+
+// The firmware's receive path for one datagram (udp_transport.c
+// handle_packet, then main.c udp_rx_handler on a pack)
+static void receive(jitter_buffer_t *jb, audio_packet_stream_t *stream, const sim_packet_t *packet)
+{
+    audio_packet_frame_t frame;
+    if (!audio_packet_parse(packet->data, packet->size, &frame)) {
+        stats.malformed++;
+        return;
+    }
+    if (frame.group != INTERCOM_GROUP_ID || (frame.flags & PACKET_FLAG_CONTROL)) {
+        return;
+    }
+    if (frame.compact) {
+        audio_packet_unwrap(stream, &frame);
+    }
+
+    audio_packet_frame_t frames[UDP_BUNDLE_MAX_FRAMES];
+    size_t count = 1;
+    if (frame.flags & PACKET_FLAG_BUNDLE) {
+        count = audio_packet_split_bundle(&frame, frames, NULL);
+        if (count == 0) {
+            stats.malformed++;
+            return;
+        }
+    } else {
+        frames[0] = frame;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        // Bundle repeats are dropped here (a reordered bundle's frames are
+        // not repeats); a single late or duplicate frame still goes to the
+        // jitter buffer, which sorts it out
+        int32_t lost = audio_packet_track(stream, frames[i].sequence);
+        if (lost < 0) {
+            stats.repeats++;
+            if (frame.flags & PACKET_FLAG_BUNDLE) continue;
+        } else {
+            stats.lost += (uint32_t)lost;
+            stats.received++;
+        }
+
+        if (frames[i].size > 0) {
+            jitter_buffer_push(jb, frames[i].payload, frames[i].size, frames[i].sequence,
+                               frames[i].timestamp, (frames[i].flags & PACKET_FLAG_MIX_MINUS) != 0,
+                               (frames[i].flags & PACKET_FLAG_DTX) != 0);
+        }
+    }
+}
+
+static bool parse_options(int argc, char **argv, sim_options_t *opt)
+{
+    memset(opt, 0, sizeof(*opt));
+    opt->net.delay_us = 2000;
+    opt->net.burst_frames = 1.0f;
+    opt->net.reorder_us = 2 * SIM_FRAME_US;
+    opt->net.seed = 1;
+    opt->bundle = 1;
+
+    int c;
+    while ((c = getopt(argc, argv, "i:p:w:o:l:b:d:j:r:R:s:B:cLvh")) != -1) {
+        switch (c) {
+        case 'i': opt->pcm_in = optarg; break;
+        case 'p': opt->pcap_in = optarg; break;
+        case 'w': opt->pcap_out = optarg; break;
+        case 'o': opt->pcm_out = optarg; break;
+        case 'l': opt->net.loss_percent = strtof(optarg, NULL); break;
+        case 'b': opt->net.burst_frames = strtof(optarg, NULL); break;
+        case 'd': opt->net.delay_us = (uint32_t)(strtof(optarg, NULL) * 1000.0f); break;
+        case 'j': opt->net.jitter_us = (uint32_t)(strtof(optarg, NULL) * 1000.0f); break;
+        case 'r': opt->net.reorder_percent = strtof(optarg, NULL); break;
+        case 'R': opt->net.reorder_us = (uint32_t)(strtof(optarg, NULL) * 1000.0f); break;
+        case 's': opt->net.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'B': opt->bundle = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': opt->compact = true; break;
+        case 'L': opt->low_latency = true; break;
+        case 'v': platform_host_set_log_level(PLATFORM_LOG_DEBUG); break;
+        default: return false;
+        }
+    }
+    return optind == argc && opt->bundle >= 1 && opt->bundle <= UDP_BUNDLE_MAX_FRAMES;
+}
+
+//=============================================================================
+// MAIN
+//=============================================================================
+
+int main(int argc, char **argv)
+{
+    sim_options_t opt;
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (audio_opus_init() != ESP_OK) {
+        return 1;
+    }
+    if (!(opt.pcap_in ? load_capture(opt.pcap_in) : encode_source(&opt))) {
+        return 1;
+    }
+
+    if (opt.pcap_out) {
+        pcap_trace_t trace;
+        if (!pcap_trace_open_write(&trace, opt.pcap_out, UDP_PORT)) {
+            ESP_LOGE(TAG, "Cannot write %s", opt.pcap_out);
+            return 1;
+        }
+        for (size_t i = 0; i < packet_count; i++) {
+            pcap_trace_write(&trace, packets[i].send_us, packets[i].addr,
+                             packets[i].data, packets[i].size);
+        }
+        pcap_trace_close(&trace);
+    }
+
+    // Impair, then replay in arrival order
+    netsim_t net;
+    netsim_init(&net, &opt.net);
+    for (size_t i = 0; i < packet_count; i++) {
+        packets[i].lost = !netsim_route(&net, packets[i].send_us, &packets[i].arrival_us);
+    }
+    qsort(packets, packet_count, sizeof(sim_packet_t), by_arrival);
+    size_t arrived = packet_count - net.stats.lost;
+
+    FILE *out = NULL;
+    if (opt.pcm_out) {
+        out = fopen(opt.pcm_out, "wb");
+        if (!out) {
+            ESP_LOGE(TAG, "Cannot write %s", opt.pcm_out);
+            return 1;
+        }
+    }
+
+    static jitter_buffer_t jb;
+    if (jitter_buffer_init(&jb) != ESP_OK) {
+        return 1;
+    }
+    jitter_buffer_set_low_latency(&jb, opt.low_latency);
+    audio_packet_stream_t stream = {0};
+
+    // Playout ticks once a frame from the first arrival, like the engine
+    int64_t now_us = arrived ? packets[0].arrival_us : 0;
+    int64_t end_us = arrived ? packets[arrived - 1].arrival_us + SIM_TAIL_US : 0;
+    size_t next = 0;
+    int16_t AUDIO_DSP_ALIGN pcm[SAMPLES_PER_FRAME];
+
+    for (; now_us <= end_us; now_us += SIM_FRAME_US) {
+        while (next < arrived && packets[next].arrival_us <= now_us) {
+            platform_host_set_time_us(packets[next].arrival_us);
+            receive(&jb, &stream, &packets[next]);
+            next++;
+        }
+
+        platform_host_set_time_us(now_us);
+        int produced = jitter_buffer_decode_next(&jb, NULL, pcm, SAMPLES_PER_FRAME);
+        if (produced <= 0) {
+            stats.frames_silent++;
+            produced = 0;
+        } else {
+            stats.frames_played++;
+        }
+        memset(&pcm[produced], 0, (SAMPLES_PER_FRAME - produced) * sizeof(int16_t));
+        if (out) {
+            fwrite(pcm, sizeof(int16_t), SAMPLES_PER_FRAME, out);
+        }
+    }
+    if (out) fclose(out);
+
+    jitter_buffer_stats_t jbs;
+    jitter_buffer_get_stats(&jb, &jbs);
+
+    printf("Link:     %lu sent, %lu lost (%.2f%%), %lu reordered\n",
+           (unsigned long)net.stats.sent, (unsigned long)net.stats.lost,
+           net.stats.sent ? 100.0f * net.stats.lost / net.stats.sent : 0.0f,
+           (unsigned long)net.stats.reordered);
+    printf("Receiver: %lu frames, %lu gaps, %lu repeats, %lu malformed\n",
+           (unsigned long)stats.received, (unsigned long)stats.lost,
+           (unsigned long)stats.repeats, (unsigned long)stats.malformed);
+    printf("Playout:  %lu frames (%lu silent), %lu missing (%lu FEC), %lu late, "
+           "%lu underruns, %lu queue drops\n",
+           (unsigned long)stats.frames_played, (unsigned long)stats.frames_silent,
+           (unsigned long)jbs.frames_missing, (unsigned long)jbs.fec_recovered,
+           (unsigned long)jbs.late_drops, (unsigned long)jbs.underruns,
+           (unsigned long)jbs.queue_drops);
+    printf("Depth:    target %lu frames (%lu ms), jitter %lu us, dwell %lu us, "
+           "%lu stretched, %lu shrunk\n",
+           (unsigned long)jbs.target_depth, (unsigned long)(jbs.target_depth * FRAME_SIZE_MS),
+           (unsigned long)jbs.jitter_us, (unsigned long)jbs.dwell_us,
+           (unsigned long)jbs.frames_stretched, (unsigned long)jbs.frames_shrunk);
+
+    jitter_buffer_deinit(&jb);
+    audio_opus_deinit();
+    free(packets);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file netsim.c
+ * @brief Network Impairment Model Implementation
+ */
+
+#include "netsim.h"
+#include <math.h>
+#include <string.h>
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+// Uniform in [0, 1)
+static float uniform(netsim_t *sim)
+{
+    sim->rng ^= sim->rng << 13;
+    sim->rng ^= sim->rng >> 17;
+    sim->rng ^= sim->rng << 5;
+    return (float)(sim->rng >> 8) / (float)(1u << 24);
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void netsim_init(netsim_t *sim, const netsim_config_t *config)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->config = *config;
+    sim->rng = config->seed ? config->seed : 1;
+
+    // Stationary loss p / (p + r) = loss with r = 1 / burst
+    float loss = config->loss_percent / 100.0f;
+    float burst = config->burst_frames < 1.0f ? 1.0f : config->burst_frames;
+    if (loss > 0.0f && loss < 1.0f) {
+        sim->p_bad_good = 1.0f / burst;
+        sim->p_good_bad = loss * sim->p_bad_good / (1.0f - loss);
+    } else if (loss >= 1.0f) {
+        sim->bad_state = true;
+    }
+}
+
+bool netsim_route(netsim_t *sim, int64_t send_us, int64_t *arrival_us)
+{
+    sim->stats.sent++;
+
+    if (sim->bad_state) {
+        if (sim->p_bad_good > 0.0f && uniform(sim) < sim->p_bad_good) {
+            sim->bad_state = false;
+        }
+    } else if (sim->p_good_bad > 0.0f && uniform(sim) < sim->p_good_bad) {
+        sim->bad_state = true;
+    }
+    if (sim->bad_state) {
+        sim->stats.lost++;
+        return false;
+    }
+
+    int64_t arrival = send_us + sim->config.delay_us;
+    if (sim->config.jitter_us > 0) {
+        arrival += (int64_t)(-logf(1.0f - uniform(sim)) * (float)sim->config.jitter_us);
+    }
+
+    if (sim->config.reorder_percent > 0.0f &&
+        uniform(sim) * 100.0f < sim->config.reorder_percent) {
+        // Held back; later packets are not queued behind it
+        sim->stats.reordered++;
+        *arrival_us = arrival + sim->config.reorder_us;
+        return true;
+    }
+
+    if (arrival < sim->last_arrival_us) {
+        arrival = sim->last_arrival_us;
+    }
+    sim->last_arrival_us = arrival;
+    *arrival_us = arrival;
+    return true;
+}
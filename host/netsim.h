@@ -0,0 +1,57 @@
+/**
+ * @file netsim.h
+ * @brief Network Impairment Model
+ *
+ * Decides for each datagram whether it arrives and when. Loss follows a
+ * two-state (Gilbert-Elliott) model: every packet is lost in the bad
+ * state, and the mean burst length sets how long it lasts. Delay is a
+ * fixed base plus an exponential jitter term (a WiFi link's queueing and
+ * retries give a long tail), kept in send order unless a packet is picked
+ * for reordering, which holds it back behind its successors.
+ */
+
+#ifndef NETSIM_H
+#define NETSIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    float    loss_percent;       // Long-run share of packets lost
+    float    burst_frames;       // Mean loss burst (1 = independent losses)
+    uint32_t delay_us;           // Fixed one-way delay
+    uint32_t jitter_us;          // Mean of the exponential extra delay
+    float    reorder_percent;    // Packets held back behind later ones
+    uint32_t reorder_us;         // How far a reordered packet is held back
+    uint32_t seed;
+} netsim_config_t;
+
+typedef struct {
+    uint32_t sent;
+    uint32_t lost;
+    uint32_t reordered;
+} netsim_stats_t;
+
+typedef struct {
+    netsim_config_t config;
+    uint32_t rng;
+    bool     bad_state;
+    float    p_good_bad;         // Per-packet state transition probabilities
+    float    p_bad_good;
+    int64_t  last_arrival_us;    // In-order arrivals never overtake
+    netsim_stats_t stats;
+} netsim_t;
+
+/**
+ * @brief Set up a link with the given impairments
+ */
+void netsim_init(netsim_t *sim, const netsim_config_t *config);
+
+/**
+ * @brief Route one datagram sent at send_us
+ * @param arrival_us Set to its arrival time if it gets through
+ * @return false if the packet is lost
+ */
+bool netsim_route(netsim_t *sim, int64_t send_us, int64_t *arrival_us);
+
+#endif // NETSIM_H
@@ -0,0 +1,203 @@
+/**
+ * @file pcap_trace.c
+ * @brief Packet Traces in pcap Format Implementation
+ */
+
+#include "pcap_trace.h"
+#include <string.h>
+
+#define PCAP_MAGIC_US       0xA1B2C3D4u
+#define PCAP_MAGIC_NS       0xA1B23C4Du
+
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+#define LINKTYPE_IPV4       228
+
+#define PCAP_SNAPLEN        65535
+#define IPV4_HEADER         20
+#define UDP_HEADER          8
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static uint32_t swap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24);
+}
+
+static uint32_t file32(const pcap_trace_t *trace, uint32_t v)
+{
+    return trace->swapped ? swap32(v) : v;
+}
+
+static uint16_t be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+// Offset of the IPv4 header in a captured frame, or -1
+static long ip_offset(const pcap_trace_t *trace, const uint8_t *frame, size_t len)
+{
+    switch (trace->linktype) {
+    case LINKTYPE_ETHERNET: {
+        size_t offset = 12;
+        if (len < offset + 2) return -1;
+        uint16_t type = be16(&frame[offset]);
+        if (type == 0x8100) {            // 802.1Q tag
+            offset += 4;
+            if (len < offset + 2) return -1;
+            type = be16(&frame[offset]);
+        }
+        return type == 0x0800 ? (long)(offset + 2) : -1;
+    }
+    case LINKTYPE_LINUX_SLL:
+        return len >= 16 && be16(&frame[14]) == 0x0800 ? 16 : -1;
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+bool pcap_trace_open_read(pcap_trace_t *trace, const char *path, uint16_t port)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->port = port;
+    trace->file = fopen(path, "rb");
+    if (!trace->file) {
+        return false;
+    }
+
+    uint32_t header[6];
+    if (fread(header, sizeof(header), 1, trace->file) != 1) {
+        pcap_trace_close(trace);
+        return false;
+    }
+
+    if (header[0] == PCAP_MAGIC_US || header[0] == PCAP_MAGIC_NS) {
+        trace->nanosecond = header[0] == PCAP_MAGIC_NS;
+    } else if (swap32(header[0]) == PCAP_MAGIC_US || swap32(header[0]) == PCAP_MAGIC_NS) {
+        trace->swapped = true;
+        trace->nanosecond = swap32(header[0]) == PCAP_MAGIC_NS;
+    } else {
+        pcap_trace_close(trace);
+        return false;
+    }
+    trace->linktype = file32(trace, header[5]) & 0xFFFF;
+    return true;
+}
+
+size_t pcap_trace_read(pcap_trace_t *trace, int64_t *time_us, uint32_t *source_addr,
+                       uint8_t *buffer, size_t capacity)
+{
+    static uint8_t frame[PCAP_SNAPLEN];
+
+    while (trace->file) {
+        uint32_t record[4];
+        if (fread(record, sizeof(record), 1, trace->file) != 1) {
+            return 0;
+        }
+        size_t len = file32(trace, record[2]);
+        if (len > sizeof(frame) || fread(frame, len, 1, trace->file) != 1) {
+            return 0;
+        }
+
+        long ip = ip_offset(trace, frame, len);
+        if (ip < 0 || len < (size_t)ip + IPV4_HEADER) continue;
+
+        const uint8_t *iph = &frame[ip];
+        size_t ihl = (size_t)(iph[0] & 0x0F) * 4;
+        if ((iph[0] >> 4) != 4 || iph[9] != 17 || (be16(&iph[6]) & 0x3FFF) != 0) continue;
+        if (len < (size_t)ip + ihl + UDP_HEADER) continue;
+
+        const uint8_t *udp = iph + ihl;
+        size_t udp_len = be16(&udp[4]);
+        if (be16(&udp[2]) != trace->port || udp_len < UDP_HEADER ||
+            (size_t)ip + ihl + udp_len > len) continue;
+
+        // The device's own sends in a packet_capture dump (source 0.0.0.0)
+        if (be16(&iph[12]) == 0 && be16(&iph[14]) == 0) continue;
+
+        size_t size = udp_len - UDP_HEADER;
+        if (size > capacity) continue;
+
+        uint32_t sec = file32(trace, record[0]);
+        uint32_t frac = file32(trace, record[1]);
+        *time_us = (int64_t)sec * 1000000 + (trace->nanosecond ? frac / 1000 : frac);
+        memcpy(source_addr, &iph[12], sizeof(*source_addr));
+        memcpy(buffer, udp + UDP_HEADER, size);
+        return size;
+    }
+    return 0;
+}
+
+bool pcap_trace_open_write(pcap_trace_t *trace, const char *path, uint16_t port)
+{
+    memset(trace, 0, sizeof(*trace));
+    trace->port = port;
+    trace->linktype = LINKTYPE_RAW;
+    trace->file = fopen(path, "wb");
+    if (!trace->file) {
+        return false;
+    }
+
+    uint32_t header[6] = { PCAP_MAGIC_US, 2 | (4u << 16), 0, 0, PCAP_SNAPLEN, LINKTYPE_RAW };
+    return fwrite(header, sizeof(header), 1, trace->file) == 1;
+}
+
+void pcap_trace_write(pcap_trace_t *trace, int64_t time_us, uint32_t source_addr,
+                      const uint8_t *data, size_t size)
+{
+    if (!trace->file || size > PCAP_SNAPLEN - IPV4_HEADER - UDP_HEADER) return;
+
+    uint8_t header[IPV4_HEADER + UDP_HEADER] = {0};
+    size_t total = sizeof(header) + size;
+
+    header[0] = 0x45;
+    put_be16(&header[2], (uint16_t)total);
+    header[8] = 64;                      // TTL
+    header[9] = 17;                      // UDP
+    memcpy(&header[12], &source_addr, sizeof(source_addr));
+    memset(&header[16], 0xFF, 4);        // Broadcast, as the downlink is
+
+    uint32_t sum = 0;
+    for (size_t i = 0; i < IPV4_HEADER; i += 2) {
+        sum += be16(&header[i]);
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    put_be16(&header[10], (uint16_t)~sum);
+
+    put_be16(&header[IPV4_HEADER], trace->port);
+    put_be16(&header[IPV4_HEADER + 2], trace->port);
+    put_be16(&header[IPV4_HEADER + 4], (uint16_t)(UDP_HEADER + size));
+
+    uint32_t record[4] = {
+        (uint32_t)(time_us / 1000000), (uint32_t)(time_us % 1000000),
+        (uint32_t)total, (uint32_t)total,
+    };
+    fwrite(record, sizeof(record), 1, trace->file);
+    fwrite(header, sizeof(header), 1, trace->file);
+    fwrite(data, size, 1, trace->file);
+}
+
+void pcap_trace_close(pcap_trace_t *trace)
+{
+    if (trace->file) {
+        fclose(trace->file);
+        trace->file = NULL;
+    }
+}
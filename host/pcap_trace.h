@@ -0,0 +1,58 @@
+/**
+ * @file pcap_trace.h
+ * @brief Packet Traces in pcap Format
+ *
+ * Recorded traces are ordinary captures of the intercom's UDP traffic
+ * (e.g. tcpdump -w on a laptop joined to the base's AP, or a monitor-mode
+ * capture). Ethernet, Linux cooked and raw IPv4 link types are read;
+ * only unfragmented IPv4 UDP datagrams to the given port are returned.
+ * Dumps from main/system/packet_capture.c read the same way; the
+ * device's own sends in them (source 0.0.0.0) are skipped.
+ * Traces the simulator writes use raw IPv4, so they open in Wireshark
+ * and replay like a capture.
+ */
+
+#ifndef PCAP_TRACE_H
+#define PCAP_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct {
+    FILE    *file;
+    bool     swapped;            // File written with the other byte order
+    bool     nanosecond;         // Timestamps in ns rather than us
+    uint32_t linktype;
+    uint16_t port;
+} pcap_trace_t;
+
+/**
+ * @brief Open a capture for reading datagrams sent to port
+ */
+bool pcap_trace_open_read(pcap_trace_t *trace, const char *path, uint16_t port);
+
+/**
+ * @brief Next UDP payload to the port
+ * @param time_us     Capture time
+ * @param source_addr Sender's IPv4 address in network byte order (as lwIP reports it)
+ * @return Payload size, 0 at the end of the file
+ */
+size_t pcap_trace_read(pcap_trace_t *trace, int64_t *time_us, uint32_t *source_addr,
+                       uint8_t *buffer, size_t capacity);
+
+/**
+ * @brief Create a raw IPv4 capture of datagrams to port
+ */
+bool pcap_trace_open_write(pcap_trace_t *trace, const char *path, uint16_t port);
+
+/**
+ * @brief Append one datagram
+ */
+void pcap_trace_write(pcap_trace_t *trace, int64_t time_us, uint32_t source_addr,
+                      const uint8_t *data, size_t size);
+
+void pcap_trace_close(pcap_trace_t *trace);
+
+#endif // PCAP_TRACE_H
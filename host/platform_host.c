@@ -0,0 +1,110 @@
+/**
+ * @file platform_host.c
+ * @brief Host (Linux) Implementation of the Platform Layer
+ *
+ * Time is simulated: it only moves when the simulator sets it, so a run
+ * over a packet trace gives the same result every time and takes as long
+ * as the processing does, not as long as the audio. The cycle counter is
+ * the real monotonic clock in nanoseconds, for the timing hooks.
+ */
+
+#include "platform/platform.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+struct platform_mutex {
+    pthread_mutex_t mutex;
+};
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static int64_t sim_time_us = 0;
+static platform_log_level_t log_level = PLATFORM_LOG_INFO;
+
+static const char level_letters[] = { '?', 'E', 'W', 'I', 'D' };
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void platform_log(platform_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (level > log_level) return;
+
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%lld) %s: ", level_letters[level],
+            (long long)(sim_time_us / 1000), tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+int64_t platform_time_us(void)
+{
+    return sim_time_us;
+}
+
+uint32_t platform_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+void *platform_malloc_internal(size_t size)
+{
+    return malloc(size);
+}
+
+void *platform_malloc_psram(size_t size)
+{
+    (void)size;
+    return NULL;
+}
+
+void platform_free(void *ptr)
+{
+    free(ptr);
+}
+
+platform_mutex_t platform_mutex_create(void)
+{
+    platform_mutex_t mutex = malloc(sizeof(*mutex));
+    if (!mutex) {
+        return NULL;
+    }
+    pthread_mutex_init(&mutex->mutex, NULL);
+    return mutex;
+}
+
+void platform_mutex_lock(platform_mutex_t mutex)
+{
+    pthread_mutex_lock(&mutex->mutex);
+}
+
+void platform_mutex_unlock(platform_mutex_t mutex)
+{
+    pthread_mutex_unlock(&mutex->mutex);
+}
+
+void platform_mutex_delete(platform_mutex_t mutex)
+{
+    pthread_mutex_destroy(&mutex->mutex);
+    free(mutex);
+}
+
+void platform_host_set_time_us(int64_t now_us)
+{
+    sim_time_us = now_us;
+}
+
+void platform_host_set_log_level(platform_log_level_t level)
+{
+    log_level = level;
+}
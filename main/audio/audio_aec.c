@@ -0,0 +1,288 @@
+/**
+ * @file audio_aec.c
+ * @brief Echo Canceller Implementation
+ *
+ * Delay: the played and captured envelopes (mean |x| per 5 ms block) are
+ * cross-correlated at every lag up to AEC_MAX_DELAY_MS, mean-removed and
+ * smoothed. A lag that leads for AEC_DELAY_CONFIRM_BLOCKS and falls
+ * outside the span the filter covers moves the filter there (and
+ * restarts it); the I2S queue depth then never has to be known.
+ *
+ * Filter: normalised LMS over AEC_TAPS reference samples in float (the
+ * S3 FPU does a multiply-add per cycle; a sliding-window Q15 filter would
+ * miss the aligned PIE path on 7 of 8 samples). The reference window's
+ * energy is updated by one sample in and one out per step.
+ */
+
+#include "audio_aec.h"
+#include "audio_dsp.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+#include <math.h>
+
+static const char *TAG = "AEC";
+
+#define AEC_RING_MASK           (AEC_RING_SAMPLES - 1)
+#define AEC_ENV_MASK            (AEC_ENV_BLOCKS - 1)
+
+// Envelope correlation smoothing (per block) and how long a new lag must
+// lead before the filter moves (200 ms)
+#define AEC_SCORE_ALPHA         (1.0f / 128.0f)
+#define AEC_MEAN_ALPHA          (1.0f / 64.0f)
+#define AEC_DELAY_CONFIRM_BLOCKS 50
+
+// Far end counts as active above this reference peak (~-60 dBFS)
+#define AEC_REF_FLOOR           0.001f
+
+// NLMS regularisation: reference energy floor over the window
+#define AEC_ENERGY_FLOOR        ((float)AEC_TAPS * 1e-6f)
+
+#define AEC_DT_HANGOVER_FRAMES  (AEC_DT_HANGOVER_MS / FRAME_SIZE_MS)
+
+// Start where a filled I2S TX queue puts the echo
+#define AEC_DEFAULT_DELAY       ((I2S_DMA_DESC_NUM - 1) * SAMPLES_PER_FRAME)
+
+#if SAMPLES_PER_FRAME % AEC_BLOCK != 0
+#error "Frames must be whole AEC_BLOCKs (multiples of 5 ms)"
+#endif
+
+#if AEC_DELAY_BLOCKS + SAMPLES_PER_FRAME / AEC_BLOCK + 1 > AEC_ENV_BLOCKS
+#error "AEC_MAX_DELAY_MS too long for AEC_ENV_BLOCKS"
+#endif
+
+#if AEC_TAPS + AEC_DELAY_BLOCKS * AEC_BLOCK + SAMPLES_PER_FRAME > AEC_RING_SAMPLES
+#error "AEC_TAIL_MS + AEC_MAX_DELAY_MS too long for AEC_RING_SAMPLES"
+#endif
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static float block_envelope(const int16_t *pcm, uint32_t start, uint32_t mask)
+{
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < AEC_BLOCK; i++) {
+        int32_t v = pcm[(start + i) & mask];
+        sum += (uint32_t)(v < 0 ? -v : v);
+    }
+    return (float)sum * (1.0f / (32768.0f * AEC_BLOCK));
+}
+
+static void restart_filter(audio_aec_t *aec)
+{
+    memset(aec->weights, 0, sizeof(aec->weights));
+    aec->hold_frames = 0;
+}
+
+// Correlate this frame's mic envelope with the reference at every lag
+// (not during double talk: near-end speech would pull the estimate)
+static void update_delay(audio_aec_t *aec, const int16_t *mic, size_t samples, bool learn)
+{
+    // Block of the reference played with mic block 0 at zero delay
+    uint32_t zero_block = (aec->ref_end - (uint32_t)samples) / AEC_BLOCK;
+    size_t blocks = samples / AEC_BLOCK;
+
+    for (size_t b = 0; b < blocks; b++) {
+        float m = block_envelope(mic, (uint32_t)(b * AEC_BLOCK), UINT32_MAX);
+        aec->mic_env_mean += (m - aec->mic_env_mean) * AEC_MEAN_ALPHA;
+
+        // Nothing to learn while the far end is silent
+        if (!learn || aec->ref_env_mean < AEC_REF_FLOOR) continue;
+
+        float m_dev = m - aec->mic_env_mean;
+        uint32_t block = zero_block + (uint32_t)b;
+        for (uint32_t d = 0; d < AEC_DELAY_BLOCKS && d <= block; d++) {
+            float r_dev = aec->ref_env[(block - d) & AEC_ENV_MASK] - aec->ref_env_mean;
+            aec->score[d] += (m_dev * r_dev - aec->score[d]) * AEC_SCORE_ALPHA;
+        }
+
+        uint32_t best = 0;
+        for (uint32_t d = 1; d < AEC_DELAY_BLOCKS; d++) {
+            if (aec->score[d] > aec->score[best]) best = d;
+        }
+        if (best != aec->best_blocks) {
+            aec->best_blocks = best;
+            aec->best_held = 0;
+            continue;
+        }
+        if (++aec->best_held < AEC_DELAY_CONFIRM_BLOCKS || aec->score[best] <= 0.0f) continue;
+
+        // Move only when the echo has left the span the filter covers;
+        // one block of margin ahead of the estimate
+        uint32_t echo = best * AEC_BLOCK;
+        uint32_t delay = echo >= AEC_BLOCK ? echo - AEC_BLOCK : 0;
+        if (delay == aec->delay_samples ||
+            (echo >= aec->delay_samples + AEC_BLOCK &&
+             echo + AEC_BLOCK <= aec->delay_samples + AEC_TAPS)) {
+            continue;
+        }
+        aec->delay_samples = delay;
+        aec->best_held = 0;
+        aec->stats.delay_ms = aec->delay_samples * 1000 / SAMPLE_RATE_HZ;
+        aec->stats.delay_changes++;
+        restart_filter(aec);
+        ESP_LOGI(TAG, "Echo delay %lu ms", (unsigned long)aec->stats.delay_ms);
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void audio_aec_init(audio_aec_t *aec)
+{
+    if (!aec) return;
+
+    memset(aec, 0, sizeof(*aec));
+    aec->delay_samples = AEC_DEFAULT_DELAY;
+    aec->stats.delay_ms = AEC_DEFAULT_DELAY * 1000 / SAMPLE_RATE_HZ;
+    aec->out_gain = 1.0f;
+}
+
+void audio_aec_reset(audio_aec_t *aec)
+{
+    if (!aec) return;
+
+    restart_filter(aec);
+}
+
+void audio_aec_reference(audio_aec_t *aec, const int16_t *pcm, size_t samples)
+{
+    if (!aec) return;
+
+    uint32_t start = aec->ref_end;
+    for (size_t i = 0; i < samples; i++) {
+        aec->ring[(start + i) & AEC_RING_MASK] = pcm ? pcm[i] : 0;
+    }
+    aec->ref_end = start + (uint32_t)samples;
+
+    // Envelope of every block completed by this frame
+    for (uint32_t block = (start + AEC_BLOCK - 1) / AEC_BLOCK;
+         (block + 1) * AEC_BLOCK <= aec->ref_end; block++) {
+        float r = block_envelope(aec->ring, block * AEC_BLOCK, AEC_RING_MASK);
+        aec->ref_env[block & AEC_ENV_MASK] = r;
+        aec->ref_env_mean += (r - aec->ref_env_mean) * AEC_MEAN_ALPHA;
+    }
+}
+
+void audio_aec_process(audio_aec_t *aec, int16_t *mic, size_t samples)
+{
+#if AEC_ENABLE
+    if (!aec || !mic || samples != SAMPLES_PER_FRAME) return;
+
+    int64_t start_us = esp_timer_get_time();
+
+    // Reference for this frame at the current delay, with the filter's
+    // history in front: mic[n] meets xbuf[n .. n + AEC_TAPS - 1]
+    float xbuf[AEC_TAPS - 1 + SAMPLES_PER_FRAME];
+    uint32_t first = aec->ref_end - (uint32_t)samples - aec->delay_samples - (AEC_TAPS - 1);
+    float ref_peak = 0.0f;
+    for (size_t i = 0; i < AEC_TAPS - 1 + SAMPLES_PER_FRAME; i++) {
+        float v = (float)aec->ring[(first + i) & AEC_RING_MASK] * (1.0f / 32768.0f);
+        xbuf[i] = v;
+        if (fabsf(v) > ref_peak) ref_peak = fabsf(v);
+    }
+
+    bool far_active = ref_peak > AEC_REF_FLOOR;
+
+    // Geigel: the near end is talking if the mic beats what the echo
+    // path could return from the recent far-end peak
+    int16_t mic_peak = 0;
+    for (size_t n = 0; n < samples; n++) {
+        int16_t a = mic[n] < 0 ? (mic[n] == INT16_MIN ? INT16_MAX : -mic[n]) : mic[n];
+        if (a > mic_peak) mic_peak = a;
+    }
+    if ((float)mic_peak * (1.0f / 32768.0f) > AEC_DOUBLE_TALK * ref_peak) {
+        if (far_active) {
+            aec->stats.double_talk++;
+        }
+        aec->hold_frames = AEC_DT_HANGOVER_FRAMES;
+    } else if (aec->hold_frames > 0) {
+        aec->hold_frames--;
+    }
+    bool adapt = far_active && aec->hold_frames == 0;
+
+    // A new delay takes effect from the next frame
+    update_delay(aec, mic, samples, aec->hold_frames == 0);
+
+    // Residual echo is only worth suppressing while the far end talks alone
+    float target_gain = adapt ? AEC_SUPPRESS : 1.0f;
+
+    if (!far_active) {
+        // No echo to cancel: pass through, easing any suppression off
+        for (size_t n = 0; n < samples; n++) {
+            aec->out_gain += (target_gain - aec->out_gain) * (1.0f / 64.0f);
+            mic[n] = audio_dsp_sat16((int32_t)((float)mic[n] * aec->out_gain));
+        }
+    } else {
+        float energy = AEC_ENERGY_FLOOR;
+        for (size_t j = 0; j < AEC_TAPS; j++) {
+            energy += xbuf[j] * xbuf[j];
+        }
+
+        float *w = aec->weights;
+        float mic_power = 0.0f;
+        float res_power = 0.0f;
+        for (size_t n = 0; n < samples; n++) {
+            const float *x = &xbuf[n];
+
+            float y = 0.0f;
+            for (size_t j = 0; j < AEC_TAPS; j++) {
+                y += w[j] * x[j];
+            }
+
+            float d = (float)mic[n] * (1.0f / 32768.0f);
+            float e = d - y;
+            mic_power += d * d;
+            res_power += e * e;
+
+            if (adapt) {
+                float g = AEC_STEP_SIZE * e / energy;
+                for (size_t j = 0; j < AEC_TAPS; j++) {
+                    w[j] += g * x[j];
+                }
+            }
+
+            aec->out_gain += (target_gain - aec->out_gain) * (1.0f / 64.0f);
+            mic[n] = audio_dsp_sat16((int32_t)(e * aec->out_gain * 32768.0f));
+
+            // Slide the window one sample
+            if (n + 1 < samples) {
+                energy += x[AEC_TAPS] * x[AEC_TAPS] - x[0] * x[0];
+                if (energy < AEC_ENERGY_FLOOR) energy = AEC_ENERGY_FLOOR;
+            }
+        }
+
+        // A filter that adds energy has diverged (echo path changed)
+        if (res_power > 4.0f * mic_power + AEC_ENERGY_FLOOR) {
+            restart_filter(aec);
+        }
+
+        if (adapt) {
+            aec->echo_power += (mic_power - aec->echo_power) * (1.0f / 16.0f);
+            aec->residual_power += (res_power - aec->residual_power) * (1.0f / 16.0f);
+        }
+    }
+
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (elapsed_us > aec->stats.worst_us) {
+        aec->stats.worst_us = elapsed_us;
+    }
+#else
+    (void)aec;
+    (void)mic;
+    (void)samples;
+#endif
+}
+
+void audio_aec_get_stats(audio_aec_t *aec, audio_aec_stats_t *stats)
+{
+    if (!aec || !stats) return;
+
+    aec->stats.erle_db = aec->residual_power > 0.0f
+        ? 10.0f * log10f((aec->echo_power + 1e-12f) / aec->residual_power)
+        : 0.0f;
+    *stats = aec->stats;
+    aec->stats.worst_us = 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file audio_aec.h
+ * @brief Echo Canceller (NLMS Against the Played Stream)
+ *
+ * Far-end audio played into a headset leaks back into its microphone and
+ * would return to the party line as echo. The canceller keeps every
+ * played frame in a reference ring, finds the playout-to-capture delay
+ * from the two signals, and subtracts an adaptive (NLMS) estimate of the
+ * echo from each captured frame. A Geigel detector stops adaptation while
+ * the near end talks, and residual echo is attenuated while only the far
+ * end does.
+ *
+ * The audio engine (audio_engine_config_t.echo) calls
+ * audio_aec_reference() with every frame handed to the output (zeros when
+ * nothing plays, so the ring stays time-aligned) and audio_aec_process()
+ * with every captured frame. On the pack the echo is the headset leaking
+ * into the mic; on the base it is the party-line hybrid returning the
+ * packs' own audio to the line input.
+ */
+
+#ifndef AUDIO_AEC_H
+#define AUDIO_AEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../config.h"
+
+// Filter taps, delay search and reference history
+#define AEC_TAPS            ((SAMPLE_RATE_HZ / 1000) * AEC_TAIL_MS)
+#define AEC_BLOCK           (SAMPLE_RATE_HZ / 200)  // Delay search resolution (5 ms)
+#define AEC_DELAY_BLOCKS    ((SAMPLE_RATE_HZ / 1000) * AEC_MAX_DELAY_MS / AEC_BLOCK + 1)
+#define AEC_ENV_BLOCKS      32                  // Envelope history (power of 2)
+#define AEC_RING_SAMPLES    2048                // Reference history (power of 2)
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef struct {
+    uint32_t delay_ms;           // Current playout-to-capture delay estimate
+    uint32_t delay_changes;      // Times the estimate moved (filter restarted)
+    float    erle_db;            // Echo return loss enhancement (far end only)
+    uint32_t double_talk;        // Frames with adaptation held for near-end speech
+    uint32_t worst_us;           // Longest audio_aec_process() since last read
+} audio_aec_stats_t;
+
+typedef struct {
+    // Played samples; ref_end counts every sample pushed
+    int16_t  ring[AEC_RING_SAMPLES];
+    uint32_t ref_end;
+
+    // Envelopes (mean |x| per AEC_BLOCK) for the delay search
+    float    ref_env[AEC_ENV_BLOCKS];
+    float    ref_env_mean;
+    float    mic_env_mean;
+    float    score[AEC_DELAY_BLOCKS];
+    uint32_t best_blocks;        // Candidate delay and how long it has led
+    uint32_t best_held;
+    uint32_t delay_samples;      // Delay the filter runs at
+
+    // Filter, reversed: weights[j] meets the reference AEC_TAPS-1-j back
+    float    weights[AEC_TAPS];
+    uint32_t hold_frames;        // Double-talk hangover
+    float    out_gain;           // Residual suppression gain (ramped)
+    float    echo_power;         // Smoothed mic and residual power (ERLE)
+    float    residual_power;
+
+    audio_aec_stats_t stats;
+} audio_aec_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Reset the canceller (empty reference, delay unknown)
+ */
+void audio_aec_init(audio_aec_t *aec);
+
+/**
+ * @brief Forget the filter, keeping the reference and the delay estimate
+ *
+ * For a capture restart: its DMA phase against playout moves by a
+ * fraction of a frame, so the old weights no longer line up.
+ */
+void audio_aec_reset(audio_aec_t *aec);
+
+/**
+ * @brief Record one frame as it goes to the output
+ * @param pcm Played frame, or NULL for a frame of silence
+ * @param samples Samples in frame
+ */
+void audio_aec_reference(audio_aec_t *aec, const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Remove echo from one captured frame in place
+ * @param samples Must be SAMPLES_PER_FRAME (other sizes pass through)
+ */
+void audio_aec_process(audio_aec_t *aec, int16_t *mic, size_t samples);
+
+/**
+ * @brief Get statistics (the worst time resets on each call)
+ */
+void audio_aec_get_stats(audio_aec_t *aec, audio_aec_stats_t *stats);
+
+#endif // AUDIO_AEC_H
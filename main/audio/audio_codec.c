@@ -2,53 +2,39 @@
  * @file audio_codec.c
  * @brief WM8960 Audio Codec Driver
  *
- * Handles I2C register configuration and I2S audio data transfer
- * for the WM8960 codec. Device-specific register values are selected
- * at compile time based on DEVICE_TYPE_BASE / DEVICE_TYPE_PACK.
+ * Handles register configuration (through wm8960.c) and I2S audio data
+ * transfer for the WM8960 codec. Device-specific register values are
+ * selected at compile time based on DEVICE_TYPE_BASE / DEVICE_TYPE_PACK.
+ * Gain and volume changes are queued for the async register writer, so
+ * the caller never waits on the I2C bus.
+ *
+ * Frame events normally come from the RX channel (a capture frame has
+ * landed); with capture powered down they come from the TX channel
+ * instead (a playout frame has been sent), which runs off the same bit
+ * clock, so the engine keeps its frame rate either way.
  */
 
 #include "audio_codec.h"
+#include "wm8960.h"
 #include "../config.h"
 #include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
 #include "driver/i2s_std.h"
-#include "driver/i2c.h"
+#include <math.h>
 #include <string.h>
 
 static const char *TAG = "CODEC";
 
 //=============================================================================
-// WM8960 REGISTER ADDRESSES
+// WM8960 SETTINGS
 //=============================================================================
 
-#define WM8960_I2C_ADDR         0x1A
-
-#define WM8960_REG_LINVOL       0x00
-#define WM8960_REG_RINVOL       0x01
-#define WM8960_REG_LOUT1        0x02
-#define WM8960_REG_ROUT1        0x03
-#define WM8960_REG_CLOCK1       0x04
-#define WM8960_REG_DACCTL1      0x05
-#define WM8960_REG_IFACE1       0x07
-#define WM8960_REG_LDACVOL      0x0A
-#define WM8960_REG_RDACVOL      0x0B
-#define WM8960_REG_RESET        0x0F
-#define WM8960_REG_LADCVOL      0x15
-#define WM8960_REG_RADCVOL      0x16
-#define WM8960_REG_ADDCTL1      0x17
-#define WM8960_REG_ADDCTL2      0x18
-#define WM8960_REG_POWER1       0x19
-#define WM8960_REG_POWER2       0x1A
-#define WM8960_REG_LINPATH      0x20
-#define WM8960_REG_RINPATH      0x21
-#define WM8960_REG_LOUTMIX      0x22
-#define WM8960_REG_ROUTMIX      0x25
-#define WM8960_REG_LOUT2        0x28
-#define WM8960_REG_ROUT2        0x29
-#define WM8960_REG_POWER3       0x2F
-#define WM8960_REG_LINBOOST     0x2B
-#define WM8960_REG_RINBOOST     0x2C
-#define WM8960_REG_ADDCTL4      0x30
-#define WM8960_REG_CLASSD1      0x31
+// POWER1 with the ADCs on, and with only the ADCs off: VMID, VREF, the
+// input PGAs and mic bias stay up, so capture is back within a frame
+// without a settling pop, and the analogue sidetone keeps working
+#define WM8960_POWER1_CAPTURE   0x1FE
+#define WM8960_POWER1_LISTEN    0x1F2
 
 //=============================================================================
 // PRIVATE VARIABLES
@@ -58,160 +44,140 @@ static bool initialized = false;
 static i2s_chan_handle_t tx_handle = NULL;
 static i2s_chan_handle_t rx_handle = NULL;
 
-//=============================================================================
-// I2C COMMUNICATION
-//=============================================================================
-
-static esp_err_t wm8960_write_reg(uint8_t reg, uint16_t value)
-{
-    uint8_t data[2];
-    data[0] = (reg << 1) | ((value >> 8) & 0x01);
-    data[1] = value & 0xFF;
-
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (WM8960_I2C_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(cmd, data, 2, true);
-    i2c_master_stop(cmd);
-
-    esp_err_t ret = i2c_master_cmd_begin(I2C_NUM_0, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2C write failed: reg=0x%02X val=0x%03X err=%d", reg, value, ret);
-    }
-
-    return ret;
-}
-
-static esp_err_t wm8960_init_i2c(void)
-{
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_SDA_PIN,
-        .scl_io_num = I2C_SCL_PIN,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = 100000,
-    };
-
-    esp_err_t ret = i2c_param_config(I2C_NUM_0, &conf);
-    if (ret != ESP_OK) return ret;
-
-    return i2c_driver_install(I2C_NUM_0, conf.mode, 0, 0, 0);
-}
+static volatile audio_codec_frame_cb_t frame_callback = NULL;
+static void *volatile frame_callback_ctx = NULL;
+static volatile uint32_t rx_overruns = 0;
+static bool streaming = false;       // I2S channels enabled
+static volatile bool capturing = true;  // ADCs powered and RX enabled
 
 //=============================================================================
 // WM8960 REGISTER CONFIGURATION
 //=============================================================================
 
-static esp_err_t wm8960_configure(void)
-{
-    ESP_LOGI(TAG, "Configuring WM8960...");
-
-    // Reset
-    if (wm8960_write_reg(WM8960_REG_RESET, 0x000) != ESP_OK) {
-        ESP_LOGE(TAG, "WM8960 not responding");
-        return ESP_FAIL;
-    }
-    vTaskDelay(pdMS_TO_TICKS(100));
-
+// Written in order after the reset; the shadow drops the repeats
+static const wm8960_write_t config_seq[] = {
     // --- Power ---
     // POWER1: VMIDSEL=50k divider + VREF + AINL
-    if (wm8960_write_reg(WM8960_REG_POWER1, 0x1C0) != ESP_OK) return ESP_FAIL;
-
+    { WM8960_REG_POWER1,   0x1C0 },
 #if DEVICE_TYPE_BASE
     // Base: DACs + LOUT1/ROUT1 + SPK, no PLL (MCLK is direct from ESP32)
-    if (wm8960_write_reg(WM8960_REG_POWER2, 0x0F8) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_POWER2,   0x0F8 },
 #else
     // Pack: DACs + LOUT1/ROUT1 + SPKL/SPKR + PLL
-    if (wm8960_write_reg(WM8960_REG_POWER2, 0x1F8) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_POWER2,   0x1F8 },
 #endif
-
     // POWER3: Output mixers enabled
-    if (wm8960_write_reg(WM8960_REG_POWER3, 0x00C) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_POWER3,   0x00C },
 
     // --- Clock & Interface ---
-    if (wm8960_write_reg(WM8960_REG_CLOCK1, 0x000) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_IFACE1, 0x002) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_CLOCK1,   0x000 },
+    { WM8960_REG_IFACE1,   0x002 },
 
     // --- DAC ---
-    if (wm8960_write_reg(WM8960_REG_DACCTL1, 0x000) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_LDACVOL, 0x1FF) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_RDACVOL, 0x1FF) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_DACCTL1,  0x000 },
+#if DEVICE_TYPE_BASE
+    // DACPOL = right inverted: differential transformer drive from one
+    // mono I2S stream
+    { WM8960_REG_DACCTL2,  0x040 },
+#else
+    // Pack: same signal on both channels
+    { WM8960_REG_DACCTL2,  0x000 },
+#endif
+    { WM8960_REG_LDACVOL,  0x1FF },
+    { WM8960_REG_RDACVOL,  0x1FF },
 
     // --- Output Mixers ---
 #if DEVICE_TYPE_BASE
     // Base: DAC only to output mixer (bit 8 = LD2LO/RD2RO)
     // Do NOT enable bit 7 (LI2LO) - LINPUT3 is floating
-    if (wm8960_write_reg(WM8960_REG_LOUTMIX, 0x100) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ROUTMIX, 0x100) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LOUTMIX,  0x100 },
+    { WM8960_REG_ROUTMIX,  0x100 },
 #else
     // Pack: DAC + bypass input to output (for sidetone path)
-    if (wm8960_write_reg(WM8960_REG_LOUTMIX, 0x180) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ROUTMIX, 0x180) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LOUTMIX,  0x180 },
+    { WM8960_REG_ROUTMIX,  0x180 },
 #endif
 
     // --- Output Volumes ---
 #if DEVICE_TYPE_BASE
     // Base: LOUT1/ROUT1 drive transformer for partyline - max volume
-    if (wm8960_write_reg(WM8960_REG_LOUT1, 0x17F) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ROUT1, 0x17F) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LOUT1,    0x17F },
+    { WM8960_REG_ROUT1,    0x17F },
     // LOUT2/ROUT2 also max (differential output through transformer)
-    if (wm8960_write_reg(WM8960_REG_LOUT2, 0x1FF) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ROUT2, 0x1FF) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LOUT2,    0x1FF },
+    { WM8960_REG_ROUT2,    0x1FF },
     // Class D disabled - using analog outputs for transformer
-    if (wm8960_write_reg(WM8960_REG_CLASSD1, 0x000) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_CLASSD1,  0x000 },
 #else
     // Pack: Headphone output volumes
-    if (wm8960_write_reg(WM8960_REG_LOUT1, 0x161) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ROUT1, 0x161) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LOUT1,    0x161 },
+    { WM8960_REG_ROUT1,    0x161 },
     // Speaker output volumes
-    if (wm8960_write_reg(WM8960_REG_LOUT2, 0x177) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ROUT2, 0x177) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LOUT2,    0x177 },
+    { WM8960_REG_ROUT2,    0x177 },
     // Class D enabled for speaker
-    if (wm8960_write_reg(WM8960_REG_CLASSD1, 0x0F7) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_CLASSD1,  0x0F7 },
 #endif
 
     // --- Jack Detect: DISABLED for both devices ---
     // Base has no headphone jack (transformer output)
     // Pack doesn't need auto-mute behavior
-    if (wm8960_write_reg(WM8960_REG_ADDCTL2, 0x000) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_ADDCTL4, 0x000) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_ADDCTL2,  0x000 },
+    { WM8960_REG_ADDCTL4,  0x000 },
 
     // --- ADC Input Configuration ---
     // Enable both ADCs and input mixers
-    if (wm8960_write_reg(WM8960_REG_POWER1, 0x1FE) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_POWER3, 0x03C) != ESP_OK) return ESP_FAIL;
-
+    { WM8960_REG_POWER1,   WM8960_POWER1_CAPTURE },
+    { WM8960_REG_POWER3,   0x03C },
 #if DEVICE_TYPE_BASE
     // Base: Differential input from partyline transformer
     // LINPUT1 inverting + LINPUT2 non-inverting, PGA to boost, +20dB
-    if (wm8960_write_reg(WM8960_REG_LINPATH, 0x158) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_RINPATH, 0x158) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LINPATH,  0x158 },
+    { WM8960_REG_RINPATH,  0x158 },
 #else
     // Pack: Single-ended mic input on LINPUT1
     // LMN1 + LMIC2B + 20dB boost
-    if (wm8960_write_reg(WM8960_REG_LINPATH, 0x138) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_RINPATH, 0x138) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LINPATH,  0x138 },
+    { WM8960_REG_RINPATH,  0x138 },
 #endif
-
     // Input boost: disable direct LINPUT2/LINPUT3 paths (use PGA path only)
-    if (wm8960_write_reg(WM8960_REG_LINBOOST, 0x000) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_RINBOOST, 0x000) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LINBOOST, 0x000 },
+    { WM8960_REG_RINBOOST, 0x000 },
 
     // ADC volumes: 0dB
-    if (wm8960_write_reg(WM8960_REG_LADCVOL, 0x1C3) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_RADCVOL, 0x1C3) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LADCVOL,  0x1C3 },
+    { WM8960_REG_RADCVOL,  0x1C3 },
 
     // Input PGA volumes: +30dB
-    if (wm8960_write_reg(WM8960_REG_LINVOL, 0x13F) != ESP_OK) return ESP_FAIL;
-    if (wm8960_write_reg(WM8960_REG_RINVOL, 0x13F) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_LINVOL,   0x13F },
+    { WM8960_REG_RINVOL,   0x13F },
 
     // Additional Control 1: ADC HPF enabled, thermal shutdown enabled
-    if (wm8960_write_reg(WM8960_REG_ADDCTL1, 0x0C0) != ESP_OK) return ESP_FAIL;
+    { WM8960_REG_ADDCTL1,  0x0C0 },
+};
+
+static esp_err_t wm8960_configure(void)
+{
+    ESP_LOGI(TAG, "Configuring WM8960...");
+
+    if (wm8960_reset() != ESP_OK) {
+        ESP_LOGE(TAG, "WM8960 not responding");
+        return ESP_FAIL;
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+
+    wm8960_stats_t before, after;
+    wm8960_get_stats(&before);
+    int64_t start_us = esp_timer_get_time();
+    if (wm8960_write_seq(config_seq, sizeof(config_seq) / sizeof(config_seq[0])) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    wm8960_get_stats(&after);
 
-    ESP_LOGI(TAG, "WM8960 configured");
+    ESP_LOGI(TAG, "WM8960 configured (%lu writes, %lu skipped, %lu us)",
+             (unsigned long)(after.writes - before.writes),
+             (unsigned long)(after.skipped - before.skipped),
+             (unsigned long)(esp_timer_get_time() - start_us));
     return ESP_OK;
 }
 
@@ -219,18 +185,43 @@ static esp_err_t wm8960_configure(void)
 // I2S INITIALIZATION
 //=============================================================================
 
+static bool IRAM_ATTR on_rx_frame(i2s_chan_handle_t handle, i2s_event_data_t *event, void *ctx)
+{
+    audio_codec_frame_cb_t callback = frame_callback;
+    return callback && capturing ? callback(frame_callback_ctx) : false;
+}
+
+// Frame clock while capture is off: one TX descriptor sent per frame
+static bool IRAM_ATTR on_tx_frame(i2s_chan_handle_t handle, i2s_event_data_t *event, void *ctx)
+{
+    audio_codec_frame_cb_t callback = frame_callback;
+    return callback && !capturing ? callback(frame_callback_ctx) : false;
+}
+
+static bool IRAM_ATTR on_rx_overrun(i2s_chan_handle_t handle, i2s_event_data_t *event, void *ctx)
+{
+    rx_overruns++;
+    return false;
+}
+
 static esp_err_t wm8960_init_i2s(void)
 {
+    // One descriptor per frame: DMA completes exactly on frame boundaries
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_0, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = I2S_DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = SAMPLES_PER_FRAME;
+    chan_cfg.auto_clear = true;     // Underrun plays silence, not stale audio
     ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, &tx_handle, &rx_handle));
 
+    // Mono slots: TX duplicates each sample to both channels, RX keeps
+    // only the left ADC - no interleave/deinterleave on the CPU
     i2s_std_config_t std_cfg = {
         .clk_cfg = {
             .sample_rate_hz = SAMPLE_RATE_HZ,
             .clk_src = I2S_CLK_SRC_DEFAULT,
             .mclk_multiple = I2S_MCLK_MULTIPLE_256,
         },
-        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_STEREO),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
         .gpio_cfg = {
             .mclk = I2S_MCLK_PIN,
             .bclk = I2S_BCLK_PIN,
@@ -244,14 +235,31 @@ static esp_err_t wm8960_init_i2s(void)
             },
         },
     };
-
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_BOTH;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(tx_handle, &std_cfg));
+
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle, &std_cfg));
+
+    i2s_event_callbacks_t rx_cbs = {
+        .on_recv = on_rx_frame,
+        .on_recv_q_ovf = on_rx_overrun,
+    };
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(rx_handle, &rx_cbs, NULL));
+
+    i2s_event_callbacks_t tx_cbs = {
+        .on_sent = on_tx_frame,
+    };
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(tx_handle, &tx_cbs, NULL));
+
     ESP_ERROR_CHECK(i2s_channel_enable(tx_handle));
     ESP_ERROR_CHECK(i2s_channel_enable(rx_handle));
+    streaming = true;
+    capturing = true;
 
-    ESP_LOGI(TAG, "I2S initialized (MCLK GPIO%d, %.3f MHz)",
-             I2S_MCLK_PIN, (float)(SAMPLE_RATE_HZ * 256) / 1000000.0f);
+    ESP_LOGI(TAG, "I2S initialized (MCLK GPIO%d, %.3f MHz, mono, %d x %d-sample DMA)",
+             I2S_MCLK_PIN, (float)(SAMPLE_RATE_HZ * 256) / 1000000.0f,
+             I2S_DMA_DESC_NUM, SAMPLES_PER_FRAME);
     return ESP_OK;
 }
 
@@ -267,7 +275,7 @@ esp_err_t audio_codec_init(void)
 
     ESP_LOGI(TAG, "Initializing WM8960...");
 
-    esp_err_t ret = wm8960_init_i2c();
+    esp_err_t ret = wm8960_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "I2C init failed");
         return ret;
@@ -276,14 +284,14 @@ esp_err_t audio_codec_init(void)
     ret = wm8960_configure();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "WM8960 configuration failed - check hardware");
-        i2c_driver_delete(I2C_NUM_0);
+        wm8960_deinit();
         return ret;
     }
 
     ret = wm8960_init_i2s();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "I2S init failed");
-        i2c_driver_delete(I2C_NUM_0);
+        wm8960_deinit();
         return ret;
     }
 
@@ -308,9 +316,11 @@ esp_err_t audio_codec_set_input_gain(uint8_t gain)
 {
     if (gain > 31) gain = 31;
     uint16_t reg_val = 0x100 | (gain & 0x3F);
-    wm8960_write_reg(WM8960_REG_LINVOL, reg_val);
-    wm8960_write_reg(WM8960_REG_RINVOL, reg_val);
-    return ESP_OK;
+    const wm8960_write_t seq[] = {
+        { WM8960_REG_LINVOL, reg_val },
+        { WM8960_REG_RINVOL, reg_val },
+    };
+    return wm8960_write_async(seq, 2);
 }
 
 esp_err_t audio_codec_set_output_volume(uint8_t volume)
@@ -323,10 +333,11 @@ esp_err_t audio_codec_set_output_volume(uint8_t volume)
     uint16_t vol_reg = volume;  // Direct 1:1 mapping to WM8960 register
     uint16_t reg_val = 0x100 | vol_reg;  // Bit 8 = update both L/R together
 
-    wm8960_write_reg(WM8960_REG_LOUT1, reg_val);
-    wm8960_write_reg(WM8960_REG_ROUT1, reg_val);
-
-    return ESP_OK;
+    const wm8960_write_t seq[] = {
+        { WM8960_REG_LOUT1, reg_val },
+        { WM8960_REG_ROUT1, reg_val },
+    };
+    return wm8960_write_async(seq, 2);
 }
 
 esp_err_t audio_codec_read(int16_t *buffer, size_t sample_count, size_t *samples_read)
@@ -336,26 +347,13 @@ esp_err_t audio_codec_read(int16_t *buffer, size_t sample_count, size_t *samples
         return ESP_FAIL;
     }
 
-    static int16_t stereo_buffer[SAMPLES_PER_FRAME * 2];
-
+    // Mono slot: DMA data is already the left channel
     size_t bytes_read = 0;
-    size_t bytes_to_read = sample_count * 2 * sizeof(int16_t);
-
-    esp_err_t ret = i2s_channel_read(rx_handle, stereo_buffer, bytes_to_read,
-                                     &bytes_read, portMAX_DELAY);
-    if (ret != ESP_OK) {
-        if (samples_read) *samples_read = 0;
-        return ret;
-    }
+    esp_err_t ret = i2s_channel_read(rx_handle, buffer, sample_count * sizeof(int16_t),
+                                     &bytes_read, pdMS_TO_TICKS(I2S_IO_TIMEOUT_MS));
 
-    // Extract left channel (mono)
-    size_t mono_samples = bytes_read / (2 * sizeof(int16_t));
-    for (size_t i = 0; i < mono_samples; i++) {
-        buffer[i] = stereo_buffer[i * 2];
-    }
-
-    if (samples_read) *samples_read = mono_samples;
-    return ESP_OK;
+    if (samples_read) *samples_read = bytes_read / sizeof(int16_t);
+    return ret;
 }
 
 esp_err_t audio_codec_write(const int16_t *buffer, size_t sample_count)
@@ -364,28 +362,104 @@ esp_err_t audio_codec_write(const int16_t *buffer, size_t sample_count)
         return ESP_FAIL;
     }
 
-    static int16_t stereo_buffer[SAMPLES_PER_FRAME * 2];
+    // Mono slot: hardware sends each sample to both channels; the base's
+    // right channel is inverted by the DAC (DACPOL)
+    size_t bytes_written = 0;
+    esp_err_t ret = i2s_channel_write(tx_handle, buffer, sample_count * sizeof(int16_t),
+                                      &bytes_written, pdMS_TO_TICKS(I2S_IO_TIMEOUT_MS));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2S write failed: %d", ret);
+    }
+    return ret;
+}
 
-    for (size_t i = 0; i < sample_count; i++) {
-        stereo_buffer[i * 2] = buffer[i];
-#if DEVICE_TYPE_BASE
-        // Invert right channel for differential transformer output
-        stereo_buffer[i * 2 + 1] = -buffer[i];
-#else
-        // Pack: same signal on both channels
-        stereo_buffer[i * 2 + 1] = buffer[i];
-#endif
+void audio_codec_set_frame_callback(audio_codec_frame_cb_t callback, void *ctx)
+{
+    frame_callback = NULL;
+    frame_callback_ctx = ctx;
+    frame_callback = callback;
+}
+
+esp_err_t audio_codec_set_streaming(bool enable)
+{
+    if (!initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (enable == streaming) {
+        return ESP_OK;
     }
 
-    size_t bytes_written = 0;
-    size_t bytes_to_write = sample_count * 2 * sizeof(int16_t);
+    // The I2S driver holds its power-management lock while enabled
+    // RX only runs while capturing (audio_codec_set_capture)
+    esp_err_t ret;
+    if (enable) {
+        ret = i2s_channel_enable(tx_handle);
+        if (ret == ESP_OK && capturing) {
+            ret = i2s_channel_enable(rx_handle);
+        }
+    } else {
+        ret = capturing ? i2s_channel_disable(rx_handle) : ESP_OK;
+        if (ret == ESP_OK) {
+            ret = i2s_channel_disable(tx_handle);
+        }
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2S %s failed: %s", enable ? "start" : "stop", esp_err_to_name(ret));
+        return ret;
+    }
+
+    streaming = enable;
+    ESP_LOGI(TAG, "I2S %s", enable ? "streaming" : "stopped");
+    return ESP_OK;
+}
 
-    esp_err_t ret = i2s_channel_write(tx_handle, stereo_buffer, bytes_to_write,
-                                      &bytes_written, portMAX_DELAY);
+esp_err_t audio_codec_set_capture(bool enable)
+{
+    if (!initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (enable == capturing) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (enable) {
+        // ADCs first, so the first DMA frame is already converted audio
+        ret = wm8960_write(WM8960_REG_POWER1, WM8960_POWER1_CAPTURE);
+        if (ret == ESP_OK && streaming) {
+            ret = i2s_channel_enable(rx_handle);
+        }
+        if (ret == ESP_OK) {
+            capturing = true;
+        }
+    } else {
+        // Frame events move to TX before RX stops, so none is missed
+        capturing = false;
+        if (streaming) {
+            ret = i2s_channel_disable(rx_handle);
+        }
+        if (ret == ESP_OK) {
+            ret = wm8960_write(WM8960_REG_POWER1, WM8960_POWER1_LISTEN);
+        }
+    }
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2S write failed: %d", ret);
+        ESP_LOGE(TAG, "Capture %s failed: %s", enable ? "power-up" : "power-down",
+                 esp_err_to_name(ret));
+        return ret;
     }
-    return ret;
+
+    ESP_LOGD(TAG, "Capture %s", enable ? "on" : "off (listen only)");
+    return ESP_OK;
+}
+
+bool audio_codec_is_capturing(void)
+{
+    return capturing;
+}
+
+uint32_t audio_codec_get_rx_overruns(void)
+{
+    return rx_overruns;
 }
 
 bool audio_codec_is_initialized(void)
@@ -395,14 +469,35 @@ bool audio_codec_is_initialized(void)
 
 esp_err_t audio_codec_set_sidetone(bool enable, float level)
 {
-    ESP_LOGI(TAG, "Sidetone: %s (%.2f)", enable ? "ON" : "OFF", level);
-    return ESP_OK;
+#if DEVICE_TYPE_PACK
+    // Output mixers: DAC always (bit 8), plus the input bypass (bit 7) at
+    // LI2LOVOL/RI2ROVOL (bits 6:4), 0 dB down to -21 dB in 3 dB steps
+    uint16_t mix = 0x100;
+    if (enable && level > 0.0f) {
+        float atten_db = level >= 1.0f ? 0.0f : -20.0f * log10f(level);
+        int step = (int)(atten_db / 3.0f + 0.5f);
+        if (step > 7) step = 7;
+        mix |= 0x080 | (uint16_t)(step << 4);
+    }
+
+    ESP_LOGI(TAG, "Sidetone: %s (%.2f)", (mix & 0x080) ? "ON" : "OFF", level);
+    const wm8960_write_t seq[] = {
+        { WM8960_REG_LOUTMIX, mix },
+        { WM8960_REG_ROUTMIX, mix },
+    };
+    return wm8960_write_async(seq, 2);
+#else
+    // The base's bypass input (LINPUT3) is floating
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
 }
 
 void audio_codec_deinit(void)
 {
     if (!initialized) return;
 
+    streaming = false;
+    capturing = true;
     if (tx_handle) {
         i2s_channel_disable(tx_handle);
         i2s_del_channel(tx_handle);
@@ -414,7 +509,7 @@ void audio_codec_deinit(void)
         rx_handle = NULL;
     }
 
-    i2c_driver_delete(I2C_NUM_0);
+    wm8960_deinit();
     initialized = false;
     ESP_LOGI(TAG, "Codec deinitialized");
 }
@@ -4,6 +4,15 @@
  *
  * I2S and I2C driver for WM8960 audio codec.
  * Device-specific configuration selected at compile time.
+ *
+ * I2S runs in mono slot mode with one DMA descriptor per frame: capture
+ * takes the left ADC slot and playback is duplicated to both DAC slots
+ * in hardware (the base's differential inversion is done by the codec's
+ * DAC polarity control), so reads and writes go straight between the
+ * caller's buffer and DMA with no CPU copy or shared state.
+ *
+ * Capture can be powered down on its own (ADCs and I2S RX) while playout
+ * carries on; frame events then come from the TX channel.
  */
 
 #ifndef AUDIO_CODEC_H
@@ -27,6 +36,16 @@ typedef enum {
     CODEC_OUTPUT_LINE
 } codec_output_t;
 
+/**
+ * @brief Frame-ready callback (ISR context)
+ *
+ * Called each time a full capture frame lands in DMA; the next
+ * audio_codec_read() then returns without blocking.
+ * @param ctx Context given at registration
+ * @return true if a higher-priority task was woken
+ */
+typedef bool (*audio_codec_frame_cb_t)(void *ctx);
+
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
@@ -36,8 +55,67 @@ esp_err_t audio_codec_set_input(codec_input_t input);
 esp_err_t audio_codec_set_output(codec_output_t output);
 esp_err_t audio_codec_set_input_gain(uint8_t gain);
 esp_err_t audio_codec_set_output_volume(uint8_t volume);
+
+/**
+ * @brief Read mono capture samples
+ *
+ * Blocks until the samples are in (at most I2S_IO_TIMEOUT_MS).
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if I2S stalled
+ */
 esp_err_t audio_codec_read(int16_t *buffer, size_t sample_count, size_t *samples_read);
+
+/**
+ * @brief Write mono playback samples (sent to both DAC channels)
+ *
+ * Blocks while DMA is full (at most I2S_IO_TIMEOUT_MS).
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if I2S stalled
+ */
 esp_err_t audio_codec_write(const int16_t *buffer, size_t sample_count);
+
+/**
+ * @brief Register a frame-ready callback for interrupt-driven capture
+ * @param callback Called from the I2S ISR per capture frame (NULL = off)
+ * @param ctx Passed to the callback
+ */
+void audio_codec_set_frame_callback(audio_codec_frame_cb_t callback, void *ctx);
+
+/**
+ * @brief Start or stop both I2S channels (codec registers untouched)
+ *
+ * Stopped, the I2S clocks and DMA are off and no frame events arrive;
+ * the chip can then light-sleep. Pending DMA frames are dropped.
+ * @return ESP_OK, ESP_ERR_INVALID_STATE before audio_codec_init
+ */
+esp_err_t audio_codec_set_streaming(bool enable);
+
+/**
+ * @brief Power the capture path up or down (ADCs and I2S RX)
+ *
+ * Down, the codec's ADCs are off and RX DMA is stopped, and the frame
+ * callback is driven by sent TX frames instead; audio_codec_read must not
+ * be called. Up, the first capture frame lands one DMA frame later. The
+ * input PGAs and mic bias stay powered, so nothing has to settle.
+ * @return ESP_OK, ESP_ERR_INVALID_STATE before audio_codec_init, or the
+ *         I2C/I2S error
+ */
+esp_err_t audio_codec_set_capture(bool enable);
+
+/**
+ * @brief Check if the capture path is powered
+ */
+bool audio_codec_is_capturing(void);
+
+/**
+ * @brief Capture frames lost because DMA wrapped before they were read
+ */
+uint32_t audio_codec_get_rx_overruns(void);
+
+/**
+ * @brief Set the analogue sidetone (mic bypass into the headset mix, pack)
+ * @param enable Bypass on
+ * @param level 0.0-1.0, applied in the codec's 3 dB steps (0 dB to -21 dB)
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED on the base
+ */
 esp_err_t audio_codec_set_sidetone(bool enable, float level);
 void audio_codec_deinit(void);
 
@@ -0,0 +1,203 @@
+/**
+ * @file audio_drift.c
+ * @brief Far-End Clock Drift Measurement and Compensation Implementation
+ *
+ * Measurement: err = remote elapsed - local elapsed. Network delay only
+ * ever makes err smaller, so the largest err in each DRIFT_WINDOW_MS
+ * window is the least-delayed sample of the clock offset. The drift is
+ * the slope of those maxima across the last DRIFT_WINDOWS windows,
+ * smoothed, and clamped to DRIFT_MAX_PPM.
+ *
+ * Resampling: 4-point cubic Hermite interpolation at a Q32.32 read
+ * position stepping by 1 + ppm per output sample. At zero drift the
+ * position stays on whole samples and the output equals the input.
+ */
+
+#include "audio_drift.h"
+#include "audio_engine.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "DRIFT";
+
+// Offset jump treated as a restart of the far end, not drift (us)
+#define DRIFT_RESYNC_US         500000
+
+// Shortest span the slope is taken over (us)
+#define DRIFT_MIN_SPAN_US       ((int64_t)DRIFT_WINDOW_MS * 1000 * 3)
+
+// Smoothing of successive slope estimates (1/N per window)
+#define DRIFT_SMOOTHING         8
+
+#define Q32_ONE                 ((uint64_t)1 << 32)
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void restart_measurement(audio_drift_t *drift, uint32_t remote_ts, int64_t local_us)
+{
+    drift->have_origin = true;
+    drift->last_remote_ts = remote_ts;
+    drift->remote_us = 0;
+    drift->local_origin_us = local_us;
+    drift->window_start_us = local_us;
+    drift->window_max_err_us = 0;
+    drift->window_max_at_us = local_us;
+    drift->win_head = 0;
+    drift->win_count = 0;
+}
+
+static void close_window(audio_drift_t *drift)
+{
+    drift->win_local_us[drift->win_head] = drift->window_max_at_us;
+    drift->win_err_us[drift->win_head] = drift->window_max_err_us;
+    drift->win_head = (drift->win_head + 1) % DRIFT_WINDOWS;
+    if (drift->win_count < DRIFT_WINDOWS) drift->win_count++;
+
+    if (drift->win_count < 2) return;
+
+    size_t newest = (drift->win_head + DRIFT_WINDOWS - 1) % DRIFT_WINDOWS;
+    size_t oldest = (drift->win_head + DRIFT_WINDOWS - drift->win_count) % DRIFT_WINDOWS;
+    int64_t span_us = drift->win_local_us[newest] - drift->win_local_us[oldest];
+    if (span_us < DRIFT_MIN_SPAN_US) return;
+
+    float slope_ppm = (float)(drift->win_err_us[newest] - drift->win_err_us[oldest]) *
+                      1000000.0f / (float)span_us;
+    if (slope_ppm > DRIFT_MAX_PPM) slope_ppm = DRIFT_MAX_PPM;
+    if (slope_ppm < -DRIFT_MAX_PPM) slope_ppm = -DRIFT_MAX_PPM;
+
+    if (!drift->locked) {
+        drift->ppm = slope_ppm;
+        drift->locked = true;
+        ESP_LOGI(TAG, "Locked: far end %+.1f ppm", slope_ppm);
+    } else {
+        drift->ppm += (slope_ppm - drift->ppm) / DRIFT_SMOOTHING;
+    }
+}
+
+static inline int16_t hermite(const int16_t *x, float t)
+{
+    // x[-1..2] around the read position, t in [0, 1)
+    float xm1 = x[-1], x0 = x[0], x1 = x[1], x2 = x[2];
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    float y = ((c3 * t + c2) * t + c1) * t + x0;
+
+    if (y > 32767.0f) return 32767;
+    if (y < -32768.0f) return -32768;
+    return (int16_t)y;
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void audio_drift_reset(audio_drift_t *drift)
+{
+    if (!drift) return;
+
+    memset(drift, 0, sizeof(*drift));
+}
+
+void audio_drift_note_arrival(audio_drift_t *drift, uint32_t remote_timestamp_us)
+{
+#if DRIFT_COMP_ENABLE
+    if (!drift) return;
+
+    int64_t local_us = audio_engine_clock_us();
+
+    if (!drift->have_origin) {
+        restart_measurement(drift, remote_timestamp_us, local_us);
+        return;
+    }
+
+    // Timestamps are 32-bit microseconds: unwrap by step
+    drift->remote_us += (int32_t)(remote_timestamp_us - drift->last_remote_ts);
+    drift->last_remote_ts = remote_timestamp_us;
+
+    int64_t err_us = drift->remote_us - (local_us - drift->local_origin_us);
+
+    // Far end rebooted or we lost it for a long time: start over, keep
+    // the ppm estimate (same crystals)
+    int64_t reference_us = drift->win_count > 0
+        ? drift->win_err_us[(drift->win_head + DRIFT_WINDOWS - 1) % DRIFT_WINDOWS]
+        : drift->window_max_err_us;
+    if (err_us - reference_us > DRIFT_RESYNC_US || reference_us - err_us > DRIFT_RESYNC_US) {
+        restart_measurement(drift, remote_timestamp_us, local_us);
+        return;
+    }
+
+    if (local_us - drift->window_start_us >= (int64_t)DRIFT_WINDOW_MS * 1000) {
+        close_window(drift);
+        drift->window_start_us = local_us;
+        drift->window_max_err_us = err_us;
+        drift->window_max_at_us = local_us;
+    } else if (err_us > drift->window_max_err_us) {
+        drift->window_max_err_us = err_us;
+        drift->window_max_at_us = local_us;
+    }
+#else
+    (void)drift;
+    (void)remote_timestamp_us;
+#endif
+}
+
+int audio_drift_playout(audio_drift_t *drift, audio_drift_pull_t pull, void *ctx,
+                        int16_t *out, size_t samples)
+{
+    if (!drift || !pull || !out) return 0;
+    if (samples > SAMPLES_PER_FRAME) samples = SAMPLES_PER_FRAME;
+
+    // 1 + ppm input samples per output sample
+    int64_t step_adj = (int64_t)(drift->ppm * 4294.967296f);
+    uint64_t step = (uint64_t)((int64_t)Q32_ONE + step_adj);
+
+    for (size_t i = 0; i < samples; i++) {
+        size_t index = (size_t)(drift->pos >> 32);
+
+        // Interpolation needs x[-1..2]
+        while (index + 2 >= drift->fill) {
+            if (drift->fill == 0) {
+                // Fresh stream: one sample of history, read from x[1]
+                int pulled = pull(ctx, &drift->fifo[1], SAMPLES_PER_FRAME);
+                if (pulled <= 0) return 0;
+                drift->fifo[0] = drift->fifo[1];
+                drift->fill = 1 + (size_t)pulled;
+                drift->pos = Q32_ONE;
+                index = 1;
+                continue;
+            }
+
+            size_t space = sizeof(drift->fifo) / sizeof(drift->fifo[0]) - drift->fill;
+            int pulled = pull(ctx, &drift->fifo[drift->fill],
+                              space < SAMPLES_PER_FRAME ? space : SAMPLES_PER_FRAME);
+            if (pulled <= 0) {
+                // Stream went idle mid-frame: start clean next time
+                drift->fill = 0;
+                drift->pos = 0;
+                return 0;
+            }
+            drift->fill += (size_t)pulled;
+        }
+
+        out[i] = hermite(&drift->fifo[index], (float)(uint32_t)drift->pos * (1.0f / 4294967296.0f));
+        drift->pos += step;
+    }
+
+    // Keep one sample of history in front of the read position
+    size_t consumed = (size_t)(drift->pos >> 32) - 1;
+    if (consumed > 0) {
+        memmove(drift->fifo, &drift->fifo[consumed], (drift->fill - consumed) * sizeof(int16_t));
+        drift->fill -= consumed;
+        drift->pos -= (uint64_t)consumed << 32;
+    }
+
+    return (int)samples;
+}
+
+float audio_drift_get_ppm(const audio_drift_t *drift)
+{
+    return drift ? drift->ppm : 0.0f;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file audio_drift.h
+ * @brief Far-End Clock Drift Measurement and Compensation
+ *
+ * The far end captures on its own crystal, so its frames arrive slightly
+ * faster or slower than our I2S clock plays them out and a jitter buffer
+ * slowly fills or drains over a long show. Each received frame's sender
+ * timestamp is compared against the local I2S clock
+ * (audio_engine_clock_us); the slope of the minimum-delay offset over a
+ * few minutes is the drift in ppm. Playout then runs through a cubic
+ * resampler that consumes input at (1 + ppm) times the local rate, so the
+ * buffer depth stays put without ever dropping or repeating a frame.
+ *
+ * One instance per received stream. note_arrival() runs in the RX task,
+ * playout() in the audio engine.
+ */
+
+#ifndef AUDIO_DRIFT_H
+#define AUDIO_DRIFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../config.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+/**
+ * @brief Supplies the next frame of the stream, in order
+ * @param ctx Context given to audio_drift_playout
+ * @param pcm Output buffer
+ * @param samples Samples wanted
+ * @return Samples produced, 0 = stream idle
+ */
+typedef int (*audio_drift_pull_t)(void *ctx, int16_t *pcm, size_t samples);
+
+typedef struct {
+    // Measurement (RX task)
+    bool     have_origin;
+    uint32_t last_remote_ts;
+    int64_t  remote_us;            // Far-end time since origin, unwrapped
+    int64_t  local_origin_us;
+    int64_t  window_start_us;
+    int64_t  window_max_err_us;    // Least-delayed arrival in this window
+    int64_t  window_max_at_us;
+    int64_t  win_local_us[DRIFT_WINDOWS];
+    int64_t  win_err_us[DRIFT_WINDOWS];
+    size_t   win_head;
+    size_t   win_count;
+    bool     locked;               // ppm holds a real estimate
+    volatile float ppm;            // Far-end clock vs local I2S (+ = faster)
+
+    // Resampler (audio engine)
+    int16_t  fifo[SAMPLES_PER_FRAME * 3];
+    size_t   fill;
+    uint64_t pos;                  // Read position, Q32.32 samples into fifo
+} audio_drift_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Forget the stream and its drift estimate (new far end)
+ */
+void audio_drift_reset(audio_drift_t *drift);
+
+/**
+ * @brief Record a received frame's sender timestamp
+ * @param remote_timestamp_us Sender's packet timestamp
+ */
+void audio_drift_note_arrival(audio_drift_t *drift, uint32_t remote_timestamp_us);
+
+/**
+ * @brief Produce one playout frame, resampled to the local clock
+ *
+ * Pulls as many frames from the stream as the drift calls for (usually
+ * one, occasionally none or two).
+ * @param pull Stream source (e.g. jitter_buffer_decode_next)
+ * @param ctx Passed to pull
+ * @param out Output buffer
+ * @param samples Samples to produce (<= SAMPLES_PER_FRAME)
+ * @return samples, or 0 when the stream is idle
+ */
+int audio_drift_playout(audio_drift_t *drift, audio_drift_pull_t pull, void *ctx,
+                        int16_t *out, size_t samples);
+
+/**
+ * @brief Current drift estimate in ppm (0 until locked)
+ */
+float audio_drift_get_ppm(const audio_drift_t *drift);
+
+#endif // AUDIO_DRIFT_H
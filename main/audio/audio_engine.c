@@ -0,0 +1,387 @@
+/**
+ * @file audio_engine.c
+ * @brief Full-Duplex Audio Engine Implementation
+ *
+ * The I2S receive ISR counts frames, stamps the event and notifies the
+ * engine task. The task then reads the frame that just landed (no wait),
+ * hands it to the capture handler, asks the playout handler for one frame
+ * and writes it to the TX DMA, which runs off the same bit clock. Capture
+ * and playout can no longer drift apart; the one remaining clock
+ * difference, to the far end, is handled by audio_drift.
+ *
+ * The echo canceller's reference is the frame handed to the sink, and the
+ * captured frame is cancelled in place before the capture handler; the
+ * output-to-input delay through the codec is then a fixed number of
+ * frames that audio_aec finds for itself.
+ *
+ * Each pass holds a CPU-frequency lock, so under DFS the core runs at the
+ * configured maximum only while a frame is being worked and drops to the
+ * minimum the drivers allow (the I2S driver holds the APB lock while
+ * streaming) until the next frame event. Suspended, the engine stops I2S
+ * itself and sleeps on its notification; its clock carries on at
+ * esp_timer pace, without a step, until frame events come back.
+ *
+ * Capture on/off requests are applied by the engine task at a frame
+ * boundary: on, before the pass (that frame has no capture yet); off,
+ * after the pass, so the capture handler sees the frame that was already
+ * in DMA. Either way the frame events switch between the RX and TX DMA,
+ * a fraction of a frame apart, so the clock is rebased as for a suspend.
+ */
+
+#include "audio_engine.h"
+#include "audio_codec.h"
+#include "audio_dsp.h"
+#include "audio_tones.h"
+#include "../config.h"
+#include "../system/task_map.h"
+#include "../system/latency.h"
+#include "../system/trace.h"
+#include "../platform/mem_arena.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_task_wdt.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "sdkconfig.h"
+#include <string.h>
+
+static const char *TAG = "ENGINE";
+
+#define FRAME_US    ((int64_t)FRAME_SIZE_MS * 1000)
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static bool running = false;
+static TaskHandle_t engine_task_handle = NULL;
+static audio_engine_config_t engine_config;
+
+// I2S clock, written by the ISR
+static portMUX_TYPE clock_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t clock_frames = 0;
+static volatile int64_t clock_base_us = 0;
+static volatile int64_t clock_event_us = 0;
+static int64_t clock_offset_us = 0;          // Carries the clock across suspends
+
+static audio_engine_stats_t stats = {0};
+static volatile uint64_t busy_us = 0;        // Engine task writes, any task reads
+static uint32_t peak_process_us = 0;         // Since the last audio_engine_take_peak_us()
+static volatile bool suspend_requested = false;
+static volatile bool suspended = false;
+static volatile bool capture_requested = true;
+static bool capture_on = true;               // Engine task only
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t cpu_lock = NULL;
+#endif
+
+// Frame buffers (fast arena, AUDIO_DSP_ALIGN)
+static int16_t *capture_pcm = NULL;
+static int16_t *playout_pcm = NULL;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+// I2S ISR context: one capture frame is in DMA
+static bool IRAM_ATTR on_frame_ready(void *ctx)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&clock_lock);
+    if (clock_frames == 0) {
+        clock_base_us = now_us;
+    }
+    clock_frames++;
+    clock_event_us = now_us;
+    portEXIT_CRITICAL_ISR(&clock_lock);
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(engine_task_handle, &woken);
+    return woken == pdTRUE;
+}
+
+// Frame counting starts over; until it does the clock runs on esp_timer
+// from where the I2S clock left it
+static void clock_rebase(void)
+{
+    int64_t clock_us = audio_engine_clock_us();
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&clock_lock);
+    clock_frames = 0;
+    clock_offset_us = clock_us - now_us;
+    portEXIT_CRITICAL(&clock_lock);
+}
+
+// Engine task: power capture up or down, at a frame boundary. RX DMA
+// restarts at a new phase against TX, so the echo filter starts over.
+static void switch_capture(bool enable)
+{
+    if (audio_codec_set_capture(enable) == ESP_OK) {
+        capture_on = enable;
+        clock_rebase();
+        if (enable && engine_config.echo) {
+            audio_aec_reset(engine_config.echo);
+        }
+        stats.capture_switches++;
+    }
+}
+
+// Engine task: park with I2S stopped until resumed
+static void engine_sleep(void)
+{
+    audio_codec_set_streaming(false);
+    clock_rebase();
+
+    esp_task_wdt_delete(NULL);
+    suspended = true;
+    ESP_LOGI(TAG, "Audio engine suspended");
+
+    while (suspend_requested) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    ulTaskNotifyTake(pdTRUE, 0);  // Frame events from before the pause
+
+    suspended = false;
+    esp_task_wdt_add(NULL);
+    audio_codec_set_streaming(true);
+    ESP_LOGI(TAG, "Audio engine resumed");
+}
+
+static void engine_task(void *arg)
+{
+    ESP_LOGI(TAG, "Audio engine started");
+    esp_task_wdt_add(NULL);
+
+    while (1) {
+        if (suspend_requested) {
+            engine_sleep();
+            continue;
+        }
+
+        // One notification per frame; a backlog is worked off one frame
+        // per pass so nothing is skipped
+        if (ulTaskNotifyTake(pdFALSE, pdMS_TO_TICKS(I2S_IO_TIMEOUT_MS)) == 0) {
+            stats.stalls++;
+            esp_task_wdt_reset();
+            continue;
+        }
+        esp_task_wdt_reset();
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_acquire(cpu_lock);
+#endif
+
+        int64_t start_us = esp_timer_get_time();
+        uint32_t frame_start = trace_begin();
+
+        // Deadline runs from the frame event, so ISR-to-task latency counts
+        portENTER_CRITICAL(&clock_lock);
+        int64_t release_us = clock_event_us;
+        portEXIT_CRITICAL(&clock_lock);
+
+        // Powering up, this event came from TX and the first capture
+        // frame is a DMA frame away
+        bool want_capture = capture_requested;
+        uint32_t stage_start;
+        if (want_capture && !capture_on) {
+            switch_capture(true);
+        } else if (capture_on) {
+            // The frame is already in DMA - this does not block
+            size_t captured = 0;
+            stage_start = trace_begin();
+            esp_err_t read_ret = audio_codec_read(capture_pcm, SAMPLES_PER_FRAME, &captured);
+            trace_end(TRACE_I2S_READ, stage_start);
+            if (read_ret == ESP_OK && captured == SAMPLES_PER_FRAME) {
+                if (engine_config.echo && !latency_echo_hold()) {
+                    stage_start = trace_begin();
+                    audio_aec_process(engine_config.echo, capture_pcm, captured);
+                    trace_end(TRACE_AEC, stage_start);
+                }
+                latency_capture_frame(capture_pcm, captured);
+                if (engine_config.capture) {
+                    engine_config.capture(capture_pcm, captured);
+                }
+            }
+        } else {
+            stats.listen_frames++;
+        }
+
+        // With no stream nothing is written; I2S plays silence
+        // (avoids amplifying digital noise when disconnected). With echo
+        // cancelling, silence is written instead: a steady TX queue keeps
+        // the echo delay fixed.
+        if (engine_config.playout) {
+            size_t samples = engine_config.playout(playout_pcm, SAMPLES_PER_FRAME);
+            if (engine_config.tones) {
+                samples = audio_tones_mix(playout_pcm, samples, SAMPLES_PER_FRAME);
+            }
+            if (engine_config.echo) {
+                if (samples < SAMPLES_PER_FRAME) {
+                    memset(&playout_pcm[samples], 0,
+                           (SAMPLES_PER_FRAME - samples) * sizeof(int16_t));
+                    samples = SAMPLES_PER_FRAME;
+                }
+                audio_aec_reference(engine_config.echo, playout_pcm, samples);
+            }
+            if (samples > 0) {
+                latency_playout_frame(playout_pcm, samples);
+                stage_start = trace_begin();
+                engine_config.sink(playout_pcm, samples);
+                trace_end(TRACE_I2S_WRITE, stage_start);
+            }
+        }
+
+        // Powering down after the pass: the next event comes from TX
+        if (!want_capture && capture_on) {
+            switch_capture(false);
+        }
+
+        stats.frames++;
+        trace_end(TRACE_ENGINE_FRAME, frame_start);
+        int64_t end_us = esp_timer_get_time();
+        uint32_t elapsed_us = (uint32_t)(end_us - start_us);
+        stats.last_process_us = elapsed_us;
+        if (elapsed_us > peak_process_us) {
+            peak_process_us = elapsed_us;
+        }
+        busy_us += elapsed_us;
+        task_map_record(TASK_AUDIO_ENGINE, (uint32_t)(end_us - release_us));
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_release(cpu_lock);
+#endif
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t audio_engine_start(const audio_engine_config_t *config)
+{
+    if (running) {
+        return ESP_OK;
+    }
+    if (!config || !audio_codec_is_initialized()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    engine_config = *config;
+    if (!engine_config.sink) {
+        engine_config.sink = audio_codec_write;
+    }
+
+    if (!capture_pcm) {
+        capture_pcm = mem_arena_alloc(MEM_ARENA_FAST, SAMPLES_PER_FRAME * sizeof(int16_t),
+                                      "engine_pcm");
+        playout_pcm = mem_arena_alloc(MEM_ARENA_FAST, SAMPLES_PER_FRAME * sizeof(int16_t),
+                                      "engine_pcm");
+        if (!capture_pcm || !playout_pcm) {
+            capture_pcm = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+#if CONFIG_PM_ENABLE
+    if (!cpu_lock) {
+        esp_err_t lock_ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_engine", &cpu_lock);
+        if (lock_ret != ESP_OK) {
+            return lock_ret;
+        }
+    }
+#endif
+
+    esp_err_t ret = task_map_create(TASK_AUDIO_ENGINE, engine_task, NULL, &engine_task_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    running = true;
+    audio_codec_set_frame_callback(on_frame_ready, NULL);
+
+    ESP_LOGI(TAG, "Clocked by I2S: %d ms frames, capture%s%s%s%s",
+             FRAME_SIZE_MS, engine_config.capture ? "" : " (discarded)",
+             engine_config.playout ? " + playout" : "",
+             engine_config.playout && engine_config.tones ? " + tones" : "",
+             engine_config.echo ? " + echo cancel" : "");
+    return ESP_OK;
+}
+
+int64_t audio_engine_clock_us(void)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&clock_lock);
+    uint32_t frames = clock_frames;
+    int64_t base_us = clock_base_us;
+    int64_t event_us = clock_event_us;
+    int64_t offset_us = clock_offset_us;
+    portEXIT_CRITICAL(&clock_lock);
+
+    if (frames == 0) {
+        return now_us + offset_us;
+    }
+
+    // Position within the current frame, never past its end
+    int64_t within_us = now_us - event_us;
+    if (within_us < 0) within_us = 0;
+    if (within_us > FRAME_US) within_us = FRAME_US;
+
+    return base_us + (int64_t)(frames - 1) * FRAME_US + within_us + offset_us;
+}
+
+int64_t audio_engine_frame_us(void)
+{
+    portENTER_CRITICAL(&clock_lock);
+    uint32_t frames = clock_frames;
+    int64_t base_us = clock_base_us;
+    int64_t offset_us = clock_offset_us;
+    portEXIT_CRITICAL(&clock_lock);
+
+    if (frames == 0) {
+        return esp_timer_get_time() + offset_us;
+    }
+    return base_us + (int64_t)(frames - 1) * FRAME_US + offset_us;
+}
+
+void audio_engine_suspend(bool suspend)
+{
+    if (!running || suspend == suspend_requested) {
+        return;
+    }
+
+    suspend_requested = suspend;
+    // Wakes a suspended engine; a running one picks the flag up within a frame
+    xTaskNotifyGive(engine_task_handle);
+}
+
+void audio_engine_set_capture(bool enable)
+{
+    capture_requested = enable;
+}
+
+bool audio_engine_is_suspended(void)
+{
+    return suspended;
+}
+
+uint64_t audio_engine_busy_us(void)
+{
+    return busy_us;
+}
+
+void audio_engine_get_stats(audio_engine_stats_t *stats_out)
+{
+    if (!stats_out) return;
+
+    *stats_out = stats;
+    stats_out->rx_overruns = audio_codec_get_rx_overruns();
+}
+
+uint32_t audio_engine_take_peak_us(void)
+{
+    return __atomic_exchange_n(&peak_process_us, 0, __ATOMIC_RELAXED);
+}
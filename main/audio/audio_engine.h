@@ -0,0 +1,143 @@
+/**
+ * @file audio_engine.h
+ * @brief Full-Duplex Audio Engine Clocked by I2S
+ *
+ * One task handles one captured frame and one played frame per I2S DMA
+ * frame event, so capture, encode, decode and playout all run off the
+ * same hardware clock. The engine also keeps that clock
+ * (audio_engine_clock_us) for drift measurement against the far end.
+ *
+ * With an echo canceller configured, every written frame is its reference
+ * and every captured frame is cleaned before the capture handler sees it,
+ * so the two stay frame-aligned: headset echo on the pack, the party-line
+ * hybrid return on the base.
+ *
+ * Alert tones (audio_tones) are summed into each played frame before it
+ * becomes the echo reference, and play on their own when nothing is
+ * received.
+ *
+ * Capture can be powered down while playout runs (a pack listening with
+ * PTT off); the TX DMA then clocks the engine.
+ */
+
+#ifndef AUDIO_ENGINE_H
+#define AUDIO_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "audio_aec.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+/**
+ * @brief One captured frame (encode and send it)
+ */
+typedef void (*audio_engine_capture_cb_t)(const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Fill one playout frame
+ * @return Samples written, 0 = nothing to play this frame
+ */
+typedef size_t (*audio_engine_playout_cb_t)(int16_t *pcm, size_t samples);
+
+/**
+ * @brief Where playout frames are written
+ */
+typedef esp_err_t (*audio_engine_sink_t)(const int16_t *pcm, size_t samples);
+
+typedef struct {
+    audio_engine_capture_cb_t capture;   // NULL = discard capture
+    audio_engine_playout_cb_t playout;   // NULL = playout handled elsewhere
+    audio_engine_sink_t sink;            // NULL = audio_codec_write
+    audio_aec_t *echo;                   // NULL = no echo canceller
+    bool tones;                          // Sum queued alert tones into playout
+} audio_engine_config_t;
+
+typedef struct {
+    uint32_t frames;             // I2S frame events handled
+    uint32_t stalls;             // Waits that timed out with no frame event
+    uint32_t rx_overruns;        // Capture frames lost in DMA (engine too slow)
+    uint32_t last_process_us;    // Latest capture + playout pass
+    uint32_t listen_frames;      // Frames handled with capture powered down
+    uint32_t capture_switches;   // Capture power-ups and power-downs
+} audio_engine_stats_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Start the engine task (audio codec must be initialized)
+ * @param config Frame handlers (copied)
+ * @return ESP_OK on success
+ */
+esp_err_t audio_engine_start(const audio_engine_config_t *config);
+
+/**
+ * @brief Local I2S clock in microseconds
+ *
+ * Frames counted since the engine started, interpolated within the
+ * current frame. Before the first frame event, and while suspended, it
+ * runs on esp_timer and continues from there without a step.
+ */
+int64_t audio_engine_clock_us(void);
+
+/**
+ * @brief Local I2S clock at the latest frame event
+ *
+ * The end of the frame the engine is handling (or last handled), on the
+ * audio_engine_clock_us() scale.
+ */
+int64_t audio_engine_frame_us(void);
+
+/**
+ * @brief Suspend or resume the engine (any task)
+ *
+ * Suspending stops I2S from the engine task once the current pass is
+ * done, so nothing audio holds a power-management lock; resuming restarts
+ * it and the next frame event comes a DMA frame later.
+ * audio_engine_clock_us runs on through the pause without a step, so
+ * drift measurement carries on; the jitter buffer is the caller's to reset.
+ */
+void audio_engine_suspend(bool suspend);
+
+/**
+ * @brief Power capture up or down (any task; the engine applies it)
+ *
+ * Off, the codec's ADCs and I2S RX are stopped and the capture handler
+ * and echo canceller are skipped; playout carries on, clocked by the TX
+ * DMA. The change is made at the next frame boundary, and a powered-up
+ * capture delivers its first frame one frame after that. Capture is on
+ * when the engine starts.
+ */
+void audio_engine_set_capture(bool enable);
+
+/**
+ * @brief Check if the engine is parked with I2S stopped
+ */
+bool audio_engine_is_suspended(void);
+
+/**
+ * @brief Total time spent in frame passes since start (CPU lock held), in us
+ */
+uint64_t audio_engine_busy_us(void);
+
+/**
+ * @brief Get engine statistics
+ * @param stats Pointer to statistics structure
+ */
+void audio_engine_get_stats(audio_engine_stats_t *stats);
+
+/**
+ * @brief Get the longest capture + playout pass since the last call, then reset it
+ *
+ * One reader (the status log); others track last_process_us themselves.
+ * @return Peak pass time in microseconds
+ */
+uint32_t audio_engine_take_peak_us(void);
+
+#endif // AUDIO_ENGINE_H
@@ -2,158 +2,629 @@
  * @file audio_jitter_buffer.c
  * @brief Jitter Buffer Implementation
  *
- * Simple ring buffer of decoded PCM frames.  The UDP receive callback
- * pushes frames in; a dedicated playback task pops them out at a
- * steady 20 ms cadence and writes to I2S.
+ * Window of Opus payload slots indexed by sequence number modulo the
+ * capacity.  The UDP receive callback drops each payload into its slot;
+ * the audio engine walks the window one sequence number per
+ * FRAME_SIZE_MS tick and decodes whatever it finds there.
+ *
+ * Adaptive mode estimates inter-arrival jitter the RFC 3550 way: for
+ * each new packet the change in transit time (arrival delta minus sender
+ * timestamp delta) is folded into a 1/16 running average.  The target
+ * depth is sized to cover a multiple of that estimate.  The buffer moves
+ * towards the target only across silent frames: holding the playout point
+ * for a tick to grow, skipping a slot to shrink.
+ *
+ * A sender in DTX sends nothing between comfort-noise updates but keeps
+ * its sequence contiguous. Once a DTX update has played, starvation is
+ * expected: the playout point holds (no underrun, no stream end) and the
+ * gap is filled with comfort noise at the update's level.
+ *
+ * The receive task only copies each payload into the arrivals ring. Each
+ * pop first drains the ring in arrival order and does the slot, jitter
+ * and depth work the receive path used to do under a mutex, so all of
+ * the window state has a single owner. Nothing on either path logs:
+ * drops and gaps are counted in the stats.
  */
 
 #include "audio_jitter_buffer.h"
+#include "audio_processor.h"
 #include "../config.h"
+#include "../system/trace.h"
+#include "../platform/platform.h"
+#include "../platform/mem_arena.h"
 
 #include <string.h>
-#include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
-#include "esp_log.h"
 
 static const char *TAG = "JBUF";
 
 //=============================================================================
-// RING BUFFER STATE
+// CONFIGURATION
+//=============================================================================
+
+#if JITTER_BUFFER_ADAPTIVE
+#if (JITTER_BUFFER_MIN_FRAMES < 1) || (JITTER_BUFFER_MIN_FRAMES > JITTER_BUFFER_MAX_FRAMES)
+#error "JITTER_BUFFER_MIN_FRAMES must be between 1 and JITTER_BUFFER_MAX_FRAMES"
+#endif
+#if (JITTER_BUFFER_FRAMES < JITTER_BUFFER_MIN_FRAMES) || (JITTER_BUFFER_FRAMES > JITTER_BUFFER_MAX_FRAMES)
+#error "JITTER_BUFFER_FRAMES must lie within JITTER_BUFFER_MIN_FRAMES..JITTER_BUFFER_MAX_FRAMES"
+#endif
+#if (JITTER_BUFFER_LOW_LATENCY_MAX_FRAMES < JITTER_BUFFER_MIN_FRAMES) || \
+    (JITTER_BUFFER_LOW_LATENCY_MAX_FRAMES > JITTER_BUFFER_MAX_FRAMES)
+#error "JITTER_BUFFER_LOW_LATENCY_MAX_MS must lie within JITTER_BUFFER_MIN_MS..JITTER_BUFFER_MAX_MS"
+#endif
+#define JB_CAPACITY_FRAMES      JITTER_BUFFER_MAX_FRAMES
+#else
+#define JB_CAPACITY_FRAMES      JITTER_BUFFER_FRAMES
+#endif
+
+#define JB_FRAME_US             (FRAME_SIZE_MS * 1000)
+
+// Transit deltas above this are treated as outliers (talk-spurt restarts,
+// sender reboots) and clamped so one event can't blow up the estimate
+#define JB_MAX_TRANSIT_DELTA_US (JB_FRAME_US * JITTER_BUFFER_MAX_FRAMES)
+
+// A backwards sequence jump larger than this means the sender restarted
+#define JB_SEQ_RESTART_WINDOW   1000
+
+// Consecutive starved pops after which the stream is considered finished
+// (matches the 500 ms window playout conceals over)
+#define JB_STREAM_IDLE_FRAMES   (500 / FRAME_SIZE_MS)
+
+// Comfort noise continues this long without an update (three missed
+// updates) before a DTX sender is considered gone
+#define JB_DTX_IDLE_FRAMES      (3 * DTX_UPDATE_MS / FRAME_SIZE_MS)
+
+#if (JITTER_BUFFER_RX_QUEUE & (JITTER_BUFFER_RX_QUEUE - 1)) != 0
+#error "JITTER_BUFFER_RX_QUEUE must be a power of two"
+#endif
+
+//=============================================================================
+// PRIVATE VARIABLES
 //=============================================================================
 
-static int16_t *ring_buf = NULL;          // flat array: JITTER_BUFFER_FRAMES * SAMPLES_PER_FRAME
-static size_t   frame_capacity = 0;       // JITTER_BUFFER_FRAMES
-static size_t   head = 0;                 // next write slot
-static size_t   tail = 0;                 // next read slot
-static size_t   count = 0;               // frames currently stored
-static SemaphoreHandle_t mutex = NULL;
-static bool     initialized = false;
+// Depth range shared by every buffer, in frames (jitter_buffer_set_depth_range)
+static volatile size_t depth_min = JITTER_BUFFER_MIN_FRAMES;
+static volatile size_t depth_start = JITTER_BUFFER_FRAMES;
+static volatile size_t depth_max = JITTER_BUFFER_MAX_FRAMES;
+
+//=============================================================================
+// PRIVATE FUNCTIONS (playout side)
+//=============================================================================
+
+static inline jitter_slot_t *slot_for(jitter_buffer_t *jb, uint32_t sequence)
+{
+    return &jb->slots[sequence % jb->capacity];
+}
+
+static inline uint32_t buffered_depth(const jitter_buffer_t *jb)
+{
+    return jb->streaming ? (jb->end_seq - jb->next_seq) : 0;
+}
+
+// The lower of the buffer's own ceiling (low latency) and the shared one
+static inline size_t depth_ceiling(const jitter_buffer_t *jb)
+{
+    size_t ceiling = depth_max;
+    return jb->max_depth < ceiling ? jb->max_depth : ceiling;
+}
+
+static void clear_slots(jitter_buffer_t *jb)
+{
+    for (size_t i = 0; i < jb->capacity; i++) {
+        jb->slots[i].valid = false;
+    }
+}
+
+static void reset_adaptation(jitter_buffer_t *jb)
+{
+    jb->target_depth = jb->low_latency ? depth_min : depth_start;
+    jb->have_last_arrival = false;
+    jb->jitter_q4 = 0;
+    jb->shrink_pending_since_us = 0;
+    jb->empty_pops = 0;
+    jb->in_dtx = false;
+    jb->dtx_pops = 0;
+    jb->last_output_silent = true;
+}
+
+static void anchor_stream(jitter_buffer_t *jb, uint32_t sequence)
+{
+    clear_slots(jb);
+    jb->next_seq = sequence;
+    jb->end_seq = sequence;
+    jb->streaming = true;
+    jb->empty_pops = 0;
+    jb->in_dtx = false;
+    jb->dtx_pops = 0;
+}
+
+// Move the playout point forward, discarding whatever was in the skipped slots
+static void advance_to(jitter_buffer_t *jb, uint32_t sequence)
+{
+    while ((int32_t)(sequence - jb->next_seq) > 0) {
+        slot_for(jb, jb->next_seq)->valid = false;
+        jb->next_seq++;
+    }
+    if ((int32_t)(jb->end_seq - jb->next_seq) < 0) {
+        jb->end_seq = jb->next_seq;
+    }
+}
+
+static void grow_target(jitter_buffer_t *jb)
+{
+#if JITTER_BUFFER_ADAPTIVE
+    if (jb->target_depth < depth_ceiling(jb)) {
+        jb->target_depth++;
+    }
+    jb->shrink_pending_since_us = 0;
+#endif
+}
+
+static void update_jitter(jitter_buffer_t *jb, uint32_t sequence, uint32_t timestamp,
+                          int64_t now_us)
+{
+    if (jb->have_last_arrival) {
+        int32_t seq_delta = (int32_t)(sequence - jb->last_sequence);
+
+        if (seq_delta <= 0 && seq_delta > -JB_SEQ_RESTART_WINDOW) {
+            // Duplicate or reordered packet - carries no new timing info
+            return;
+        }
+
+        if (seq_delta > 0) {
+            int64_t transit_delta = (now_us - jb->last_arrival_us) -
+                                    (int32_t)(timestamp - jb->last_timestamp);
+            if (transit_delta < 0) transit_delta = -transit_delta;
+            if (transit_delta > JB_MAX_TRANSIT_DELTA_US) {
+                transit_delta = JB_MAX_TRANSIT_DELTA_US;
+            }
+
+            // J += (|D| - J) / 16, kept in Q4 to avoid losing precision
+            jb->jitter_q4 += (uint32_t)transit_delta - ((jb->jitter_q4 + 8) >> 4);
+        }
+        // else: sender restarted its sequence - just re-anchor below
+    }
+
+    jb->have_last_arrival = true;
+    jb->last_sequence = sequence;
+    jb->last_timestamp = timestamp;
+    jb->last_arrival_us = now_us;
+}
+
+static void update_target(jitter_buffer_t *jb, int64_t now_us)
+{
+#if JITTER_BUFFER_ADAPTIVE
+    uint32_t needed_us = (jb->jitter_q4 >> 4) * JITTER_BUFFER_JITTER_MULT;
+    size_t needed = (needed_us + JB_FRAME_US - 1) / JB_FRAME_US;
+
+    size_t ceiling = depth_ceiling(jb);
+    if (needed < depth_min) needed = depth_min;
+    if (needed > ceiling) needed = ceiling;
+
+    if (needed > jb->target_depth) {
+        jb->target_depth = needed;
+        jb->shrink_pending_since_us = 0;
+    } else if (needed < jb->target_depth) {
+        if (jb->shrink_pending_since_us == 0) {
+            jb->shrink_pending_since_us = now_us;
+        } else if (now_us - jb->shrink_pending_since_us >=
+                   (int64_t)JITTER_BUFFER_SHRINK_HOLD_MS * 1000) {
+            jb->target_depth--;
+            jb->shrink_pending_since_us = now_us;
+        }
+    } else {
+        jb->shrink_pending_since_us = 0;
+    }
+#else
+    (void)jb;
+    (void)now_us;
+#endif
+}
+
+static void apply_low_latency(jitter_buffer_t *jb, bool low_latency)
+{
+    jb->low_latency = low_latency;
+#if JITTER_BUFFER_ADAPTIVE
+    jb->max_depth = low_latency ? JITTER_BUFFER_LOW_LATENCY_MAX_FRAMES : JITTER_BUFFER_MAX_FRAMES;
+    // Steer straight for the minimum; the jitter estimate grows it back
+    // as far as the link needs
+    if (low_latency) {
+        jb->target_depth = depth_min;
+    }
+    jb->shrink_pending_since_us = 0;
+#endif
+}
+
+static void apply_reset(jitter_buffer_t *jb, uint32_t generation)
+{
+    clear_slots(jb);
+    jb->streaming = false;
+    reset_adaptation(jb);
+    audio_processor_limiter_init(&jb->limiter, AUDIO_LIMITER_SHARED, true);
+    jb->generation = generation;
+}
+
+// Place one arrival in its sequence slot
+static void store(jitter_buffer_t *jb, const jitter_arrival_t *arrival)
+{
+    uint32_t sequence = arrival->frame.sequence;
+    int64_t now_us = arrival->arrival_us;
+
+    update_jitter(jb, sequence, arrival->timestamp, now_us);
+    update_target(jb, now_us);
+
+    int32_t offset = jb->streaming ? (int32_t)(sequence - jb->next_seq) : 0;
+
+    if (!jb->streaming || offset < -JB_SEQ_RESTART_WINDOW) {
+        // New talk spurt, or the sender restarted its sequence
+        anchor_stream(jb, sequence);
+        offset = 0;
+    } else if (offset < 0) {
+        // Its slot has already been played (or concealed)
+        jb->counters.late_drops++;
+        return;
+    }
+
+    // Data arriving after a short starvation gap means the stream underran
+    // rather than ended - deepen the buffer straight away
+    if (jb->empty_pops > 0) {
+        jb->counters.underruns++;
+        grow_target(jb);
+        jb->empty_pops = 0;
+    }
+
+    if ((uint32_t)offset >= jb->capacity) {
+        // Window full: slide it so this packet becomes the newest slot,
+        // discarding the oldest frames to keep latency bounded
+        uint32_t new_start = sequence - (uint32_t)(jb->capacity - 1);
+        jb->counters.overruns += new_start - jb->next_seq;
+        advance_to(jb, new_start);
+    }
+
+    jitter_slot_t *slot = slot_for(jb, sequence);
+    if (slot->valid && slot->frame.sequence == sequence && !arrival->preferred) {
+        jb->counters.duplicates++;
+        return;
+    }
+
+    if (!slot->valid || slot->frame.sequence != sequence) {
+        slot->arrival_us = now_us;
+    }
+    slot->valid = true;
+    slot->frame.sequence = sequence;
+    slot->frame.size = arrival->frame.size;
+    slot->frame.dtx = arrival->frame.dtx;
+    memcpy(slot->frame.data, arrival->frame.data, arrival->frame.size);
+
+    if ((int32_t)(sequence + 1 - jb->end_seq) > 0) {
+        jb->end_seq = sequence + 1;
+    }
+}
+
+// Take in everything the receive task queued since the last pop
+static void drain(jitter_buffer_t *jb)
+{
+    uint32_t trace_start = trace_begin();
+    uint32_t generation = __atomic_load_n(&jb->rx_generation, __ATOMIC_ACQUIRE);
+
+    // Asked for with the packets now queued, so applied before them
+    bool low_latency = __atomic_load_n(&jb->want_low_latency, __ATOMIC_RELAXED);
+    if (low_latency != jb->low_latency) {
+        apply_low_latency(jb, low_latency);
+    }
+
+    const jitter_arrival_t *arrival;
+    while ((arrival = audio_ring_peek(&jb->arrivals)) != NULL) {
+        if (arrival->generation != jb->generation) {
+            apply_reset(jb, arrival->generation);
+        }
+        store(jb, arrival);
+        audio_ring_release(&jb->arrivals);
+    }
+    if ((int32_t)(generation - jb->generation) > 0) {
+        apply_reset(jb, generation);
+    }
+    trace_end(TRACE_JB_DRAIN, trace_start);
+}
 
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
 
-esp_err_t jitter_buffer_init(void)
+esp_err_t jitter_buffer_init(jitter_buffer_t *jb)
 {
-    if (initialized) {
+    if (!jb) return ESP_ERR_INVALID_ARG;
+
+    if (jb->initialized) {
         ESP_LOGW(TAG, "Already initialized");
         return ESP_OK;
     }
 
-    frame_capacity = JITTER_BUFFER_FRAMES;
+    memset(jb, 0, sizeof(*jb));
+    jb->capacity = JB_CAPACITY_FRAMES;
+    jb->max_depth = JB_CAPACITY_FRAMES;
 
-    size_t total_samples = frame_capacity * SAMPLES_PER_FRAME;
-    ring_buf = heap_caps_malloc(total_samples * sizeof(int16_t), MALLOC_CAP_INTERNAL);
-    if (!ring_buf) {
+    // A deep window touched once per frame: bulk (PSRAM when present)
+    jb->slots = mem_arena_alloc(MEM_ARENA_BULK, jb->capacity * sizeof(jitter_slot_t),
+                                "jitter_slots");
+    if (!jb->slots) {
         ESP_LOGE(TAG, "Failed to allocate jitter buffer (%u bytes)",
-                 (unsigned)(total_samples * sizeof(int16_t)));
+                 (unsigned)(jb->capacity * sizeof(jitter_slot_t)));
         return ESP_ERR_NO_MEM;
     }
-    memset(ring_buf, 0, total_samples * sizeof(int16_t));
+    memset(jb->slots, 0, jb->capacity * sizeof(jitter_slot_t));
 
-    mutex = xSemaphoreCreateMutex();
-    if (!mutex) {
-        free(ring_buf);
-        ring_buf = NULL;
-        return ESP_ERR_NO_MEM;
+    esp_err_t ret = audio_ring_init(&jb->arrivals, sizeof(jitter_arrival_t),
+                                    JITTER_BUFFER_RX_QUEUE, "jitter_arrivals");
+    if (ret != ESP_OK) {
+        jb->slots = NULL;
+        return ret;
     }
 
-    head = 0;
-    tail = 0;
-    count = 0;
-    initialized = true;
-
+    reset_adaptation(jb);
+    audio_processor_limiter_init(&jb->limiter, AUDIO_LIMITER_SHARED, true);
+    audio_cng_init(&jb->cng);
+    jb->initialized = true;
+
+#if JITTER_BUFFER_ADAPTIVE
+    ESP_LOGI(TAG, "Jitter buffer ready: adaptive %u-%u frames (start %u, %u ms)",
+             (unsigned)JITTER_BUFFER_MIN_FRAMES, (unsigned)JITTER_BUFFER_MAX_FRAMES,
+             (unsigned)JITTER_BUFFER_FRAMES,
+             (unsigned)(JITTER_BUFFER_FRAMES * FRAME_SIZE_MS));
+#else
     ESP_LOGI(TAG, "Jitter buffer ready: %u frames (%u ms)",
-             (unsigned)frame_capacity,
-             (unsigned)(frame_capacity * FRAME_SIZE_MS));
+             (unsigned)jb->capacity,
+             (unsigned)(jb->capacity * FRAME_SIZE_MS));
+#endif
     return ESP_OK;
 }
 
-bool jitter_buffer_push(const int16_t *frame, size_t samples)
+bool jitter_buffer_push(jitter_buffer_t *jb, const uint8_t *opus_data, uint16_t opus_size,
+                        uint32_t sequence, uint32_t timestamp, bool preferred, bool dtx)
 {
-    if (!initialized || !frame) return false;
+    if (!jb || !jb->initialized || !opus_data || opus_size == 0) return false;
+    if (opus_size > OPUS_MAX_PACKET_SIZE) return false;
 
-    size_t copy_samples = (samples < SAMPLES_PER_FRAME) ? samples : SAMPLES_PER_FRAME;
+    jitter_arrival_t *arrival = audio_ring_reserve(&jb->arrivals);
+    if (!arrival) {
+        // Playout stopped draining (counted in queue_drops)
+        return false;
+    }
 
-    xSemaphoreTake(mutex, portMAX_DELAY);
+    arrival->arrival_us = platform_time_us();
+    arrival->timestamp = timestamp;
+    arrival->generation = __atomic_load_n(&jb->rx_generation, __ATOMIC_ACQUIRE);
+    arrival->preferred = preferred;
+    arrival->frame.sequence = sequence;
+    arrival->frame.size = opus_size;
+    arrival->frame.dtx = dtx;
+    memcpy(arrival->frame.data, opus_data, opus_size);
+    audio_ring_commit(&jb->arrivals);
+    return true;
+}
 
-    if (count >= frame_capacity) {
-        xSemaphoreGive(mutex);
-        ESP_LOGW(TAG, "Buffer full - frame dropped");
-        return false;
+jitter_pop_result_t jitter_buffer_pop(jitter_buffer_t *jb, jitter_frame_t *frame,
+                                      bool last_output_silent)
+{
+    if (!jb || !jb->initialized || !frame) return JITTER_POP_EMPTY;
+
+    drain(jb);
+
+    if (!jb->streaming) {
+        return JITTER_POP_EMPTY;
     }
 
-    int16_t *dst = &ring_buf[head * SAMPLES_PER_FRAME];
-    memcpy(dst, frame, copy_samples * sizeof(int16_t));
+    if (buffered_depth(jb) == 0 && jb->in_dtx) {
+        // Sender is quiet on purpose: hold the playout point for its next frame
+        if (++jb->dtx_pops >= JB_DTX_IDLE_FRAMES) {
+            jb->streaming = false;
+            jb->in_dtx = false;
+            return JITTER_POP_EMPTY;
+        }
+        jb->counters.comfort_frames++;
+        frame->sequence = jb->next_seq;
+        frame->size = 0;
+        return JITTER_POP_COMFORT;
+    }
 
-    // Zero-pad if the pushed frame is shorter than SAMPLES_PER_FRAME
-    if (copy_samples < SAMPLES_PER_FRAME) {
-        memset(&dst[copy_samples], 0,
-               (SAMPLES_PER_FRAME - copy_samples) * sizeof(int16_t));
+    if (buffered_depth(jb) == 0) {
+        // Starved: hold the playout point so the next packet isn't counted late
+        if (++jb->empty_pops >= JB_STREAM_IDLE_FRAMES) {
+            jb->streaming = false;
+            jb->empty_pops = 0;
+            return JITTER_POP_EMPTY;
+        }
+        frame->sequence = jb->next_seq;
+        frame->size = 0;
+        return JITTER_POP_MISSING;
     }
 
-    head = (head + 1) % frame_capacity;
-    count++;
+#if JITTER_BUFFER_ADAPTIVE
+    if (last_output_silent) {
+        uint32_t depth = buffered_depth(jb);
+        if (depth < jb->target_depth) {
+            // Too shallow: hold the playout point for one tick
+            jb->counters.frames_stretched++;
+            return JITTER_POP_STRETCH;
+        }
+        if (depth > jb->target_depth) {
+            // Too deep: skip one slot to pull latency back down
+            advance_to(jb, jb->next_seq + 1);
+            jb->counters.frames_shrunk++;
+        }
+    }
+#else
+    (void)last_output_silent;
+#endif
+
+    jitter_pop_result_t result;
+    jitter_slot_t *slot = slot_for(jb, jb->next_seq);
+    trace_jb_depth(buffered_depth(jb));
+
+    frame->sequence = jb->next_seq;
+    if (slot->valid && slot->frame.sequence == jb->next_seq) {
+        frame->size = slot->frame.size;
+        frame->dtx = slot->frame.dtx;
+        memcpy(frame->data, slot->frame.data, slot->frame.size);
+        jb->in_dtx = slot->frame.dtx;
+        jb->dtx_pops = 0;
+        result = JITTER_POP_FRAME;
+
+        int64_t dwell_us = platform_time_us() - slot->arrival_us;
+        if (dwell_us >= 0) {
+            jb->dwell_q4 += (uint32_t)dwell_us - ((jb->dwell_q4 + 8) >> 4);
+        }
+    } else {
+        frame->size = 0;
+        frame->dtx = false;
+        jb->counters.frames_missing++;
+        result = JITTER_POP_MISSING;
+    }
+    advance_to(jb, jb->next_seq + 1);
+    return result;
+}
 
-    xSemaphoreGive(mutex);
+bool jitter_buffer_peek(jitter_buffer_t *jb, uint32_t sequence, jitter_frame_t *frame)
+{
+    if (!jb || !jb->initialized || !frame) return false;
+
+    jitter_slot_t *slot = slot_for(jb, sequence);
+    if (!jb->streaming || !slot->valid || slot->frame.sequence != sequence) {
+        return false;
+    }
+
+    frame->sequence = sequence;
+    frame->size = slot->frame.size;
+    memcpy(frame->data, slot->frame.data, slot->frame.size);
     return true;
 }
 
-bool jitter_buffer_pop(int16_t *frame, size_t samples)
+int jitter_buffer_decode_next(jitter_buffer_t *jb, audio_opus_decoder_t *decoder,
+                              int16_t *pcm, size_t samples)
 {
-    if (!initialized || !frame) return false;
+    if (!jb || !jb->initialized || !pcm) return 0;
 
-    size_t copy_samples = (samples < SAMPLES_PER_FRAME) ? samples : SAMPLES_PER_FRAME;
+    jitter_frame_t *frame = &jb->scratch;
+    jitter_pop_result_t result = jitter_buffer_pop(jb, frame, jb->last_output_silent);
 
-    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (result == JITTER_POP_EMPTY) {
+        jb->last_output_silent = true;
+        return 0;
+    }
 
-    if (count == 0) {
-        xSemaphoreGive(mutex);
-        return false;
+    // A stretch across DTX silence is comfort noise too
+    if (result == JITTER_POP_COMFORT || (result == JITTER_POP_STRETCH && jb->in_dtx)) {
+        audio_cng_generate(&jb->cng, pcm, samples);
+        jb->last_output_silent = true;
+        return (int)samples;
     }
 
-    const int16_t *src = &ring_buf[tail * SAMPLES_PER_FRAME];
-    memcpy(frame, src, copy_samples * sizeof(int16_t));
+    int decoded = -1;
+    if (result == JITTER_POP_FRAME) {
+        decoded = audio_opus_decoder_decode(decoder, frame->data, frame->size,
+                                            pcm, samples, 0);
+        if (decoded > 0 && frame->dtx) {
+            audio_cng_update(&jb->cng, pcm, decoded);
+        }
+    }
+#if OPUS_FEC_ACTIVE
+    else if (result == JITTER_POP_MISSING &&
+             jitter_buffer_peek(jb, frame->sequence + 1, &jb->fec_scratch)) {
+        // Next packet already here - rebuild this frame from its FEC data
+        decoded = audio_opus_decoder_decode(decoder, jb->fec_scratch.data,
+                                            jb->fec_scratch.size, pcm, samples, 1);
+        if (decoded > 0) {
+            jb->counters.fec_recovered++;
+            result = JITTER_POP_FRAME;
+        }
+    }
+#endif
 
-    tail = (tail + 1) % frame_capacity;
-    count--;
+    if (decoded <= 0) {
+        // Lost/late packet, stretch during silence, or decode error - use Opus PLC
+        decoded = audio_opus_decoder_decode(decoder, NULL, 0, pcm, samples, 1);
+    }
 
-    xSemaphoreGive(mutex);
-    return true;
+    if (decoded <= 0) {
+        memset(pcm, 0, samples * sizeof(int16_t));
+        decoded = samples;
+    }
+
+    // Silence is judged before the AGC lifts the noise floor
+    jb->last_output_silent = audio_processor_get_rms(pcm, decoded) < JITTER_BUFFER_SILENCE_RMS;
+    audio_processor_limiter_process(&jb->limiter, pcm, decoded);
+    return decoded;
 }
 
-void jitter_buffer_reset(void)
+void jitter_buffer_set_low_latency(jitter_buffer_t *jb, bool low_latency)
 {
-    if (!initialized) return;
+    if (!jb || !jb->initialized || jb->want_low_latency == low_latency) return;
+
+    __atomic_store_n(&jb->want_low_latency, low_latency, __ATOMIC_RELAXED);
+#if JITTER_BUFFER_ADAPTIVE
+    size_t ceiling = low_latency ? JITTER_BUFFER_LOW_LATENCY_MAX_FRAMES : JITTER_BUFFER_MAX_FRAMES;
+    if (ceiling > depth_max) ceiling = depth_max;
+    ESP_LOGI(TAG, "%s link: depth %u-%u frames",
+             low_latency ? "Low-latency" : "Normal", (unsigned)depth_min, (unsigned)ceiling);
+#endif
+}
 
-    xSemaphoreTake(mutex, portMAX_DELAY);
-    head = 0;
-    tail = 0;
-    count = 0;
-    xSemaphoreGive(mutex);
+esp_err_t jitter_buffer_set_depth_range(size_t min_frames, size_t start_frames, size_t max_frames)
+{
+    if (min_frames < 1 || min_frames > start_frames || start_frames > max_frames ||
+        max_frames > JITTER_BUFFER_MAX_FRAMES || start_frames > JB_CAPACITY_FRAMES) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    ESP_LOGI(TAG, "Buffer reset");
+    depth_min = min_frames;
+    depth_start = start_frames;
+    depth_max = max_frames;
+#if JITTER_BUFFER_ADAPTIVE
+    ESP_LOGI(TAG, "Depth range %u-%u frames (start %u)", (unsigned)min_frames,
+             (unsigned)max_frames, (unsigned)start_frames);
+#else
+    ESP_LOGI(TAG, "Depth %u frames", (unsigned)start_frames);
+#endif
+    return ESP_OK;
 }
 
-void jitter_buffer_deinit(void)
+void jitter_buffer_get_stats(jitter_buffer_t *jb, jitter_buffer_stats_t *stats)
 {
-    if (!initialized) return;
+    if (!stats) return;
 
-    initialized = false;
-
-    if (mutex) {
-        vSemaphoreDelete(mutex);
-        mutex = NULL;
-    }
-    if (ring_buf) {
-        free(ring_buf);
-        ring_buf = NULL;
+    if (!jb || !jb->initialized) {
+        memset(stats, 0, sizeof(*stats));
+        return;
     }
 
-    head = 0;
-    tail = 0;
-    count = 0;
-    frame_capacity = 0;
+    *stats = jb->counters;
+    stats->current_depth = buffered_depth(jb);
+    stats->target_depth = jb->target_depth;
+    stats->jitter_us = jb->jitter_q4 >> 4;
+    stats->dwell_us = jb->dwell_q4 >> 4;
+    stats->queue_drops = audio_ring_drops(&jb->arrivals);
+}
+
+void jitter_buffer_reset(jitter_buffer_t *jb)
+{
+    if (!jb || !jb->initialized) return;
+
+    // Any task may ask: an increment is never lost to a concurrent reset
+    __atomic_fetch_add(&jb->rx_generation, 1, __ATOMIC_ACQ_REL);
+}
+
+void jitter_buffer_deinit(jitter_buffer_t *jb)
+{
+    if (!jb || !jb->initialized) return;
+
+    jb->initialized = false;
+
+    audio_ring_deinit(&jb->arrivals);
+    // Storage stays in the arena
+    jb->slots = NULL;
+
+    jb->streaming = false;
+    jb->capacity = 0;
 
-    ESP_LOGI(TAG, "Jitter buffer freed");
+    ESP_LOGI(TAG, "Jitter buffer released");
 }
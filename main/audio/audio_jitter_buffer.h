@@ -2,9 +2,28 @@
  * @file audio_jitter_buffer.h
  * @brief Jitter Buffer for Audio Receive Path
  *
- * Buffers decoded PCM frames to absorb WiFi timing jitter.
- * A playback task drains the buffer at a steady 20ms cadence,
- * producing smooth audio output regardless of packet arrival timing.
+ * Buffers received Opus payloads to absorb WiFi timing jitter.
+ * Packets are stored in the slot given by their sequence number, so
+ * reordered packets play in the right place and packets arriving after
+ * their slot was played are dropped. The audio engine drains the buffer
+ * at a steady FRAME_SIZE_MS cadence and decodes at playout time.
+ *
+ * With JITTER_BUFFER_ADAPTIVE the target depth follows the measured
+ * inter-arrival jitter. Depth changes are applied only during silence
+ * (a frame is inserted or skipped), so speech is never cut.
+ *
+ * When the sender goes into DTX (PACKET_FLAG_DTX) the starved playout
+ * point holds and plays comfort noise instead of concealing, until the
+ * sender's next frame continues the sequence.
+ *
+ * Each remote stream gets its own jitter_buffer_t (the base keeps one per
+ * connected pack). Storage comes from the boot-time arena (mem_arena.h)
+ * in jitter_buffer_init().
+ *
+ * One task receives (jitter_buffer_push, _set_low_latency, _reset) and one
+ * plays out (jitter_buffer_pop, _peek, _decode_next). They meet only in
+ * a lock-free queue of arrivals (audio_ring), so neither ever waits for
+ * the other; jitter_buffer_get_stats may be called from any task.
  */
 
 #ifndef AUDIO_JITTER_BUFFER_H
@@ -12,38 +31,221 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "esp_err.h"
+#include <stddef.h>
+#include "../platform/platform.h"
+#include "audio_opus.h"
+#include "audio_processor.h"
+#include "audio_vad.h"
+#include "audio_ring.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef enum {
+    JITTER_POP_FRAME = 0,        // Payload for this slot is in the frame
+    JITTER_POP_MISSING,          // Packet for this slot lost or not yet here - conceal
+    JITTER_POP_STRETCH,          // Inserted frame to grow depth during silence
+    JITTER_POP_EMPTY,            // No active stream - output nothing
+    JITTER_POP_COMFORT,          // Sender in DTX - play comfort noise
+} jitter_pop_result_t;
+
+typedef struct {
+    uint32_t sequence;
+    uint16_t size;
+    bool     dtx;                // Comfort-noise update (PACKET_FLAG_DTX)
+    uint8_t  data[OPUS_MAX_PACKET_SIZE];
+} jitter_frame_t;
+
+// One received payload on its way from the receive task to playout
+typedef struct {
+    int64_t        arrival_us;
+    uint32_t       timestamp;    // Sender's timestamp
+    uint32_t       generation;   // jitter_buffer_reset() count when pushed
+    bool           preferred;
+    jitter_frame_t frame;
+} jitter_arrival_t;
+
+typedef struct {
+    uint32_t current_depth;      // Frames between playout point and newest packet
+    uint32_t target_depth;       // Depth the buffer is steering towards
+    uint32_t jitter_us;          // Smoothed inter-arrival jitter estimate
+    uint32_t dwell_us;           // Smoothed arrival-to-playout wait of played frames
+    uint32_t underruns;          // Starvation gaps during a stream
+    uint32_t overruns;           // Frames discarded because the window was full
+    uint32_t frames_stretched;   // Frames inserted during silence to grow depth
+    uint32_t frames_shrunk;      // Silent frames skipped to cut depth
+    uint32_t late_drops;         // Packets that arrived after their slot played
+    uint32_t duplicates;         // Packets already held in their slot
+    uint32_t frames_missing;     // Slots played without a packet
+    uint32_t fec_recovered;      // Missing frames rebuilt from in-band FEC
+    uint32_t comfort_frames;     // Frames of local comfort noise during sender DTX
+    uint32_t queue_drops;        // Arrivals dropped because playout had stopped draining
+} jitter_buffer_stats_t;
+
+typedef struct {
+    bool           valid;
+    int64_t        arrival_us;   // First copy's arrival (dwell)
+    jitter_frame_t frame;
+} jitter_slot_t;
+
+// One buffer instance. Fields are private - use the functions below.
+// Everything but the receive side's fields is owned by playout.
+typedef struct {
+    jitter_slot_t *slots;
+    size_t   capacity;
+    bool     streaming;          // playout point is anchored
+    uint32_t next_seq;           // sequence of the next slot to play
+    uint32_t end_seq;            // one past the newest sequence received
+    bool     initialized;
+
+    // Receive side
+    audio_ring_t arrivals;       // jitter_arrival_t, drained by each pop
+    uint32_t rx_generation;      // Resets requested (atomic, any task)
+    bool     want_low_latency;
+    uint32_t generation;         // Resets applied by playout
+
+    // Adaptation
+    size_t   target_depth;
+    size_t   max_depth;          // Lower on a low-latency link
+    bool     low_latency;
+    bool     have_last_arrival;
+    uint32_t last_sequence;
+    uint32_t last_timestamp;
+    int64_t  last_arrival_us;
+    uint32_t jitter_q4;          // jitter estimate in us, scaled by 16
+    uint32_t dwell_q4;           // dwell estimate in us, scaled by 16
+    int64_t  shrink_pending_since_us;
+    uint32_t empty_pops;
+    bool     in_dtx;             // Last frame played was a DTX update
+    uint32_t dtx_pops;           // Comfort-noise frames since it
+
+    // Playout (jitter_buffer_decode_next)
+    bool     last_output_silent;
+    jitter_frame_t scratch;
+    jitter_frame_t fec_scratch;
+    audio_limiter_t limiter;
+    audio_cng_t cng;
+
+    jitter_buffer_stats_t counters;
+} jitter_buffer_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
 
 /**
- * @brief Initialize the jitter buffer and allocate storage
+ * @brief Initialize a jitter buffer and allocate its storage
+ * @param jb Buffer instance
  * @return ESP_OK on success
  */
-esp_err_t jitter_buffer_init(void);
+esp_err_t jitter_buffer_init(jitter_buffer_t *jb);
 
 /**
- * @brief Push a decoded PCM frame into the buffer
- * @param frame  Pointer to PCM samples (int16_t)
- * @param samples Number of samples in the frame
- * @return true if the frame was stored, false if the buffer was full (frame dropped)
+ * @brief Store a received Opus payload in its sequence slot
+ * @param jb        Buffer instance
+ * @param opus_data Opus encoded audio
+ * @param opus_size Size of Opus data (bytes)
+ * @param sequence  Sender's packet sequence number
+ * @param timestamp Sender's microsecond timestamp (audio_packet_t.timestamp)
+ * @param preferred Replace a copy of this frame already held (e.g. the
+ *                  listener's own mix-minus over the broadcast mix)
+ * @param dtx       Comfort-noise update: the sender goes quiet after it
+ * @return true if the payload was queued for playout (which still drops
+ *         it if late or a duplicate), false if invalid or the queue is full
  */
-bool jitter_buffer_push(const int16_t *frame, size_t samples);
+bool jitter_buffer_push(jitter_buffer_t *jb, const uint8_t *opus_data, uint16_t opus_size,
+                        uint32_t sequence, uint32_t timestamp, bool preferred, bool dtx);
 
 /**
- * @brief Pop the oldest PCM frame from the buffer
- * @param frame   Output buffer for PCM samples
- * @param samples Number of samples to read
- * @return true if a frame was available, false if the buffer was empty
+ * @brief Take the next slot for playout
+ * @param jb                 Buffer instance
+ * @param frame              Filled with the payload on JITTER_POP_FRAME
+ * @param last_output_silent Whether the previously played frame was silent
+ *                           (depth is only adjusted across silence)
+ * @return What the caller should play for this slot
  */
-bool jitter_buffer_pop(int16_t *frame, size_t samples);
+jitter_pop_result_t jitter_buffer_pop(jitter_buffer_t *jb, jitter_frame_t *frame,
+                                      bool last_output_silent);
+
+/**
+ * @brief Copy a buffered payload without consuming it
+ *
+ * Used on a missing slot to fetch the following packet, whose in-band
+ * FEC data can rebuild the lost frame.
+ * @param jb       Buffer instance
+ * @param sequence Sequence number to look up
+ * @param frame    Filled with the payload if present
+ * @return true if the packet for @p sequence is buffered
+ */
+bool jitter_buffer_peek(jitter_buffer_t *jb, uint32_t sequence, jitter_frame_t *frame);
+
+/**
+ * @brief Pop the next slot and decode it to PCM
+ *
+ * Handles the whole playout step: decode, FEC recovery from the next
+ * packet, PLC for missing or stretched frames, comfort noise during
+ * sender DTX, and the output limiter.
+ * @param jb         Buffer instance
+ * @param decoder    Decoder for this stream (NULL = audio_opus default)
+ * @param pcm        Output buffer for PCM samples
+ * @param samples    Size of @p pcm in samples
+ * @return Samples written, or 0 if there is no active stream
+ */
+int jitter_buffer_decode_next(jitter_buffer_t *jb, audio_opus_decoder_t *decoder,
+                              int16_t *pcm, size_t samples);
+
+/**
+ * @brief Switch between the normal and the low-latency depth range
+ *
+ * A low-latency link starts its target at the depth floor and never
+ * grows past JITTER_BUFFER_LOW_LATENCY_MAX_FRAMES (adaptive depth
+ * only). Cheap, so it can be called per packet; playout applies a
+ * change before its next frame.
+ * @param jb          Buffer instance
+ * @param low_latency true for the low-latency range
+ */
+void jitter_buffer_set_low_latency(jitter_buffer_t *jb, bool low_latency);
+
+/**
+ * @brief Set the depth range of every buffer
+ *
+ * The build defaults are JITTER_BUFFER_MIN_FRAMES, JITTER_BUFFER_FRAMES
+ * and JITTER_BUFFER_MAX_FRAMES. The floor and ceiling bind from the next adaptation step (a target above a lowered
+ * ceiling shrinks back at the usual pace); the starting depth is taken at
+ * each buffer's next reset. Without JITTER_BUFFER_ADAPTIVE the starting
+ * depth is the fixed depth.
+ * @param min_frames Floor (at least 1)
+ * @param start_frames Starting depth, min_frames..max_frames
+ * @param max_frames Ceiling, at most JITTER_BUFFER_MAX_FRAMES
+ * @return ESP_OK, ESP_ERR_INVALID_ARG out of order or past the capacity
+ */
+esp_err_t jitter_buffer_set_depth_range(size_t min_frames, size_t start_frames, size_t max_frames);
+
+/**
+ * @brief Get depth, jitter and underrun/overrun counters
+ *
+ * A snapshot taken without stopping playout: counters can be a frame
+ * apart from each other.
+ * @param jb    Buffer instance
+ * @param stats Pointer to stats structure
+ */
+void jitter_buffer_get_stats(jitter_buffer_t *jb, jitter_buffer_stats_t *stats);
 
 /**
  * @brief Reset the buffer (discard all queued frames)
+ *
+ * Safe from any task (it bumps a counter atomically). Frames pushed after
+ * the call returns are kept, everything before it is discarded when
+ * playout reaches it; a push racing the call may land on either side.
+ * @param jb Buffer instance
  */
-void jitter_buffer_reset(void);
+void jitter_buffer_reset(jitter_buffer_t *jb);
 
 /**
- * @brief Free all resources allocated by jitter_buffer_init()
+ * @brief Retire the buffer (its arena storage is held until reboot)
+ * @param jb Buffer instance
  */
-void jitter_buffer_deinit(void);
+void jitter_buffer_deinit(jitter_buffer_t *jb);
 
 #endif // AUDIO_JITTER_BUFFER_H
@@ -1,28 +1,125 @@
 /**
  * @file audio_opus.c
  * @brief Opus Codec Wrapper Implementation
+ *
+ * Encoder and decoder state is sized with opus_*_get_size() and
+ * initialised in place in the fast arena region, so libopus never
+ * allocates. State is held until reboot: destroy only resets it, and a
+ * later audio_opus_init() reuses the default pair.
  */
 
 #include "audio_opus.h"
 #include "../config.h"
+#include "../system/trace.h"
+#include "../platform/platform.h"
+#include "../platform/mem_arena.h"
 #include "opus.h"
-#include "esp_log.h"
-#include "esp_timer.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "OPUS";
 
+#if FRAME_SIZE_MS != 5 && FRAME_SIZE_MS != 10 && FRAME_SIZE_MS != 20
+#error "FRAME_SIZE_MS must be 5, 10 or 20"
+#endif
+
+#if FRAME_SIZE_MS < 10 && !OPUS_LOW_DELAY
+#error "Frames below 10 ms need OPUS_LOW_DELAY (CELT only)"
+#endif
+
+#if OPUS_LOW_DELAY
+#define OPUS_CODEC_APPLICATION      OPUS_APPLICATION_RESTRICTED_LOWDELAY
+#else
+#define OPUS_CODEC_APPLICATION      OPUS_APPLICATION_VOIP
+#endif
+
 //=============================================================================
 // PRIVATE VARIABLES
 //=============================================================================
 
-static OpusEncoder *encoder = NULL;
+struct audio_opus_decoder {
+    OpusDecoder *opus;
+};
+
+struct audio_opus_encoder {
+    OpusEncoder *opus;
+    int applied_loss_perc;
+    int applied_bitrate;
+    int applied_complexity;
+};
+
+static audio_opus_encoder_t default_encoder = {0};
 static OpusDecoder *decoder = NULL;
 static bool initialized = false;
 
+// Encoder settings requested at run time (rate control, monitor task).
+// They are applied from the encode path so encoder ctl calls never race
+// opus_encode()
+static volatile int requested_loss_perc = OPUS_FEC_MIN_LOSS_PERC;
+static volatile int requested_bitrate = OPUS_BITRATE;
+static volatile int requested_complexity = OPUS_COMPLEXITY;
+
 // Statistics
 static int64_t total_encode_time_us = 0;
 static uint32_t total_frames_encoded = 0;
+static volatile uint32_t peak_encode_time_us = 0;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+// Set up an encoder for low-latency voice at the build defaults, in
+// arena storage (enc = NULL) or reusing earlier storage
+static OpusEncoder *create_encoder(OpusEncoder *enc)
+{
+    if (!enc) {
+        enc = mem_arena_alloc(MEM_ARENA_FAST, (size_t)opus_encoder_get_size(1), "opus_encoder");
+    }
+    if (!enc) {
+        return NULL;
+    }
+
+    int error = opus_encoder_init(enc, SAMPLE_RATE_HZ, 1, OPUS_CODEC_APPLICATION);
+    if (error != OPUS_OK) {
+        ESP_LOGE(TAG, "Failed to create encoder: %s", opus_strerror(error));
+        return NULL;
+    }
+
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE(OPUS_BITRATE));
+    opus_encoder_ctl(enc, OPUS_SET_VBR(0));  // Constant bitrate
+    opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(OPUS_COMPLEXITY));
+    opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    // DTX codes silent frames as comfort-noise updates (audio_vad decides
+    // which frames are actually sent)
+    opus_encoder_ctl(enc, OPUS_SET_DTX(DTX_ENABLE));
+#if OPUS_FEC_ACTIVE
+    // In-band FEC: each packet carries a low-bitrate copy of the previous
+    // frame, sized by the expected loss rate
+    opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(1));
+    opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(OPUS_FEC_MIN_LOSS_PERC));
+#else
+    opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(0));
+#endif
+
+    return enc;
+}
+
+static OpusDecoder *create_decoder(OpusDecoder *dec)
+{
+    if (!dec) {
+        dec = mem_arena_alloc(MEM_ARENA_FAST, (size_t)opus_decoder_get_size(1), "opus_decoder");
+    }
+    if (!dec) {
+        return NULL;
+    }
+
+    int error = opus_decoder_init(dec, SAMPLE_RATE_HZ, 1);
+    if (error != OPUS_OK) {
+        ESP_LOGE(TAG, "Failed to create decoder: %s", opus_strerror(error));
+        return NULL;
+    }
+    return dec;
+}
 
 //=============================================================================
 // PUBLIC FUNCTIONS
@@ -37,33 +134,29 @@ esp_err_t audio_opus_init(void)
 
     ESP_LOGI(TAG, "Initializing Opus codec...");
     ESP_LOGI(TAG, "Sample rate: %d Hz", SAMPLE_RATE_HZ);
-    ESP_LOGI(TAG, "Frame size: %d ms (%d samples)", FRAME_SIZE_MS, SAMPLES_PER_FRAME);
+    ESP_LOGI(TAG, "Frame size: %d ms (%d samples)%s", FRAME_SIZE_MS, SAMPLES_PER_FRAME,
+             OPUS_LOW_DELAY ? ", restricted low delay" : "");
     ESP_LOGI(TAG, "Bitrate: %d bps", OPUS_BITRATE);
 
-    int error;
-
     // Create encoder
-    encoder = opus_encoder_create(SAMPLE_RATE_HZ, 1, OPUS_APPLICATION_VOIP, &error);
-    if (error != OPUS_OK || !encoder) {
-        ESP_LOGE(TAG, "Failed to create encoder: %s", opus_strerror(error));
+    default_encoder.opus = create_encoder(default_encoder.opus);
+    if (!default_encoder.opus) {
         return ESP_FAIL;
     }
-
-    // Configure encoder for low-latency voice
-    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(OPUS_BITRATE));
-    opus_encoder_ctl(encoder, OPUS_SET_VBR(0));  // Constant bitrate
-    opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(OPUS_COMPLEXITY));
-    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
-    opus_encoder_ctl(encoder, OPUS_SET_DTX(0));  // Disable discontinuous transmission
+    default_encoder.applied_loss_perc = OPUS_FEC_MIN_LOSS_PERC;
+    default_encoder.applied_bitrate = OPUS_BITRATE;
+    default_encoder.applied_complexity = OPUS_COMPLEXITY;
+#if OPUS_FEC_ACTIVE
+    ESP_LOGI(TAG, "In-band FEC enabled");
+#elif OPUS_INBAND_FEC_ENABLE
+    ESP_LOGW(TAG, "In-band FEC unavailable in restricted low delay (CELT only)");
+#endif
 
     ESP_LOGI(TAG, "Encoder created successfully");
 
     // Create decoder
-    decoder = opus_decoder_create(SAMPLE_RATE_HZ, 1, &error);
-    if (error != OPUS_OK || !decoder) {
-        ESP_LOGE(TAG, "Failed to create decoder: %s", opus_strerror(error));
-        opus_encoder_destroy(encoder);
-        encoder = NULL;
+    decoder = create_decoder(decoder);
+    if (!decoder) {
         return ESP_FAIL;
     }
 
@@ -82,7 +175,35 @@ esp_err_t audio_opus_init(void)
 int audio_opus_encode(const int16_t *pcm_in, int frame_size,
                       uint8_t *opus_out, int max_size)
 {
-    if (!initialized || !encoder) {
+    return audio_opus_encoder_encode(NULL, pcm_in, frame_size, opus_out, max_size);
+}
+
+audio_opus_encoder_t *audio_opus_encoder_create(void)
+{
+    audio_opus_encoder_t *enc = mem_arena_alloc(MEM_ARENA_FAST, sizeof(audio_opus_encoder_t),
+                                                "opus_encoder");
+    if (!enc) {
+        return NULL;
+    }
+
+    enc->opus = create_encoder(NULL);
+    if (!enc->opus) {
+        return NULL;
+    }
+    enc->applied_loss_perc = OPUS_FEC_MIN_LOSS_PERC;
+    enc->applied_bitrate = OPUS_BITRATE;
+    enc->applied_complexity = OPUS_COMPLEXITY;
+
+    return enc;
+}
+
+int audio_opus_encoder_encode(audio_opus_encoder_t *enc,
+                              const int16_t *pcm_in, int frame_size,
+                              uint8_t *opus_out, int max_size)
+{
+    if (!enc) enc = &default_encoder;
+
+    if (!initialized || !enc->opus) {
         ESP_LOGE(TAG, "Encoder not initialized");
         return -1;
     }
@@ -92,13 +213,38 @@ int audio_opus_encode(const int16_t *pcm_in, int frame_size,
         return -1;
     }
 
+#if OPUS_FEC_ACTIVE
+    int loss_perc = requested_loss_perc;
+    if (loss_perc != enc->applied_loss_perc) {
+        opus_encoder_ctl(enc->opus, OPUS_SET_PACKET_LOSS_PERC(loss_perc));
+        enc->applied_loss_perc = loss_perc;
+        ESP_LOGD(TAG, "Expected packet loss set to %d%%", loss_perc);
+    }
+#endif
+
+    int bitrate = requested_bitrate;
+    if (bitrate != enc->applied_bitrate) {
+        opus_encoder_ctl(enc->opus, OPUS_SET_BITRATE(bitrate));
+        enc->applied_bitrate = bitrate;
+        ESP_LOGD(TAG, "Bitrate set to %d bps", bitrate);
+    }
+
+    int complexity = requested_complexity;
+    if (complexity != enc->applied_complexity) {
+        opus_encoder_ctl(enc->opus, OPUS_SET_COMPLEXITY(complexity));
+        enc->applied_complexity = complexity;
+        ESP_LOGD(TAG, "Complexity set to %d", complexity);
+    }
+
     // Measure encode time
-    int64_t start = esp_timer_get_time();
+    int64_t start = platform_time_us();
+    uint32_t trace_start = trace_begin();
 
-    int encoded_bytes = opus_encode(encoder, pcm_in, frame_size,
+    int encoded_bytes = opus_encode(enc->opus, pcm_in, frame_size,
                                     opus_out, max_size);
 
-    int64_t encode_time = esp_timer_get_time() - start;
+    trace_end(TRACE_ENCODE, trace_start);
+    int64_t encode_time = platform_time_us() - start;
 
     if (encoded_bytes < 0) {
         ESP_LOGE(TAG, "Encode error: %s", opus_strerror(encoded_bytes));
@@ -108,6 +254,9 @@ int audio_opus_encode(const int16_t *pcm_in, int frame_size,
     // Update statistics
     total_encode_time_us += encode_time;
     total_frames_encoded++;
+    if (encode_time > peak_encode_time_us) {
+        peak_encode_time_us = (uint32_t)encode_time;
+    }
 
     ESP_LOGD(TAG, "Encoded %d samples -> %d bytes (%.2f ms)",
              frame_size, encoded_bytes, encode_time / 1000.0f);
@@ -115,10 +264,57 @@ int audio_opus_encode(const int16_t *pcm_in, int frame_size,
     return encoded_bytes;
 }
 
+void audio_opus_encoder_reset(audio_opus_encoder_t *enc)
+{
+    if (!enc) enc = &default_encoder;
+
+    if (enc->opus) {
+        opus_encoder_ctl(enc->opus, OPUS_RESET_STATE);
+    }
+}
+
+void audio_opus_encoder_destroy(audio_opus_encoder_t *enc)
+{
+    if (!enc || enc == &default_encoder) {
+        return;
+    }
+
+    // Arena storage: nothing to free, just stop it being used
+    if (enc->opus) {
+        opus_encoder_ctl(enc->opus, OPUS_RESET_STATE);
+    }
+    enc->opus = NULL;
+}
+
 int audio_opus_decode(const uint8_t *opus_in, int opus_size,
                       int16_t *pcm_out, int frame_size, int use_fec)
 {
-    if (!initialized || !decoder) {
+    return audio_opus_decoder_decode(NULL, opus_in, opus_size, pcm_out, frame_size, use_fec);
+}
+
+audio_opus_decoder_t *audio_opus_decoder_create(void)
+{
+    audio_opus_decoder_t *dec = mem_arena_alloc(MEM_ARENA_FAST, sizeof(audio_opus_decoder_t),
+                                                "opus_decoder");
+    if (!dec) {
+        return NULL;
+    }
+
+    dec->opus = create_decoder(NULL);
+    if (!dec->opus) {
+        return NULL;
+    }
+
+    return dec;
+}
+
+int audio_opus_decoder_decode(audio_opus_decoder_t *dec,
+                              const uint8_t *opus_in, int opus_size,
+                              int16_t *pcm_out, int frame_size, int use_fec)
+{
+    OpusDecoder *opus = dec ? dec->opus : decoder;
+
+    if (!initialized || !opus) {
         ESP_LOGE(TAG, "Decoder not initialized");
         return -1;
     }
@@ -129,16 +325,18 @@ int audio_opus_decode(const uint8_t *opus_in, int opus_size,
     }
 
     int decoded_samples;
+    uint32_t trace_start = trace_begin();
 
     if (opus_in == NULL || opus_size == 0) {
         // Packet loss - use FEC or PLC
         ESP_LOGD(TAG, "Packet loss - using PLC");
-        decoded_samples = opus_decode(decoder, NULL, 0, pcm_out, frame_size, use_fec);
+        decoded_samples = opus_decode(opus, NULL, 0, pcm_out, frame_size, use_fec);
     } else {
         // Normal decode
-        decoded_samples = opus_decode(decoder, opus_in, opus_size,
+        decoded_samples = opus_decode(opus, opus_in, opus_size,
                                      pcm_out, frame_size, use_fec);
     }
+    trace_end(TRACE_DECODE, trace_start);
 
     if (decoded_samples < 0) {
         ESP_LOGE(TAG, "Decode error: %s", opus_strerror(decoded_samples));
@@ -150,6 +348,72 @@ int audio_opus_decode(const uint8_t *opus_in, int opus_size,
     return decoded_samples;
 }
 
+void audio_opus_decoder_reset(audio_opus_decoder_t *dec)
+{
+    OpusDecoder *opus = dec ? dec->opus : decoder;
+
+    if (opus) {
+        opus_decoder_ctl(opus, OPUS_RESET_STATE);
+    }
+}
+
+void audio_opus_decoder_destroy(audio_opus_decoder_t *dec)
+{
+    if (!dec) {
+        return;
+    }
+
+    dec->opus = NULL;
+}
+
+void audio_opus_set_packet_loss_perc(float loss_percent)
+{
+    int perc = (int)(loss_percent + 0.5f);
+
+    if (perc < OPUS_FEC_MIN_LOSS_PERC) perc = OPUS_FEC_MIN_LOSS_PERC;
+    if (perc > OPUS_FEC_MAX_LOSS_PERC) perc = OPUS_FEC_MAX_LOSS_PERC;
+
+    requested_loss_perc = perc;
+}
+
+int audio_opus_get_packet_loss_perc(void)
+{
+    return requested_loss_perc;
+}
+
+void audio_opus_set_bitrate(int bitrate_bps)
+{
+    if (bitrate_bps < 6000) bitrate_bps = 6000;
+    if (bitrate_bps > 510000) bitrate_bps = 510000;
+
+    requested_bitrate = bitrate_bps;
+}
+
+int audio_opus_get_bitrate(void)
+{
+    return requested_bitrate;
+}
+
+void audio_opus_set_complexity(int complexity)
+{
+    if (complexity < 0) complexity = 0;
+    if (complexity > 10) complexity = 10;
+
+    requested_complexity = complexity;
+}
+
+int audio_opus_get_complexity(void)
+{
+    return requested_complexity;
+}
+
+uint32_t audio_opus_take_peak_encode_time_us(void)
+{
+    uint32_t peak = peak_encode_time_us;
+    peak_encode_time_us = 0;
+    return peak;
+}
+
 void audio_opus_get_stats(float *avg_encode_time_ms, uint32_t *total_frames)
 {
     if (!initialized) {
@@ -175,6 +439,7 @@ void audio_opus_reset_stats(void)
 {
     total_encode_time_us = 0;
     total_frames_encoded = 0;
+    peak_encode_time_us = 0;
 }
 
 void audio_opus_deinit(void)
@@ -185,16 +450,7 @@ void audio_opus_deinit(void)
 
     ESP_LOGI(TAG, "Destroying Opus codec");
 
-    if (encoder) {
-        opus_encoder_destroy(encoder);
-        encoder = NULL;
-    }
-
-    if (decoder) {
-        opus_decoder_destroy(decoder);
-        decoder = NULL;
-    }
-
+    // The state stays in the arena for the next audio_opus_init()
     initialized = false;
     ESP_LOGI(TAG, "Opus deinitialized");
 }
\ No newline at end of file
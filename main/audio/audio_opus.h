@@ -10,7 +10,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "esp_err.h"
+#include "../platform/platform.h"
 
 //=============================================================================
 // OPUS CONFIGURATION
@@ -20,6 +20,13 @@
 // Typical: 60-80 bytes at 24kbps for 20ms frames
 #define OPUS_MAX_PACKET_SIZE    256
 
+// Extra decoder instance (one per remote stream, e.g. per pack on the base)
+typedef struct audio_opus_decoder audio_opus_decoder_t;
+
+// Extra encoder instance (one per outgoing mix, e.g. per-pack mix-minus).
+// Every encoder follows the bitrate/complexity/loss settings below.
+typedef struct audio_opus_encoder audio_opus_encoder_t;
+
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
@@ -41,6 +48,42 @@ esp_err_t audio_opus_init(void);
 int audio_opus_encode(const int16_t *pcm_in, int frame_size,
                       uint8_t *opus_out, int max_size);
 
+/**
+ * @brief Create an additional encoder
+ *
+ * State comes from the boot-time arena (mem_arena.h), so call it during
+ * init, before mem_arena_seal().
+ * @return Encoder, or NULL on failure
+ */
+audio_opus_encoder_t *audio_opus_encoder_create(void);
+
+/**
+ * @brief Encode with a specific encoder
+ * @param encoder Encoder instance (NULL = default encoder from audio_opus_init)
+ * @param pcm_in Pointer to PCM samples (16-bit signed)
+ * @param frame_size Number of samples per channel
+ * @param opus_out Buffer for encoded data
+ * @param max_size Maximum size of output buffer
+ * @return Number of bytes written, or negative error code
+ */
+int audio_opus_encoder_encode(audio_opus_encoder_t *encoder,
+                              const int16_t *pcm_in, int frame_size,
+                              uint8_t *opus_out, int max_size);
+
+/**
+ * @brief Reset encoder state (new stream on a reused encoder)
+ * @param encoder Encoder instance (NULL = default encoder)
+ */
+void audio_opus_encoder_reset(audio_opus_encoder_t *encoder);
+
+/**
+ * @brief Retire an encoder created by audio_opus_encoder_create()
+ *
+ * Its arena storage is held until reboot.
+ * @param encoder Encoder instance
+ */
+void audio_opus_encoder_destroy(audio_opus_encoder_t *encoder);
+
 /**
  * @brief Decode Opus to PCM audio
  * @param opus_in Pointer to Opus encoded data
@@ -53,6 +96,93 @@ int audio_opus_encode(const int16_t *pcm_in, int frame_size,
 int audio_opus_decode(const uint8_t *opus_in, int opus_size,
                       int16_t *pcm_out, int frame_size, int use_fec);
 
+/**
+ * @brief Create an additional decoder
+ *
+ * State comes from the boot-time arena (mem_arena.h), so call it during
+ * init, before mem_arena_seal().
+ * @return Decoder, or NULL on failure
+ */
+audio_opus_decoder_t *audio_opus_decoder_create(void);
+
+/**
+ * @brief Decode with a specific decoder
+ * @param decoder Decoder instance (NULL = default decoder from audio_opus_init)
+ * @param opus_in Opus data (NULL for PLC)
+ * @param opus_size Size of encoded data in bytes
+ * @param pcm_out Buffer for decoded PCM samples
+ * @param frame_size Maximum number of samples per channel
+ * @param use_fec Use forward error correction (0 or 1)
+ * @return Number of samples decoded, or negative error code
+ */
+int audio_opus_decoder_decode(audio_opus_decoder_t *decoder,
+                              const uint8_t *opus_in, int opus_size,
+                              int16_t *pcm_out, int frame_size, int use_fec);
+
+/**
+ * @brief Reset decoder state (new stream on a reused decoder)
+ * @param decoder Decoder instance (NULL = default decoder)
+ */
+void audio_opus_decoder_reset(audio_opus_decoder_t *decoder);
+
+/**
+ * @brief Retire a decoder created by audio_opus_decoder_create()
+ *
+ * Its arena storage is held until reboot.
+ * @param decoder Decoder instance
+ */
+void audio_opus_decoder_destroy(audio_opus_decoder_t *decoder);
+
+/**
+ * @brief Set the packet loss rate the encoder should protect against
+ *
+ * Drives the amount of in-band FEC. Clamped to
+ * OPUS_FEC_MIN_LOSS_PERC..OPUS_FEC_MAX_LOSS_PERC and applied on the next
+ * encode, so it is safe to call from any task.
+ * @param loss_percent Measured packet loss (0-100)
+ */
+void audio_opus_set_packet_loss_perc(float loss_percent);
+
+/**
+ * @brief Get the packet loss rate currently requested from the encoder
+ * @return Loss percentage as passed to OPUS_SET_PACKET_LOSS_PERC
+ */
+int audio_opus_get_packet_loss_perc(void);
+
+/**
+ * @brief Set the encoder bitrate at run time
+ *
+ * Applied on the next encode, so it is safe to call from any task.
+ * @param bitrate_bps Target bitrate (6000-510000 bps)
+ */
+void audio_opus_set_bitrate(int bitrate_bps);
+
+/**
+ * @brief Get the bitrate currently requested from the encoder
+ * @return Bitrate in bits per second
+ */
+int audio_opus_get_bitrate(void);
+
+/**
+ * @brief Set the encoder complexity at run time
+ *
+ * Applied on the next encode, so it is safe to call from any task.
+ * @param complexity Complexity (0-10)
+ */
+void audio_opus_set_complexity(int complexity);
+
+/**
+ * @brief Get the complexity currently requested from the encoder
+ * @return Complexity (0-10)
+ */
+int audio_opus_get_complexity(void);
+
+/**
+ * @brief Get the longest single encode since the last call, then reset it
+ * @return Peak encode time in microseconds
+ */
+uint32_t audio_opus_take_peak_encode_time_us(void);
+
 /**
  * @brief Get encoder statistics (for monitoring)
  * @param avg_encode_time_ms Average encode time in milliseconds
@@ -1,25 +1,183 @@
 /**
  * @file audio_processor.c
  * @brief Audio Processing Pipeline Implementation
+ *
+ * Per-sample loops run on the Q15 kernels in audio_dsp (PIE vector path
+ * on the ESP32-S3).
  */
 
 #include "audio_processor.h"
+#include "audio_dsp.h"
 #include "../config.h"
-#include "esp_log.h"
+#include "../platform/platform.h"
 #include <math.h>
 #include <string.h>
 
 static const char *TAG = "AUDIO_PROC";
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 //=============================================================================
 // PRIVATE FUNCTIONS
 //=============================================================================
 
 static inline int16_t clamp_sample(int32_t sample)
 {
-    if (sample > 32767) return 32767;
-    if (sample < -32768) return -32768;
-    return (int16_t)sample;
+    return audio_dsp_sat16(sample);
+}
+
+// Unity gain in Q15
+#define MIX_UNITY_Q15           32768
+
+// Mix bus peak allowed before the automatic gain steps in
+#define MIX_PEAK_LIMIT          ((int32_t)(32767.0f * LIMITER_THRESHOLD))
+
+// Recovery per frame: close 1/8 of the gap back to unity (~160 ms to 2/3)
+#define MIX_RELEASE_SHIFT       3
+
+// Look-ahead limiter
+#define LIM_UNITY_Q30           (1 << 30)
+#define LIM_LOOKAHEAD_SAMPLES   (LIMITER_LOOKAHEAD_MS * SAMPLE_RATE_HZ / 1000)
+
+// AGC gains, Q12
+#define AGC_UNITY_Q12           4096
+#define AGC_MAX_Q12             ((int32_t)(AGC_MAX_GAIN * AGC_UNITY_Q12))
+#define AGC_MIN_Q12             ((int32_t)(AGC_MIN_GAIN * AGC_UNITY_Q12))
+#define AGC_TARGET_LEVEL        ((int32_t)(AGC_TARGET_RMS * 32768.0f))
+#define AGC_GATE_LEVEL          ((uint32_t)(AGC_GATE_RMS * 32768.0f))
+
+// Party-line input filter: the DC tracker's pole is 1 - 2^-DC_SHIFT (~2.5 Hz)
+#define LINE_DC_SHIFT           10
+#define LINE_BIQUAD_Q28         (1 << 28)
+#define LINE_GATE_UNITY_Q15     32768
+
+// Ceiling of the AUDIO_LIMITER_SHARED limiters, Q15 (as audio_dsp_q15)
+static volatile int32_t shared_threshold = (int32_t)(LIMITER_THRESHOLD * 32768.0f + 0.5f);
+
+static inline int32_t mix_sum(const int16_t *const *inputs, size_t input_count, size_t i)
+{
+    int32_t sum = 0;
+    for (size_t n = 0; n < input_count; n++) {
+        sum += inputs[n][i];
+    }
+    return sum;
+}
+
+// Gain ramp for one frame given the bus peak: instant attack, gradual
+// release (ramped across the frame)
+static void mix_gain_update(audio_mix_state_t *state, int32_t peak,
+                            int32_t *gain_start, int32_t *gain_end)
+{
+    int32_t target = MIX_UNITY_Q15;
+    if (peak > MIX_PEAK_LIMIT) {
+        target = (int32_t)(((int64_t)MIX_PEAK_LIMIT << 15) / peak);
+    }
+
+    int32_t start = state->gain_q15;
+    int32_t end;
+    if (target <= start) {
+        start = target;
+        end = target;
+    } else {
+        end = start + ((MIX_UNITY_Q15 - start) >> MIX_RELEASE_SHIFT);
+        if (end > target) end = target;
+    }
+    state->gain_q15 = end;
+
+    *gain_start = start;
+    *gain_end = end;
+}
+
+static uint32_t isqrt32(uint32_t x)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+
+    while (bit > x) bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// New AGC gain for this frame from its RMS (held through silence)
+static int32_t agc_update(audio_limiter_t *lim, const int16_t *buf, size_t count)
+{
+    uint32_t rms = isqrt32((uint32_t)(audio_dsp_energy(buf, count) / count));
+    if (rms < AGC_GATE_LEVEL) {
+        return lim->agc_q12;
+    }
+
+    int32_t desired = (int32_t)(((int64_t)AGC_TARGET_LEVEL << 12) / rms);
+    if (desired > AGC_MAX_Q12) desired = AGC_MAX_Q12;
+    if (desired < AGC_MIN_Q12) desired = AGC_MIN_Q12;
+
+    int32_t agc = lim->agc_q12;
+    agc += (desired - agc) >> (desired < agc ? AGC_ATTACK_SHIFT : AGC_RELEASE_SHIFT);
+    lim->agc_q12 = agc;
+    return agc;
+}
+
+static inline int32_t limit_gain_q15(int32_t threshold, int32_t peak)
+{
+    return peak > threshold ? (int32_t)(((int64_t)threshold << 15) / peak) : 32768;
+}
+
+static void limiter_block(audio_limiter_t *lim, int16_t *buf, size_t count)
+{
+    int32_t level[SAMPLES_PER_FRAME];     // After AGC, before limiting
+    uint16_t target[SAMPLES_PER_FRAME];   // Limiter gain wanted, Q15
+    const int32_t threshold = lim->threshold;
+
+    // AGC, ramped from last frame's gain
+    int32_t agc = lim->agc_q12;
+    int32_t agc_end = (AGC_ENABLE && lim->agc) ? agc_update(lim, buf, count) : agc;
+    int32_t agc_step = (agc_end - agc) / (int32_t)count;
+    for (size_t i = 0; i < count; i++) {
+        level[i] = ((int32_t)buf[i] * agc) >> 12;
+        agc += agc_step;
+    }
+
+    // Backward pass: peak over the look-ahead window (held peak), as a gain
+    int32_t hold = 0;
+    int hold_left = 0;
+    int32_t hold_gain = 32768;
+    for (size_t i = count; i-- > 0;) {
+        int32_t mag = level[i] < 0 ? -level[i] : level[i];
+        if (mag >= hold || hold_left == 0) {
+            hold = mag;
+            hold_left = LIM_LOOKAHEAD_SAMPLES;
+            hold_gain = limit_gain_q15(threshold, hold);
+        } else {
+            hold_left--;
+        }
+        target[i] = (uint16_t)hold_gain;
+    }
+
+    // Forward pass: smooth, and never let a sample past the ceiling (the
+    // look-ahead is cut short at the end of the frame)
+    int32_t gain = lim->gain_q30;
+    for (size_t i = 0; i < count; i++) {
+        int32_t want = (int32_t)target[i] << 15;
+        gain += (want - gain) >> (want < gain ? LIMITER_ATTACK_SHIFT : LIMITER_RELEASE_SHIFT);
+
+        int32_t applied = gain;
+        int32_t mag = level[i] < 0 ? -level[i] : level[i];
+        if (mag > threshold) {
+            int32_t ceiling = limit_gain_q15(threshold, mag) << 15;
+            if (applied > ceiling) applied = ceiling;
+        }
+        buf[i] = clamp_sample((int32_t)(((int64_t)level[i] * applied) >> 30));
+    }
+    lim->gain_q30 = gain;
 }
 
 //=============================================================================
@@ -32,6 +190,10 @@ esp_err_t audio_processor_init(void)
     ESP_LOGI(TAG, "Limiter enabled: %d", ENABLE_AUDIO_LIMITER);
     ESP_LOGI(TAG, "Limiter threshold: %.2f", LIMITER_THRESHOLD);
 
+#if AUDIO_DSP_BENCHMARK
+    audio_dsp_benchmark();
+#endif
+
     return ESP_OK;
 }
 
@@ -43,15 +205,118 @@ void audio_processor_mix(const int16_t *stream1, const int16_t *stream2,
         return;
     }
 
-    // Clamp mix levels
-    if (mix1 > 1.0f) mix1 = 1.0f;
-    if (mix1 < 0.0f) mix1 = 0.0f;
-    if (mix2 > 1.0f) mix2 = 1.0f;
-    if (mix2 < 0.0f) mix2 = 0.0f;
+    // Levels are clamped to 0.0-1.0 by the Q15 conversion
+    audio_dsp_mix2(stream1, stream2, output, sample_count,
+                   audio_dsp_q15(mix1), audio_dsp_q15(mix2));
+}
+
+void audio_processor_mix_init(audio_mix_state_t *state)
+{
+    if (state) {
+        state->gain_q15 = MIX_UNITY_Q15;
+    }
+}
+
+void audio_processor_mix_n(const int16_t *const *inputs, size_t input_count,
+                           int16_t *output, size_t sample_count,
+                           audio_mix_state_t *state)
+{
+    if (!output || (input_count > 0 && !inputs)) {
+        return;
+    }
+
+    if (input_count == 0) {
+        memset(output, 0, sample_count * sizeof(int16_t));
+        return;
+    }
+
+    if (!state) {
+        if (input_count == 2) {
+            audio_dsp_add_sat(inputs[0], inputs[1], output, sample_count);
+            return;
+        }
+        for (size_t i = 0; i < sample_count; i++) {
+            output[i] = clamp_sample(mix_sum(inputs, input_count, i));
+        }
+        return;
+    }
 
+    // Pass 1: find the bus peak so the gain for this frame is known up front
+    int32_t peak = 0;
     for (size_t i = 0; i < sample_count; i++) {
-        int32_t mixed = (int32_t)(stream1[i] * mix1) + (int32_t)(stream2[i] * mix2);
-        output[i] = clamp_sample(mixed);
+        int32_t sum = mix_sum(inputs, input_count, i);
+        if (sum < 0) sum = -sum;
+        if (sum > peak) peak = sum;
+    }
+
+    int32_t gain_start, gain_end;
+    mix_gain_update(state, peak, &gain_start, &gain_end);
+
+    // Pass 2: sum again and apply gain (inputs are read before output is written)
+    if (gain_start == MIX_UNITY_Q15 && gain_end == MIX_UNITY_Q15) {
+        if (input_count == 2) {
+            audio_dsp_add_sat(inputs[0], inputs[1], output, sample_count);
+            return;
+        }
+        for (size_t i = 0; i < sample_count; i++) {
+            output[i] = clamp_sample(mix_sum(inputs, input_count, i));
+        }
+        return;
+    }
+
+    int32_t gain_step = (gain_end - gain_start) / (int32_t)sample_count;
+    int32_t gain = gain_start;
+    for (size_t i = 0; i < sample_count; i++) {
+        int32_t sum = mix_sum(inputs, input_count, i);
+        output[i] = clamp_sample((int32_t)(((int64_t)sum * gain) >> 15));
+        gain += gain_step;
+    }
+}
+
+void audio_processor_mix_bus(const int16_t *const *inputs, size_t input_count,
+                             int32_t *bus, size_t sample_count)
+{
+    if (!bus || (input_count > 0 && !inputs)) {
+        return;
+    }
+
+    for (size_t i = 0; i < sample_count; i++) {
+        bus[i] = mix_sum(inputs, input_count, i);
+    }
+}
+
+void audio_processor_mix_minus(const int32_t *bus, const int16_t *own,
+                               int16_t *output, size_t sample_count,
+                               audio_mix_state_t *state)
+{
+    if (!bus || !output) {
+        return;
+    }
+
+    if (!state) {
+        for (size_t i = 0; i < sample_count; i++) {
+            int32_t sum = own ? bus[i] - own[i] : bus[i];
+            output[i] = clamp_sample(sum);
+        }
+        return;
+    }
+
+    int32_t peak = 0;
+    for (size_t i = 0; i < sample_count; i++) {
+        int32_t sum = own ? bus[i] - own[i] : bus[i];
+        if (sum < 0) sum = -sum;
+        if (sum > peak) peak = sum;
+    }
+
+    int32_t gain_start, gain_end;
+    mix_gain_update(state, peak, &gain_start, &gain_end);
+
+    int32_t gain_step = (gain_end - gain_start) / (int32_t)sample_count;
+    int32_t gain = gain_start;
+    for (size_t i = 0; i < sample_count; i++) {
+        int32_t sum = own ? bus[i] - own[i] : bus[i];
+        output[i] = clamp_sample((int32_t)(((int64_t)sum * gain) >> 15));
+        gain += gain_step;
     }
 }
 
@@ -61,22 +326,132 @@ void audio_processor_limit(int16_t *buffer, size_t sample_count, float threshold
         return;
     }
 
-    // Clamp threshold
-    if (threshold > 1.0f) threshold = 1.0f;
-    if (threshold < 0.0f) threshold = 0.0f;
+    // Soft limiting (prevents hard clipping): excess over the threshold
+    // is reduced by 75%. The threshold is clamped by the Q15 conversion.
+    audio_dsp_soft_limit(buffer, sample_count, audio_dsp_q15(threshold));
+}
 
-    const int16_t threshold_value = (int16_t)(32767.0f * threshold);
+void audio_processor_limiter_init(audio_limiter_t *limiter, float threshold, bool agc)
+{
+    if (!limiter) return;
+
+    limiter->shared = threshold <= 0.0f;
+    limiter->threshold = limiter->shared ? shared_threshold : audio_dsp_q15(threshold);
+    limiter->gain_q30 = LIM_UNITY_Q30;
+    limiter->agc_q12 = AGC_UNITY_Q12;
+    limiter->agc = agc;
+}
+
+void audio_processor_set_limiter_threshold(float threshold)
+{
+    shared_threshold = audio_dsp_q15(threshold);
+}
+
+void audio_processor_limiter_process(audio_limiter_t *limiter, int16_t *buffer,
+                                     size_t sample_count)
+{
+    if (!limiter || !buffer || !ENABLE_AUDIO_LIMITER) {
+        return;
+    }
+
+    if (limiter->shared) {
+        limiter->threshold = shared_threshold;
+    }
+
+    // Look-ahead is within one frame; longer buffers go a frame at a time
+    while (sample_count > 0) {
+        size_t count = sample_count < SAMPLES_PER_FRAME ? sample_count : SAMPLES_PER_FRAME;
+        limiter_block(limiter, buffer, count);
+        buffer += count;
+        sample_count -= count;
+    }
+}
+
+void audio_processor_line_filter_init(audio_line_filter_t *filter, bool dc_block,
+                                      float hpf_hz, float gate_floor, uint32_t release_ms)
+{
+    if (!filter) return;
+
+    memset(filter, 0, sizeof(*filter));
+    filter->dc_block = dc_block;
+
+    // Butterworth high-pass (RBJ cookbook), or a straight wire
+    if (hpf_hz > 0.0f) {
+        float w0 = 2.0f * (float)M_PI * hpf_hz / (float)SAMPLE_RATE_HZ;
+        float cos_w0 = cosf(w0);
+        float alpha = sinf(w0) / (2.0f * 0.70710678f);
+        float a0 = 1.0f + alpha;
+        filter->b0 = (int32_t)((1.0f + cos_w0) / 2.0f / a0 * LINE_BIQUAD_Q28);
+        filter->b1 = -2 * filter->b0;
+        filter->b2 = filter->b0;
+        filter->a1 = (int32_t)(-2.0f * cos_w0 / a0 * LINE_BIQUAD_Q28);
+        filter->a2 = (int32_t)((1.0f - alpha) / a0 * LINE_BIQUAD_Q28);
+    } else {
+        filter->b0 = LINE_BIQUAD_Q28;
+    }
+
+    if (gate_floor > 1.0f) gate_floor = 1.0f;
+    if (gate_floor < 0.0f) gate_floor = 0.0f;
+    filter->floor_q15 = (int32_t)(gate_floor * LINE_GATE_UNITY_Q15);
+    uint32_t release_frames = release_ms / FRAME_SIZE_MS;
+    if (release_frames == 0) release_frames = 1;
+    filter->release_q15 = (LINE_GATE_UNITY_Q15 - filter->floor_q15) / (int32_t)release_frames;
+    if (filter->release_q15 < 1) filter->release_q15 = 1;
+    filter->gate_q15 = LINE_GATE_UNITY_Q15;
+}
+
+void audio_processor_line_filter_process(audio_line_filter_t *filter, int16_t *buffer,
+                                         size_t sample_count, bool gate_open)
+{
+    if (!filter || !buffer || sample_count == 0) return;
+
+    // Gate ramp for this frame: opens within it, closes at the release rate
+    int32_t gate_start = filter->gate_q15;
+    int32_t gate_end = gate_open ? LINE_GATE_UNITY_Q15 : filter->floor_q15;
+    if (gate_end < gate_start - filter->release_q15) {
+        gate_end = gate_start - filter->release_q15;
+    }
+    int32_t gate_q23 = gate_start * 256;
+    int32_t gate_step = (gate_end - gate_start) * 256 / (int32_t)sample_count;
+
+    // Locals for the loop: the state is written back once
+    int32_t dc_q12 = filter->dc_q12;
+    int32_t x1 = filter->x1, x2 = filter->x2;
+    int32_t y1 = filter->y1, y2 = filter->y2;
+    const int32_t b0 = filter->b0, b1 = filter->b1, b2 = filter->b2;
+    const int32_t a1 = filter->a1, a2 = filter->a2;
+    uint64_t energy = 0;
 
     for (size_t i = 0; i < sample_count; i++) {
-        if (buffer[i] > threshold_value) {
-            // Soft limiting (prevents hard clipping)
-            int16_t excess = buffer[i] - threshold_value;
-            buffer[i] = threshold_value + (excess / 4);  // Reduce excess by 75%
-        } else if (buffer[i] < -threshold_value) {
-            int16_t excess = buffer[i] + threshold_value;
-            buffer[i] = -threshold_value + (excess / 4);
+        int32_t x = buffer[i];
+
+        // DC block: x minus a slow running mean
+        if (filter->dc_block) {
+            dc_q12 += (x * 4096 - dc_q12) >> LINE_DC_SHIFT;
+            x -= dc_q12 >> 12;
         }
+
+        // High-pass, direct form I with 8 fractional bits of history
+        int32_t x0 = x * 256;
+        int64_t acc = (int64_t)b0 * x0 + (int64_t)b1 * x1 + (int64_t)b2 * x2
+                    - (int64_t)a1 * y1 - (int64_t)a2 * y2;
+        int32_t y0 = (int32_t)(acc >> 28);
+        x2 = x1; x1 = x0;
+        y2 = y1; y1 = y0;
+
+        // Meter before the gate, then gate
+        int16_t y = audio_dsp_sat16((y0 + 128) >> 8);
+        energy += (uint64_t)((int32_t)y * y);
+        buffer[i] = audio_dsp_sat16(((int32_t)y * (gate_q23 >> 8)) >> 15);
+        gate_q23 += gate_step;
     }
+
+    filter->dc_q12 = dc_q12;
+    filter->x1 = x1; filter->x2 = x2;
+    filter->y1 = y1; filter->y2 = y2;
+    filter->gate_q15 = gate_end;
+    filter->dc = dc_q12 >> 12;
+    filter->level = sqrtf((float)energy / sample_count) / 32768.0f;
 }
 
 void audio_processor_sidetone(const int16_t *mic_in, const int16_t *audio_in,
@@ -110,11 +485,7 @@ float audio_processor_get_rms(const int16_t *buffer, size_t sample_count)
         return 0.0f;
     }
 
-    int64_t sum = 0;
-    for (size_t i = 0; i < sample_count; i++) {
-        int32_t sample = buffer[i];
-        sum += sample * sample;
-    }
+    uint64_t sum = audio_dsp_energy(buffer, sample_count);
 
     float mean = (float)sum / sample_count;
     float rms = sqrtf(mean);
@@ -2,7 +2,8 @@
  * @file audio_processor.h
  * @brief Audio Processing Pipeline
  *
- * Handles audio mixing, sidetone, and limiting.
+ * Handles audio mixing, sidetone, limiting, automatic gain and the
+ * party-line input filter.
  */
 
 #ifndef AUDIO_PROCESSOR_H
@@ -10,7 +11,47 @@
 
 #include <stdint.h>
 #include <stdbool.h>
-#include "esp_err.h"
+#include <stddef.h>
+#include "../platform/platform.h"
+
+//=============================================================================
+// MIXER STATE
+//=============================================================================
+
+// Automatic gain state for audio_processor_mix_n/mix_minus (one per mix bus)
+typedef struct {
+    int32_t gain_q15;        // Current bus gain, Q15 (32768 = unity)
+} audio_mix_state_t;
+
+// Look-ahead limiter + AGC state (one per stream)
+typedef struct {
+    int32_t threshold;       // Output ceiling, sample units
+    int32_t gain_q30;        // Smoothed limiter gain, Q30 (1 << 30 = unity)
+    int32_t agc_q12;         // AGC gain, Q12 (4096 = unity)
+    bool    agc;             // AGC stage enabled
+    bool    shared;          // Threshold follows audio_processor_set_limiter_threshold
+} audio_limiter_t;
+
+// Party-line input filter state: DC block, high-pass, noise gate
+typedef struct {
+    bool    dc_block;        // DC blocking stage enabled
+    int32_t dc_q12;          // Tracked DC, Q12 sample units
+    int32_t b0, b1, b2;      // High-pass biquad, Q28
+    int32_t a1, a2;
+    int32_t x1, x2;          // Biquad history, Q8 sample units
+    int32_t y1, y2;
+    int32_t gate_q15;        // Current gate gain, Q15 (32768 = open)
+    int32_t floor_q15;       // Gate gain when closed
+    int32_t release_q15;     // Most the gate closes per frame
+
+    // Metering of the last frame
+    float   level;           // RMS after the high-pass, before the gate (0.0-1.0)
+    int32_t dc;              // DC removed, sample units
+} audio_line_filter_t;
+
+// Threshold for audio_processor_limiter_init: the run-time setting
+// (LIMITER_THRESHOLD until changed)
+#define AUDIO_LIMITER_SHARED    0.0f
 
 //=============================================================================
 // AUDIO PROCESSING
@@ -35,14 +76,120 @@ void audio_processor_mix(const int16_t *stream1, const int16_t *stream2,
                          int16_t *output, size_t sample_count,
                          float mix1, float mix2);
 
+/**
+ * @brief Reset a mix bus to unity gain
+ * @param state Mixer state
+ */
+void audio_processor_mix_init(audio_mix_state_t *state);
+
+/**
+ * @brief Mix N audio streams with automatic gain (fixed point)
+ *
+ * Streams are summed at unity; when the sum would exceed the limiter
+ * threshold the bus gain drops at once for that frame and then recovers
+ * gradually over the following frames. No per-frame allocation.
+ * @param inputs Array of input streams (each sample_count long)
+ * @param input_count Number of streams (0 writes silence)
+ * @param output Output buffer (may alias one of the inputs)
+ * @param sample_count Number of samples
+ * @param state Mixer state (NULL = plain saturating sum)
+ */
+void audio_processor_mix_n(const int16_t *const *inputs, size_t input_count,
+                           int16_t *output, size_t sample_count,
+                           audio_mix_state_t *state);
+
+/**
+ * @brief Sum N audio streams into a 32-bit bus without scaling
+ *
+ * First half of a mix-minus: the bus is built once, then each listener's
+ * feed is taken from it with audio_processor_mix_minus().
+ * @param inputs Array of input streams (each sample_count long)
+ * @param input_count Number of streams (0 clears the bus)
+ * @param bus Output bus (sample_count long)
+ * @param sample_count Number of samples
+ */
+void audio_processor_mix_bus(const int16_t *const *inputs, size_t input_count,
+                             int32_t *bus, size_t sample_count);
+
+/**
+ * @brief Take one listener's feed from a bus: bus minus own contribution
+ *
+ * Same automatic gain as audio_processor_mix_n(), with one state per
+ * listener.
+ * @param bus Summed bus from audio_processor_mix_bus()
+ * @param own Listener's own contribution to the bus (NULL = full bus)
+ * @param output Output buffer
+ * @param sample_count Number of samples
+ * @param state Mixer state (NULL = plain saturating difference)
+ */
+void audio_processor_mix_minus(const int32_t *bus, const int16_t *own,
+                               int16_t *output, size_t sample_count,
+                               audio_mix_state_t *state);
+
 /**
  * @brief Apply audio limiter to prevent clipping
+ *
+ * Stateless per-sample soft clip; streams use audio_processor_limiter_*.
  * @param buffer Audio buffer (modified in-place)
  * @param sample_count Number of samples
  * @param threshold Limiter threshold (0.0 to 1.0, default 0.95)
  */
 void audio_processor_limit(int16_t *buffer, size_t sample_count, float threshold);
 
+/**
+ * @brief Reset a stream's limiter to unity gain
+ * @param limiter Limiter state
+ * @param threshold Output ceiling (0.0 to 1.0), or AUDIO_LIMITER_SHARED
+ * @param agc Run the AGC stage (still needs AGC_ENABLE)
+ */
+void audio_processor_limiter_init(audio_limiter_t *limiter, float threshold, bool agc);
+
+/**
+ * @brief Change the ceiling of every AUDIO_LIMITER_SHARED limiter
+ *
+ * Each picks it up at its next frame.
+ * @param threshold Output ceiling (0.0 to 1.0)
+ */
+void audio_processor_set_limiter_threshold(float threshold);
+
+/**
+ * @brief AGC, then look-ahead peak limiting, in place (fixed point)
+ *
+ * The AGC gain is set once per frame from the frame's RMS and ramped
+ * across it. The limiter gain attacks towards the peak of the next
+ * LIMITER_LOOKAHEAD_MS and releases slowly; no sample leaves above the
+ * threshold. No allocation and no added latency.
+ * @param limiter Limiter state
+ * @param buffer Audio buffer (modified in-place)
+ * @param sample_count Number of samples
+ */
+void audio_processor_limiter_process(audio_limiter_t *limiter, int16_t *buffer,
+                                     size_t sample_count);
+
+/**
+ * @brief Reset a party-line input filter
+ * @param filter Filter state
+ * @param dc_block Run the DC blocking stage
+ * @param hpf_hz High-pass corner (0 = no high-pass)
+ * @param gate_floor Gain of the closed gate (1.0 = no gate)
+ * @param release_ms Time the gate takes to close fully
+ */
+void audio_processor_line_filter_init(audio_line_filter_t *filter, bool dc_block,
+                                      float hpf_hz, float gate_floor, uint32_t release_ms);
+
+/**
+ * @brief DC block, high-pass and noise gate in place, in one pass
+ *
+ * The gate opens across this frame or closes at its release rate,
+ * following gate_open; level and dc are measured on the way.
+ * @param filter Filter state
+ * @param buffer Audio buffer (modified in-place)
+ * @param sample_count Number of samples
+ * @param gate_open Gate target (typically the VAD verdict on the last frame)
+ */
+void audio_processor_line_filter_process(audio_line_filter_t *filter, int16_t *buffer,
+                                         size_t sample_count, bool gate_open);
+
 /**
  * @brief Apply sidetone (mic to headset loopback)
  * @param mic_in Microphone input
@@ -0,0 +1,308 @@
+/**
+ * @file audio_rate_control.c
+ * @brief Closed-Loop Encoder Rate Control Implementation
+ *
+ * Bitrate follows an AIMD rule: a bad interval (loss or weak RSSI) cuts it
+ * by a quarter, a run of good intervals adds one step back. Complexity is
+ * stepped from the peak encode time so the audio task keeps its 20 ms
+ * deadline. Frame size stays at FRAME_SIZE_MS for now.
+ */
+
+#include "audio_rate_control.h"
+#include "audio_opus.h"
+#include "../config.h"
+#include "../network/udp_transport.h"
+#include "../network/wifi_manager.h"
+#include "../network/control_channel.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "RATE_CTL";
+
+// Encode budget (us) for one frame
+#define FRAME_BUDGET_US         (FRAME_SIZE_MS * 1000)
+
+// Intervals to wait after a back-off before cutting again, so the far
+// end's next report can reflect the change
+#define BACKOFF_HOLD_INTERVALS  2
+
+// Hysteresis above RATE_CONTROL_RSSI_LOW_DBM before RSSI counts as good
+#define RSSI_HYSTERESIS_DB      5
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static bool initialized = false;
+
+// Local receive-path measurement
+static uint32_t prev_packets_received = 0;
+static uint32_t prev_packets_lost = 0;
+static float local_loss_ema = 0.0f;
+static bool local_loss_fresh = false;   // Last tick's window had traffic
+
+// Latest far-end report (written from the UDP RX task)
+static portMUX_TYPE report_lock = portMUX_INITIALIZER_UNLOCKED;
+static control_report_t remote_report;
+static int64_t remote_report_time_us = 0;
+static float remote_loss_ema = 0.0f;
+
+// Ceilings, set at run time from the settings (any task)
+static volatile int max_bitrate_bps = OPUS_BITRATE;
+static volatile int max_complexity = OPUS_COMPLEXITY;
+
+// Controller state
+static int bitrate_bps = OPUS_BITRATE;
+static int complexity = OPUS_COMPLEXITY;
+static uint32_t good_link_intervals = 0;
+static uint32_t good_cpu_intervals = 0;
+static uint32_t backoff_hold = 0;
+static uint32_t last_peak_encode_us = 0;
+static bool last_report_fresh = false;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void report_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    if (size < sizeof(control_report_t)) {
+        return;
+    }
+
+    portENTER_CRITICAL(&report_lock);
+    memcpy(&remote_report, payload, sizeof(control_report_t));
+    remote_loss_ema = 0.7f * remote_loss_ema +
+                      0.3f * (remote_report.loss_percent_x10 / 10.0f);
+    remote_report_time_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&report_lock);
+}
+
+// Loss on the stream we receive over the last interval; false if idle
+static bool measure_local_loss(float *window_loss)
+{
+    udp_stats_t stats;
+    udp_transport_get_stats(&stats);
+
+    if (stats.packets_received < prev_packets_received ||
+        stats.packets_lost < prev_packets_lost) {
+        prev_packets_received = 0;   // stats were reset
+        prev_packets_lost = 0;
+    }
+
+    uint32_t window_rx = stats.packets_received - prev_packets_received;
+    uint32_t window_lost = stats.packets_lost - prev_packets_lost;
+    prev_packets_received = stats.packets_received;
+    prev_packets_lost = stats.packets_lost;
+
+    if (window_rx + window_lost == 0) {
+        return false;
+    }
+
+    *window_loss = (float)window_lost * 100.0f / (float)(window_rx + window_lost);
+    local_loss_ema = 0.7f * local_loss_ema + 0.3f * (*window_loss);
+    return true;
+}
+
+static void send_report(float window_loss, int8_t rssi, const jitter_buffer_stats_t *rx_stats)
+{
+    control_report_t report = {0};
+    report.loss_percent_x10 = (uint16_t)(window_loss * 10.0f + 0.5f);
+    report.rssi_dbm = rssi;
+
+    if (rx_stats) {
+        report.jitter_ms_x10 = (uint16_t)(rx_stats->jitter_us / 100);
+        report.jitter_depth = (uint16_t)rx_stats->target_depth;
+    }
+
+    control_channel_send(CONTROL_MSG_REPORT, &report, sizeof(report));
+}
+
+#if RATE_CONTROL_ENABLE
+static void adapt_bitrate(float link_loss, int8_t rssi)
+{
+    bool weak_rssi = (rssi != 0) && (rssi < RATE_CONTROL_RSSI_LOW_DBM);
+    bool strong_rssi = (rssi == 0) ||
+                       (rssi >= RATE_CONTROL_RSSI_LOW_DBM + RSSI_HYSTERESIS_DB);
+
+    if (backoff_hold > 0) {
+        backoff_hold--;
+    }
+
+    if (link_loss > RATE_CONTROL_LOSS_HIGH_PCT || weak_rssi) {
+        good_link_intervals = 0;
+        if (backoff_hold == 0 && bitrate_bps > RATE_CONTROL_MIN_BITRATE) {
+            bitrate_bps = bitrate_bps * 3 / 4;
+            if (bitrate_bps < RATE_CONTROL_MIN_BITRATE) {
+                bitrate_bps = RATE_CONTROL_MIN_BITRATE;
+            }
+            backoff_hold = BACKOFF_HOLD_INTERVALS;
+            audio_opus_set_bitrate(bitrate_bps);
+            ESP_LOGI(TAG, "Link degraded (loss %.1f%%, RSSI %d) - bitrate %d bps",
+                     link_loss, rssi, bitrate_bps);
+        }
+    } else if (link_loss < RATE_CONTROL_LOSS_LOW_PCT && strong_rssi) {
+        if (++good_link_intervals >= RATE_CONTROL_RECOVER_S &&
+            bitrate_bps < max_bitrate_bps) {
+            bitrate_bps += RATE_CONTROL_BITRATE_STEP;
+            if (bitrate_bps > max_bitrate_bps) {
+                bitrate_bps = max_bitrate_bps;
+            }
+            good_link_intervals = 0;
+            audio_opus_set_bitrate(bitrate_bps);
+            ESP_LOGI(TAG, "Link good - bitrate %d bps", bitrate_bps);
+        }
+    } else {
+        good_link_intervals = 0;
+    }
+}
+
+static void adapt_complexity(uint32_t peak_encode_us)
+{
+    if (peak_encode_us == 0) {
+        return;  // Not encoding (pack idle) - nothing to judge
+    }
+
+    if (peak_encode_us > FRAME_BUDGET_US * RATE_CONTROL_CPU_HIGH_PCT / 100) {
+        good_cpu_intervals = 0;
+        if (complexity > RATE_CONTROL_MIN_COMPLEXITY) {
+            complexity--;
+            audio_opus_set_complexity(complexity);
+            ESP_LOGW(TAG, "Encode peak %lu us - complexity %d",
+                     (unsigned long)peak_encode_us, complexity);
+        }
+    } else if (peak_encode_us < FRAME_BUDGET_US * RATE_CONTROL_CPU_LOW_PCT / 100) {
+        if (++good_cpu_intervals >= RATE_CONTROL_RECOVER_S &&
+            complexity < max_complexity) {
+            complexity++;
+            good_cpu_intervals = 0;
+            audio_opus_set_complexity(complexity);
+            ESP_LOGI(TAG, "Encode headroom - complexity %d", complexity);
+        }
+    } else {
+        good_cpu_intervals = 0;
+    }
+}
+#endif // RATE_CONTROL_ENABLE
+
+// Hold the encoder at or below the ceilings; without the controller it
+// runs at them
+static void apply_limits(void)
+{
+    int bitrate_max = max_bitrate_bps;
+    int complexity_max = max_complexity;
+
+    if (bitrate_bps > bitrate_max || (!RATE_CONTROL_ENABLE && bitrate_bps != bitrate_max)) {
+        bitrate_bps = bitrate_max;
+        audio_opus_set_bitrate(bitrate_bps);
+        ESP_LOGI(TAG, "Bitrate ceiling %d bps", bitrate_bps);
+    }
+    if (complexity > complexity_max ||
+        (!RATE_CONTROL_ENABLE && complexity != complexity_max)) {
+        complexity = complexity_max;
+        audio_opus_set_complexity(complexity);
+        ESP_LOGI(TAG, "Complexity ceiling %d", complexity);
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t audio_rate_control_init(void)
+{
+    if (initialized) {
+        return ESP_OK;
+    }
+
+    bitrate_bps = OPUS_BITRATE;
+    complexity = OPUS_COMPLEXITY;
+    apply_limits();
+    local_loss_ema = 0.0f;
+    local_loss_fresh = false;
+    remote_loss_ema = 0.0f;
+    remote_report_time_us = 0;
+
+    control_channel_register(CONTROL_MSG_REPORT, report_handler);
+
+    initialized = true;
+#if RATE_CONTROL_ENABLE
+    ESP_LOGI(TAG, "Rate control: %d-%d bps, complexity %d-%d",
+             RATE_CONTROL_MIN_BITRATE, max_bitrate_bps,
+             RATE_CONTROL_MIN_COMPLEXITY, max_complexity);
+#endif
+    return ESP_OK;
+}
+
+void audio_rate_control_tick(const jitter_buffer_stats_t *rx_stats)
+{
+    if (!initialized) return;
+
+    int8_t rssi = wifi_manager_get_rssi();
+
+    float window_loss;
+    local_loss_fresh = measure_local_loss(&window_loss);
+    if (local_loss_fresh) {
+        send_report(window_loss, rssi, rx_stats);
+    }
+
+    // Prefer the far end's view of our stream; fall back to our own
+    // receive loss, which shares the same RF link
+    portENTER_CRITICAL(&report_lock);
+    bool fresh = (remote_report_time_us > 0) &&
+                 (esp_timer_get_time() - remote_report_time_us <
+                  (int64_t)RATE_CONTROL_REPORT_TIMEOUT_MS * 1000);
+    float remote_loss = remote_loss_ema;
+    int8_t remote_rssi = remote_report.rssi_dbm;
+    portEXIT_CRITICAL(&report_lock);
+
+    last_report_fresh = fresh;
+    float link_loss = fresh ? remote_loss : local_loss_ema;
+
+    // Worst known RSSI at either end (0 = unknown)
+    if (fresh && remote_rssi != 0 && (rssi == 0 || remote_rssi < rssi)) {
+        rssi = remote_rssi;
+    }
+
+    audio_opus_set_packet_loss_perc(link_loss);
+
+    last_peak_encode_us = audio_opus_take_peak_encode_time_us();
+
+    apply_limits();
+#if RATE_CONTROL_ENABLE
+    adapt_bitrate(link_loss, rssi);
+    adapt_complexity(last_peak_encode_us);
+#endif
+}
+
+esp_err_t audio_rate_control_set_limits(int max_bitrate, int max_complexity_level)
+{
+    if (max_bitrate < RATE_CONTROL_MIN_BITRATE || max_complexity_level < RATE_CONTROL_MIN_COMPLEXITY ||
+        max_complexity_level > 10) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    max_bitrate_bps = max_bitrate;
+    max_complexity = max_complexity_level;
+    return ESP_OK;
+}
+
+void audio_rate_control_get_status(rate_control_status_t *status)
+{
+    if (!status) return;
+
+    status->bitrate_bps = audio_opus_get_bitrate();
+    status->complexity = audio_opus_get_complexity();
+    status->fec_loss_percent = OPUS_FEC_ACTIVE ? audio_opus_get_packet_loss_perc() : -1;
+    status->local_loss_percent = local_loss_ema;
+    status->local_loss_fresh = local_loss_fresh;
+    status->peak_encode_us = last_peak_encode_us;
+    status->remote_report_fresh = last_report_fresh;
+
+    portENTER_CRITICAL(&report_lock);
+    status->remote_loss_percent = remote_loss_ema;
+    status->remote_rssi_dbm = remote_report.rssi_dbm;
+    portEXIT_CRITICAL(&report_lock);
+}
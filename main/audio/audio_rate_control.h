@@ -0,0 +1,72 @@
+/**
+ * @file audio_rate_control.h
+ * @brief Closed-Loop Encoder Rate Control
+ *
+ * Once a second, measures loss on the receive path and reports it to the
+ * far end over the control channel. The far end's report on our stream,
+ * together with RSSI and the encoder's measured CPU time, then drives the
+ * Opus bitrate, complexity and FEC level.
+ */
+
+#ifndef AUDIO_RATE_CONTROL_H
+#define AUDIO_RATE_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "audio_jitter_buffer.h"
+
+//=============================================================================
+// STATUS
+//=============================================================================
+
+typedef struct {
+    int      bitrate_bps;          // Current encoder bitrate
+    int      complexity;           // Current encoder complexity
+    int      fec_loss_percent;     // Loss figure given to the encoder's FEC (-1 = no FEC)
+    float    local_loss_percent;   // Smoothed loss of the stream we receive
+    bool     local_loss_fresh;     // Something was received in the last tick's second
+    float    remote_loss_percent;  // Far end's smoothed loss of our stream
+    int8_t   remote_rssi_dbm;      // Far end's RSSI (0 = unknown)
+    uint32_t peak_encode_us;       // Longest encode in the last interval
+    bool     remote_report_fresh;  // A far-end report arrived recently
+} rate_control_status_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Initialize rate control and register for far-end reports
+ * @return ESP_OK on success
+ */
+esp_err_t audio_rate_control_init(void);
+
+/**
+ * @brief Run one control interval (call once per second)
+ *
+ * Sends our receiver report and updates the encoder settings.
+ * @param rx_stats Jitter statistics of the stream we receive (worst
+ *                 stream on the base), included in the report
+ */
+void audio_rate_control_tick(const jitter_buffer_stats_t *rx_stats);
+
+/**
+ * @brief Get current controller state (for monitoring)
+ * @param status Pointer to status structure
+ */
+void audio_rate_control_get_status(rate_control_status_t *status);
+
+/**
+ * @brief Set the bitrate and complexity the controller works up to
+ *
+ * The build defaults are OPUS_BITRATE and OPUS_COMPLEXITY. A lower ceiling
+ * takes the encoder down at the next tick; a higher one is climbed to as
+ * the link allows (straight away without RATE_CONTROL_ENABLE).
+ * @param max_bitrate Bitrate ceiling (bps, at least RATE_CONTROL_MIN_BITRATE)
+ * @param max_complexity_level Complexity ceiling (RATE_CONTROL_MIN_COMPLEXITY-10)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG out of range
+ */
+esp_err_t audio_rate_control_set_limits(int max_bitrate, int max_complexity_level);
+
+#endif // AUDIO_RATE_CONTROL_H
@@ -0,0 +1,46 @@
+/**
+ * @file audio_ring.c
+ * @brief Lock-Free SPSC Frame Ring Implementation
+ *
+ * Only setup and teardown live here; the per-element operations are
+ * inlines in the header. Storage comes from the boot-time arena.
+ */
+
+#include "audio_ring.h"
+#include "../platform/mem_arena.h"
+
+#include <string.h>
+
+static const char *TAG = "RING";
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t audio_ring_init(audio_ring_t *ring, size_t element_size, size_t capacity,
+                          const char *owner)
+{
+    if (!ring || element_size == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        capacity > (1u << 30)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->storage = mem_arena_alloc(MEM_ARENA_FAST, element_size * capacity, owner);
+    if (!ring->storage) {
+        ESP_LOGE(TAG, "Failed to allocate ring (%u bytes)",
+                 (unsigned)(element_size * capacity));
+        return ESP_ERR_NO_MEM;
+    }
+
+    ring->element_size = element_size;
+    ring->mask = (uint32_t)(capacity - 1);
+    return ESP_OK;
+}
+
+void audio_ring_deinit(audio_ring_t *ring)
+{
+    if (!ring) return;
+
+    memset(ring, 0, sizeof(*ring));
+}
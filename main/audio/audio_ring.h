@@ -0,0 +1,119 @@
+/**
+ * @file audio_ring.h
+ * @brief Lock-Free Single-Producer/Single-Consumer Frame Ring
+ *
+ * Fixed-size elements in a power-of-two ring. One task only writes
+ * (reserving a slot, filling it in place, committing it), one task only
+ * reads; head and tail are each stored by their own side with release
+ * ordering and loaded by the other with acquire, so neither side ever
+ * blocks or takes a lock. A full ring refuses the write and counts it.
+ *
+ * Used between the receive task and playout in the jitter buffer, and
+ * meant for any other one-to-one audio queue (capture to encode, decode
+ * to mix).
+ */
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "../platform/platform.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+// Fields are private - use the functions below
+typedef struct {
+    uint8_t *storage;
+    size_t   element_size;
+    uint32_t mask;               // Capacity - 1
+    uint32_t head;               // Elements committed (producer stores)
+    uint32_t tail;               // Elements released (consumer stores)
+    uint32_t drops;              // Writes refused while full (producer stores)
+} audio_ring_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Set up a ring in the fast arena region (init code only)
+ * @param element_size Bytes per element
+ * @param capacity     Elements (power of two)
+ * @param owner        Name for the arena's footprint report
+ * @return ESP_OK, ESP_ERR_INVALID_ARG or ESP_ERR_NO_MEM
+ */
+esp_err_t audio_ring_init(audio_ring_t *ring, size_t element_size, size_t capacity,
+                          const char *owner);
+
+/**
+ * @brief Retire the ring (neither side may be using it; the storage stays
+ *        in the arena)
+ */
+void audio_ring_deinit(audio_ring_t *ring);
+
+/**
+ * @brief Producer: reserve the next element to fill in place
+ * @return The element, or NULL if the ring is full (counted in drops)
+ */
+static inline void *audio_ring_reserve(audio_ring_t *ring)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail > ring->mask) {
+        ring->drops++;
+        return NULL;
+    }
+    return ring->storage + (size_t)(head & ring->mask) * ring->element_size;
+}
+
+/**
+ * @brief Producer: publish the element from audio_ring_reserve()
+ */
+static inline void audio_ring_commit(audio_ring_t *ring)
+{
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Consumer: oldest committed element, left in place
+ * @return The element, or NULL if the ring is empty
+ */
+static inline const void *audio_ring_peek(audio_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        return NULL;
+    }
+    return ring->storage + (size_t)(tail & ring->mask) * ring->element_size;
+}
+
+/**
+ * @brief Consumer: hand the element from audio_ring_peek() back to the producer
+ */
+static inline void audio_ring_release(audio_ring_t *ring)
+{
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Elements waiting (exact from either side, a snapshot from others)
+ */
+static inline uint32_t audio_ring_count(const audio_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Writes refused because the ring was full
+ */
+static inline uint32_t audio_ring_drops(const audio_ring_t *ring)
+{
+    return __atomic_load_n(&ring->drops, __ATOMIC_RELAXED);
+}
+
+#endif // AUDIO_RING_H
@@ -1,13 +1,22 @@
 /**
  * @file audio_tones.c
  * @brief Audio Tone Generation Implementation
+ *
+ * A 256-entry Q15 sine table with one guard entry, read with linear
+ * interpolation: the top 8 bits of the phase pick the entry, the next 16
+ * the blend. Spurs sit below -80 dB, far under what an alert needs.
+ *
+ * The queue is shared with whichever task starts a tone (monitor, battery,
+ * button handlers) under a spinlock; the step being played, its phase and
+ * its envelope belong to the audio engine task alone. Every step fades in
+ * and out over TONE_RAMP_SAMPLES so neither a start, a stop nor a gap
+ * clicks.
  */
 
 #include "audio_tones.h"
 
-#include <esp_timer.h>
-
 #include "../config.h"
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
 #include <math.h>
 #include <string.h>
@@ -18,15 +27,125 @@
 
 static const char *TAG = "TONES";
 
+#define TONE_TABLE_BITS         8
+#define TONE_TABLE_SIZE         (1 << TONE_TABLE_BITS)
+#define TONE_QUEUE_STEPS        16
+#define TONE_RAMP_SAMPLES       (SAMPLE_RATE_HZ / 500)     // 2 ms
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef struct {
+    uint16_t frequency_hz;       // 0 = silent gap
+    uint16_t duration_ms;
+    int16_t  level;              // Q15 peak
+} tone_step_t;
+
 //=============================================================================
 // PRIVATE VARIABLES
 //=============================================================================
 
-static bool tone_playing = false;
-static uint16_t current_frequency = 0;
-static uint16_t current_duration = 0;
-static float current_amplitude = 0.0f;
-static int64_t tone_start_time = 0;
+static int16_t sine_table[TONE_TABLE_SIZE + 1];
+static bool table_ready = false;
+
+// Queue (any task, under queue_lock)
+static portMUX_TYPE queue_lock = portMUX_INITIALIZER_UNLOCKED;
+static tone_step_t queue[TONE_QUEUE_STEPS];
+static uint32_t queue_head = 0;
+static uint32_t queue_count = 0;
+static bool stop_requested = false;
+static volatile bool tones_busy = false;   // Queued or playing: the mixer's fast-path test
+
+// Step being played (audio engine task only)
+static tone_step_t current;
+static uint32_t current_phase = 0;
+static uint32_t current_inc = 0;
+static uint32_t current_elapsed = 0;
+static uint32_t current_remaining = 0;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void build_table(void)
+{
+    if (table_ready) return;
+
+    for (int i = 0; i <= TONE_TABLE_SIZE; i++) {
+        sine_table[i] = (int16_t)lrintf(32767.0f * sinf(2.0f * (float)M_PI * (float)i /
+                                                        (float)TONE_TABLE_SIZE));
+    }
+    table_ready = true;
+}
+
+// Q15 sine of a phase where 2^32 is a full turn
+static inline int32_t sine_at(uint32_t phase)
+{
+    uint32_t index = phase >> (32 - TONE_TABLE_BITS);
+    int32_t frac = (int32_t)((phase >> (16 - TONE_TABLE_BITS)) & 0xFFFF);
+    int32_t a = sine_table[index];
+    int32_t b = sine_table[index + 1];
+    return a + (((b - a) * frac) >> 16);
+}
+
+static uint32_t phase_increment(float frequency_hz)
+{
+    if (frequency_hz <= 0.0f || frequency_hz >= SAMPLE_RATE_HZ / 2) {
+        return 0;
+    }
+    return (uint32_t)(frequency_hz * (4294967296.0f / (float)SAMPLE_RATE_HZ));
+}
+
+static int16_t level_q15(float amplitude)
+{
+    if (amplitude > 1.0f) amplitude = 1.0f;
+    if (amplitude < 0.0f) amplitude = 0.0f;
+    return (int16_t)(amplitude * 32767.0f);
+}
+
+// Called with queue_lock held
+static bool queue_push(uint16_t frequency_hz, uint16_t duration_ms, int16_t level)
+{
+    if (queue_count >= TONE_QUEUE_STEPS || duration_ms == 0) {
+        return false;
+    }
+    queue[(queue_head + queue_count) % TONE_QUEUE_STEPS] =
+        (tone_step_t){ frequency_hz, duration_ms, level };
+    queue_count++;
+    tones_busy = true;
+    return true;
+}
+
+// Engine task: apply a pending stop, then start the next step if the
+// current one is done. False once nothing is left.
+static bool advance(void)
+{
+    portENTER_CRITICAL(&queue_lock);
+    if (stop_requested) {
+        stop_requested = false;
+        // Fade out from wherever the envelope is now
+        uint32_t fade = current_elapsed < TONE_RAMP_SAMPLES ? current_elapsed : TONE_RAMP_SAMPLES;
+        if (current_remaining > fade) {
+            current_remaining = fade;
+        }
+    }
+    if (current_remaining == 0) {
+        if (queue_count == 0) {
+            tones_busy = false;
+            portEXIT_CRITICAL(&queue_lock);
+            return false;
+        }
+        current = queue[queue_head];
+        queue_head = (queue_head + 1) % TONE_QUEUE_STEPS;
+        queue_count--;
+        current_inc = phase_increment(current.frequency_hz);
+        current_elapsed = 0;
+        current_remaining = (uint32_t)current.duration_ms * SAMPLE_RATE_HZ / 1000;
+    }
+    portEXIT_CRITICAL(&queue_lock);
+    return current_remaining > 0;
+}
 
 //=============================================================================
 // PUBLIC FUNCTIONS
@@ -34,72 +153,159 @@ static int64_t tone_start_time = 0;
 
 void audio_tones_generate_sine(int16_t *buffer, size_t sample_count,
                                float frequency_hz, float amplitude,
-                               float *phase)
+                               uint32_t *phase)
 {
     if (!buffer || !phase) {
         return;
     }
+    build_table();
 
-    // Clamp amplitude
-    if (amplitude > 1.0f) amplitude = 1.0f;
-    if (amplitude < 0.0f) amplitude = 0.0f;
-
-    const float phase_increment = 2.0f * M_PI * frequency_hz / SAMPLE_RATE_HZ;
-    const float peak_value = 32767.0f * amplitude;
+    const uint32_t inc = phase_increment(frequency_hz);
+    const int32_t level = level_q15(amplitude);
+    uint32_t p = *phase;
 
     for (size_t i = 0; i < sample_count; i++) {
-        buffer[i] = (int16_t)(peak_value * sinf(*phase));
-        *phase += phase_increment;
+        buffer[i] = (int16_t)((sine_at(p) * level) >> 15);
+        p += inc;
+    }
+    *phase = p;
+}
 
-        // Wrap phase to prevent overflow
-        if (*phase >= 2.0f * M_PI) {
-            *phase -= 2.0f * M_PI;
-        }
+void audio_tones_generate_click(int16_t *buffer, size_t sample_count, float amplitude)
+{
+    if (!buffer || sample_count == 0) {
+        return;
+    }
+    build_table();
+
+    const uint32_t inc = phase_increment(2000.0f);
+    const uint32_t window_inc = (uint32_t)(4294967296.0 / (double)sample_count);
+    const int32_t level = level_q15(amplitude);
+    uint32_t p = 0;
+    uint32_t w = 0;
+
+    for (size_t i = 0; i < sample_count; i++) {
+        // Hann: (1 - cos) / 2, cos being the sine a quarter turn on
+        int32_t window = (32767 - sine_at(w + 0x40000000u)) >> 1;
+        int32_t burst = (sine_at(p) * window) >> 15;
+        buffer[i] = (int16_t)((burst * level) >> 15);
+        p += inc;
+        w += window_inc;
     }
 }
 
 esp_err_t audio_tones_play(uint16_t frequency_hz, uint16_t duration_ms, float amplitude)
 {
-    ESP_LOGD(TAG, "Playing tone: %d Hz, %d ms, %.2f amplitude",
+    ESP_LOGD(TAG, "Queueing tone: %d Hz, %d ms, %.2f amplitude",
              frequency_hz, duration_ms, amplitude);
 
-    current_frequency = frequency_hz;
-    current_duration = duration_ms;
-    current_amplitude = amplitude;
-    tone_start_time = esp_timer_get_time() / 1000; // Convert to ms
-    tone_playing = true;
+    int16_t level = level_q15(amplitude);
+    portENTER_CRITICAL(&queue_lock);
+    bool queued = queue_push(frequency_hz, duration_ms, level);
+    portEXIT_CRITICAL(&queue_lock);
 
-    return ESP_OK;
+    return queued ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t audio_tones_play_pattern(uint16_t frequency_hz, uint16_t duration_ms,
+                                   uint8_t repeat_count, uint16_t interval_ms,
+                                   float amplitude)
+{
+    if (repeat_count == 0) {
+        return ESP_OK;
+    }
+
+    ESP_LOGD(TAG, "Queueing pattern: %d Hz, %d x %d ms every %d ms",
+             frequency_hz, repeat_count, duration_ms, interval_ms);
+
+    uint32_t steps = repeat_count + (interval_ms > 0 ? repeat_count - 1 : 0);
+    int16_t level = level_q15(amplitude);
+    bool queued = false;
+
+    portENTER_CRITICAL(&queue_lock);
+    if (queue_count + steps <= TONE_QUEUE_STEPS) {
+        for (uint8_t i = 0; i < repeat_count; i++) {
+            if (i > 0 && interval_ms > 0) {
+                queue_push(0, interval_ms, 0);
+            }
+            queue_push(frequency_hz, duration_ms, level);
+        }
+        queued = true;
+    }
+    portEXIT_CRITICAL(&queue_lock);
+
+    return queued ? ESP_OK : ESP_ERR_NO_MEM;
 }
 
 void audio_tones_stop(void)
 {
-    if (tone_playing) {
-        ESP_LOGD(TAG, "Stopping tone");
-        tone_playing = false;
+    // The queue goes now, so tones queued after this call still play; the
+    // step on air is faded out by the mixer
+    portENTER_CRITICAL(&queue_lock);
+    queue_count = 0;
+    if (tones_busy) {
+        stop_requested = true;
     }
+    portEXIT_CRITICAL(&queue_lock);
 }
 
 bool audio_tones_is_playing(void)
 {
-    if (!tone_playing) {
-        return false;
+    return tones_busy;
+}
+
+size_t audio_tones_mix(int16_t *pcm, size_t produced, size_t capacity)
+{
+    if (!tones_busy || !pcm || !table_ready) {
+        return produced;
     }
 
-    // Check if duration expired
-    int64_t now = esp_timer_get_time() / 1000;
-    int64_t elapsed = now - tone_start_time;
+    if (produced < capacity) {
+        memset(&pcm[produced], 0, (capacity - produced) * sizeof(int16_t));
+    }
 
-    if (elapsed >= current_duration) {
-        tone_playing = false;
-        return false;
+    size_t i = 0;
+    while (i < capacity && advance()) {
+        size_t run = capacity - i;
+        if (run > current_remaining) {
+            run = current_remaining;
+        }
+
+        if (current_inc == 0) {
+            // Gap: nothing to add
+            current_elapsed += run;
+            current_remaining -= run;
+            i += run;
+            continue;
+        }
+
+        const int32_t level = current.level;
+        for (size_t end = i + run; i < end; i++) {
+            int32_t v = (sine_at(current_phase) * level) >> 15;
+            current_phase += current_inc;
+
+            uint32_t edge = current_elapsed < current_remaining ? current_elapsed
+                                                                : current_remaining;
+            if (edge < TONE_RAMP_SAMPLES) {
+                v = v * (int32_t)edge / TONE_RAMP_SAMPLES;
+            }
+            current_elapsed++;
+            current_remaining--;
+
+            int32_t sum = pcm[i] + v;
+            if (sum > 32767) sum = 32767;
+            if (sum < -32768) sum = -32768;
+            pcm[i] = (int16_t)sum;
+        }
     }
 
-    return true;
+    return capacity;
 }
 
 esp_err_t audio_tones_init(void)
 {
-    ESP_LOGI(TAG, "Tone generator initialized");
+    build_table();
+    ESP_LOGI(TAG, "Tone generator initialized (%d-entry wavetable, %d-step queue)",
+             TONE_TABLE_SIZE, TONE_QUEUE_STEPS);
     return ESP_OK;
-}
\ No newline at end of file
+}
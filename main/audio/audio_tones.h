@@ -1,8 +1,13 @@
 /**
-* @file audio_tones.h
- * @brief Audio Tone Generation
+ * @file audio_tones.h
+ * @brief Audio Tone Generation and Alert Mixer
  *
- * Generates sine wave tones for testing and user feedback.
+ * Tones come from one sine wavetable (built once at init) read by a
+ * 32-bit phase accumulator, so nothing in a per-sample loop calls libm.
+ * Alerts are queued as steps (a tone or a gap) and summed into the
+ * playout frame by the audio engine, so a ring cadence or a PTT-timeout
+ * warning plays over the received audio and is part of the echo
+ * canceller's reference.
  */
 
 #ifndef AUDIO_TONES_H
@@ -10,6 +15,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 //=============================================================================
@@ -22,38 +28,70 @@
  * @param sample_count Number of samples to generate
  * @param frequency_hz Tone frequency in Hz
  * @param amplitude Peak amplitude (0.0 to 1.0)
- * @param phase Pointer to phase accumulator (maintains continuity)
+ * @param phase Phase accumulator, full turn = 2^32 (maintains continuity)
  */
 void audio_tones_generate_sine(int16_t *buffer, size_t sample_count,
                                float frequency_hz, float amplitude,
-                               float *phase);
+                               uint32_t *phase);
 
 /**
- * @brief Play a tone (non-blocking start)
- * @param frequency_hz Tone frequency
+ * @brief Generate a short test click (Hann-windowed 2 kHz burst)
+ * @param buffer Output buffer for PCM samples
+ * @param sample_count Click length in samples
+ * @param amplitude Peak amplitude (0.0 to 1.0)
+ */
+void audio_tones_generate_click(int16_t *buffer, size_t sample_count, float amplitude);
+
+//=============================================================================
+// ALERT SEQUENCES
+//=============================================================================
+
+/**
+ * @brief Queue a tone after whatever is already queued (non-blocking)
+ * @param frequency_hz Tone frequency (0 = silent gap)
  * @param duration_ms Duration in milliseconds
  * @param amplitude Peak amplitude (0.0 to 1.0)
- * @return ESP_OK on success
- *
- * Note: Requires tone playback task to be running
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the queue is full
  */
 esp_err_t audio_tones_play(uint16_t frequency_hz, uint16_t duration_ms, float amplitude);
 
 /**
- * @brief Stop currently playing tone
+ * @brief Queue a repeated beep (e.g. a ring cadence), all or nothing
+ * @param frequency_hz Beep frequency
+ * @param duration_ms Length of each beep
+ * @param repeat_count Beeps
+ * @param interval_ms Gap between beeps
+ * @param amplitude Peak amplitude (0.0 to 1.0)
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the queue cannot take the pattern
+ */
+esp_err_t audio_tones_play_pattern(uint16_t frequency_hz, uint16_t duration_ms,
+                                   uint8_t repeat_count, uint16_t interval_ms,
+                                   float amplitude);
+
+/**
+ * @brief Stop the current tone (faded out) and drop everything queued
  */
 void audio_tones_stop(void);
 
 /**
- * @brief Check if tone is currently playing
+ * @brief Check if a tone is playing or queued
  * @return true if tone active, false otherwise
  */
 bool audio_tones_is_playing(void);
 
 /**
- * @brief Initialize tone generator
+ * @brief Sum the queued tones into one playout frame (audio engine task)
+ * @param pcm Frame buffer, holding @p produced samples of received audio
+ * @param produced Samples already in the frame (0 = nothing received)
+ * @param capacity Frame size; unfilled samples are zeroed if a tone plays
+ * @return Samples to play (@p produced when no tone is active)
+ */
+size_t audio_tones_mix(int16_t *pcm, size_t produced, size_t capacity);
+
+/**
+ * @brief Initialize tone generator (builds the wavetable)
  * @return ESP_OK on success
  */
 esp_err_t audio_tones_init(void);
 
-#endif // AUDIO_TONES_H
\ No newline at end of file
+#endif // AUDIO_TONES_H
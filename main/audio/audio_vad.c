@@ -0,0 +1,131 @@
+/**
+ * @file audio_vad.c
+ * @brief Voice Activity Detection, DTX Decisions and Comfort Noise Implementation
+ *
+ * The detector compares each frame's RMS with a noise floor that drops
+ * straight to quieter frames and creeps up slowly, so it follows a
+ * changing background without learning speech as noise. A frame is
+ * speech when it is VAD_SNR above that floor (and above an absolute
+ * minimum); speech holds for VAD_HANGOVER_MS so word endings and short
+ * pauses still go out.
+ */
+
+#include "audio_vad.h"
+#include "audio_processor.h"
+#include "audio_dsp.h"
+#include "../config.h"
+#include <string.h>
+
+#define VAD_HANGOVER_FRAMES     (VAD_HANGOVER_MS / FRAME_SIZE_MS)
+#define DTX_UPDATE_FRAMES       (DTX_UPDATE_MS / FRAME_SIZE_MS)
+
+// Noise floor creep per frame on louder frames (~0.4 dB/s)
+#define VAD_NOISE_RISE          1.001f
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void audio_vad_init(audio_vad_t *vad)
+{
+    if (!vad) return;
+
+    memset(vad, 0, sizeof(*vad));
+    vad->noise_rms = VAD_THRESHOLD_RMS;
+    vad->hangover = VAD_HANGOVER_FRAMES;
+}
+
+bool audio_vad_speech(audio_vad_t *vad, float rms, bool speech_elsewhere)
+{
+    if (!vad) return true;
+
+    if (rms < vad->noise_rms) {
+        vad->noise_rms = rms;
+    } else {
+        vad->noise_rms *= VAD_NOISE_RISE;
+    }
+    if (vad->noise_rms < 1e-5f) vad->noise_rms = 1e-5f;
+
+    float threshold = vad->noise_rms * VAD_SNR;
+    if (threshold < VAD_THRESHOLD_RMS) threshold = VAD_THRESHOLD_RMS;
+
+    if (speech_elsewhere || rms > threshold) {
+        vad->hangover = VAD_HANGOVER_FRAMES;
+        vad->silent_frames = 0;
+        return true;
+    }
+
+    if (vad->hangover > 0) {
+        vad->hangover--;
+        return true;
+    }
+    return false;
+}
+
+audio_dtx_action_t audio_vad_frame(audio_vad_t *vad, const int16_t *pcm, size_t samples,
+                                   bool speech_elsewhere)
+{
+#if DTX_ENABLE
+    if (!vad || !pcm) return AUDIO_DTX_SEND;
+
+    if (audio_vad_speech(vad, audio_processor_get_rms(pcm, samples), speech_elsewhere)) {
+        return AUDIO_DTX_SEND;
+    }
+
+    // First silent frame marks the start of DTX, then one update per period
+    audio_dtx_action_t action = (vad->silent_frames % DTX_UPDATE_FRAMES == 0)
+        ? AUDIO_DTX_UPDATE : AUDIO_DTX_SKIP;
+    vad->silent_frames++;
+    if (action == AUDIO_DTX_SKIP) {
+        vad->frames_skipped++;
+    }
+    return action;
+#else
+    (void)vad;
+    (void)pcm;
+    (void)samples;
+    (void)speech_elsewhere;
+    return AUDIO_DTX_SEND;
+#endif
+}
+
+void audio_cng_init(audio_cng_t *cng)
+{
+    if (!cng) return;
+
+    cng->level = 0;
+    cng->lowpass = 0;
+    cng->seed = 0x12345678;
+}
+
+void audio_cng_update(audio_cng_t *cng, const int16_t *pcm, size_t samples)
+{
+    if (!cng || !pcm) return;
+
+    cng->level = (int32_t)(audio_processor_get_rms(pcm, samples) * 32768.0f);
+}
+
+void audio_cng_generate(audio_cng_t *cng, int16_t *pcm, size_t samples)
+{
+    if (!cng || !pcm) return;
+
+    if (cng->level <= 0) {
+        memset(pcm, 0, samples * sizeof(int16_t));
+        return;
+    }
+
+    // White noise, gently low-passed towards typical background hiss
+    for (size_t i = 0; i < samples; i++) {
+        cng->seed = cng->seed * 1664525u + 1013904223u;
+        int32_t white = (int32_t)(cng->seed >> 16) - 32768;
+        cng->lowpass += (white - cng->lowpass) >> 1;
+        pcm[i] = (int16_t)cng->lowpass;
+    }
+
+    // Scale to the far end's background level
+    float rms = audio_processor_get_rms(pcm, samples) * 32768.0f;
+    if (rms < 1.0f) return;
+
+    float gain = (float)cng->level / rms;
+    audio_dsp_gain(pcm, pcm, samples, audio_dsp_q15(gain));
+}
@@ -0,0 +1,93 @@
+/**
+ * @file audio_vad.h
+ * @brief Voice Activity Detection, DTX Decisions and Comfort Noise
+ *
+ * Sender: audio_vad_frame() classifies each frame against a tracked
+ * noise floor and says whether to send it, send it as a comfort-noise
+ * update (PACKET_FLAG_DTX), or skip it. Sequence numbers only advance
+ * for frames that are sent, so the receiver sees no loss during silence.
+ *
+ * Receiver: after a DTX frame the jitter buffer plays audio_cng noise at
+ * the level of the last update until the next frame arrives.
+ */
+
+#ifndef AUDIO_VAD_H
+#define AUDIO_VAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef enum {
+    AUDIO_DTX_SEND = 0,          // Speech (or hangover): send normally
+    AUDIO_DTX_UPDATE,            // Silence: send as a comfort-noise update
+    AUDIO_DTX_SKIP               // Silence: send nothing
+} audio_dtx_action_t;
+
+typedef struct {
+    float    noise_rms;          // Tracked background level (0.0-1.0)
+    uint32_t hangover;           // Frames still treated as speech
+    uint32_t silent_frames;      // Frames since the hangover ran out
+    uint32_t frames_skipped;     // Total frames not sent
+} audio_vad_t;
+
+typedef struct {
+    int32_t  level;              // Target RMS, sample units
+    int32_t  lowpass;            // Spectral tilt state
+    uint32_t seed;
+} audio_cng_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Reset the detector (speech assumed, so the first frames go out)
+ */
+void audio_vad_init(audio_vad_t *vad);
+
+/**
+ * @brief Track the noise floor and say whether a frame's level is speech
+ *
+ * The classifier behind audio_vad_frame, for callers that measured the
+ * level themselves (works without DTX_ENABLE).
+ * @param rms Frame RMS (0.0-1.0)
+ * @param speech_elsewhere Speech known from another source
+ * @return true for speech or hangover
+ */
+bool audio_vad_speech(audio_vad_t *vad, float rms, bool speech_elsewhere);
+
+/**
+ * @brief Classify one frame to be encoded and decide whether to send it
+ *
+ * The frame must still be encoded either way so the encoder state stays
+ * continuous.
+ * @param pcm Frame to be sent
+ * @param samples Samples in frame
+ * @param speech_elsewhere Speech known from another source (e.g. a pack
+ *                         talking into the mix)
+ * @return Send action (always AUDIO_DTX_SEND without DTX_ENABLE)
+ */
+audio_dtx_action_t audio_vad_frame(audio_vad_t *vad, const int16_t *pcm, size_t samples,
+                                   bool speech_elsewhere);
+
+/**
+ * @brief Reset a comfort-noise generator to silence
+ */
+void audio_cng_init(audio_cng_t *cng);
+
+/**
+ * @brief Take the noise level from a decoded comfort-noise update
+ */
+void audio_cng_update(audio_cng_t *cng, const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Generate one frame of comfort noise
+ */
+void audio_cng_generate(audio_cng_t *cng, int16_t *pcm, size_t samples);
+
+#endif // AUDIO_VAD_H
@@ -0,0 +1,277 @@
+/**
+ * @file wm8960.c
+ * @brief WM8960 Register Access Implementation
+ *
+ * Synchronous writes and the async writer share one mutex, which also
+ * covers the shadow. Pending async values sit in a per-register slot
+ * under a spinlock; the writer takes the whole set at once while holding
+ * the mutex, so a synchronous write to the same register either cancels
+ * the pending one or lands after it - never before it.
+ *
+ * The bus is created on the network core so its interrupt stays off the
+ * audio core.
+ */
+
+#include "wm8960.h"
+#include "../config.h"
+#include "../system/task_map.h"
+#include "esp_log.h"
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "WM8960";
+
+// Longest a single register write may take (clock stretching included)
+#define WM8960_I2C_TIMEOUT_MS   20
+
+#define REG_BIT(reg)            (1ULL << (reg))
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static i2c_master_bus_handle_t bus = NULL;
+static i2c_master_dev_handle_t dev = NULL;
+static SemaphoreHandle_t bus_lock = NULL;
+static TaskHandle_t writer_handle = NULL;
+
+// Shadow (under bus_lock)
+static uint16_t shadow[WM8960_REG_COUNT];
+static uint64_t shadow_valid = 0;
+
+// Async writes not yet made (under pending_lock)
+static portMUX_TYPE pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t pending[WM8960_REG_COUNT];
+static uint64_t pending_mask = 0;
+
+static wm8960_stats_t stats = {0};
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+// Called with bus_lock held
+static esp_err_t transmit(uint8_t reg, uint16_t value)
+{
+    if (reg >= WM8960_REG_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((shadow_valid & REG_BIT(reg)) && shadow[reg] == value) {
+        stats.skipped++;
+        return ESP_OK;
+    }
+    if (!dev) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // 7-bit address, 9-bit value: B8 rides in the address byte
+    uint8_t data[2] = {
+        (uint8_t)((reg << 1) | ((value >> 8) & 0x01)),
+        (uint8_t)(value & 0xFF),
+    };
+    esp_err_t ret = i2c_master_transmit(dev, data, sizeof(data), WM8960_I2C_TIMEOUT_MS);
+    stats.writes++;
+
+    if (ret != ESP_OK) {
+        stats.errors++;
+        shadow_valid &= ~REG_BIT(reg);   // Unknown whether it landed
+        ESP_LOGE(TAG, "I2C write failed: reg=0x%02X val=0x%03X err=%d", reg, value, ret);
+        return ret;
+    }
+
+    if (reg == WM8960_REG_RESET) {
+        shadow_valid = 0;
+    } else {
+        shadow[reg] = value;
+        shadow_valid |= REG_BIT(reg);
+    }
+    return ESP_OK;
+}
+
+// A synchronous write supersedes what the writer has not sent yet
+static void cancel_pending(uint8_t reg)
+{
+    if (reg >= WM8960_REG_COUNT) return;
+
+    portENTER_CRITICAL(&pending_lock);
+    pending_mask &= ~REG_BIT(reg);
+    portEXIT_CRITICAL(&pending_lock);
+}
+
+static void writer_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(bus_lock, portMAX_DELAY);
+        uint16_t values[WM8960_REG_COUNT];
+        portENTER_CRITICAL(&pending_lock);
+        uint64_t mask = pending_mask;
+        pending_mask = 0;
+        memcpy(values, pending, sizeof(values));
+        portEXIT_CRITICAL(&pending_lock);
+
+        for (uint8_t reg = 0; mask != 0; reg++, mask >>= 1) {
+            if (mask & 1) {
+                transmit(reg, values[reg]);
+            }
+        }
+        xSemaphoreGive(bus_lock);
+    }
+}
+
+static esp_err_t create_bus(void)
+{
+    i2c_master_bus_config_t bus_config = {
+        .i2c_port = I2C_NUM_0,
+        .sda_io_num = I2C_SDA_PIN,
+        .scl_io_num = I2C_SCL_PIN,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t ret = i2c_new_master_bus(&bus_config, &bus);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = WM8960_I2C_ADDR,
+        .scl_speed_hz = I2C_CLOCK_HZ,
+    };
+    ret = i2c_master_bus_add_device(bus, &dev_config, &dev);
+    if (ret != ESP_OK) {
+        i2c_del_master_bus(bus);
+        bus = NULL;
+    }
+    return ret;
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t wm8960_init(void)
+{
+    if (dev) {
+        return ESP_OK;
+    }
+
+    if (!bus_lock) {
+        bus_lock = xSemaphoreCreateMutex();
+        if (!bus_lock) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    esp_err_t ret = task_map_run_on_core(TASK_CORE_NETWORK, create_bus);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2C bus init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    shadow_valid = 0;
+    pending_mask = 0;
+    if (!writer_handle) {
+        ret = task_map_create(TASK_CODEC, writer_task, NULL, &writer_handle);
+        if (ret != ESP_OK) {
+            writer_handle = NULL;   // Async writes fall back to synchronous
+            ESP_LOGW(TAG, "Async writer not started: %s", esp_err_to_name(ret));
+        }
+    }
+
+    ESP_LOGI(TAG, "I2C master at %lu kHz", (unsigned long)(I2C_CLOCK_HZ / 1000));
+    return ESP_OK;
+}
+
+esp_err_t wm8960_reset(void)
+{
+    return wm8960_write(WM8960_REG_RESET, 0x000);
+}
+
+esp_err_t wm8960_write(uint8_t reg, uint16_t value)
+{
+    wm8960_write_t one = { .reg = reg, .value = value };
+    return wm8960_write_seq(&one, 1);
+}
+
+esp_err_t wm8960_write_seq(const wm8960_write_t *seq, size_t count)
+{
+    if (!seq || !bus_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(bus_lock, portMAX_DELAY);
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        cancel_pending(seq[i].reg);
+        ret = transmit(seq[i].reg, seq[i].value);
+    }
+    xSemaphoreGive(bus_lock);
+    return ret;
+}
+
+esp_err_t wm8960_write_async(const wm8960_write_t *seq, size_t count)
+{
+    if (!seq) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!writer_handle || !dev) {
+        return wm8960_write_seq(seq, count);
+    }
+
+    portENTER_CRITICAL(&pending_lock);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t reg = seq[i].reg;
+        if (reg >= WM8960_REG_COUNT) continue;
+        if (pending_mask & REG_BIT(reg)) {
+            stats.coalesced++;
+        }
+        pending[reg] = seq[i].value;
+        pending_mask |= REG_BIT(reg);
+    }
+    portEXIT_CRITICAL(&pending_lock);
+
+    xTaskNotifyGive(writer_handle);
+    return ESP_OK;
+}
+
+uint16_t wm8960_shadow(uint8_t reg)
+{
+    if (reg >= WM8960_REG_COUNT || !(shadow_valid & REG_BIT(reg))) {
+        return 0;
+    }
+    return shadow[reg];
+}
+
+void wm8960_get_stats(wm8960_stats_t *stats_out)
+{
+    if (stats_out) {
+        *stats_out = stats;
+    }
+}
+
+void wm8960_deinit(void)
+{
+    if (!bus_lock) return;
+
+    xSemaphoreTake(bus_lock, portMAX_DELAY);
+    portENTER_CRITICAL(&pending_lock);
+    pending_mask = 0;
+    portEXIT_CRITICAL(&pending_lock);
+
+    if (dev) {
+        i2c_master_bus_rm_device(dev);
+        dev = NULL;
+    }
+    if (bus) {
+        i2c_del_master_bus(bus);
+        bus = NULL;
+    }
+    shadow_valid = 0;
+    xSemaphoreGive(bus_lock);
+}
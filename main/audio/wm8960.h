@@ -0,0 +1,133 @@
+/**
+ * @file wm8960.h
+ * @brief WM8960 Register Access
+ *
+ * The codec's control port is write-only, so this layer keeps a shadow of
+ * every register it has written and drops writes that would change
+ * nothing. A register is unknown (always written) from reset until its
+ * first write.
+ *
+ * The WM8960 takes one register per I2C transaction (no auto-increment):
+ * a sequence is written back to back under one bus lock, skipping the
+ * unchanged ones. Asynchronous writes are coalesced per register and
+ * go out from a low-priority task, so the ADC and audio tasks never wait
+ * on the bus for a gain or volume change.
+ */
+
+#ifndef WM8960_H
+#define WM8960_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+//=============================================================================
+// REGISTERS
+//=============================================================================
+
+#define WM8960_I2C_ADDR         0x1A
+
+#define WM8960_REG_LINVOL       0x00
+#define WM8960_REG_RINVOL       0x01
+#define WM8960_REG_LOUT1        0x02
+#define WM8960_REG_ROUT1        0x03
+#define WM8960_REG_CLOCK1       0x04
+#define WM8960_REG_DACCTL1      0x05
+#define WM8960_REG_DACCTL2      0x06
+#define WM8960_REG_IFACE1       0x07
+#define WM8960_REG_LDACVOL      0x0A
+#define WM8960_REG_RDACVOL      0x0B
+#define WM8960_REG_RESET        0x0F
+#define WM8960_REG_LADCVOL      0x15
+#define WM8960_REG_RADCVOL      0x16
+#define WM8960_REG_ADDCTL1      0x17
+#define WM8960_REG_ADDCTL2      0x18
+#define WM8960_REG_POWER1       0x19
+#define WM8960_REG_POWER2       0x1A
+#define WM8960_REG_LINPATH      0x20
+#define WM8960_REG_RINPATH      0x21
+#define WM8960_REG_LOUTMIX      0x22
+#define WM8960_REG_ROUTMIX      0x25
+#define WM8960_REG_LOUT2        0x28
+#define WM8960_REG_ROUT2        0x29
+#define WM8960_REG_POWER3       0x2F
+#define WM8960_REG_LINBOOST     0x2B
+#define WM8960_REG_RINBOOST     0x2C
+#define WM8960_REG_ADDCTL4      0x30
+#define WM8960_REG_CLASSD1      0x31
+
+#define WM8960_REG_COUNT        0x38        // Register addresses 0x00-0x37
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef struct {
+    uint8_t  reg;
+    uint16_t value;              // 9 bits
+} wm8960_write_t;
+
+typedef struct {
+    uint32_t writes;             // Transactions on the bus
+    uint32_t skipped;            // Writes the shadow showed to be no-ops
+    uint32_t coalesced;          // Async writes overtaken by a newer value
+    uint32_t errors;             // Failed transactions
+} wm8960_stats_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Bring up the I2C bus, add the codec and start the async writer
+ * @return ESP_OK, or the I2C driver's error
+ */
+esp_err_t wm8960_init(void);
+
+/**
+ * @brief Software-reset the codec and forget the shadow
+ * @return ESP_OK, or the I2C error (e.g. no codec on the bus)
+ */
+esp_err_t wm8960_reset(void);
+
+/**
+ * @brief Write one register now, unless it already holds the value
+ *
+ * Supersedes an async write to the same register still pending.
+ * @return ESP_OK, or the I2C error
+ */
+esp_err_t wm8960_write(uint8_t reg, uint16_t value);
+
+/**
+ * @brief Write a sequence now, in order, skipping unchanged registers
+ * @return ESP_OK, or the first I2C error (the rest is not written)
+ */
+esp_err_t wm8960_write_seq(const wm8960_write_t *seq, size_t count);
+
+/**
+ * @brief Queue register writes for the async writer and return
+ *
+ * Writes are applied in register order; a register queued again before
+ * the writer gets to it only goes out once, with the newest value.
+ * Before wm8960_init, or if the writer is not running, the writes are
+ * made now.
+ * @return ESP_OK, or the I2C error of a synchronous fallback
+ */
+esp_err_t wm8960_write_async(const wm8960_write_t *seq, size_t count);
+
+/**
+ * @brief Last value written to a register (0 if not written since reset)
+ */
+uint16_t wm8960_shadow(uint8_t reg);
+
+/**
+ * @brief Get bus counters
+ */
+void wm8960_get_stats(wm8960_stats_t *stats);
+
+/**
+ * @brief Remove the codec and the bus (the async writer idles)
+ */
+void wm8960_deinit(void);
+
+#endif // WM8960_H
@@ -0,0 +1,475 @@
+/**
+ * @file benchmark.c
+ * @brief On-Target Audio Hot-Path Benchmark Implementation
+ *
+ * Corpus: BENCHMARK_CORPUS_MS of synthetic speech (two voiced talkers
+ * with pitch glides and syllable envelopes, a fricative burst and a
+ * near-silent gap), generated from fixed seeds so every run codes the
+ * same samples.
+ *
+ * Opus runs at every frame size (5, 10, 20 ms), every rate-control
+ * bitrate (RATE_CONTROL_MIN_BITRATE to OPUS_BITRATE) and complexities
+ * 0-10, with the build's encoder settings. The DSP stages run at every
+ * frame size; the echo canceller and jitter buffer at the build's.
+ * Times are CPU cycles per frame; load is the share of one frame period
+ * on the audio core, where the engine runs all of this (task_map.c). The
+ * network core's work (WiFi, lwIP, send) needs a live link and is not
+ * part of the suite.
+ */
+
+#include "benchmark.h"
+
+#if BENCHMARK_MODE_ENABLE
+
+#include "audio/audio_processor.h"
+#include "audio/audio_dsp.h"
+#include "audio/audio_jitter_buffer.h"
+#include "audio/audio_tones.h"
+#include "audio/audio_aec.h"
+#include "system/task_map.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "opus.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "BENCH";
+
+#define BENCH_MAX_SAMPLES       (SAMPLE_RATE_HZ / 50)   // 20 ms
+#define BENCH_CORPUS_SAMPLES    (SAMPLE_RATE_HZ * BENCHMARK_CORPUS_MS / 1000)
+#define BENCH_COMPLEXITIES      11
+
+#if DEVICE_TYPE_BASE
+#define BENCH_MIX_INPUTS        (MAX_PACKS + 1)         // Line + every pack
+#define BENCH_STREAMS           MAX_PACKS
+#else
+#define BENCH_MIX_INPUTS        2
+#define BENCH_STREAMS           1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+typedef struct {
+    uint64_t total;
+    uint32_t max;
+    uint32_t count;
+} bench_stat_t;
+
+// Per-frame means at the build's frame size, bitrate and complexity
+typedef struct {
+    uint32_t encode;
+    uint32_t decode;
+    uint32_t mix;
+    uint32_t mix_bus;
+    uint32_t mix_minus;
+    uint32_t limiter;
+    uint32_t aec;
+    uint32_t jb_push;
+    uint32_t jb_pop;
+} bench_build_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static const int frame_sizes_ms[] = { 5, 10, 20 };
+
+static int16_t *corpus = NULL;
+static bench_build_t build = {0};
+static TaskHandle_t caller_handle = NULL;
+static esp_err_t suite_result = ESP_OK;
+
+// Peak encode per complexity at the build's frame size and bitrate
+static uint32_t build_encode_peak[BENCH_COMPLEXITIES];
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static inline void stat_add(bench_stat_t *stat, uint32_t cycles)
+{
+    stat->total += cycles;
+    stat->count++;
+    if (cycles > stat->max) stat->max = cycles;
+}
+
+static inline uint32_t stat_mean(const bench_stat_t *stat)
+{
+    return stat->count ? (uint32_t)(stat->total / stat->count) : 0;
+}
+
+static float load_percent(uint32_t cycles, int frame_ms)
+{
+    float budget = (float)esp_rom_get_cpu_ticks_per_us() * (float)frame_ms * 1000.0f;
+    return 100.0f * (float)cycles / budget;
+}
+
+static void log_stat(const char *name, int frame_ms, const bench_stat_t *stat)
+{
+    ESP_LOGI(TAG, "  %-10s %2d ms: mean %7lu  max %7lu cycles  (%5.2f%%, peak %5.2f%%)",
+             name, frame_ms, (unsigned long)stat_mean(stat), (unsigned long)stat->max,
+             load_percent(stat_mean(stat), frame_ms), load_percent(stat->max, frame_ms));
+}
+
+// Harmonic voice with a pitch glide and a 4 Hz syllable envelope
+static void synth_voiced(int16_t *out, size_t count, float f0_start, float f0_end, float level)
+{
+    float phase = 0.0f;
+    for (size_t n = 0; n < count; n++) {
+        float t = (float)n / (float)count;
+        float f0 = f0_start + (f0_end - f0_start) * t;
+        phase += 2.0f * (float)M_PI * f0 / SAMPLE_RATE_HZ;
+        if (phase > 2.0f * (float)M_PI) phase -= 2.0f * (float)M_PI;
+
+        float v = 0.0f;
+        for (int k = 1; k <= 10; k++) {
+            v += sinf(phase * (float)k) / (float)k;
+        }
+        float syllable = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * 4.0f * (float)n / SAMPLE_RATE_HZ);
+        out[n] = (int16_t)(v * syllable * level * 32767.0f / 2.0f);
+    }
+}
+
+static void synth_noise(int16_t *out, size_t count, uint32_t seed, float level)
+{
+    int32_t lowpass = 0;
+    for (size_t n = 0; n < count; n++) {
+        seed = seed * 1664525u + 1013904223u;
+        int32_t white = (int32_t)(seed >> 16) - 32768;
+        lowpass += (white - lowpass) >> 2;
+        out[n] = (int16_t)((float)lowpass * level);
+    }
+}
+
+static void build_corpus(void)
+{
+    const size_t seg = BENCH_CORPUS_SAMPLES / 10;
+
+    synth_voiced(&corpus[0], 4 * seg, 110.0f, 170.0f, 0.5f);
+    synth_noise(&corpus[4 * seg], seg + seg / 2, 12345, 0.3f);
+    synth_noise(&corpus[5 * seg + seg / 2], seg + seg / 2, 777, 0.001f);
+    synth_voiced(&corpus[7 * seg], BENCH_CORPUS_SAMPLES - 7 * seg, 230.0f, 200.0f, 0.4f);
+}
+
+// Every bitrate and complexity at one frame size
+static esp_err_t bench_opus(int frame_ms)
+{
+    const int samples = SAMPLE_RATE_HZ * frame_ms / 1000;
+    const int frames = BENCH_CORPUS_SAMPLES / samples;
+    // Below 20 ms the codec runs CELT only (as OPUS_LOW_DELAY does)
+    const bool low_delay = frame_ms < 20;
+
+    int error;
+    OpusEncoder *enc = opus_encoder_create(SAMPLE_RATE_HZ, 1,
+        low_delay ? OPUS_APPLICATION_RESTRICTED_LOWDELAY : OPUS_APPLICATION_VOIP, &error);
+    if (error != OPUS_OK || !enc) {
+        ESP_LOGE(TAG, "Encoder: %s", opus_strerror(error));
+        return ESP_FAIL;
+    }
+    OpusDecoder *dec = opus_decoder_create(SAMPLE_RATE_HZ, 1, &error);
+    if (error != OPUS_OK || !dec) {
+        ESP_LOGE(TAG, "Decoder: %s", opus_strerror(error));
+        opus_encoder_destroy(enc);
+        return ESP_FAIL;
+    }
+
+    // The build's encoder settings (audio_opus.c)
+    opus_encoder_ctl(enc, OPUS_SET_VBR(0));
+    opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    opus_encoder_ctl(enc, OPUS_SET_DTX(DTX_ENABLE));
+    opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(OPUS_FEC_ACTIVE));
+    opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(OPUS_FEC_MIN_LOSS_PERC));
+
+    static uint8_t packet[OPUS_MAX_PACKET_SIZE];
+    static int16_t AUDIO_DSP_ALIGN pcm[BENCH_MAX_SAMPLES];
+
+    ESP_LOGI(TAG, "Opus %d ms%s, %d frames:", frame_ms, low_delay ? " (restricted low delay)" : "",
+             frames);
+
+    for (int bitrate = RATE_CONTROL_MIN_BITRATE; bitrate <= OPUS_BITRATE;
+         bitrate += RATE_CONTROL_BITRATE_STEP) {
+        for (int complexity = 0; complexity < BENCH_COMPLEXITIES; complexity++) {
+            opus_encoder_ctl(enc, OPUS_RESET_STATE);
+            opus_decoder_ctl(dec, OPUS_RESET_STATE);
+            opus_encoder_ctl(enc, OPUS_SET_BITRATE(bitrate));
+            opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
+
+            bench_stat_t enc_stat = {0}, dec_stat = {0};
+            uint32_t bytes = 0;
+            for (int f = 0; f < frames; f++) {
+                uint32_t t0 = esp_cpu_get_cycle_count();
+                int size = opus_encode(enc, &corpus[f * samples], samples, packet, sizeof(packet));
+                uint32_t t1 = esp_cpu_get_cycle_count();
+                if (size < 0) {
+                    ESP_LOGE(TAG, "Encode failed: %s", opus_strerror(size));
+                    opus_encoder_destroy(enc);
+                    opus_decoder_destroy(dec);
+                    return ESP_FAIL;
+                }
+                // DTX frames (1-2 bytes) decode as comfort noise, as on air
+                opus_decode(dec, packet, size, pcm, samples, 0);
+                uint32_t t2 = esp_cpu_get_cycle_count();
+
+                stat_add(&enc_stat, t1 - t0);
+                stat_add(&dec_stat, t2 - t1);
+                bytes += (uint32_t)size;
+            }
+
+            ESP_LOGI(TAG, "  %5d bps cx %2d: enc mean %7lu max %7lu (%5.2f%%, peak %5.2f%%)  "
+                     "dec mean %6lu max %6lu (%5.2f%%)  %lu B/frame",
+                     bitrate, complexity,
+                     (unsigned long)stat_mean(&enc_stat), (unsigned long)enc_stat.max,
+                     load_percent(stat_mean(&enc_stat), frame_ms),
+                     load_percent(enc_stat.max, frame_ms),
+                     (unsigned long)stat_mean(&dec_stat), (unsigned long)dec_stat.max,
+                     load_percent(stat_mean(&dec_stat), frame_ms),
+                     (unsigned long)(bytes / frames));
+
+            if (frame_ms == FRAME_SIZE_MS && bitrate == OPUS_BITRATE) {
+                build_encode_peak[complexity] = enc_stat.max;
+                if (complexity == OPUS_COMPLEXITY) {
+                    build.encode = stat_mean(&enc_stat);
+                    build.decode = stat_mean(&dec_stat);
+                }
+            }
+
+            // Let the idle task run (task watchdog)
+            vTaskDelay(1);
+        }
+    }
+
+    opus_encoder_destroy(enc);
+    opus_decoder_destroy(dec);
+    return ESP_OK;
+}
+
+// Mixer, limiter, level and tone stages at one frame size
+static void bench_dsp(int frame_ms)
+{
+    const size_t samples = SAMPLE_RATE_HZ * frame_ms / 1000;
+    const size_t frames = BENCH_CORPUS_SAMPLES / samples;
+
+    static int16_t AUDIO_DSP_ALIGN out[BENCH_MAX_SAMPLES];
+    static int32_t bus[BENCH_MAX_SAMPLES];
+    const int16_t *inputs[BENCH_MIX_INPUTS];
+
+    audio_mix_state_t mix_state, minus_state;
+    audio_processor_mix_init(&mix_state);
+    audio_processor_mix_init(&minus_state);
+    audio_limiter_t limiter;
+    audio_processor_limiter_init(&limiter, LIMITER_THRESHOLD, true);
+    uint32_t tone_phase = 0;
+    volatile float rms_sink = 0.0f;
+
+    bench_stat_t mix = {0}, mix_bus = {0}, mix_minus = {0}, limit = {0}, rms = {0}, tone = {0};
+
+    for (size_t f = 0; f < frames; f++) {
+        // Each input a different stretch of the corpus (different talkers)
+        for (size_t k = 0; k < BENCH_MIX_INPUTS; k++) {
+            inputs[k] = &corpus[((f + k * 7) % frames) * samples];
+        }
+
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        audio_processor_mix_n(inputs, BENCH_MIX_INPUTS, out, samples, &mix_state);
+        uint32_t t1 = esp_cpu_get_cycle_count();
+        audio_processor_mix_bus(inputs, BENCH_MIX_INPUTS, bus, samples);
+        uint32_t t2 = esp_cpu_get_cycle_count();
+        audio_processor_mix_minus(bus, inputs[1], out, samples, &minus_state);
+        uint32_t t3 = esp_cpu_get_cycle_count();
+        stat_add(&mix, t1 - t0);
+        stat_add(&mix_bus, t2 - t1);
+        stat_add(&mix_minus, t3 - t2);
+
+        memcpy(out, inputs[0], samples * sizeof(int16_t));
+        t0 = esp_cpu_get_cycle_count();
+        audio_processor_limiter_process(&limiter, out, samples);
+        t1 = esp_cpu_get_cycle_count();
+        rms_sink = audio_processor_get_rms(inputs[0], samples);
+        t2 = esp_cpu_get_cycle_count();
+        audio_tones_generate_sine(out, samples, 1000.0f, 0.5f, &tone_phase);
+        t3 = esp_cpu_get_cycle_count();
+        stat_add(&limit, t1 - t0);
+        stat_add(&rms, t2 - t1);
+        stat_add(&tone, t3 - t2);
+    }
+    (void)rms_sink;
+
+    log_stat("mix_n", frame_ms, &mix);
+    log_stat("mix_bus", frame_ms, &mix_bus);
+    log_stat("mix_minus", frame_ms, &mix_minus);
+    log_stat("limiter", frame_ms, &limit);
+    log_stat("rms", frame_ms, &rms);
+    log_stat("tone", frame_ms, &tone);
+
+    if (frame_ms == FRAME_SIZE_MS) {
+        build.mix = stat_mean(&mix);
+        build.mix_bus = stat_mean(&mix_bus);
+        build.mix_minus = stat_mean(&mix_minus);
+        build.limiter = stat_mean(&limit);
+    }
+}
+
+// Echo canceller and jitter buffer, at the build's frame size only
+static esp_err_t bench_build_frame(void)
+{
+    const size_t frames = BENCH_CORPUS_SAMPLES / SAMPLES_PER_FRAME;
+    esp_err_t result = ESP_OK;
+
+#if AEC_ENABLE
+    static int16_t AUDIO_DSP_ALIGN mic[SAMPLES_PER_FRAME];
+    static audio_aec_t aec;
+    audio_aec_init(&aec);
+    bench_stat_t aec_stat = {0};
+    for (size_t f = 0; f < frames; f++) {
+        // Echo: the frame played three frames earlier at -6 dB
+        const int16_t *played = &corpus[f * SAMPLES_PER_FRAME];
+        const int16_t *echo = &corpus[((f + frames - 3) % frames) * SAMPLES_PER_FRAME];
+        for (size_t n = 0; n < SAMPLES_PER_FRAME; n++) {
+            mic[n] = (int16_t)(echo[n] / 2);
+        }
+
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        audio_aec_process(&aec, mic, SAMPLES_PER_FRAME);
+        audio_aec_reference(&aec, played, SAMPLES_PER_FRAME);
+        stat_add(&aec_stat, esp_cpu_get_cycle_count() - t0);
+    }
+    log_stat("aec", FRAME_SIZE_MS, &aec_stat);
+    build.aec = stat_mean(&aec_stat);
+
+    uint32_t aec_peak_us = aec_stat.max / esp_rom_get_cpu_ticks_per_us();
+    if (aec_peak_us < AEC_BUDGET_US) {
+        ESP_LOGI(TAG, "  aec peak %lu us: pass (budget %d us)",
+                 (unsigned long)aec_peak_us, AEC_BUDGET_US);
+    } else {
+        ESP_LOGW(TAG, "  aec peak %lu us: FAIL (budget %d us)",
+                 (unsigned long)aec_peak_us, AEC_BUDGET_US);
+        result = ESP_FAIL;
+    }
+#endif
+
+    static jitter_buffer_t jb;
+    static jitter_frame_t frame;
+    esp_err_t ret = jitter_buffer_init(&jb);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    static uint8_t payload[64];
+    memset(payload, 0x5A, sizeof(payload));
+    bench_stat_t push = {0}, pop = {0};
+    for (size_t f = 0; f < frames; f++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        jitter_buffer_push(&jb, payload, sizeof(payload), (uint32_t)f,
+                           (uint32_t)(f * FRAME_SIZE_MS * 1000), false, false);
+        uint32_t t1 = esp_cpu_get_cycle_count();
+        jitter_buffer_pop(&jb, &frame, false);
+        uint32_t t2 = esp_cpu_get_cycle_count();
+        stat_add(&push, t1 - t0);
+        stat_add(&pop, t2 - t1);
+    }
+    jitter_buffer_deinit(&jb);
+
+    log_stat("jb_push", FRAME_SIZE_MS, &push);
+    log_stat("jb_pop", FRAME_SIZE_MS, &pop);
+    build.jb_push = stat_mean(&push);
+    build.jb_pop = stat_mean(&pop);
+    return result;
+}
+
+// What one engine frame costs this device at the build's settings
+static void log_budget(void)
+{
+    uint32_t per_stream = build.decode + build.limiter + build.jb_push + build.jb_pop;
+#if DEVICE_TYPE_BASE
+    // Every pack decoded and mixed; a mix-minus feed and encode per pack
+    // plus the broadcast
+    uint32_t total = BENCH_STREAMS * per_stream + build.mix + build.mix_bus +
+                     (BENCH_STREAMS + 1) * (build.mix_minus + build.encode) + build.aec;
+#else
+    // One stream in; mic limiter, echo canceller and one encode out
+    uint32_t total = per_stream + build.limiter + build.aec + build.encode;
+#endif
+
+    ESP_LOGI(TAG, "Audio core per %d ms frame (%s, %d bps, cx %d): %lu cycles, %.1f%% "
+             "(network core not measured)",
+             FRAME_SIZE_MS, DEVICE_TYPE_STRING, OPUS_BITRATE, OPUS_COMPLEXITY,
+             (unsigned long)total, load_percent(total, FRAME_SIZE_MS));
+
+    // Rate control steps complexity down when the peak encode passes this
+    int best = -1;
+    for (int cx = 0; cx < BENCH_COMPLEXITIES; cx++) {
+        if (load_percent(build_encode_peak[cx], FRAME_SIZE_MS) <= RATE_CONTROL_CPU_HIGH_PCT) {
+            best = cx;
+        }
+    }
+    if (best >= 0) {
+        ESP_LOGI(TAG, "Highest complexity with peak encode under %d%% of a frame: %d "
+                 "(OPUS_COMPLEXITY is %d)", RATE_CONTROL_CPU_HIGH_PCT, best, OPUS_COMPLEXITY);
+    } else {
+        ESP_LOGW(TAG, "No complexity keeps peak encode under %d%% of a frame",
+                 RATE_CONTROL_CPU_HIGH_PCT);
+    }
+}
+
+static void benchmark_task(void *arg)
+{
+    (void)arg;
+    uint32_t ticks_per_us = esp_rom_get_cpu_ticks_per_us();
+    ESP_LOGI(TAG, "Audio hot-path benchmark on core %d at %lu MHz, %d ms corpus",
+             (int)xPortGetCoreID(), (unsigned long)ticks_per_us, BENCHMARK_CORPUS_MS);
+
+    build_corpus();
+
+    for (size_t i = 0; i < sizeof(frame_sizes_ms) / sizeof(frame_sizes_ms[0]); i++) {
+        if (bench_opus(frame_sizes_ms[i]) != ESP_OK) {
+            suite_result = ESP_FAIL;
+        }
+    }
+
+    ESP_LOGI(TAG, "DSP (%d-input mixes):", BENCH_MIX_INPUTS);
+    for (size_t i = 0; i < sizeof(frame_sizes_ms) / sizeof(frame_sizes_ms[0]); i++) {
+        bench_dsp(frame_sizes_ms[i]);
+        vTaskDelay(1);
+    }
+
+    if (bench_build_frame() != ESP_OK) {
+        suite_result = ESP_FAIL;
+    }
+
+    log_budget();
+
+    xTaskNotifyGive(caller_handle);
+    task_map_exit(TASK_BENCHMARK);
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t benchmark_run(void)
+{
+    corpus = heap_caps_malloc(BENCH_CORPUS_SAMPLES * sizeof(int16_t), MALLOC_CAP_INTERNAL);
+    if (!corpus) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    caller_handle = xTaskGetCurrentTaskHandle();
+    esp_err_t ret = task_map_create(TASK_BENCHMARK, benchmark_task, NULL, NULL);
+    if (ret == ESP_OK) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        ret = suite_result;
+    }
+
+    heap_caps_free(corpus);
+    corpus = NULL;
+    ESP_LOGI(TAG, "Benchmark %s", ret == ESP_OK ? "complete" : "failed");
+    return ret;
+}
+
+#endif // BENCHMARK_MODE_ENABLE
@@ -0,0 +1,23 @@
+/**
+ * @file benchmark.h
+ * @brief On-Target Audio Hot-Path Benchmark
+ *
+ * Built with BENCHMARK_MODE_ENABLE: instead of starting the intercom, the
+ * firmware runs every audio hot-path stage over a fixed synthetic speech
+ * corpus and logs cycles per frame and the share of the audio core's
+ * frame budget, then idles.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "esp_err.h"
+#include "config.h"
+
+/**
+ * @brief Run the whole suite on the audio core and wait for it
+ * @return ESP_OK when every stage ran
+ */
+esp_err_t benchmark_run(void);
+
+#endif // BENCHMARK_H
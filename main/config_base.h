@@ -26,8 +26,29 @@
 // Static IP for base station
 #define BASE_STATION_IP         "192.168.4.1"
 
-// Maximum number of connected stations (should be 1 for 1:1 pairing)
-#define MAX_STA_CONN            1
+// Maximum number of belt packs served by this base station. Each pack gets
+// its own jitter buffer and Opus decoder (allocated at boot) and all packs
+// are mixed onto the party line. Budget ~1 ms of decode per talking pack.
+#define MAX_PACKS               4
+
+// Maximum number of connected stations
+#define MAX_STA_CONN            MAX_PACKS
+
+// Internal-SRAM arena (see MEMORY in config_common.h): Opus state for the
+// line and every pack's decoder and mix-minus encoder, receive queues
+#define MEM_ARENA_FAST_BYTES    (224 * 1024)
+
+// A pack that has sent no audio for this long releases its slot (ms)
+#define PACK_TIMEOUT_MS         5000
+
+// Mix-minus: each talking pack gets its own feed (line + other packs) and
+// its own encoder. With shared encode, packs that are only listening get
+// the broadcast mix instead, so idle packs cost no extra encoder time.
+#define MIX_MINUS_SHARED_ENCODE 1
+
+// Keep a pack on its own feed this long after its last audio (ms), so the
+// tail of its speech is not echoed back
+#define MIX_MINUS_HOLD_MS       500
 
 //=============================================================================
 // PARTY LINE INTERFACE
@@ -46,6 +67,14 @@
 // 0 = disabled, 1 = enabled
 #define PARTYLINE_DC_BLOCKING   1
 
+// Party line input filter, after the echo canceller and before encoding:
+// high-pass against hum and cable rumble, and a noise gate that follows
+// the line's VAD so hiss between words does not cost bits
+#define PARTYLINE_HPF_HZ        90      // High-pass corner, 0 = off
+#define PARTYLINE_GATE_ENABLE   1
+#define PARTYLINE_GATE_FLOOR    0.125f  // Gain with the gate closed (-18 dB)
+#define PARTYLINE_GATE_RELEASE_MS 150   // Time to close once the VAD hangover ends
+
 //=============================================================================
 // GPIO PIN ASSIGNMENTS (Base Station Specific)
 //=============================================================================
@@ -67,6 +96,7 @@
 // Call voltage thresholds (adjust based on your voltage divider)
 // With 100k/10k divider: 1.5V at GPIO = ~16.5V on partyline
 #define CALL_VOLTAGE_THRESHOLD  1.5f  // Volts - above this = call detected
+#define CALL_VOLTAGE_HYSTERESIS 0.1f  // Volts either side of the threshold
 #define CALL_DEBOUNCE_MS        50    // Milliseconds - debounce time
 
 // Optional passthrough detect (if 3-pin XLR female is used)
@@ -17,13 +17,24 @@
 // Sample rate (Hz) - DO NOT CHANGE unless you know what you're doing
 #define SAMPLE_RATE_HZ          16000
 
-// Frame size for Opus encoding (ms)
-// Options: 10, 20, 40, 60 (20ms recommended for balance of latency/efficiency)
+// Frame size for Opus encoding (ms). Also the I2S DMA frame and the
+// jitter buffer slot, so every stage runs at this cadence. Both ends of a
+// link must be built with the same size.
+// Options: 5, 10, 20 (20ms recommended for balance of latency/efficiency;
+// 10 or 5 for IFB/cue, ~30-40 ms less end to end at twice or four times
+// the packet rate)
 #define FRAME_SIZE_MS           20
 
 // Samples per frame (calculated)
 #define SAMPLES_PER_FRAME       ((SAMPLE_RATE_HZ * FRAME_SIZE_MS) / 1000)
 
+// I2S DMA: each descriptor holds exactly one mono frame, so a frame read
+// or write completes on a DMA boundary. Depth in frames per direction.
+#define I2S_DMA_DESC_NUM        3
+
+// Longest a codec read/write may block before giving up (ms)
+#define I2S_IO_TIMEOUT_MS       (FRAME_SIZE_MS * 4)
+
 // Opus bitrate (bits per second)
 // Range: 6000-510000, recommend 24000 for voice
 #define OPUS_BITRATE            24000
@@ -32,25 +43,115 @@
 // Recommend: 5 for balance
 #define OPUS_COMPLEXITY         5
 
+// Opus low-delay mode (OPUS_APPLICATION_RESTRICTED_LOWDELAY): CELT only,
+// ~4 ms less algorithmic delay. Needed below 10 ms frames (SILK cannot
+// code them). In-band FEC lives in SILK and has nothing to carry here;
+// use BUNDLE_REDUNDANT for loss protection instead.
+// 0 = VOIP (SILK/hybrid), 1 = restricted low delay
+#define OPUS_LOW_DELAY          (FRAME_SIZE_MS < 20)
+
+// Opus in-band FEC: each packet also carries a coarse copy of the previous
+// frame, so a single lost packet can be rebuilt from the one after it.
+// The redundancy follows the measured packet loss, clamped to MIN..MAX %.
+// 0 = disabled, 1 = enabled (recommended on 2.4 GHz)
+#define OPUS_INBAND_FEC_ENABLE  1
+#define OPUS_FEC_MIN_LOSS_PERC  2
+#define OPUS_FEC_MAX_LOSS_PERC  30
+
+// FEC this build can code: none under OPUS_LOW_DELAY, so the encoder does
+// not ask for it, the jitter buffer does not look ahead for it and the
+// status reports it unavailable
+#define OPUS_FEC_ACTIVE         (OPUS_INBAND_FEC_ENABLE && !OPUS_LOW_DELAY)
+
+// Rate control: adapt bitrate and complexity at run time. Bitrate backs off
+// on packet loss (as reported by the far end) or weak RSSI and climbs back
+// towards OPUS_BITRATE once the link is clean; complexity drops when the
+// encoder's peak time eats too much of the frame and recovers towards
+// OPUS_COMPLEXITY when there is headroom.
+// 0 = fixed OPUS_BITRATE / OPUS_COMPLEXITY, 1 = adaptive
+#define RATE_CONTROL_ENABLE             1
+#define RATE_CONTROL_MIN_BITRATE        12000   // Floor (bps)
+#define RATE_CONTROL_BITRATE_STEP       2000    // Increase per recovery step (bps)
+#define RATE_CONTROL_LOSS_HIGH_PCT      5.0f    // Back off above this loss
+#define RATE_CONTROL_LOSS_LOW_PCT       1.0f    // Recover below this loss
+#define RATE_CONTROL_RSSI_LOW_DBM       (-75)   // Back off below this RSSI
+#define RATE_CONTROL_RECOVER_S          5       // Good seconds per recovery step
+#define RATE_CONTROL_MIN_COMPLEXITY     1
+#define RATE_CONTROL_CPU_HIGH_PCT       50      // Peak encode, % of frame time
+#define RATE_CONTROL_CPU_LOW_PCT        25
+#define RATE_CONTROL_REPORT_TIMEOUT_MS  3000    // Far-end report considered stale
+
 // Jitter buffer: absorbs WiFi timing jitter on the receive path.
-// A dedicated playback task drains the buffer at a steady 20ms cadence.
+// The audio engine drains it one frame per I2S frame event.
 // 0 = disabled (decoded audio written directly to I2S from the UDP callback)
 // 1 = enabled  (recommended for production use)
 #define JITTER_BUFFER_ENABLE    1
 
-// Number of decoded PCM frames held in the jitter buffer.
-// Each frame is FRAME_SIZE_MS (20 ms), so the total buffering latency is
-// JITTER_BUFFER_FRAMES * 20 ms.
+// Audio held in the jitter buffer (one slot per sequence number, each
+// FRAME_SIZE_MS long), so the total buffering latency is JITTER_BUFFER_MS
+// rounded down to whole frames.
 //
 // Trade-off:
 //   Lower value  -> less latency, but more likely to underrun on WiFi jitter
 //   Higher value -> smoother playback, but adds latency
 //
-// 2 frames (40 ms) is the practical minimum: one frame is being played
-// while the next can arrive up to 20 ms early or late without a gap.
-// For a real-time intercom the extra 40 ms is acceptable and eliminates
-// most WiFi-induced audio glitches.
-#define JITTER_BUFFER_FRAMES    2
+// 40 ms is the practical minimum at 20 ms frames: one frame is being
+// played while the next can arrive up to 20 ms early or late without a
+// gap. For a real-time intercom the extra 40 ms is acceptable and
+// eliminates most WiFi-induced audio glitches.
+#define JITTER_BUFFER_MS        40
+#define JITTER_BUFFER_FRAMES    (JITTER_BUFFER_MS / FRAME_SIZE_MS)
+
+// Adaptive depth: track inter-arrival jitter from the packet timestamps and
+// move the target depth between MIN and MAX at run time.
+// JITTER_BUFFER_MS is then only the starting depth.
+// 0 = fixed depth of JITTER_BUFFER_MS
+// 1 = adaptive (recommended)
+#define JITTER_BUFFER_ADAPTIVE      1
+#define JITTER_BUFFER_MIN_MS        20
+#define JITTER_BUFFER_MAX_MS        120
+#define JITTER_BUFFER_MIN_FRAMES    (JITTER_BUFFER_MIN_MS / FRAME_SIZE_MS)
+#define JITTER_BUFFER_MAX_FRAMES    (JITTER_BUFFER_MAX_MS / FRAME_SIZE_MS)
+
+// Low-latency links (LINK_LOW_LATENCY): the buffer starts at its minimum
+// and never grows past this, trading occasional concealment for delay
+#define JITTER_BUFFER_LOW_LATENCY_MAX_MS 40
+#define JITTER_BUFFER_LOW_LATENCY_MAX_FRAMES (JITTER_BUFFER_LOW_LATENCY_MAX_MS / FRAME_SIZE_MS)
+
+// Arrivals the receive task can queue between two playout ticks, e.g. a
+// burst after a WiFi stall (power of two; more are dropped and counted)
+#define JITTER_BUFFER_RX_QUEUE      16
+
+// Safety margin applied to the smoothed jitter estimate when sizing the
+// buffer (target covers JITTER_BUFFER_JITTER_MULT x mean jitter)
+#define JITTER_BUFFER_JITTER_MULT   4
+
+// How long the link must stay calmer before the target depth shrinks (ms).
+// Growth is immediate, shrinking is deliberately slow to avoid hunting.
+#define JITTER_BUFFER_SHRINK_HOLD_MS 3000
+
+// Frames quieter than this RMS (0.0-1.0) count as silence. Depth changes
+// are only made on silent frames so speech is never stretched or cut.
+#define JITTER_BUFFER_SILENCE_RMS   0.01f
+
+// Clock drift compensation (jitter buffer path). The far end's packet
+// timestamps are compared with the local I2S clock; playout is resampled
+// by the measured ppm so the buffer neither creeps full nor drains over a
+// long show. 0 = disabled, 1 = enabled (recommended)
+#define DRIFT_COMP_ENABLE           1
+#define DRIFT_WINDOW_MS             10000   // Least-delay window per measurement
+#define DRIFT_WINDOWS               16      // Windows in the slope (~160 s)
+#define DRIFT_MAX_PPM               300     // Clamp, well beyond any crystal pair
+
+// Voice activity detection + DTX on the base downlink. During line
+// silence only a comfort-noise update goes out every DTX_UPDATE_MS; packs
+// fill the gaps with locally generated comfort noise.
+// 0 = disabled (send every frame), 1 = enabled
+#define DTX_ENABLE              1
+#define VAD_THRESHOLD_RMS       0.003f  // Absolute speech floor (~-50 dBFS)
+#define VAD_SNR                 3.0f    // Speech is this far above the noise floor (~10 dB)
+#define VAD_HANGOVER_MS         300     // Speech holds this long after the level drops
+#define DTX_UPDATE_MS           400     // Comfort-noise update period
 
 // Enable audio limiter to prevent clipping
 // 0 = disabled, 1 = enabled (recommended)
@@ -59,6 +160,60 @@
 // Limiter threshold (0.0 to 1.0, where 1.0 = full scale)
 #define LIMITER_THRESHOLD       0.95f
 
+// Look-ahead limiter (received streams and the pack mic). Gain follows
+// the peak over the next LIMITER_LOOKAHEAD_MS of the frame, so it is down
+// before a transient arrives; no latency is added. Attack/release are
+// one-pole time constants of 2^shift samples at 16 kHz.
+#define LIMITER_LOOKAHEAD_MS    2
+#define LIMITER_ATTACK_SHIFT    3       // ~0.5 ms
+#define LIMITER_RELEASE_SHIFT   11      // ~130 ms
+
+// Automatic gain ahead of the limiter: steers each stream's speech level
+// towards AGC_TARGET_RMS so talkers arrive equally loud.
+// 0 = disabled, 1 = enabled (recommended)
+#define AGC_ENABLE              1
+#define AGC_TARGET_RMS          0.1f    // ~-20 dBFS
+#define AGC_MAX_GAIN            4.0f    // +12 dB for quiet talkers
+#define AGC_MIN_GAIN            0.25f   // -12 dB for loud ones
+#define AGC_GATE_RMS            0.005f  // Quieter frames hold the gain (no noise pumping)
+#define AGC_ATTACK_SHIFT        3       // Per frame: gain falls 1/8 of the gap (~160 ms)
+#define AGC_RELEASE_SHIFT       6       // Rises 1/64 of the gap (~1.3 s)
+
+// Echo canceller (audio_aec.c), run by the audio engine on every captured
+// frame against the frame it played. Pack: far-end audio leaking from the
+// headset back into the mic. Base: the packs' audio returned by the party
+// line hybrid into the line input. Needs JITTER_BUFFER_ENABLE (the played
+// stream is the reference).
+// 0 = disabled, 1 = enabled (recommended)
+#define AEC_ENABLE              1
+#define AEC_TAIL_MS             16      // Echo path length the filter covers
+#define AEC_MAX_DELAY_MS        80      // Longest playout-to-capture delay searched
+#define AEC_STEP_SIZE           0.3f    // NLMS step (0-1): faster vs steadier convergence
+#define AEC_DOUBLE_TALK         0.5f    // Near end talking: mic peak > this x far-end peak
+#define AEC_DT_HANGOVER_MS      100     // Adaptation held this long after near-end speech
+#define AEC_SUPPRESS            0.25f   // Residual gain while only the far end talks (-12 dB)
+#define AEC_BUDGET_US           3000    // Worst audio_aec_process() per frame must stay under this
+
+// DSP kernels (audio_dsp.c): 1 = ESP32-S3 PIE vector path where buffer
+// alignment allows, 0 = scalar reference path everywhere
+#define AUDIO_DSP_SIMD          1
+
+// Time both kernel paths at startup and log the speedup (development aid)
+#define AUDIO_DSP_BENCHMARK     0
+
+//=============================================================================
+// MEMORY
+//=============================================================================
+
+// Boot-time arena (platform/mem_arena.c): pipeline buffers and codec state
+// are carved from one block per region during init and the arena is
+// sealed before streaming starts. The fast region is internal SRAM
+// (MEM_ARENA_FAST_BYTES in config_base.h / config_pack.h); the bulk
+// region is PSRAM when the build enables CONFIG_SPIRAM, else it shares
+// the fast one. The boot log reports what each region used; anything
+// beyond a region's size is taken from the heap at boot and logged.
+#define MEM_ARENA_BULK_BYTES    (1536 * 1024)
+
 //=============================================================================
 // NETWORK CONFIGURATION
 //=============================================================================
@@ -69,22 +224,148 @@
 // WiFi Password (minimum 8 characters for WPA2)
 #define WIFI_PASSWORD           "intercom123"
 
-// WiFi Channel (1, 6, or 11 recommended for 2.4GHz to avoid overlap)
+// WiFi Channel (1, 6, or 11 recommended for 2.4GHz to avoid overlap).
+// With WIFI_AUTO_CHANNEL_ENABLE it is only the fallback; the ESP-NOW
+// backend always uses it
 #define WIFI_CHANNEL            6
 
+// Automatic channel selection (base, lwIP backend). Before the AP starts
+// the radio listens on each candidate for WIFI_CHANNEL_SURVEY_MS and
+// scores it by the air time of the frames it hears plus the noise floor
+// above WIFI_SURVEY_NOISE_REF_DBM; the AP starts on the lowest score. The
+// channel used last time (NVS) is kept unless another beats it by
+// WIFI_CHANNEL_MARGIN points. Costs about 3 x 100 ms of boot time.
+// 0 = always WIFI_CHANNEL, 1 = survey at boot
+#define WIFI_AUTO_CHANNEL_ENABLE  1
+#define WIFI_CHANNEL_CANDIDATES   { 1, 6, 11 }
+#define WIFI_CHANNEL_SURVEY_MS    100
+#define WIFI_SURVEY_PREAMBLE_US   40      // Per-frame PHY overhead in the air time estimate
+#define WIFI_SURVEY_NOISE_REF_DBM (-96)   // Noise floor that scores nothing
+#define WIFI_CHANNEL_MARGIN       10      // Points (1 = 1 % air time or 1 dB noise)
+#define WIFI_CHANNEL_NVS_KEY      "channel"  // u8 in WIFI_CACHE_NVS_NAMESPACE
+
+// Channel hopping while running (base). Audio loss above
+// WIFI_CHANNEL_HOP_LOSS_PCT, in either direction, while every pack's RSSI
+// is at least WIFI_CHANNEL_HOP_RSSI_DBM (interference rather than range,
+// which a new channel would not fix), for WIFI_CHANNEL_HOP_BAD_S seconds
+// moves the AP to the best other candidate. Packs are told on the
+// control channel and by a CSA in WIFI_CHANNEL_CSA_COUNT beacons, and
+// follow without reassociating. A channel left is avoided for
+// WIFI_CHANNEL_AVOID_S, and no hop follows another within
+// WIFI_CHANNEL_HOP_HOLD_S.
+#define WIFI_CHANNEL_HOP_ENABLE   1
+#define WIFI_CHANNEL_HOP_LOSS_PCT 5.0f
+#define WIFI_CHANNEL_HOP_RSSI_DBM (-70)
+#define WIFI_CHANNEL_HOP_BAD_S    10
+#define WIFI_CHANNEL_HOP_HOLD_S   120
+#define WIFI_CHANNEL_AVOID_S      900
+#define WIFI_CHANNEL_CSA_COUNT    3
+
 // Hide SSID from casual discovery
 // 0 = visible, 1 = hidden (recommended for security)
 #define WIFI_HIDDEN_SSID        1
 
+// Link profile, applied by wifi_manager on every start: predictable
+// airtime and latency rather than the driver's throughput defaults.
+// 802.11g/n only - no 11b DSSS rates, whose long frames stall the channel
+#define WIFI_LINK_NO_11B        1
+// 20 MHz channel (HT40 buys nothing at voice bitrates and doubles the
+// spectrum exposed to interference)
+#define WIFI_LINK_HT20          1
+// Lock every frame to one PHY rate instead of rate control. Airtime per
+// packet is then constant, but range is only what that rate reaches.
+#define WIFI_LINK_FIXED_RATE_ENABLE 0
+#define WIFI_LINK_FIXED_RATE    WIFI_PHY_RATE_MCS3_LGI  // 26 Mbps
+// Maximum TX power in 0.25 dBm steps (8-84), 0 = driver default
+#define WIFI_LINK_MAX_TX_POWER  0
+// DSCP on every audio and control datagram. The WiFi driver takes the top
+// three bits as the WMM user priority: CS6 (48) = UP 6 = AC_VO.
+// (EF, 46, would land in AC_VI.) Not used by the ESP-NOW backend.
+#define WIFI_AUDIO_DSCP         48
+// Pack STA power save: no modem sleep while talking or receiving live
+// audio, WIFI_PS_MIN_MODEM once the link has been idle this long. Needs
+// the power manager (BATTERY_MODE != BATTERY_NONE); otherwise the radio
+// never sleeps.
+#define WIFI_PS_IDLE_MS         5000
+
+// Link backend carrying the audio packets
+// TRANSPORT_LWIP   = 0 - UDP over the associated WiFi link (AP + STA)
+// TRANSPORT_ESPNOW = 1 - ESP-NOW frames on WIFI_CHANNEL: no IP stack, DHCP
+//                        or association, so lower per-packet latency and
+//                        near-instant reconnect. Frames are unencrypted.
+// A u8 stored at NVS TRANSPORT_NVS_NAMESPACE/TRANSPORT_NVS_KEY when the
+// device is provisioned overrides the build default.
+#define TRANSPORT_LWIP          0
+#define TRANSPORT_ESPNOW        1
+#define TRANSPORT_BACKEND       TRANSPORT_LWIP
+#define TRANSPORT_NVS_NAMESPACE "transport"
+#define TRANSPORT_NVS_KEY       "backend"
+
 // UDP port for audio packets
 #define UDP_PORT                5000
 
+// Compact audio header (6 bytes instead of 12) towards peers that announce
+// support for it; others keep the full header. Always understood on receive.
+// 0 = disabled, 1 = enabled (recommended)
+#define COMPACT_HEADER_ENABLE   1
+
+// Audio frames per datagram towards peers that read bundles (the encoder
+// path: base broadcast, pack uplink; mix-minus always goes per frame)
+// BUNDLE_LOW_LATENCY = 0 - one frame per datagram, 50/s (lowest latency)
+// BUNDLE_REDUNDANT   = 1 - each frame plus the previous one, 50/s: a
+//                          single lost datagram costs nothing
+// BUNDLE_AIRTIME     = 2 - two frames per datagram, 25/s (+20 ms): half
+//                          the MAC/PHY overhead on a crowded channel
+// BUNDLE_ROBUST      = 3 - two new frames plus the previous one, 25/s
+//                          (+20 ms): fewer packets and loss protection
+// A u8 stored at NVS TRANSPORT_NVS_NAMESPACE/BUNDLE_NVS_KEY overrides it
+// per deployment.
+#define BUNDLE_LOW_LATENCY      0
+#define BUNDLE_REDUNDANT        1
+#define BUNDLE_AIRTIME          2
+#define BUNDLE_ROBUST           3
+#define BUNDLE_MODE             BUNDLE_LOW_LATENCY
+#define BUNDLE_NVS_KEY          "bundle"
+
+// Low-latency link for IFB/cue: no frames held for bundles and a shallow
+// jitter buffer (JITTER_BUFFER_LOW_LATENCY_MAX_MS), on both ends. Either
+// end asking is enough: the hello carries it, so the far end follows.
+// Switchable at run time (udp_transport_set_low_latency); a u8 stored at
+// NVS TRANSPORT_NVS_NAMESPACE/LINK_LOW_LATENCY_NVS_KEY sets it at boot.
+// 0 = normal, 1 = low latency
+#define LINK_LOW_LATENCY        0
+#define LINK_LOW_LATENCY_NVS_KEY "lowlat"
+
+// Intercom group (0-15). The base encodes the party line once per frame
+// and sends it as one broadcast/multicast datagram to every pack; frames
+// carry the group ID and a per-group sequence number, and packets for
+// other groups are dropped. Base and packs must use the same group.
+#define INTERCOM_GROUP_ID       1
+
+// Send the downlink to a multicast group instead of the subnet broadcast
+// 0 = broadcast (255.255.255.255), 1 = multicast (packs join the group)
+#define DOWNLINK_MULTICAST_ENABLE   0
+#define DOWNLINK_MULTICAST_ADDR     "239.255.70.1"
+
 // Maximum packet size (bytes)
 #define MAX_PACKET_SIZE         512
 
 // Packet loss threshold for status warnings (percent)
 #define PACKET_LOSS_WARN_THRESHOLD  2.0f
 
+// End-to-end latency measurement: pings each peer once a second over the
+// control channel and logs per-stage times and a mouth-to-ear estimate
+// 0 = disabled, 1 = enabled (recommended)
+#define LATENCY_MEASURE_ENABLE  1
+
+// Loopback click test at boot: injects a click into the captured audio and
+// times its return (loop the far end's output into its input first)
+// 0 = disabled (normal use), 1 = enabled (bench measurement)
+#define LATENCY_LOOPBACK_ENABLE 0
+
+// Interval between loopback clicks (ms)
+#define LATENCY_LOOPBACK_INTERVAL_MS 2000
+
 //=============================================================================
 // LOGGING CONFIGURATION
 //=============================================================================
@@ -98,6 +379,34 @@
 // Stats display interval (milliseconds)
 #define STATS_INTERVAL_MS       5000
 
+// Per-stage timing traces (cycle counter): p50/p99/max per pipeline stage
+// in the status log and on CONTROL_MSG_METRICS_QUERY
+// 0 = disabled, 1 = enabled (recommended)
+#define TRACE_ENABLE            1
+
+// Samples kept per stage for the percentiles (~5 s of 20 ms frames)
+#define TRACE_RING_SAMPLES      256
+
+// Base: ask every pack for its metrics with each status print
+// 0 = disabled, 1 = enabled
+#define TRACE_QUERY_PEERS       0
+
+// Packet capture (system/packet_capture.c): flight recorder of every
+// datagram sent and received, dumped as pcap on the console
+// 0 = compiled out, 1 = recording from boot
+#define PACKET_CAPTURE_ENABLE   0
+
+// Ring size in PSRAM (needs CONFIG_SPIRAM), else in internal RAM
+#define PACKET_CAPTURE_PSRAM_BYTES      (1024 * 1024)
+#define PACKET_CAPTURE_INTERNAL_BYTES   (24 * 1024)
+
+// Bytes kept per datagram (headers plus the start of the Opus frame)
+#define PACKET_CAPTURE_SNAP_BYTES       128
+
+// Freeze this long after a jitter-buffer underrun (post-roll, milliseconds)
+// 0 = freeze on request only
+#define PACKET_CAPTURE_FREEZE_ON_UNDERRUN_MS    2000
+
 //=============================================================================
 // TEST MODE
 //=============================================================================
@@ -108,6 +417,28 @@
 // Set to 1 for testing, 0 for production
 #define TEST_MODE_ENABLE        1
 
+// Benchmark mode: run the audio hot-path benchmark (benchmark.c) at boot
+// instead of the intercom, log the results and idle
+// 0 = normal firmware, 1 = benchmark only
+#define BENCHMARK_MODE_ENABLE   0
+#define BENCHMARK_CORPUS_MS     1000    // Synthetic speech coded per configuration
+
+// Soak mode (base, TEST_MODE_ENABLE 0): the intercom runs normally but
+// hears virtual packs (soak_test.c) instead of the radio, added one per
+// step to find how many the base carries, then held for hours.
+// Build with the sdkconfig.soak fragment for CPU per core (README, Soak Mode).
+// 0 = normal firmware, 1 = soak
+#define SOAK_MODE_ENABLE        0
+#define SOAK_PACKS              MAX_PACKS   // Virtual packs at the top of the ramp
+#define SOAK_STEP_S             60      // Judged time per pack count
+#define SOAK_DURATION_H         8       // Hold at SOAK_PACKS (0 = until reset)
+#define SOAK_LOSS_PCT           2.0f    // Random frame loss per pack
+#define SOAK_JITTER_MS          30      // Delay per frame, uniform 0..this
+#define SOAK_DRIFT_PPM          50      // Pack clocks spread over +/- this
+#define SOAK_REPORT_S           60      // Hold report interval
+#define SOAK_CPU_LIMIT_PCT      85      // Busiest core above this fails a step
+#define SOAK_HEAP_FLOOR_BYTES   (16 * 1024)  // Heap minimum below this fails a step
+
 //=============================================================================
 // GPIO PIN ASSIGNMENTS (ESP32-S3)
 //=============================================================================
@@ -121,6 +452,7 @@
 // I2C (Audio Codec Control)
 #define I2C_SDA_PIN             GPIO_NUM_4   // I2C data
 #define I2C_SCL_PIN             GPIO_NUM_5   // I2C clock
+#define I2C_CLOCK_HZ            400000       // WM8960 control port is fast-mode (400 kHz)
 
 // LEDs (all devices)
 #define LED_POWER_PIN           GPIO_NUM_10
@@ -129,6 +461,32 @@
 
 // Device-specific pins (MCLK, buttons, etc) defined in config_base.h and config_pack.h
 
+//=============================================================================
+// ADC SERVICE
+//=============================================================================
+
+// One continuous (DMA) scan of every ADC1 channel in use - battery and
+// volume pot on the pack, party-line call detect on the base - read by
+// one task (hardware/adc_service.c). Total conversion rate across the
+// scanned channels, in Hz (ESP32-S3 minimum 611)
+#define ADC_SERVICE_SAMPLE_HZ   1000
+
+// Hardware IIR smoothing on each channel (ADC_DIGI_IIR_FILTER_COEFF_2..64)
+#define ADC_SERVICE_IIR_COEFF   ADC_DIGI_IIR_FILTER_COEFF_16
+
+// DMA conversion frame and result pool, in bytes (4 per conversion). The
+// pool keeps the newest conversions, so a read averages at most this much
+#define ADC_SERVICE_FRAME_BYTES 128
+#define ADC_SERVICE_POOL_BYTES  512
+
+// Threshold subscribers are polled at this period where the chip has no
+// digital threshold monitor (ms)
+#define ADC_SERVICE_POLL_MS     50
+
+// While the scan is suspended for light sleep, periodic subscribers at
+// least this slow (ms) still get values from a one-frame burst
+#define ADC_SERVICE_SUSPENDED_MIN_MS 1000
+
 //=============================================================================
 // TIMING CONSTANTS
 //=============================================================================
@@ -137,8 +495,37 @@
 // If no remote call signal received within this time, clear remote call state
 #define CALL_TIMEOUT_MS         2000
 
-// Network reconnect delay (milliseconds)
-#define WIFI_RECONNECT_DELAY_MS 2000
+// Pack reconnect: the first retry goes out straight away, later ones
+// back off (doubling) up to the maximum, in milliseconds
+#define WIFI_RECONNECT_MIN_MS   20
+#define WIFI_RECONNECT_MAX_MS   1000
+
+// Fast reconnect: the AP's BSSID and channel are cached in NVS on every
+// association and the pack associates to them directly, with no scan (the
+// driver keeps the PMK with its stored config, so no PSK derivation
+// either). After WIFI_FAST_RECONNECT_TRIES failed attempts the cache is
+// set aside and the pack scans for any AP with WIFI_SSID (roaming).
+#define WIFI_FAST_RECONNECT_ENABLE 1
+#define WIFI_FAST_RECONNECT_TRIES  3
+#define WIFI_CACHE_NVS_NAMESPACE "wifi_link"
+#define WIFI_CACHE_NVS_KEY       "ap"
+
+// Run-time settings (system/settings.c): encoder ceilings, jitter depth,
+// limiter, gains, AP channel and the link options, each defaulting to its
+// build value in these files. Saved values live in NVS under
+// SETTINGS_NVS_NAMESPACE (the link options keep their TRANSPORT_NVS_*
+// keys) and are applied at boot; changes take effect live unless marked
+// [reboot]. Read and written from the serial console (commands "settings",
+// "get", "set", "try", "reset", "remote") and from other devices over
+// CONTROL_MSG_SETTING. Anything that sizes a buffer - FRAME_SIZE_MS, the
+// jitter buffer capacity - stays compile-time.
+#define SETTINGS_NVS_NAMESPACE  "settings"
+#define SETTINGS_CONSOLE_ENABLE 1
+#define SETTINGS_BITRATE_MAX    64000   // Highest bitrate ceiling accepted (bps)
+
+// Longest the audio engine waits at boot for the link (AP started on the
+// base, associated with an address on the pack) before starting without it
+#define STARTUP_LINK_TIMEOUT_MS 5000
 
 // Watchdog timeout (seconds)
 #define WATCHDOG_TIMEOUT_SEC    10
@@ -26,6 +26,14 @@
 // Base station IP to connect to
 #define BASE_STATION_IP         "192.168.4.1"
 
+//=============================================================================
+// MEMORY
+//=============================================================================
+
+// Internal-SRAM arena (see MEMORY in config_common.h): one Opus encoder and
+// decoder, the receive queue and jitter buffer
+#define MEM_ARENA_FAST_BYTES    (64 * 1024)
+
 //=============================================================================
 // AUDIO CONFIGURATION (Belt Pack Specific)
 //=============================================================================
@@ -44,6 +52,11 @@
 // 0.0 = none, 0.3 = typical, 1.0 = full volume
 #define SIDETONE_LEVEL          0.3f
 
+// Power the capture path (codec ADCs, I2S RX) down while PTT is off, so
+// a listening pack only decodes; PTT brings it back within a frame
+// 0 = capture always on, 1 = listen only (recommended on battery)
+#define LISTEN_CAPTURE_OFF      1
+
 //=============================================================================
 // PTT BUTTON CONFIGURATION
 //=============================================================================
@@ -55,6 +68,7 @@
 // Set PTT_TIMEOUT_ENABLE to 0 to disable (operator may need unlimited TX)
 #define PTT_TIMEOUT_ENABLE      1
 #define PTT_TIMEOUT_SECONDS     300     // 5 minutes
+#define PTT_TIMEOUT_WARN_SECONDS 10     // Warning tone this long before the cut
 
 // Button debounce time (milliseconds)
 #define BUTTON_DEBOUNCE_MS      20
@@ -117,6 +131,9 @@
 // AUDIO TONE CONFIGURATION
 //=============================================================================
 
+// Alerts are queued with audio_tones_play_pattern() and summed into the
+// headset playout by the audio engine, over whatever is being received
+
 // Tone structure definition
 typedef struct {
     uint16_t frequency_hz;          // Tone frequency
@@ -131,6 +148,10 @@ typedef struct {
 #define TONE_BATTERY_LOW_ENABLE     1
 #define TONE_BATTERY_CRITICAL_ENABLE 1
 #define TONE_CALL_ENABLE            1
+#define TONE_PTT_TIMEOUT_ENABLE     1
+
+// Peak level of every alert (0.0 to 1.0 of full scale)
+#define TONE_LEVEL                  0.3f
 
 // Tone definitions
 // Connected to base station
@@ -165,12 +186,20 @@ static const tone_config_t TONE_BATTERY_CRITICAL = {
     .repeat_interval_ms = 150
 };
 
-// Call button pressed / call received
+// Call button pressed / call received (ring-ring cadence)
 static const tone_config_t TONE_CALL = {
     .frequency_hz = 1000,
     .duration_ms = 200,
-    .repeat_count = 1,
-    .repeat_interval_ms = 0
+    .repeat_count = 2,
+    .repeat_interval_ms = 100
+};
+
+// PTT held close to PTT_TIMEOUT_SECONDS - about to be forced idle
+static const tone_config_t TONE_PTT_TIMEOUT = {
+    .frequency_hz = 1200,
+    .duration_ms = 80,
+    .repeat_count = 4,
+    .repeat_interval_ms = 80
 };
 
 //=============================================================================
@@ -204,14 +233,23 @@ static const tone_config_t TONE_CALL = {
 // How often to repeat warning tone when battery is critical
 #define BATTERY_CRITICAL_WARN_INTERVAL 60
 
-// Enable light sleep mode
+// Enable light sleep mode (ESP-IDF auto light sleep, CONFIG_PM_ENABLE)
 // 0 = disabled, 1 = enabled
 #define ENABLE_LIGHT_SLEEP          1
 
 // Light sleep timeout (seconds)
-// Enter light sleep after this long without receiving packets
+// Stop audio after this long without receiving packets, so the chip can
+// light-sleep between WiFi beacons; voice, a button or an alert restarts it
 #define LIGHT_SLEEP_TIMEOUT_SEC     90
 
+// CPU clock ceiling per power state (MHz, dynamic frequency scaling).
+// The audio engine runs each frame at the ceiling and the core drops to
+// POWER_MIN_CPU_MHZ (or what the drivers hold) in between
+#define POWER_TALK_CPU_MHZ          240   // Encode + echo cancel + decode
+#define POWER_LISTEN_CPU_MHZ        160   // Decode (+ echo cancel without LISTEN_CAPTURE_OFF)
+#define POWER_IDLE_CPU_MHZ          80    // Audio stopped
+#define POWER_MIN_CPU_MHZ           40    // XTAL
+
 // Enable deep sleep mode
 // 0 = disabled, 1 = enabled
 #define ENABLE_DEEP_SLEEP           1
@@ -0,0 +1,635 @@
+/**
+ * @file adc_service.c
+ * @brief Shared ADC1 Sampling Service Implementation
+ *
+ * The DMA ADC driver scans every subscribed channel round-robin at
+ * ADC_SERVICE_SAMPLE_HZ into a pool that keeps the newest conversions.
+ * The service task sleeps until the next subscriber is due (or a threshold
+ * monitor fires), drains the pool into one mean per channel, and runs the
+ * subscribers' EMAs and threshold state machines. Callbacks run in the
+ * service task, outside the service lock.
+ *
+ * The threshold monitor interrupt repeats while the level stays beyond
+ * its threshold, so each monitor is armed for one side only - the side
+ * the committed state would cross to - and disarmed while a crossing is
+ * being debounced by the task's own timer.
+ *
+ * The DMA driver holds the APB lock while it scans, which rules out light
+ * sleep. Suspended, the scan is stopped; periodic subscribers with an
+ * interval of at least ADC_SERVICE_SUSPENDED_MIN_MS are still served by a
+ * one-frame burst when they fall due, everything else waits for resume.
+ */
+
+#include "adc_service.h"
+#include "../config.h"
+#include "../system/task_map.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_filter.h"
+#include "esp_adc/adc_monitor.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "ADC";
+
+#define ADC_SERVICE_MAX_CHANNELS 4
+#define ADC_SERVICE_MAX_SUBS     6
+#define ADC_FULL_SCALE_MV        3300
+#define ADC_FULL_SCALE_RAW       4095
+
+#if SOC_ADC_DIG_IIR_FILTER_SUPPORTED
+#define ADC_FILTERS             SOC_ADC_DIGI_IIR_FILTER_NUM
+#else
+#define ADC_FILTERS             0
+#endif
+
+#if SOC_ADC_MONITOR_SUPPORTED
+#define ADC_MONITORS            SOC_ADC_DIGI_MONITOR_NUM
+#else
+#define ADC_MONITORS            0
+#endif
+
+// One conversion frame at the scan rate, plus a tick of margin
+#define ADC_BURST_MS            (ADC_SERVICE_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES * 1000 / \
+                                 ADC_SERVICE_SAMPLE_HZ + 1000 / configTICK_RATE_HZ)
+
+#define MONITOR_ARM_HIGH        0x01
+#define MONITOR_ARM_LOW         0x02
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef struct {
+    adc_service_subscription_t cfg;
+    bool     active;
+    bool     seeded;
+    int32_t  ema_q8;             // Filtered value, mV << 8
+    int64_t  next_value_us;      // Next on_value (0 = none)
+    bool     above;              // Committed threshold side
+    int64_t  pending_us;         // Debounce deadline (0 = level agrees)
+    int64_t  wake_us;            // Next time the task must look (0 = only on a monitor event)
+    int      monitor;            // Monitor slot, -1 = polled
+} subscriber_t;
+
+typedef struct {
+    adc_service_value_cb_t on_value;
+    adc_service_cross_cb_t on_cross;
+    bool     above;
+    int      millivolts;
+    void    *ctx;
+} pending_call_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static SemaphoreHandle_t service_mutex = NULL;
+static TaskHandle_t service_task = NULL;
+static volatile bool running = false;
+static bool suspended = false;           // Scan stopped (under service_mutex)
+
+static adc_continuous_handle_t adc = NULL;
+static adc_channel_t channels[ADC_SERVICE_MAX_CHANNELS];
+static int channel_mv[ADC_SERVICE_MAX_CHANNELS];        // Newest mean, -1 = no data
+static int channel_count = 0;
+
+static subscriber_t subs[ADC_SERVICE_MAX_SUBS];
+static int sub_count = 0;
+
+static uint8_t read_buf[ADC_SERVICE_FRAME_BYTES];
+
+#if ADC_FILTERS
+static adc_iir_filter_handle_t filters[ADC_FILTERS];
+#endif
+#if ADC_MONITORS
+static adc_monitor_handle_t monitors[ADC_MONITORS];
+static volatile uint8_t monitor_arm[ADC_MONITORS];
+#endif
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static int channel_index(adc_channel_t channel)
+{
+    for (int i = 0; i < channel_count; i++) {
+        if (channels[i] == channel) return i;
+    }
+    return -1;
+}
+
+static int mv_to_raw(int millivolts)
+{
+    if (millivolts <= 0) return 0;
+    if (millivolts >= ADC_FULL_SCALE_MV) return ADC_FULL_SCALE_RAW;
+    return millivolts * ADC_FULL_SCALE_RAW / ADC_FULL_SCALE_MV;
+}
+
+#if ADC_MONITORS
+static IRAM_ATTR bool monitor_wake(int slot, uint8_t side)
+{
+    if (!(monitor_arm[slot] & side)) {
+        return false;
+    }
+    monitor_arm[slot] = 0;
+
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(service_task, &woken);
+    return woken == pdTRUE;
+}
+
+static IRAM_ATTR bool on_over_high(adc_monitor_handle_t monitor,
+                                   const adc_monitor_evt_data_t *data, void *ctx)
+{
+    return monitor_wake((int)(intptr_t)ctx, MONITOR_ARM_HIGH);
+}
+
+static IRAM_ATTR bool on_below_low(adc_monitor_handle_t monitor,
+                                   const adc_monitor_evt_data_t *data, void *ctx)
+{
+    return monitor_wake((int)(intptr_t)ctx, MONITOR_ARM_LOW);
+}
+#endif
+
+// Called with service_mutex held
+static void release_driver(void)
+{
+    if (!adc) return;
+
+    adc_continuous_stop(adc);
+#if ADC_MONITORS
+    for (int i = 0; i < ADC_MONITORS; i++) {
+        monitor_arm[i] = 0;
+        if (monitors[i]) {
+            adc_continuous_monitor_disable(monitors[i]);
+            adc_del_continuous_monitor(monitors[i]);
+            monitors[i] = NULL;
+        }
+    }
+#endif
+#if ADC_FILTERS
+    for (int i = 0; i < ADC_FILTERS; i++) {
+        if (filters[i]) {
+            adc_continuous_iir_filter_disable(filters[i]);
+            adc_del_continuous_iir_filter(filters[i]);
+            filters[i] = NULL;
+        }
+    }
+#endif
+    adc_continuous_deinit(adc);
+    adc = NULL;
+}
+
+// (Re)build the scan for the current channels and subscribers. Called
+// with service_mutex held
+static esp_err_t configure_driver(void)
+{
+    release_driver();
+    if (channel_count == 0) {
+        return ESP_OK;
+    }
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+        .max_store_buf_size = ADC_SERVICE_POOL_BYTES,
+        .conv_frame_size = ADC_SERVICE_FRAME_BYTES,
+        .flags.flush_pool = 1,       // Full pool: keep the newest
+    };
+    esp_err_t ret = adc_continuous_new_handle(&handle_cfg, &adc);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Continuous ADC init failed: %s", esp_err_to_name(ret));
+        adc = NULL;
+        return ret;
+    }
+
+    adc_digi_pattern_config_t pattern[ADC_SERVICE_MAX_CHANNELS];
+    for (int i = 0; i < channel_count; i++) {
+        pattern[i] = (adc_digi_pattern_config_t){
+            .atten = ADC_ATTEN_DB_12,          // 0-3.3V range
+            .channel = channels[i],
+            .unit = ADC_UNIT_1,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+        };
+    }
+    adc_continuous_config_t scan_cfg = {
+        .pattern_num = channel_count,
+        .adc_pattern = pattern,
+        .sample_freq_hz = ADC_SERVICE_SAMPLE_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = ADC_DIGI_OUTPUT_FORMAT_TYPE2,
+    };
+    ret = adc_continuous_config(adc, &scan_cfg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Scan config failed: %s", esp_err_to_name(ret));
+        release_driver();
+        return ret;
+    }
+
+#if ADC_FILTERS
+    for (int i = 0; i < channel_count && i < ADC_FILTERS; i++) {
+        adc_continuous_iir_filter_config_t filter_cfg = {
+            .unit = ADC_UNIT_1,
+            .channel = channels[i],
+            .coeff = ADC_SERVICE_IIR_COEFF,
+        };
+        if (adc_new_continuous_iir_filter(adc, &filter_cfg, &filters[i]) == ESP_OK) {
+            adc_continuous_iir_filter_enable(filters[i]);
+        } else {
+            filters[i] = NULL;
+            ESP_LOGW(TAG, "No IIR filter for channel %d", (int)channels[i]);
+        }
+    }
+#endif
+
+    int monitor_count = 0;
+    for (int i = 0; i < sub_count; i++) {
+        subscriber_t *s = &subs[i];
+        s->monitor = -1;
+        if (!s->active || !s->cfg.on_cross || s->cfg.threshold_mv <= 0) continue;
+#if ADC_MONITORS
+        if (monitor_count >= ADC_MONITORS) continue;
+
+        adc_monitor_config_t monitor_cfg = {
+            .adc_unit = ADC_UNIT_1,
+            .channel = s->cfg.channel,
+            .h_threshold = mv_to_raw(s->cfg.threshold_mv + s->cfg.hysteresis_mv),
+            .l_threshold = mv_to_raw(s->cfg.threshold_mv - s->cfg.hysteresis_mv),
+        };
+        adc_monitor_evt_cbs_t monitor_cbs = {
+            .on_over_high_thresh = on_over_high,
+            .on_below_low_thresh = on_below_low,
+        };
+        adc_monitor_handle_t monitor = NULL;
+        if (adc_new_continuous_monitor(adc, &monitor_cfg, &monitor) != ESP_OK) continue;
+        adc_continuous_monitor_register_event_callbacks(monitor, &monitor_cbs,
+                                                        (void *)(intptr_t)monitor_count);
+        adc_continuous_monitor_enable(monitor);
+        monitors[monitor_count] = monitor;
+        s->monitor = monitor_count++;
+#endif
+    }
+
+    ret = suspended ? ESP_OK : adc_continuous_start(adc);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Scan start failed: %s", esp_err_to_name(ret));
+        release_driver();
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Scanning %d channel%s at %d Hz (%d monitored)", channel_count,
+             channel_count == 1 ? "" : "s", ADC_SERVICE_SAMPLE_HZ, monitor_count);
+    return ESP_OK;
+}
+
+// Empty the pool into one mean per channel. Called with service_mutex held
+static void drain(void)
+{
+    if (!adc) return;
+
+    uint32_t sum[ADC_SERVICE_MAX_CHANNELS] = {0};
+    uint32_t count[ADC_SERVICE_MAX_CHANNELS] = {0};
+    uint32_t got = 0;
+
+    while (adc_continuous_read(adc, read_buf, sizeof(read_buf), &got, 0) == ESP_OK && got > 0) {
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= got; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t *d = (const adc_digi_output_data_t *)&read_buf[i];
+            int idx = channel_index((adc_channel_t)d->type2.channel);
+            if (idx < 0) continue;
+            sum[idx] += d->type2.data;
+            count[idx]++;
+        }
+    }
+
+    for (int i = 0; i < channel_count; i++) {
+        if (count[i] > 0) {
+            channel_mv[i] = (int)(sum[i] / count[i]) * ADC_FULL_SCALE_MV / ADC_FULL_SCALE_RAW;
+        }
+    }
+}
+
+// Still served, by bursts, while the scan is suspended
+static bool served_while_suspended(const subscriber_t *s)
+{
+    return s->active && s->cfg.on_value && s->cfg.interval_ms >= ADC_SERVICE_SUSPENDED_MIN_MS;
+}
+
+// Suspended: run the scan for one frame if a served subscriber is due.
+// Called with service_mutex held
+static void burst_if_due(int64_t now)
+{
+    bool due = false;
+    for (int i = 0; i < sub_count; i++) {
+        if (served_while_suspended(&subs[i]) && now >= subs[i].next_value_us) {
+            due = true;
+        }
+    }
+    if (!due || !adc) return;
+
+    if (adc_continuous_start(adc) != ESP_OK) return;
+    vTaskDelay(pdMS_TO_TICKS(ADC_BURST_MS));
+    drain();
+    adc_continuous_stop(adc);
+}
+
+static int64_t earliest(int64_t a, int64_t b)
+{
+    if (a == 0) return b;
+    if (b == 0) return a;
+    return a < b ? a : b;
+}
+
+// One subscriber's EMA and threshold state. Called with service_mutex held
+static void service_subscriber(subscriber_t *s, int64_t now, pending_call_t *calls, int *n)
+{
+    s->wake_us = 0;
+    if (!s->active) return;
+
+    int idx = channel_index(s->cfg.channel);
+    int mv = idx >= 0 ? channel_mv[idx] : -1;
+    if (mv < 0) {
+        s->wake_us = now + (int64_t)ADC_SERVICE_POLL_MS * 1000;   // No data yet
+        return;
+    }
+
+    if (s->cfg.on_value && s->cfg.interval_ms > 0) {
+        if (now >= s->next_value_us) {
+            if (!s->seeded) {
+                s->ema_q8 = mv << 8;
+                s->seeded = true;
+            } else {
+                s->ema_q8 += ((mv << 8) - s->ema_q8) >> s->cfg.ema_shift;
+            }
+            calls[(*n)++] = (pending_call_t){ .on_value = s->cfg.on_value,
+                                              .millivolts = s->ema_q8 >> 8,
+                                              .ctx = s->cfg.ctx };
+
+            int64_t interval_us = (int64_t)s->cfg.interval_ms * 1000;
+            s->next_value_us += interval_us;
+            if (s->next_value_us <= now) {
+                s->next_value_us = now + interval_us;
+            }
+        }
+        s->wake_us = s->next_value_us;
+    }
+
+    if (s->cfg.on_cross && s->cfg.threshold_mv > 0) {
+        bool level = s->above ? mv > s->cfg.threshold_mv - s->cfg.hysteresis_mv
+                              : mv >= s->cfg.threshold_mv + s->cfg.hysteresis_mv;
+        if (level == s->above) {
+            s->pending_us = 0;
+        } else {
+            if (s->pending_us == 0) {
+                s->pending_us = now + (int64_t)s->cfg.debounce_ms * 1000;
+            }
+            if (now >= s->pending_us) {
+                s->above = level;
+                s->pending_us = 0;
+                calls[(*n)++] = (pending_call_t){ .on_cross = s->cfg.on_cross,
+                                                  .above = level, .millivolts = mv,
+                                                  .ctx = s->cfg.ctx };
+            }
+        }
+
+        s->wake_us = earliest(s->wake_us, s->pending_us);
+#if ADC_MONITORS
+        if (s->monitor >= 0) {
+            monitor_arm[s->monitor] = s->pending_us ? 0
+                                    : (s->above ? MONITOR_ARM_LOW : MONITOR_ARM_HIGH);
+        } else
+#endif
+        {
+            s->wake_us = earliest(s->wake_us, now + (int64_t)ADC_SERVICE_POLL_MS * 1000);
+        }
+    }
+}
+
+static void adc_service_task(void *arg)
+{
+    ESP_LOGI(TAG, "ADC service task started");
+    TickType_t wait = 0;
+
+    while (running) {
+        ulTaskNotifyTake(pdTRUE, wait);
+        if (!running) break;
+
+        pending_call_t calls[ADC_SERVICE_MAX_SUBS * 2];
+        int n = 0;
+        int64_t wake_us = 0;
+
+        xSemaphoreTake(service_mutex, portMAX_DELAY);
+        if (suspended) {
+            burst_if_due(esp_timer_get_time());
+        } else {
+            drain();
+        }
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < sub_count; i++) {
+            if (suspended && !served_while_suspended(&subs[i])) {
+                subs[i].wake_us = 0;
+                continue;
+            }
+            service_subscriber(&subs[i], now, calls, &n);
+            wake_us = earliest(wake_us, subs[i].wake_us);
+        }
+        xSemaphoreGive(service_mutex);
+
+        for (int i = 0; i < n; i++) {
+            if (calls[i].on_cross) {
+                calls[i].on_cross(calls[i].above, calls[i].millivolts, calls[i].ctx);
+            } else {
+                calls[i].on_value(calls[i].millivolts, calls[i].ctx);
+            }
+        }
+
+        if (wake_us == 0) {
+            wait = portMAX_DELAY;                  // Monitor events only
+        } else {
+            int64_t delta_us = wake_us - esp_timer_get_time();
+            wait = delta_us > 0 ? pdMS_TO_TICKS((delta_us + 999) / 1000) : 0;
+            if (delta_us > 0 && wait == 0) wait = 1;
+        }
+    }
+
+    ESP_LOGI(TAG, "ADC service task stopped");
+    task_map_exit(TASK_ADC);
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t adc_service_subscribe(const adc_service_subscription_t *sub, int *id)
+{
+    if (!sub || (!sub->on_value && !sub->on_cross)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!service_mutex) {
+        service_mutex = xSemaphoreCreateMutex();
+        if (!service_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+
+    if (sub_count >= ADC_SERVICE_MAX_SUBS) {
+        xSemaphoreGive(service_mutex);
+        ESP_LOGE(TAG, "Subscriber table full");
+        return ESP_ERR_NO_MEM;
+    }
+
+    bool new_channel = channel_index(sub->channel) < 0;
+    if (new_channel) {
+        if (channel_count >= ADC_SERVICE_MAX_CHANNELS) {
+            xSemaphoreGive(service_mutex);
+            ESP_LOGE(TAG, "Channel table full");
+            return ESP_ERR_NO_MEM;
+        }
+        channels[channel_count] = sub->channel;
+        channel_mv[channel_count] = -1;
+        channel_count++;
+    }
+
+    int index = sub_count++;
+    subs[index] = (subscriber_t){
+        .cfg = *sub,
+        .active = true,
+        .next_value_us = esp_timer_get_time(),
+        .monitor = -1,
+    };
+
+    esp_err_t ret = configure_driver();
+    if (ret != ESP_OK) {
+        // Back to the previous scan
+        sub_count--;
+        if (new_channel) channel_count--;
+        configure_driver();
+        xSemaphoreGive(service_mutex);
+        return ret;
+    }
+
+    if (!running) {
+        running = true;
+        ret = task_map_create(TASK_ADC, adc_service_task, NULL, &service_task);
+        if (ret != ESP_OK) {
+            running = false;
+            xSemaphoreGive(service_mutex);
+            return ret;
+        }
+    }
+    xSemaphoreGive(service_mutex);
+
+    // New wake times (and monitors to arm)
+    xTaskNotifyGive(service_task);
+
+    if (id) {
+        *id = index;
+    }
+    return ESP_OK;
+}
+
+void adc_service_unsubscribe(int id)
+{
+    if (!service_mutex || id < 0) return;
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+    if (id < sub_count) {
+        subs[id].active = false;
+#if ADC_MONITORS
+        if (subs[id].monitor >= 0) {
+            monitor_arm[subs[id].monitor] = 0;
+        }
+#endif
+    }
+    xSemaphoreGive(service_mutex);
+}
+
+void adc_service_rearm(int id)
+{
+    if (!service_mutex || id < 0) return;
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+    if (id < sub_count) {
+        subs[id].above = false;
+        subs[id].pending_us = 0;
+    }
+    xSemaphoreGive(service_mutex);
+
+    if (running) {
+        xTaskNotifyGive(service_task);
+    }
+}
+
+int adc_service_read_mv(adc_channel_t channel)
+{
+    if (!service_mutex) return -1;
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+    drain();
+    int idx = channel_index(channel);
+    int mv = idx >= 0 ? channel_mv[idx] : -1;
+    xSemaphoreGive(service_mutex);
+
+    return mv;
+}
+
+esp_err_t adc_service_suspend(bool suspend)
+{
+    if (!service_mutex) return ESP_OK;
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+    esp_err_t ret = ESP_OK;
+    if (suspend != suspended) {
+        if (adc) {
+            ret = suspend ? adc_continuous_stop(adc) : adc_continuous_start(adc);
+        }
+        if (ret == ESP_OK) {
+            suspended = suspend;
+            ESP_LOGI(TAG, "Scan %s", suspend ? "suspended" : "resumed");
+        }
+    }
+    xSemaphoreGive(service_mutex);
+
+    // New wake times
+    if (running) {
+        xTaskNotifyGive(service_task);
+    }
+    return ret;
+}
+
+bool adc_service_has_channel(adc_channel_t channel)
+{
+    if (!service_mutex) return false;
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+    bool found = channel_index(channel) >= 0;
+    xSemaphoreGive(service_mutex);
+
+    return found;
+}
+
+void adc_service_deinit(void)
+{
+    if (!service_mutex) return;
+
+    if (running) {
+        running = false;
+        xTaskNotifyGive(service_task);
+        vTaskDelay(pdMS_TO_TICKS(100));  // Let the task exit
+        service_task = NULL;
+    }
+
+    xSemaphoreTake(service_mutex, portMAX_DELAY);
+    release_driver();
+    sub_count = 0;
+    channel_count = 0;
+    xSemaphoreGive(service_mutex);
+
+    ESP_LOGI(TAG, "ADC service stopped");
+}
@@ -0,0 +1,114 @@
+/**
+ * @file adc_service.h
+ * @brief Shared ADC1 Sampling Service
+ *
+ * Every ADC1 channel the firmware reads (battery and volume pot on the
+ * pack, party-line call detect on the base) is scanned continuously by the
+ * DMA ADC driver, smoothed by the hardware IIR filter, and read by one
+ * task. Consumers subscribe instead of polling: each gets its filtered
+ * value at its own period, with its own EMA, and/or a debounced callback
+ * when the level crosses a threshold. Where the chip has a digital
+ * threshold monitor, a threshold-only subscriber costs no wakeups until
+ * the level actually crosses.
+ *
+ * Values are in millivolts at the pin (12 dB attenuation, 0-3.3 V,
+ * uncalibrated).
+ */
+
+#ifndef ADC_SERVICE_H
+#define ADC_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+/**
+ * @brief Periodic value callback (ADC service task)
+ * @param millivolts Subscriber's filtered value
+ * @param ctx Subscriber context
+ */
+typedef void (*adc_service_value_cb_t)(int millivolts, void *ctx);
+
+/**
+ * @brief Threshold crossing callback (ADC service task)
+ * @param above true if the level is now above the threshold
+ * @param millivolts Level that confirmed the crossing
+ * @param ctx Subscriber context
+ */
+typedef void (*adc_service_cross_cb_t)(bool above, int millivolts, void *ctx);
+
+typedef struct {
+    adc_channel_t channel;           // ADC1 channel
+    uint32_t interval_ms;            // on_value period (0 = no periodic value)
+    uint8_t  ema_shift;              // EMA weight 1/2^shift per period (0 = none)
+    adc_service_value_cb_t on_value;
+    int      threshold_mv;           // > 0 enables on_cross
+    int      hysteresis_mv;          // Either side of the threshold
+    uint32_t debounce_ms;            // Level must hold this long
+    adc_service_cross_cb_t on_cross;
+    void    *ctx;
+} adc_service_subscription_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Subscribe to a channel (starts the service on first use)
+ *
+ * A new channel reconfigures the scan, so subscribe at init rather than
+ * while latency matters. The first on_value comes with the first samples.
+ * @param sub Subscription (copied)
+ * @param id Optional subscription id output, for adc_service_unsubscribe
+ * @return ESP_OK, ESP_ERR_NO_MEM if the subscriber or channel table is full
+ */
+esp_err_t adc_service_subscribe(const adc_service_subscription_t *sub, int *id);
+
+/**
+ * @brief Stop a subscription's callbacks (its channel stays in the scan)
+ */
+void adc_service_unsubscribe(int id);
+
+/**
+ * @brief Start a threshold subscription over from "below", without a callback
+ *
+ * For a level the subscriber could not trust for a while (e.g. its own
+ * signal was on the line): a level still above is reported again after
+ * the debounce.
+ */
+void adc_service_rearm(int id);
+
+/**
+ * @brief Read a scanned channel now (mean of the newest conversions)
+ * @return Millivolts, or -1 if the channel is not scanned or has no data yet
+ */
+int adc_service_read_mv(adc_channel_t channel);
+
+/**
+ * @brief Stop or restart the scan, keeping every subscription
+ *
+ * The DMA scan keeps the chip out of light sleep. Suspended, periodic
+ * subscribers with an interval of at least ADC_SERVICE_SUSPENDED_MIN_MS
+ * are served by a short burst of conversions when due; faster ones and
+ * threshold subscribers wait for resume, and adc_service_read_mv returns
+ * the last value.
+ * @return ESP_OK, or the driver's error if the scan would not stop/start
+ */
+esp_err_t adc_service_suspend(bool suspend);
+
+/**
+ * @brief Check if a channel is in the scan
+ */
+bool adc_service_has_channel(adc_channel_t channel);
+
+/**
+ * @brief Stop the scan and the service task, drop all subscriptions
+ */
+void adc_service_deinit(void);
+
+#endif // ADC_SERVICE_H
@@ -1,6 +1,9 @@
 /**
  * @file battery.c
  * @brief Battery Monitoring Implementation
+ *
+ * The battery divider is one channel of the shared ADC scan
+ * (adc_service.c), delivered every BATTERY_CHECK_INTERVAL_SEC.
  */
 
 #include "battery.h"
@@ -8,10 +11,8 @@
 
 #if DEVICE_TYPE_PACK
 
-#include "esp_adc/adc_oneshot.h"
+#include "adc_service.h"
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 
 static const char *TAG = "BATTERY";
 
@@ -20,12 +21,11 @@ static const char *TAG = "BATTERY";
 //=============================================================================
 
 static bool initialized = false;
-static adc_oneshot_unit_handle_t adc_handle = NULL;
 
 #if (BATTERY_MODE == BATTERY_INTERNAL)
 static bool running = false;
 static battery_callback_t user_callback = NULL;
-static TaskHandle_t battery_task_handle = NULL;
+static int subscription = -1;
 
 static float current_voltage = BATTERY_FULL_VOLTAGE;
 static uint8_t current_percent = 100;
@@ -54,69 +54,49 @@ static uint8_t voltage_to_percent(float voltage)
     return percent;
 }
 
-static float read_battery_voltage(void)
+static float pin_to_battery_voltage(int pin_mv)
 {
-    int adc_reading = 0;
-    esp_err_t ret = adc_oneshot_read(adc_handle, BATTERY_ADC_CHANNEL, &adc_reading);
-
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "ADC read failed: %d", ret);
-        return current_voltage;  // Return last known value
-    }
-
-    // Convert ADC reading to voltage
-    // ESP32-S3 ADC with ADC_ATTEN_DB_12: input range ~0-3.3V
-    // 12-bit resolution (0-4095)
-    // With voltage divider: Vbat = (ADC_reading / 4095) * 3.3V * divider_ratio
+    // ESP32-S3 ADC with ADC_ATTEN_DB_12: input range ~0-3.3V at the pin
+    // With voltage divider: Vbat = Vpin * divider_ratio
     // Assuming 2:1 voltage divider (adjust for your hardware)
     const float divider_ratio = 2.0f;
 
-    float voltage = (adc_reading / 4095.0f) * 3.3f * divider_ratio;
-
-    return voltage;
+    return (pin_mv / 1000.0f) * divider_ratio;
 }
 
-static void battery_task(void *arg)
+// ADC service task, every BATTERY_CHECK_INTERVAL_SEC
+static void battery_reading(int pin_mv, void *ctx)
 {
-    ESP_LOGI(TAG, "Battery monitoring task started");
-
-    while (running) {
-        // Read battery voltage
-        float voltage = read_battery_voltage();
-        uint8_t percent = voltage_to_percent(voltage);
-
-        // Check thresholds
-        bool was_low = is_low;
-        bool was_critical = is_critical;
+    if (!running) return;
 
-        is_low = (voltage <= BATTERY_LOW_VOLTAGE);
-        is_critical = (voltage <= BATTERY_CRITICAL_VOLTAGE);
+    float voltage = pin_to_battery_voltage(pin_mv);
+    uint8_t percent = voltage_to_percent(voltage);
 
-        // Update current values
-        current_voltage = voltage;
-        current_percent = percent;
+    // Check thresholds
+    bool was_low = is_low;
+    bool was_critical = is_critical;
 
-        // Log state changes
-        if (is_low && !was_low) {
-            ESP_LOGW(TAG, "Battery LOW: %.2fV (%d%%)", voltage, percent);
-        }
-        if (is_critical && !was_critical) {
-            ESP_LOGE(TAG, "Battery CRITICAL: %.2fV (%d%%)", voltage, percent);
-        }
+    is_low = (voltage <= BATTERY_LOW_VOLTAGE);
+    is_critical = (voltage <= BATTERY_CRITICAL_VOLTAGE);
 
-        // Call user callback
-        if (user_callback) {
-            user_callback(voltage, percent, is_low, is_critical);
-        }
+    // Update current values
+    current_voltage = voltage;
+    current_percent = percent;
 
-        ESP_LOGD(TAG, "Battery: %.2fV (%d%%)", voltage, percent);
+    // Log state changes
+    if (is_low && !was_low) {
+        ESP_LOGW(TAG, "Battery LOW: %.2fV (%d%%)", voltage, percent);
+    }
+    if (is_critical && !was_critical) {
+        ESP_LOGE(TAG, "Battery CRITICAL: %.2fV (%d%%)", voltage, percent);
+    }
 
-        // Wait before next reading
-        vTaskDelay(pdMS_TO_TICKS(BATTERY_CHECK_INTERVAL_SEC * 1000));
+    // Call user callback
+    if (user_callback) {
+        user_callback(voltage, percent, is_low, is_critical);
     }
 
-    ESP_LOGI(TAG, "Battery monitoring task stopped");
-    vTaskDelete(NULL);
+    ESP_LOGD(TAG, "Battery: %.2fV (%d%%)", voltage, percent);
 }
 #endif // BATTERY_MODE == BATTERY_INTERNAL
 
@@ -133,38 +113,26 @@ esp_err_t battery_init(battery_callback_t callback)
 
     ESP_LOGI(TAG, "Initializing battery (mode=%d)...", BATTERY_MODE);
 
-    // Always create the ADC unit handle -- volume control shares it
-    adc_oneshot_unit_init_cfg_t init_config = {
-        .unit_id = ADC_UNIT_1,
-    };
-
-    esp_err_t ret = adc_oneshot_new_unit(&init_config, &adc_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "ADC init failed: %d", ret);
-        return ret;
-    }
-
 #if (BATTERY_MODE == BATTERY_INTERNAL)
     user_callback = callback;
 
-    // Configure battery ADC channel (only needed for internal battery monitoring)
-    adc_oneshot_chan_cfg_t chan_config = {
-        .bitwidth = ADC_BITWIDTH_12,
-        .atten = ADC_ATTEN_DB_12,  // 0-3.3V range
+    // Scanned from init so the self-test can read it; readings are
+    // reported once battery_start() is called
+    adc_service_subscription_t reading = {
+        .channel = BATTERY_ADC_CHANNEL,
+        .interval_ms = BATTERY_CHECK_INTERVAL_SEC * 1000,
+        .on_value = battery_reading,
     };
-
-    ret = adc_oneshot_config_channel(adc_handle, BATTERY_ADC_CHANNEL, &chan_config);
+    esp_err_t ret = adc_service_subscribe(&reading, &subscription);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "ADC channel config failed: %d", ret);
-        adc_oneshot_del_unit(adc_handle);
-        adc_handle = NULL;
+        ESP_LOGE(TAG, "ADC subscribe failed: %s", esp_err_to_name(ret));
         return ret;
     }
 
     ESP_LOGI(TAG, "Battery monitoring initialized (ADC channel %d)", BATTERY_ADC_CHANNEL);
 #else
     (void)callback;  // Unused when not BATTERY_INTERNAL
-    ESP_LOGI(TAG, "ADC unit initialized (battery monitoring disabled, mode=%d)", BATTERY_MODE);
+    ESP_LOGI(TAG, "Battery monitoring disabled (mode=%d)", BATTERY_MODE);
 #endif
 
     initialized = true;
@@ -187,7 +155,6 @@ esp_err_t battery_start(void)
     ESP_LOGI(TAG, "Starting battery monitoring...");
 
     running = true;
-    xTaskCreate(battery_task, "battery", 4096, NULL, 2, &battery_task_handle);
 #endif
 
     return ESP_OK;
@@ -203,11 +170,6 @@ esp_err_t battery_stop(void)
     ESP_LOGI(TAG, "Stopping battery monitoring...");
 
     running = false;
-
-    if (battery_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        battery_task_handle = NULL;
-    }
 #endif
 
     return ESP_OK;
@@ -252,10 +214,14 @@ bool battery_is_critical(void)
 float battery_read_voltage_once(void)
 {
 #if (BATTERY_MODE == BATTERY_INTERNAL)
-    if (!initialized || !adc_handle) {
+    if (!initialized) {
+        return -1.0f;
+    }
+    int pin_mv = adc_service_read_mv(BATTERY_ADC_CHANNEL);
+    if (pin_mv < 0) {
         return -1.0f;
     }
-    return read_battery_voltage();
+    return pin_to_battery_voltage(pin_mv);
 #else
     return -1.0f;
 #endif
@@ -271,18 +237,13 @@ void battery_deinit(void)
 
     battery_stop();
 
-    if (adc_handle) {
-        adc_oneshot_del_unit(adc_handle);
-        adc_handle = NULL;
-    }
+#if (BATTERY_MODE == BATTERY_INTERNAL)
+    adc_service_unsubscribe(subscription);
+    subscription = -1;
+#endif
 
     initialized = false;
     ESP_LOGI(TAG, "Battery deinitialized");
 }
 
-void *battery_get_adc_handle(void)
-{
-    return (void *)adc_handle;
-}
-
 #endif // DEVICE_TYPE_PACK
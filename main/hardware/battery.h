@@ -38,13 +38,13 @@ typedef void (*battery_callback_t)(float voltage, uint8_t percent,
 esp_err_t battery_init(battery_callback_t callback);
 
 /**
- * @brief Start battery monitoring task
+ * @brief Start battery status reports (from the ADC service)
  * @return ESP_OK on success
  */
 esp_err_t battery_start(void);
 
 /**
- * @brief Stop battery monitoring task
+ * @brief Stop battery status reports
  * @return ESP_OK on success
  */
 esp_err_t battery_stop(void);
@@ -84,15 +84,4 @@ float battery_read_voltage_once(void);
  */
 void battery_deinit(void);
 
-/**
- * @brief Get the ADC unit handle used by battery monitoring
- *
- * Other modules that need ADC1 channels (e.g., volume control) can
- * share this handle instead of creating a second one (ESP-IDF only
- * allows one handle per ADC unit).
- *
- * @return ADC oneshot unit handle, or NULL if not initialized
- */
-void *battery_get_adc_handle(void);
-
 #endif // BATTERY_H
\ No newline at end of file
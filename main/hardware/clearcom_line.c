@@ -1,6 +1,11 @@
 /**
  * @file clearcom_line.c
  * @brief Party Line Interface Implementation
+ *
+ * The input filter meters its frame in the same pass that filters it;
+ * the gate's VAD then classifies that level (before the gate, so the
+ * gate never hides speech from itself) and sets the gate for the next
+ * frame. The VAD's hangover holds it open through word endings.
  */
 
 #include "clearcom_line.h"
@@ -10,12 +15,12 @@
 
 #include "../audio/audio_codec.h"
 #include "../audio/audio_processor.h"
+#include "../audio/audio_vad.h"
 #include "../system/call_module.h"
+#include "adc_service.h"
 #include "esp_log.h"
-#include "esp_adc/adc_oneshot.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -29,31 +34,23 @@ static bool initialized = false;
 static bool running = false;
 static clearcom_line_status_t status = {0};
 
+// Input filter (audio engine task)
+static audio_line_filter_t input_filter;
+static audio_vad_t gate_vad;
+static bool gate_open = true;
+
 // Call monitoring
-static adc_oneshot_unit_handle_t call_adc_handle = NULL;
 static bool call_monitor_running = false;
-static TaskHandle_t call_monitor_handle = NULL;
-static bool call_tx_active = false;  // True when WE are asserting call
+static int call_subscription = -1;
+static volatile bool call_tx_active = false;        // True when WE are asserting call
+static volatile bool partyline_call_active = false;
 
 //=============================================================================
 // PRIVATE FUNCTIONS
 //=============================================================================
 
-static bool detect_dc_offset(const int16_t *buffer, size_t sample_count)
-{
-    // Calculate DC offset (average of signal)
-    int32_t sum = 0;
-    for (size_t i = 0; i < sample_count; i++) {
-        sum += buffer[i];
-    }
-
-    int16_t dc_offset = sum / sample_count;
-
-    // If DC offset is significant (>10% of max), flag as fault
-    const int16_t dc_threshold = 3276;  // 10% of 32767
-
-    return (abs(dc_offset) > dc_threshold);
-}
+// DC offset that flags a fault (10% of full scale)
+#define DC_FAULT_THRESHOLD      3276
 
 //=============================================================================
 // PUBLIC FUNCTIONS
@@ -79,6 +76,13 @@ esp_err_t clearcom_line_init(void)
     memset(&status, 0, sizeof(status));
     status.line_connected = true;  // Assume connected (no detection circuit)
 
+    audio_processor_line_filter_init(&input_filter, PARTYLINE_DC_BLOCKING, PARTYLINE_HPF_HZ,
+                                     PARTYLINE_GATE_ENABLE ? PARTYLINE_GATE_FLOOR : 1.0f,
+                                     PARTYLINE_GATE_RELEASE_MS);
+    audio_vad_init(&gate_vad);
+    gate_open = true;
+    status.gate_open = true;
+
     initialized = true;
     ESP_LOGI(TAG, "Intercom line interface initialized");
 
@@ -132,21 +136,39 @@ esp_err_t clearcom_line_read(int16_t *buffer, size_t sample_count)
     esp_err_t ret = audio_codec_read(buffer, sample_count, NULL);
 
     if (ret == ESP_OK) {
-        // Update status
-        status.input_level = audio_processor_get_rms(buffer, sample_count);
-
-        // Check for DC offset (fault condition)
-        if (PARTYLINE_DC_BLOCKING) {
-            status.dc_offset_detected = detect_dc_offset(buffer, sample_count);
-            if (status.dc_offset_detected) {
-                ESP_LOGW(TAG, "DC offset detected on party line input");
-            }
-        }
+        clearcom_line_process_input(buffer, sample_count);
     }
 
     return ret;
 }
 
+void clearcom_line_process_input(int16_t *buffer, size_t sample_count)
+{
+    if (!initialized || !buffer) {
+        return;
+    }
+
+    audio_processor_line_filter_process(&input_filter, buffer, sample_count, gate_open);
+    gate_open = audio_vad_speech(&gate_vad, input_filter.level, false);
+
+    // Update status
+    status.input_level = input_filter.level;
+    status.noise_level = gate_vad.noise_rms;
+    status.dc_offset = (int16_t)input_filter.dc;
+    status.gate_open = gate_open;
+
+    // Check for DC offset (fault condition); the blocker removes it either way
+    bool dc_fault = PARTYLINE_DC_BLOCKING && abs(input_filter.dc) > DC_FAULT_THRESHOLD;
+    if (dc_fault != status.dc_offset_detected) {
+        status.dc_offset_detected = dc_fault;
+        if (dc_fault) {
+            ESP_LOGW(TAG, "DC offset detected on party line input (%d)", (int)input_filter.dc);
+        } else {
+            ESP_LOGI(TAG, "Party line input DC offset cleared");
+        }
+    }
+}
+
 esp_err_t clearcom_line_write(const int16_t *buffer, size_t sample_count)
 {
     if (!initialized || !running || !buffer) {
@@ -185,77 +207,34 @@ void clearcom_line_set_input_gain(uint8_t gain)
 // CALL MONITORING
 //=============================================================================
 
-/**
- * @brief Partyline call monitoring task
- * - Reads ADC to detect incoming calls from partyline
- * - Drives MOSFET to assert calls onto partyline (when pack calls)
- */
-static void call_monitor_task(void *arg)
-{
-    ESP_LOGI(TAG, "Call monitor started (RX: GPIO%d, TX: GPIO%d)",
-             CALL_RX_PIN, CALL_TX_PIN);
-
-    bool partyline_call_active = false;
-    uint32_t debounce_count = 0;
-    const uint32_t debounce_threshold = CALL_DEBOUNCE_MS / 50;  // 50ms poll interval
-
-    while (call_monitor_running) {
-        // === CALL TX: Drive MOSFET based on pack's call state ===
-        // When pack is calling (base state = INCOMING or ACKNOWLEDGED),
-        // assert call on partyline
-        bool pack_calling = call_module_is_being_called();
-        if (pack_calling != call_tx_active) {
-            call_tx_active = pack_calling;
-            gpio_set_level(CALL_TX_PIN, call_tx_active ? 1 : 0);
-            ESP_LOGI(TAG, "Call TX %s (relaying pack call to partyline)",
-                     call_tx_active ? "ASSERTED" : "RELEASED");
-        }
+#define CALL_THRESHOLD_MV       ((int)(CALL_VOLTAGE_THRESHOLD * 1000.0f))
+#define CALL_HYSTERESIS_MV      ((int)(CALL_VOLTAGE_HYSTERESIS * 1000.0f))
 
-        // === CALL RX: Read partyline call voltage ===
-        // Skip reading when we're asserting call (avoid self-detection)
-        if (!call_tx_active) {
-            int adc_value = 0;
-            esp_err_t ret = adc_oneshot_read(call_adc_handle, CALL_RX_ADC_CHANNEL, &adc_value);
-
-            if (ret == ESP_OK) {
-                float voltage = (adc_value / 4095.0f) * 3.3f;
-                bool call_detected = (voltage > CALL_VOLTAGE_THRESHOLD);
-
-                if (call_detected && !partyline_call_active) {
-                    debounce_count++;
-                    if (debounce_count >= debounce_threshold) {
-                        partyline_call_active = true;
-                        debounce_count = 0;
-                        ESP_LOGI(TAG, "Partyline CALL detected (%.2fV)", voltage);
-                        // Signal to call_module as if local button pressed
-                        // This relays the partyline call to the pack via UDP
-                        call_module_button_event(true);
-                    }
-                } else if (!call_detected && partyline_call_active) {
-                    debounce_count++;
-                    if (debounce_count >= debounce_threshold) {
-                        partyline_call_active = false;
-                        debounce_count = 0;
-                        ESP_LOGI(TAG, "Partyline call ended (%.2fV)", voltage);
-                        call_module_button_event(false);
-                    }
-                } else {
-                    debounce_count = 0;
-                }
-            }
-        } else {
-            // While TX is active, clear RX state to avoid stale detection
-            partyline_call_active = false;
-            debounce_count = 0;
-        }
+static void report_partyline_call(bool active, int millivolts)
+{
+    if (active == partyline_call_active) return;
 
-        vTaskDelay(pdMS_TO_TICKS(50));
+    partyline_call_active = active;
+    if (active) {
+        ESP_LOGI(TAG, "Partyline CALL detected (%d mV)", millivolts);
+    } else {
+        ESP_LOGI(TAG, "Partyline call ended");
     }
+    // Signal to call_module as if local button pressed
+    // This relays the partyline call to the pack via UDP
+    call_module_button_event(active);
+}
 
-    // Clean up: ensure MOSFET is off
-    gpio_set_level(CALL_TX_PIN, 0);
-    ESP_LOGI(TAG, "Call monitor stopped");
-    vTaskDelete(NULL);
+/**
+ * @brief Partyline call voltage crossed the threshold (ADC service task,
+ * debounced by CALL_DEBOUNCE_MS)
+ */
+static void call_rx_crossing(bool above, int millivolts, void *ctx)
+{
+    // Our own assertion is on the line: not a call from the partyline
+    if (call_tx_active) return;
+
+    report_partyline_call(above, millivolts);
 }
 
 esp_err_t clearcom_line_call_start(void)
@@ -282,38 +261,50 @@ esp_err_t clearcom_line_call_start(void)
     gpio_set_level(CALL_TX_PIN, 0);  // MOSFET off
     ESP_LOGI(TAG, "Call TX GPIO%d configured (MOSFET driver)", CALL_TX_PIN);
 
-    // Initialize call RX ADC
-    adc_oneshot_unit_init_cfg_t adc_cfg = {
-        .unit_id = ADC_UNIT_1,
-    };
-    ret = adc_oneshot_new_unit(&adc_cfg, &call_adc_handle);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to init call RX ADC");
-        return ret;
-    }
-
-    adc_oneshot_chan_cfg_t chan_cfg = {
-        .bitwidth = ADC_BITWIDTH_12,
-        .atten = ADC_ATTEN_DB_12,  // 0-3.3V range
+    // Call RX: threshold crossings from the shared ADC scan
+    call_tx_active = false;
+    partyline_call_active = false;
+    adc_service_subscription_t call_rx = {
+        .channel = CALL_RX_ADC_CHANNEL,
+        .threshold_mv = CALL_THRESHOLD_MV,
+        .hysteresis_mv = CALL_HYSTERESIS_MV,
+        .debounce_ms = CALL_DEBOUNCE_MS,
+        .on_cross = call_rx_crossing,
     };
-    ret = adc_oneshot_config_channel(call_adc_handle, CALL_RX_ADC_CHANNEL, &chan_cfg);
+    ret = adc_service_subscribe(&call_rx, &call_subscription);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to configure call RX ADC channel");
-        adc_oneshot_del_unit(call_adc_handle);
-        call_adc_handle = NULL;
+        ESP_LOGE(TAG, "Failed to subscribe call RX ADC");
         return ret;
     }
     ESP_LOGI(TAG, "Call RX ADC configured (GPIO%d, threshold %.1fV)",
              CALL_RX_PIN, CALL_VOLTAGE_THRESHOLD);
 
-    // Start monitoring task
     call_monitor_running = true;
-    xTaskCreate(call_monitor_task, "call_mon", 3072, NULL, 4, &call_monitor_handle);
 
     ESP_LOGI(TAG, "Partyline call interface started");
     return ESP_OK;
 }
 
+void clearcom_line_call_assert(bool active)
+{
+    if (!call_monitor_running || active == call_tx_active) {
+        return;
+    }
+
+    call_tx_active = active;
+    gpio_set_level(CALL_TX_PIN, active ? 1 : 0);
+    ESP_LOGI(TAG, "Call TX %s (relaying pack call to partyline)",
+             active ? "ASSERTED" : "RELEASED");
+
+    if (!active) {
+        // Crossings were ignored while ours was on the line: start RX
+        // detection over, so a partyline call still on it is reported
+        // again after the debounce
+        report_partyline_call(false, 0);
+        adc_service_rearm(call_subscription);
+    }
+}
+
 void clearcom_line_call_stop(void)
 {
     if (!call_monitor_running) {
@@ -321,13 +312,10 @@ void clearcom_line_call_stop(void)
     }
 
     call_monitor_running = false;
-    vTaskDelay(pdMS_TO_TICKS(100));  // Let task exit
-
-    if (call_adc_handle) {
-        adc_oneshot_del_unit(call_adc_handle);
-        call_adc_handle = NULL;
-    }
+    adc_service_unsubscribe(call_subscription);
+    call_subscription = -1;
 
+    call_tx_active = false;
     gpio_set_level(CALL_TX_PIN, 0);  // Ensure MOSFET off
     ESP_LOGI(TAG, "Partyline call interface stopped");
 }
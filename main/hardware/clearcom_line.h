@@ -4,6 +4,10 @@
  *
  * Handles audio interface to wired party line intercom system.
  * Uses WM8960 line input/output for balanced audio.
+ *
+ * Every captured line frame goes through one fused filter pass (DC
+ * block, high-pass, VAD-driven noise gate) before it is encoded; the
+ * input metering comes from that pass.
  */
 
 #ifndef CLEARCOM_LINE_H
@@ -19,9 +23,12 @@
 
 typedef struct {
     bool line_connected;     // Party line physically connected
-    float input_level;       // Input audio level (RMS)
+    float input_level;       // Input audio level (RMS, after the high-pass)
     float output_level;      // Output audio level (RMS)
+    float noise_level;       // Input noise floor tracked by the gate's VAD (RMS)
+    int16_t dc_offset;       // DC removed from the input, sample units
     bool dc_offset_detected; // DC offset on input (fault condition)
+    bool gate_open;          // Noise gate passing the input
 } clearcom_line_status_t;
 
 //=============================================================================
@@ -54,6 +61,16 @@ esp_err_t clearcom_line_stop(void);
  */
 esp_err_t clearcom_line_read(int16_t *buffer, size_t sample_count);
 
+/**
+ * @brief Filter one captured party-line frame in place and meter it
+ *
+ * DC block, high-pass and noise gate in a single pass; the gate follows
+ * the VAD verdict on the frame before. Audio engine task.
+ * @param buffer Frame (modified in-place)
+ * @param sample_count Number of samples
+ */
+void clearcom_line_process_input(int16_t *buffer, size_t sample_count);
+
 /**
  * @brief Write audio to party line
  * @param buffer Buffer containing audio samples
@@ -82,11 +99,18 @@ void clearcom_line_set_input_gain(uint8_t gain);
 
 /**
  * @brief Start partyline call monitoring (RX detection + TX assertion)
- * Bridges partyline call signals with call_module.
+ * Bridges partyline call signals with call_module: RX crossings come
+ * from the shared ADC scan, TX follows clearcom_line_call_assert().
  * @return ESP_OK on success
  */
 esp_err_t clearcom_line_call_start(void);
 
+/**
+ * @brief Assert or release a call on the partyline (drives the MOSFET)
+ * @param active true while the pack is calling the base
+ */
+void clearcom_line_call_assert(bool active);
+
 /**
  * @brief Stop partyline call monitoring
  */
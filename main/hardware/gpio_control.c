@@ -1,22 +1,83 @@
 /**
  * @file gpio_control.c
  * @brief GPIO Control Implementation
+ *
+ * Nothing here polls. Each button pin has a level-triggered interrupt
+ * that masks itself and arms a one-shot esp_timer; when the timer fires
+ * the pin has been left alone for BUTTON_DEBOUNCE_MS, its level is the
+ * debounced state, and the interrupt is re-armed for the opposite level
+ * (a pin still bouncing fires straight away and is debounced again).
+ * Level rather than edge triggers because light sleep can only wake on a
+ * level, and power_manager arms the same pins for that. A second one-shot
+ * timer reports a PTT press that crosses PTT_HOLD_THRESHOLD_MS. The timers
+ * only queue what they saw: the PTT and CALL callbacks run in the button
+ * task, so a callback that sends or logs never holds up other esp_timer
+ * callbacks.
+ *
+ * LEDs are LEDC channels clocked from RC_FAST so they keep running in
+ * light sleep. Steady LEDs sit on a 1 kHz PWM timer at the set
+ * brightness, and brightness changes are hardware fades. Fast blink is a
+ * second LEDC timer running at the blink rate itself, so it costs no CPU
+ * at all; blinks flash at full intensity. The S3's LEDC cannot divide
+ * down to 1 Hz, so slow blink toggles the steady duty from a periodic
+ * esp_timer that runs only while an LED is slow-blinking.
  */
 
 #include "../config.h"
 #include "gpio_control.h"
 #include "driver/gpio.h"
 #include "driver/ledc.h"
+#include "soc/soc_caps.h"
 #include "esp_log.h"
 #include "esp_sleep.h"  // For GPIO sleep hold configuration
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/timers.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_timer.h"
-#include "rom/ets_sys.h"  // For ets_delay_us in ISR
+#include "../system/task_map.h"
 
 static const char *TAG = "GPIO";
 
+#define LED_SPEED_MODE          LEDC_LOW_SPEED_MODE
+#define LED_TIMER_STEADY        LEDC_TIMER_0     // LED_ON and slow blink
+#define LED_TIMER_BLINK         LEDC_TIMER_1     // LED_BLINK_FAST square wave
+#define LED_PWM_HZ              1000
+#define LED_PWM_BITS            LEDC_TIMER_10_BIT
+#define LED_PWM_MAX             ((1u << LED_PWM_BITS) - 1)
+#define LED_BLINK_BITS          LEDC_TIMER_14_BIT
+#define LED_BLINK_DUTY          (1u << (LED_BLINK_BITS - 1))    // 50%
+#define LED_FADE_MS             250              // Brightness changes
+
+// Button events waiting for the button task (a few presses and releases)
+#define BUTTON_QUEUE_LEN        8
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+#if DEVICE_TYPE_PACK
+typedef enum {
+    BUTTON_PTT = 0,
+    BUTTON_CALL,
+    BUTTON_COUNT
+} button_id_t;
+
+typedef struct {
+    gpio_num_t pin;
+    const char *name;
+    volatile bool pressed;               // Debounced state
+    int64_t pressed_us;                  // When the press was confirmed
+    esp_timer_handle_t debounce_timer;
+} button_t;
+
+// What the timers saw, handed to the button task
+typedef struct {
+    button_id_t id;
+    bool pressed;
+    uint32_t hold_ms;                    // PTT: release or hold, 0 on press
+} button_event_t;
+#endif
+
 //=============================================================================
 // PRIVATE VARIABLES
 //=============================================================================
@@ -26,19 +87,21 @@ static ptt_callback_t user_ptt_callback = NULL;
 static call_callback_t user_call_callback = NULL;
 
 #if DEVICE_TYPE_PACK
-// Button state (pack only)
-static volatile bool ptt_pressed = false;
-static volatile bool call_pressed = false;
-static int64_t ptt_press_time = 0;
+static button_t buttons[BUTTON_COUNT] = {
+    [BUTTON_PTT]  = { .pin = BUTTON_PTT_PIN,  .name = "PTT" },
+    [BUTTON_CALL] = { .pin = BUTTON_CALL_PIN, .name = "CALL" },
+};
+static esp_timer_handle_t ptt_hold_timer = NULL;
+static QueueHandle_t button_queue = NULL;
 #endif
 
-// LED state
+// LED state (channel n drives LED n), applied under led_mutex once LEDC is up
 static led_state_t led_states[LED_COUNT] = {0};
 static uint8_t led_brightness = LED_BRIGHTNESS_PCT;
-
-// LED blink task
-static TaskHandle_t led_task_handle = NULL;
-static bool led_task_running = false;
+static SemaphoreHandle_t led_mutex = NULL;
+static esp_timer_handle_t slow_blink_timer = NULL;
+static bool slow_blink_lit = false;
+static bool leds_ready = false;              // LEDC configured (under led_mutex)
 
 //=============================================================================
 // LED PIN MAPPING
@@ -95,58 +158,146 @@ static const bool led_inverted[LED_COUNT] = {
 // PRIVATE FUNCTIONS - LED Control
 //=============================================================================
 
-static void led_set_physical(led_id_t led, bool on)
+static uint32_t steady_duty(void)
 {
-    if (led >= LED_COUNT || !led_enabled[led]) {
-        return;
+    return (uint32_t)led_brightness * LED_PWM_MAX / 100;
+}
+
+static bool led_lit_steady(led_id_t led)
+{
+    return led_states[led] == LED_ON || (led_states[led] == LED_BLINK_SLOW && slow_blink_lit);
+}
+
+// Called with led_mutex held
+static void led_apply(led_id_t led)
+{
+    ledc_channel_t channel = (ledc_channel_t)(LEDC_CHANNEL_0 + led);
+
+#if SOC_LEDC_SUPPORT_FADE_STOP
+    ledc_fade_stop(LED_SPEED_MODE, channel);
+#endif
+    if (led_states[led] == LED_BLINK_FAST) {
+        ledc_bind_channel_timer(LED_SPEED_MODE, channel, LED_TIMER_BLINK);
+        ledc_set_duty_and_update(LED_SPEED_MODE, channel, LED_BLINK_DUTY, 0);
+    } else {
+        ledc_bind_channel_timer(LED_SPEED_MODE, channel, LED_TIMER_STEADY);
+        ledc_set_duty_and_update(LED_SPEED_MODE, channel,
+                                 led_lit_steady(led) ? steady_duty() : 0, 0);
     }
+}
 
-    // Apply inversion if LED is wired backwards
-    if (led_inverted[led]) {
-        on = !on;
+// Called with led_mutex held: the slow blink timer runs only while needed
+static void led_update_slow_blink(void)
+{
+    bool wanted = false;
+    for (int i = 0; i < LED_COUNT; i++) {
+        if (led_enabled[i] && led_states[i] == LED_BLINK_SLOW) {
+            wanted = true;
+        }
     }
 
-    // Set GPIO level (1=on, 0=off for normal LEDs)
-    gpio_set_level(led_pins[led], on ? 1 : 0);
+    bool running = esp_timer_is_active(slow_blink_timer);
+    if (wanted && !running) {
+        slow_blink_lit = true;  // A new blink starts lit
+        esp_timer_start_periodic(slow_blink_timer, (uint64_t)STATUS_LED_BLINK_SLOW * 500);
+    } else if (!wanted && running) {
+        esp_timer_stop(slow_blink_timer);
+    }
 }
 
-static void led_task(void *arg)
+static void slow_blink_cb(void *arg)
 {
-    ESP_LOGI(TAG, "LED task started");
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    slow_blink_lit = !slow_blink_lit;
+    for (int i = 0; i < LED_COUNT; i++) {
+        if (led_enabled[i] && led_states[i] == LED_BLINK_SLOW) {
+            led_apply(i);
+        }
+    }
+    xSemaphoreGive(led_mutex);
+}
 
-    uint32_t tick = 0;
+static esp_err_t led_init(void)
+{
+    // RC_FAST keeps the LEDC clocked in light sleep; all timers share it
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LED_SPEED_MODE,
+        .duty_resolution = LED_PWM_BITS,
+        .timer_num = LED_TIMER_STEADY,
+        .freq_hz = LED_PWM_HZ,
+        .clk_cfg = LEDC_USE_RC_FAST_CLK,
+    };
+    esp_err_t ret = ledc_timer_config(&timer_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "LED PWM timer failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
 
-    while (led_task_running) {
-        for (int i = 0; i < LED_COUNT; i++) {
-            if (!led_enabled[i]) continue;
-
-            switch (led_states[i]) {
-                case LED_OFF:
-                    led_set_physical(i, false);
-                    break;
-
-                case LED_ON:
-                    led_set_physical(i, true);
-                    break;
-
-                case LED_BLINK_SLOW:
-                    // 1Hz = 1000ms period, 50% duty
-                    led_set_physical(i, (tick % 1000) < 500);
-                    break;
-
-                case LED_BLINK_FAST:
-                    // 5Hz = 200ms period, 50% duty
-                    led_set_physical(i, (tick % 200) < 100);
-                    break;
-            }
+    timer_conf.duty_resolution = LED_BLINK_BITS;
+    timer_conf.timer_num = LED_TIMER_BLINK;
+    timer_conf.freq_hz = 1000 / STATUS_LED_BLINK_FAST;
+    ret = ledc_timer_config(&timer_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "LED blink timer failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = ledc_fade_func_install(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    for (int i = 0; i < LED_COUNT; i++) {
+        if (!led_enabled[i]) continue;
+
+        ledc_channel_config_t channel_conf = {
+            .gpio_num = led_pins[i],
+            .speed_mode = LED_SPEED_MODE,
+            .channel = (ledc_channel_t)(LEDC_CHANNEL_0 + i),
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = LED_TIMER_STEADY,
+            .duty = 0,  // Start off
+            .hpoint = 0,
+            .sleep_mode = LEDC_SLEEP_MODE_KEEP_ALIVE,
+            .flags.output_invert = led_inverted[i],  // LED wired backwards
+        };
+        ret = ledc_channel_config(&channel_conf);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "LED %d channel failed: %s", i, esp_err_to_name(ret));
+            return ret;
+        }
+        ESP_LOGI(TAG, "LED %d configured on GPIO %d", i, led_pins[i]);
+    }
+
+    if (!slow_blink_timer) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = slow_blink_cb,
+            .name = "led_blink",
+        };
+        ret = esp_timer_create(&timer_args, &slow_blink_timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (!led_mutex) {
+        led_mutex = xSemaphoreCreateMutex();
+        if (!led_mutex) {
+            return ESP_ERR_NO_MEM;
         }
+    }
 
-        tick += 10;
-        vTaskDelay(pdMS_TO_TICKS(10));  // 10ms update rate
+    // States set before init (e.g. by the WiFi handler) show now
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    leds_ready = true;
+    led_update_slow_blink();
+    for (int i = 0; i < LED_COUNT; i++) {
+        if (led_enabled[i]) {
+            led_apply(i);
+        }
     }
+    xSemaphoreGive(led_mutex);
 
-    ESP_LOGI(TAG, "LED task stopped");
-    vTaskDelete(NULL);
+    return ESP_OK;
 }
 
 //=============================================================================
@@ -154,102 +305,129 @@ static void led_task(void *arg)
 //=============================================================================
 
 #if DEVICE_TYPE_PACK
-static void IRAM_ATTR ptt_isr_handler(void *arg)
+static void IRAM_ATTR button_isr_handler(void *arg)
 {
-    // Read current state
-    int level = gpio_get_level(BUTTON_PTT_PIN);
-
-    // Simple noise filter: verify state is stable
-    // Re-read after a tiny delay to confirm it's not a spike
-    ets_delay_us(100);  // 100 microsecond delay
-    int level_confirm = gpio_get_level(BUTTON_PTT_PIN);
-
-    // Only update if both reads agree (noise rejection)
-    if (level == level_confirm) {
-        bool pressed = (level == 0);  // Active low
-        ptt_pressed = pressed;
-    }
-    // If reads disagree, ignore this interrupt (was noise)
+    button_t *button = (button_t *)arg;
+
+    // Level-triggered: mask until the debounce timer has read the pin
+    gpio_intr_disable(button->pin);
+    esp_timer_start_once(button->debounce_timer, BUTTON_DEBOUNCE_MS * 1000);
 }
 
-static void IRAM_ATTR call_isr_handler(void *arg)
+static void button_debounce_cb(void *arg)
 {
-    // Read current state
-    int level = gpio_get_level(BUTTON_CALL_PIN);
+    button_t *button = (button_t *)arg;
+    bool pressed = (gpio_get_level(button->pin) == 0);  // Active low
 
-    // Simple noise filter: verify state is stable
-    ets_delay_us(100);  // 100 microsecond delay
-    int level_confirm = gpio_get_level(BUTTON_CALL_PIN);
+    // Wait for the other level; a pin still bouncing comes straight back
+    gpio_set_intr_type(button->pin, pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    gpio_intr_enable(button->pin);
+
+    if (pressed == button->pressed) {
+        return;  // Noise, or bounced back to where it was
+    }
+    button->pressed = pressed;
 
-    // Only update if both reads agree
-    if (level == level_confirm) {
-        bool pressed = (level == 0);  // Active low
-        call_pressed = pressed;
+    button_event_t event = {
+        .id = (button_id_t)(button - buttons),
+        .pressed = pressed,
+    };
+    if (event.id == BUTTON_PTT) {
+        int64_t now_us = esp_timer_get_time();
+        if (pressed) {
+            button->pressed_us = now_us;
+            esp_timer_start_once(ptt_hold_timer, (uint64_t)PTT_HOLD_THRESHOLD_MS * 1000);
+        } else {
+            esp_timer_stop(ptt_hold_timer);
+            event.hold_ms = (uint32_t)((now_us - button->pressed_us) / 1000);
+        }
     }
+    xQueueSend(button_queue, &event, 0);
 }
 
-static void button_monitor_task(void *arg)
+static void ptt_hold_cb(void *arg)
 {
-    ESP_LOGI(TAG, "Button monitor task started");
-
-    bool last_ptt = false;
-    bool last_call = false;
-
-    while (1) {
-        // Check PTT button
-        bool current_ptt = ptt_pressed;
-
-        if (current_ptt != last_ptt) {
-            vTaskDelay(pdMS_TO_TICKS(BUTTON_DEBOUNCE_MS));  // Debounce
-            current_ptt = ptt_pressed;  // Re-read after debounce
-
-            if (current_ptt != last_ptt) {  // Confirmed change
-                if (current_ptt) {
-                    // Button pressed
-                    ptt_press_time = esp_timer_get_time() / 1000;  // ms
-                    ESP_LOGI(TAG, "PTT PRESSED");
-                    if (user_ptt_callback) {
-                        user_ptt_callback(true, 0);
-                    }
-                } else {
-                    // Button released
-                    int64_t hold_time = (esp_timer_get_time() / 1000) - ptt_press_time;
-                    ESP_LOGI(TAG, "PTT RELEASED (%lld ms)", hold_time);
-                    if (user_ptt_callback) {
-                        user_ptt_callback(false, (uint32_t)hold_time);
-                    }
-                }
-                last_ptt = current_ptt;
-            }
+    button_t *ptt = &buttons[BUTTON_PTT];
+    if (!ptt->pressed) {
+        return;
+    }
+
+    // Notify of the hold once, as it crosses the threshold
+    button_event_t event = {
+        .id = BUTTON_PTT,
+        .pressed = true,
+        .hold_ms = (uint32_t)((esp_timer_get_time() - ptt->pressed_us) / 1000),
+    };
+    xQueueSend(button_queue, &event, 0);
+}
+
+// Runs the user callbacks, in the order the timers saw the events
+static void button_task(void *arg)
+{
+    button_event_t event;
+    while (true) {
+        if (xQueueReceive(button_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
         }
 
-        // Check for PTT hold (while still pressed)
-        if (current_ptt && (esp_timer_get_time() / 1000 - ptt_press_time) > PTT_HOLD_THRESHOLD_MS) {
-            if (user_ptt_callback) {
-                int64_t hold_time = (esp_timer_get_time() / 1000) - ptt_press_time;
-                user_ptt_callback(true, (uint32_t)hold_time);  // Notify of hold
+        if (event.id == BUTTON_CALL) {
+            ESP_LOGI(TAG, "CALL %s", event.pressed ? "PRESSED" : "RELEASED");
+            if (user_call_callback) {
+                user_call_callback(event.pressed);
             }
-            vTaskDelay(pdMS_TO_TICKS(100));  // Don't spam hold notifications
+            continue;
         }
 
-        // Check call button
-        bool current_call = call_pressed;
-
-        if (current_call != last_call) {
-            vTaskDelay(pdMS_TO_TICKS(BUTTON_DEBOUNCE_MS));  // Debounce
-            current_call = call_pressed;
-
-            if (current_call != last_call) {  // Confirmed change
-                ESP_LOGI(TAG, "CALL %s", current_call ? "PRESSED" : "RELEASED");
-                if (user_call_callback) {
-                    user_call_callback(current_call);
-                }
-                last_call = current_call;
-            }
+        if (!event.pressed) {
+            ESP_LOGI(TAG, "PTT RELEASED (%lu ms)", (unsigned long)event.hold_ms);
+        } else if (event.hold_ms == 0) {
+            ESP_LOGI(TAG, "PTT PRESSED");
         }
+        if (user_ptt_callback) {
+            user_ptt_callback(event.pressed, event.hold_ms);
+        }
+    }
+}
 
-        vTaskDelay(pdMS_TO_TICKS(10));  // 10ms polling
+static esp_err_t button_init(button_t *button)
+{
+    if (!button->debounce_timer) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = button_debounce_cb,
+            .arg = button,
+            .name = button->name,
+        };
+        esp_err_t ret = esp_timer_create(&timer_args, &button->debounce_timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
     }
+
+    // Input with pull-up (active low)
+    gpio_config_t btn_conf = {
+        .pin_bit_mask = (1ULL << button->pin),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_config(&btn_conf);
+
+    // CRITICAL: Hold pull-up during sleep to prevent ghost activations
+    gpio_hold_en(button->pin);
+    gpio_sleep_set_direction(button->pin, GPIO_MODE_INPUT);
+    gpio_sleep_set_pull_mode(button->pin, GPIO_PULLUP_ONLY);
+
+    // A button held through boot is ignored until it has been released
+    int level = gpio_get_level(button->pin);
+    button->pressed = false;
+    gpio_set_intr_type(button->pin, level == 0 ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+    gpio_isr_handler_add(button->pin, button_isr_handler, button);
+    gpio_intr_enable(button->pin);
+
+    ESP_LOGI(TAG, "%s button configured on GPIO %d (current level: %d)",
+             button->name, button->pin, level);
+    return ESP_OK;
 }
 #endif // DEVICE_TYPE_PACK
 
@@ -269,67 +447,46 @@ esp_err_t gpio_control_init(ptt_callback_t ptt_cb, call_callback_t call_cb)
     user_ptt_callback = ptt_cb;
     user_call_callback = call_cb;
 
-    // Configure LED GPIOs as outputs
-    gpio_config_t led_conf = {
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-
-    for (int i = 0; i < LED_COUNT; i++) {
-        if (led_enabled[i]) {
-            led_conf.pin_bit_mask = (1ULL << led_pins[i]);
-            gpio_config(&led_conf);
-            gpio_set_level(led_pins[i], 0);  // Start off
-            ESP_LOGI(TAG, "LED %d configured on GPIO %d", i, led_pins[i]);
-        }
+    esp_err_t ret = led_init();
+    if (ret != ESP_OK) {
+        return ret;
     }
 
 #if DEVICE_TYPE_PACK
-    // Configure button GPIOs as inputs with pull-up (active low)
-    gpio_config_t btn_conf = {
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_ANYEDGE,
-    };
-
-    // PTT button
-    btn_conf.pin_bit_mask = (1ULL << BUTTON_PTT_PIN);
-    gpio_config(&btn_conf);
+    if (!ptt_hold_timer) {
+        const esp_timer_create_args_t hold_args = {
+            .callback = ptt_hold_cb,
+            .name = "ptt_hold",
+        };
+        ret = esp_timer_create(&hold_args, &ptt_hold_timer);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
 
-    // CRITICAL: Hold pull-up during sleep to prevent ghost activations
-    gpio_hold_en(BUTTON_PTT_PIN);
-    gpio_sleep_set_direction(BUTTON_PTT_PIN, GPIO_MODE_INPUT);
-    gpio_sleep_set_pull_mode(BUTTON_PTT_PIN, GPIO_PULLUP_ONLY);
+    // Events queued before the task runs are handled when it starts
+    if (!button_queue) {
+        button_queue = xQueueCreate(BUTTON_QUEUE_LEN, sizeof(button_event_t));
+        if (!button_queue) {
+            return ESP_ERR_NO_MEM;
+        }
+        ret = task_map_create(TASK_BUTTONS, button_task, NULL, NULL);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Button task failed: %s", esp_err_to_name(ret));
+            return ret;
+        }
+    }
 
     gpio_install_isr_service(0);
-    gpio_isr_handler_add(BUTTON_PTT_PIN, ptt_isr_handler, NULL);
-    int ptt_level = gpio_get_level(BUTTON_PTT_PIN);
-    ESP_LOGI(TAG, "PTT button configured on GPIO %d (current level: %d)", BUTTON_PTT_PIN, ptt_level);
-
-    // Call button
-    btn_conf.pin_bit_mask = (1ULL << BUTTON_CALL_PIN);
-    gpio_config(&btn_conf);
-
-    // CRITICAL: Hold pull-up during sleep to prevent ghost activations
-    gpio_hold_en(BUTTON_CALL_PIN);
-    gpio_sleep_set_direction(BUTTON_CALL_PIN, GPIO_MODE_INPUT);
-    gpio_sleep_set_pull_mode(BUTTON_CALL_PIN, GPIO_PULLUP_ONLY);
-
-    gpio_isr_handler_add(BUTTON_CALL_PIN, call_isr_handler, NULL);
-    int call_level = gpio_get_level(BUTTON_CALL_PIN);
-    ESP_LOGI(TAG, "Call button configured on GPIO %d (current level: %d)", BUTTON_CALL_PIN, call_level);
-
-    // Start button monitor task
-    xTaskCreate(button_monitor_task, "btn_monitor", 4096, NULL, 5, NULL);
+    for (int i = 0; i < BUTTON_COUNT; i++) {
+        ret = button_init(&buttons[i]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "%s button init failed: %s", buttons[i].name, esp_err_to_name(ret));
+            return ret;
+        }
+    }
 #endif
 
-    // Start LED task
-    led_task_running = true;
-    xTaskCreate(led_task, "led_task", 2048, NULL, 3, &led_task_handle);
-
     // Turn on power LED
     gpio_control_set_led(LED_POWER, LED_ON);
 
@@ -345,20 +502,49 @@ void gpio_control_set_led(led_id_t led, led_state_t state)
         return;
     }
 
-    led_states[led] = state;
+    if (!led_mutex) {
+        led_states[led] = state;  // Shown by gpio_control_init
+        return;
+    }
+
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    if (led_states[led] != state) {
+        led_states[led] = state;
+        if (leds_ready && led_enabled[led]) {
+            led_update_slow_blink();
+            led_apply(led);
+        }
+    }
+    xSemaphoreGive(led_mutex);
 }
 
 void gpio_control_set_brightness(uint8_t brightness)
 {
     if (brightness > 100) brightness = 100;
+
+    if (!led_mutex) {
+        led_brightness = brightness;
+        return;
+    }
+
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
     led_brightness = brightness;
-    // TODO: Implement PWM brightness control
+    if (leds_ready) {
+        // Lit steady LEDs glide to the new level in hardware
+        for (int i = 0; i < LED_COUNT; i++) {
+            if (led_enabled[i] && led_lit_steady(i)) {
+                ledc_set_fade_time_and_start(LED_SPEED_MODE, (ledc_channel_t)(LEDC_CHANNEL_0 + i),
+                                             steady_duty(), LED_FADE_MS, LEDC_FADE_NO_WAIT);
+            }
+        }
+    }
+    xSemaphoreGive(led_mutex);
 }
 
 bool gpio_control_is_ptt_pressed(void)
 {
 #if DEVICE_TYPE_PACK
-    return ptt_pressed;
+    return buttons[BUTTON_PTT].pressed;
 #else
     return false;
 #endif
@@ -367,7 +553,7 @@ bool gpio_control_is_ptt_pressed(void)
 bool gpio_control_is_call_pressed(void)
 {
 #if DEVICE_TYPE_PACK
-    return call_pressed;
+    return buttons[BUTTON_CALL].pressed;
 #else
     return false;
 #endif
@@ -381,20 +567,18 @@ void gpio_control_deinit(void)
 
     ESP_LOGI(TAG, "Deinitializing GPIO control...");
 
-    // Stop LED task
-    led_task_running = false;
-    if (led_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        led_task_handle = NULL;
-    }
-
     // Turn off all LEDs
+    xSemaphoreTake(led_mutex, portMAX_DELAY);
+    leds_ready = false;
+    esp_timer_stop(slow_blink_timer);
     for (int i = 0; i < LED_COUNT; i++) {
         if (led_enabled[i]) {
-            gpio_set_level(led_pins[i], 0);
+            ledc_stop(LED_SPEED_MODE, (ledc_channel_t)(LEDC_CHANNEL_0 + i), 0);
         }
     }
+    ledc_fade_func_uninstall();
+    xSemaphoreGive(led_mutex);
 
     initialized = false;
     ESP_LOGI(TAG, "GPIO control deinitialized");
-}
\ No newline at end of file
+}
@@ -6,7 +6,8 @@
  * reading to a 0-127 output volume level for the WM8960 codec.
  * 128 steps (~0.6dB each) for smooth, analog-feel control.
  *
- * Shares the ADC1 unit handle with battery.c to avoid conflicts.
+ * The pot is one channel of the shared ADC scan (adc_service.c), which
+ * delivers it EMA-smoothed every VOLUME_POLL_MS.
  */
 
 #include "volume_control.h"
@@ -14,12 +15,9 @@
 
 #if DEVICE_TYPE_PACK
 
-#include "battery.h"
+#include "adc_service.h"
 #include "../audio/audio_codec.h"
-#include "esp_adc/adc_oneshot.h"
 #include "esp_log.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 
 static const char *TAG = "VOLUME";
 
@@ -29,8 +27,8 @@ static const char *TAG = "VOLUME";
 
 #define VOLUME_POLL_MS          50      // Read pot every 50ms for smoother response
 #define VOLUME_MAX              127     // WM8960 register range (0x00-0x7F)
-#define ADC_MAX                 4095
-#define ADC_DEADBAND            16      // ~0.5 volume steps worth of hysteresis
+#define POT_MAX_MV              3300    // Pot wiper at full scale
+#define POT_DEADBAND_MV         13      // ~0.5 volume steps worth of hysteresis
 #define EMA_ALPHA_SHIFT         2       // EMA weight = 0.25
 
 //=============================================================================
@@ -39,67 +37,44 @@ static const char *TAG = "VOLUME";
 
 static bool initialized = false;
 static bool running = false;
-static TaskHandle_t volume_task_handle = NULL;
-static adc_oneshot_unit_handle_t adc_handle = NULL;
+static int subscription = -1;
 
 static uint8_t current_volume = 0;
-static int smoothed_adc = -1;
 
 //=============================================================================
 // PRIVATE FUNCTIONS
 //=============================================================================
 
-static uint8_t adc_to_volume(int adc_val)
+static uint8_t pot_to_volume(int pot_mv)
 {
-    if (adc_val <= 0) return 0;
-    if (adc_val >= ADC_MAX) return VOLUME_MAX;
+    if (pot_mv <= 0) return 0;
+    if (pot_mv >= POT_MAX_MV) return VOLUME_MAX;
 
-    // Linear mapping: 0-4095 -> 0-127
-    return (uint8_t)((uint32_t)adc_val * VOLUME_MAX / ADC_MAX);
+    // Linear mapping: 0-3300 mV -> 0-127
+    return (uint8_t)((uint32_t)pot_mv * VOLUME_MAX / POT_MAX_MV);
 }
 
-static void volume_task(void *arg)
+// ADC service task, every VOLUME_POLL_MS with the smoothed pot position
+static void pot_reading(int pot_mv, void *ctx)
 {
-    ESP_LOGI(TAG, "Volume control task started");
-
-    while (running) {
-        int raw = 0;
-        esp_err_t ret = adc_oneshot_read(adc_handle, VOLUME_ADC_CHANNEL, &raw);
-        if (ret != ESP_OK) {
-            vTaskDelay(pdMS_TO_TICKS(VOLUME_POLL_MS));
-            continue;
-        }
-
-        // Seed EMA on first reading
-        if (smoothed_adc < 0) {
-            smoothed_adc = raw;
-        }
-
-        // Exponential moving average
-        smoothed_adc += (raw - smoothed_adc) >> EMA_ALPHA_SHIFT;
-
-        uint8_t new_vol = adc_to_volume(smoothed_adc);
-        if (new_vol != current_volume) {
-            // Hysteresis: require ADC to move past deadband before changing
-            int current_centre = (int)current_volume * ADC_MAX / VOLUME_MAX;
-            int distance = smoothed_adc - current_centre;
-            if (distance < 0) distance = -distance;
-
-            if (distance >= ADC_DEADBAND || new_vol == 0 || new_vol == VOLUME_MAX) {
-                current_volume = new_vol;
-                audio_codec_set_output_volume(current_volume);
-                // Only log on significant changes (every ~4 steps) to reduce UART noise
-                if (current_volume % 4 == 0 || current_volume == VOLUME_MAX) {
-                    ESP_LOGD(TAG, "Vol: %d/127 (ADC: %d)", current_volume, smoothed_adc);
-                }
+    if (!running) return;
+
+    uint8_t new_vol = pot_to_volume(pot_mv);
+    if (new_vol != current_volume) {
+        // Hysteresis: require the pot to move past deadband before changing
+        int current_centre = (int)current_volume * POT_MAX_MV / VOLUME_MAX;
+        int distance = pot_mv - current_centre;
+        if (distance < 0) distance = -distance;
+
+        if (distance >= POT_DEADBAND_MV || new_vol == 0 || new_vol == VOLUME_MAX) {
+            current_volume = new_vol;
+            audio_codec_set_output_volume(current_volume);
+            // Only log on significant changes (every ~4 steps) to reduce UART noise
+            if (current_volume % 4 == 0 || current_volume == VOLUME_MAX) {
+                ESP_LOGD(TAG, "Vol: %d/127 (pot: %d mV)", current_volume, pot_mv);
             }
         }
-
-        vTaskDelay(pdMS_TO_TICKS(VOLUME_POLL_MS));
     }
-
-    ESP_LOGI(TAG, "Volume control task stopped");
-    vTaskDelete(NULL);
 }
 
 //=============================================================================
@@ -115,21 +90,15 @@ esp_err_t volume_control_init(void)
 
     ESP_LOGI(TAG, "Initializing volume control...");
 
-    adc_handle = (adc_oneshot_unit_handle_t)battery_get_adc_handle();
-    if (adc_handle == NULL) {
-        ESP_LOGE(TAG, "ADC handle not available -- is battery_init() called first?");
-        return ESP_FAIL;
-    }
-
-    adc_oneshot_chan_cfg_t chan_config = {
-        .bitwidth = ADC_BITWIDTH_12,
-        .atten = ADC_ATTEN_DB_12,
+    adc_service_subscription_t reading = {
+        .channel = VOLUME_ADC_CHANNEL,
+        .interval_ms = VOLUME_POLL_MS,
+        .ema_shift = EMA_ALPHA_SHIFT,
+        .on_value = pot_reading,
     };
-
-    esp_err_t ret = adc_oneshot_config_channel(adc_handle, VOLUME_ADC_CHANNEL, &chan_config);
+    esp_err_t ret = adc_service_subscribe(&reading, &subscription);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "ADC channel config failed: %d", ret);
-        adc_handle = NULL;
+        ESP_LOGE(TAG, "ADC subscribe failed: %s", esp_err_to_name(ret));
         return ret;
     }
 
@@ -151,8 +120,6 @@ esp_err_t volume_control_start(void)
     }
 
     running = true;
-    xTaskCreate(volume_task, "vol_ctrl", 4096, NULL, 3, &volume_task_handle);
-
     return ESP_OK;
 }
 
@@ -161,10 +128,6 @@ esp_err_t volume_control_stop(void)
     if (!running) return ESP_OK;
 
     running = false;
-    if (volume_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(200));
-        volume_task_handle = NULL;
-    }
     return ESP_OK;
 }
 
@@ -177,7 +140,8 @@ void volume_control_deinit(void)
 {
     if (!initialized) return;
     volume_control_stop();
-    adc_handle = NULL;
+    adc_service_unsubscribe(subscription);
+    subscription = -1;
     initialized = false;
 }
 
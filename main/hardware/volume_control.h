@@ -15,25 +15,24 @@
 /**
  * @brief Initialize volume control
  *
- * Must be called after battery_init() so the ADC1 unit handle
- * can be shared. Configures ADC1_CH1 for reading the volume pot.
+ * Adds ADC1_CH1 (the volume pot) to the shared ADC scan.
  *
  * @return ESP_OK on success
  */
 esp_err_t volume_control_init(void);
 
 /**
- * @brief Start the volume control task
+ * @brief Start following the pot
  *
- * Spawns a FreeRTOS task that reads the pot every 100ms and
- * updates the codec output volume when a change is detected.
+ * The ADC service delivers the smoothed pot position every 50ms and
+ * the codec output volume is updated when a change is detected.
  *
  * @return ESP_OK on success
  */
 esp_err_t volume_control_start(void);
 
 /**
- * @brief Stop the volume control task
+ * @brief Stop following the pot
  * @return ESP_OK on success
  */
 esp_err_t volume_control_stop(void);
@@ -22,13 +22,29 @@
 #include "system/diagnostics.h"
 #include "system/power_manager.h"
 #include "system/call_module.h"
+#include "system/pack_manager.h"
+#include "system/task_map.h"
+#include "system/latency.h"
+#include "system/trace.h"
+#include "system/packet_capture.h"
+#include "system/startup.h"
+#include "system/settings.h"
+#include "platform/mem_arena.h"
 #include "audio/audio_codec.h"
 #include "audio/audio_opus.h"
 #include "audio/audio_processor.h"
+#include "audio/audio_dsp.h"
+#include "audio/audio_vad.h"
+#include "audio/audio_aec.h"
 #include "audio/audio_tones.h"
 #include "audio/audio_jitter_buffer.h"
+#include "audio/audio_rate_control.h"
+#include "audio/audio_drift.h"
+#include "audio/audio_engine.h"
 #include "network/wifi_manager.h"
 #include "network/udp_transport.h"
+#include "network/control_channel.h"
+#include "network/channel_manager.h"
 #include "hardware/gpio_control.h"
 #include "hardware/ptt_control.h"
 #include "hardware/battery.h"
@@ -43,12 +59,65 @@
 #endif
 #endif
 
+#if BENCHMARK_MODE_ENABLE
+#include "benchmark.h"
+#endif
+
+#if SOAK_MODE_ENABLE
+#include "soak_test.h"
+#endif
+
 static const char *TAG = "MAIN";
 
+#if JITTER_BUFFER_ENABLE && DEVICE_TYPE_PACK
+// Receive jitter buffer for the base station's stream, and the base's
+// clock drift against our I2S
+static jitter_buffer_t rx_jitter;
+static audio_drift_t rx_drift;
+static volatile uint32_t rx_stream_addr = 0;    // Sender of that stream (latency)
+#elif !JITTER_BUFFER_ENABLE
+// Decoded straight in the RX handler
+static audio_limiter_t rx_limiter;
+#endif
+
+// Echo removed from every captured frame by the engine, referenced to the
+// playout: headset echo on the pack, party-line hybrid return on the base
+#define ENGINE_AEC (JITTER_BUFFER_ENABLE && AEC_ENABLE)
+
+#if ENGINE_AEC
+static audio_aec_t echo_canceller;
+#endif
+
+#if DEVICE_TYPE_PACK
+// Mic level and peaks before encode
+static audio_limiter_t mic_limiter;
+#elif !JITTER_BUFFER_ENABLE
+// Line silence detection for DTX (pack_manager has its own with the mixer)
+static audio_vad_t line_vad;
+#endif
+
 //=============================================================================
 // CALLBACK HANDLERS
 //=============================================================================
 
+#if DEVICE_TYPE_PACK
+// Queue one of the config_pack.h alerts into the headset playout
+static void play_alert(const tone_config_t *tone)
+{
+    esp_err_t ret = audio_tones_play_pattern(tone->frequency_hz, tone->duration_ms,
+                                             tone->repeat_count, tone->repeat_interval_ms,
+                                             TONE_LEVEL);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Tone queue full - %d Hz alert dropped", tone->frequency_hz);
+    }
+#if (BATTERY_MODE != BATTERY_NONE)
+    // An idle pack has its audio off; the monitor idles it again once the
+    // alert has played
+    power_manager_wake();
+#endif
+}
+#endif
+
 #if !TEST_MODE_ENABLE
 static void wifi_event_handler(wifi_event_type_t event, void *data)
 {
@@ -58,18 +127,44 @@ static void wifi_event_handler(wifi_event_type_t event, void *data)
             device_manager_set_state(DEVICE_STATE_CONNECTED);
             device_manager_update_wifi(true, 0);
             gpio_control_set_led(LED_STATUS, LED_OFF);  // Connected = OK = off
+            // Nothing from before the drop is worth playing, and the gap
+            // is not packet loss
+            udp_transport_resync();
+#if JITTER_BUFFER_ENABLE && DEVICE_TYPE_PACK
+            jitter_buffer_reset(&rx_jitter);
+#endif
+#if DEVICE_TYPE_PACK
+            // A short drop is over before its disconnect tone would be
+            audio_tones_stop();
+            if (TONE_CONNECTED_ENABLE) play_alert(&TONE_CONNECTED);
+
+            // Over lwIP a pack has no link until DHCP is done
+            if (!udp_transport_backend_uses_ip()) {
+                startup_mark(STARTUP_LINK_UP);
+            }
+#else
+            startup_mark(STARTUP_LINK_UP);
+#endif
             break;
         case WIFI_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "WiFi disconnected");
             device_manager_set_state(DEVICE_STATE_DISCONNECTED);
             device_manager_update_wifi(false, 0);
             gpio_control_set_led(LED_STATUS, LED_BLINK_FAST);  // Disconnected = fast flash
+#if DEVICE_TYPE_PACK
+            if (TONE_DISCONNECTED_ENABLE) play_alert(&TONE_DISCONNECTED);
+#endif
             break;
         case WIFI_EVENT_GOT_IP:
             ESP_LOGI(TAG, "Got IP address");
+            startup_mark(STARTUP_LINK_UP);
+#if DEVICE_TYPE_PACK && DOWNLINK_MULTICAST_ENABLE
+            udp_transport_join_multicast();
+#endif
             break;
         case WIFI_EVENT_STA_JOINED:
             ESP_LOGI(TAG, "Belt pack connected");
+            udp_transport_resync();
             break;
         case WIFI_EVENT_STA_LEFT:
             ESP_LOGW(TAG, "Belt pack disconnected");
@@ -78,42 +173,71 @@ static void wifi_event_handler(wifi_event_type_t event, void *data)
 }
 #endif // !TEST_MODE_ENABLE
 
-// Track whether we have an active audio stream (received at least one packet recently)
-static volatile int64_t last_audio_rx_time_us = 0;
-
 #if !TEST_MODE_ENABLE
 static void udp_rx_handler(const uint8_t *opus_data, uint16_t opus_size,
-                           bool remote_ptt_active, bool remote_call_active)
+                           bool remote_ptt_active, bool remote_call_active,
+                           uint32_t sequence, uint32_t timestamp,
+                           uint32_t source_addr, bool mix_minus, bool dtx)
 {
     device_manager_packet_received();
-    last_audio_rx_time_us = esp_timer_get_time();
+    latency_note_arrival(source_addr, timestamp);
 
 #if DEVICE_TYPE_PACK && (BATTERY_MODE != BATTERY_NONE)
-    power_manager_activity();
+    // Live audio keeps the radio awake; comfort-noise updates on a silent
+    // line do not
+    if (!dtx) {
+        power_manager_activity();
+    }
 #endif
 
+#if DEVICE_TYPE_BASE && JITTER_BUFFER_ENABLE
+    // Each pack has its own jitter buffer and decoder; PTT mirror and call
+    // reflect any connected pack
+    pack_manager_receive(source_addr, opus_data, opus_size, sequence, timestamp,
+                         remote_ptt_active, remote_call_active);
+    call_module_remote_signal(pack_manager_any_call());
+    gpio_control_set_led(LED_PTT_MIRROR, pack_manager_any_ptt() ? LED_ON : LED_OFF);
+#else
+    (void)source_addr;
     call_module_remote_signal(remote_call_active);
 
 #if DEVICE_TYPE_BASE
     gpio_control_set_led(LED_PTT_MIRROR, remote_ptt_active ? LED_ON : LED_OFF);
 #endif
+#endif
 
-    int16_t pcm_output[SAMPLES_PER_FRAME];
+#if JITTER_BUFFER_ENABLE
+#if DEVICE_TYPE_PACK
+    // Decoding happens at playout time in the audio engine
+    // Our own mix-minus (no self echo) wins over the broadcast copy
+    jitter_buffer_set_low_latency(&rx_jitter, udp_transport_link_low_latency(source_addr));
+    jitter_buffer_push(&rx_jitter, opus_data, opus_size, sequence, timestamp, mix_minus, dtx);
+    audio_drift_note_arrival(&rx_drift, timestamp);
+    rx_stream_addr = source_addr;
+#endif
+#else
+    (void)sequence;
+    (void)timestamp;
+    (void)mix_minus;
+    (void)dtx;
+
+    int16_t AUDIO_DSP_ALIGN pcm_output[SAMPLES_PER_FRAME];
     int decoded = audio_opus_decode(opus_data, opus_size, pcm_output, SAMPLES_PER_FRAME, 0);
 
     if (decoded > 0) {
-        audio_processor_limit(pcm_output, decoded, LIMITER_THRESHOLD);
-#if JITTER_BUFFER_ENABLE
-        jitter_buffer_push(pcm_output, decoded);
-#else
+        audio_processor_limiter_process(&rx_limiter, pcm_output, decoded);
         audio_codec_write(pcm_output, decoded);
-#endif
     }
+#endif
 }
 #endif // !TEST_MODE_ENABLE
 
 static void ptt_state_handler(ptt_state_t state, bool transmitting)
 {
+#if DEVICE_TYPE_PACK && LISTEN_CAPTURE_OFF
+    // First, so the mic is up at the next frame boundary
+    audio_engine_set_capture(transmitting);
+#endif
     ESP_LOGI(TAG, "PTT: %s", transmitting ? "ON" : "OFF");
     device_manager_set_ptt_state(state);
 
@@ -128,6 +252,7 @@ static void ptt_state_handler(ptt_state_t state, bool transmitting)
     }
 
 #if (BATTERY_MODE != BATTERY_NONE)
+    power_manager_set_talking(transmitting);
     if (transmitting) {
         power_manager_activity();
     }
@@ -146,6 +271,15 @@ static void call_state_handler(call_state_t state, bool is_calling)
 
     ESP_LOGI(TAG, "Call: %s", state_str);
 
+#if DEVICE_TYPE_PACK
+    if (TONE_CALL_ENABLE && (state == CALL_OUTGOING || state == CALL_INCOMING)) {
+        play_alert(&TONE_CALL);
+    }
+#else
+    // A pack calling the base is relayed onto the party line
+    clearcom_line_call_assert(call_module_is_being_called());
+#endif
+
     if (state == CALL_OUTGOING) {
         gpio_control_set_led(LED_CALL, LED_BLINK_SLOW);
     } else if (state == CALL_INCOMING || state == CALL_ACKNOWLEDGED) {
@@ -179,11 +313,9 @@ static void battery_status_handler(float voltage, uint8_t percent,
     device_manager_update_battery(voltage);
 
     if (is_critical && TONE_BATTERY_CRITICAL_ENABLE) {
-        audio_tones_play(TONE_BATTERY_CRITICAL.frequency_hz,
-                        TONE_BATTERY_CRITICAL.duration_ms, 0.3f);
+        play_alert(&TONE_BATTERY_CRITICAL);
     } else if (is_low && TONE_BATTERY_LOW_ENABLE) {
-        audio_tones_play(TONE_BATTERY_LOW.frequency_hz,
-                        TONE_BATTERY_LOW.duration_ms, 0.3f);
+        play_alert(&TONE_BATTERY_LOW);
     }
 }
 #endif // BATTERY_MODE == BATTERY_INTERNAL
@@ -191,101 +323,110 @@ static void battery_status_handler(float voltage, uint8_t percent,
 #if (BATTERY_MODE != BATTERY_NONE)
 static void power_state_handler(power_state_t state)
 {
+    static power_state_t last_state = POWER_STATE_LISTEN;
+
     ESP_LOGI(TAG, "Power: %s",
-             state == POWER_STATE_ACTIVE ? "ACTIVE" :
-             state == POWER_STATE_LIGHT_SLEEP ? "LIGHT_SLEEP" : "DEEP_SLEEP");
+             state == POWER_STATE_LISTEN ? "LISTEN" :
+             state == POWER_STATE_TALK ? "TALK" :
+             state == POWER_STATE_IDLE ? "IDLE" : "DEEP_SLEEP");
+
+#if JITTER_BUFFER_ENABLE
+    // Out of idle, before the engine restarts: what was buffered while
+    // audio was off (comfort-noise updates) is stale
+    if (last_state == POWER_STATE_IDLE && state != POWER_STATE_IDLE) {
+        jitter_buffer_reset(&rx_jitter);
+    }
+#endif
+    last_state = state;
 }
 #endif // BATTERY_MODE != BATTERY_NONE
 #endif // DEVICE_TYPE_PACK
 
 //=============================================================================
-// AUDIO TASK
+// AUDIO ENGINE HANDLERS
 //=============================================================================
 
-static void audio_task(void *arg)
+#if !TEST_MODE_ENABLE
+#if !(DEVICE_TYPE_BASE && JITTER_BUFFER_ENABLE)
+// Encode straight into a transport TX slot - no intermediate buffer.
+// Skipped DTX frames are still encoded so the encoder state stays whole.
+static void transmit_frame(const int16_t *pcm, bool call_active, audio_dtx_action_t action)
 {
-    ESP_LOGI(TAG, "Audio task started");
-    esp_task_wdt_add(NULL);
-
-    int16_t pcm_input[SAMPLES_PER_FRAME];
-    uint8_t opus_data[OPUS_MAX_PACKET_SIZE];
+    size_t capacity;
+    uint8_t *payload = udp_transport_acquire_tx_buffer(&capacity);
+    if (!payload) {
+        return;
+    }
 
-    while (1) {
-        // I2S read blocks until DMA buffer fills (~20ms at 16kHz)
-        // This naturally paces the loop - no additional delay needed
-        esp_task_wdt_reset();
-        esp_err_t ret = audio_codec_read(pcm_input, SAMPLES_PER_FRAME, NULL);
+    int encoded_bytes = audio_opus_encode(pcm, SAMPLES_PER_FRAME, payload, capacity);
+    if (encoded_bytes > 0 && action == AUDIO_DTX_SEND) {
+        udp_transport_commit_tx_buffer(payload, encoded_bytes, true, call_active);
+        latency_note_send();
+    } else if (encoded_bytes > 0 && action == AUDIO_DTX_UPDATE) {
+        udp_transport_commit_dtx_update(payload, encoded_bytes, call_active);
+    } else {
+        udp_transport_release_tx_buffer(payload);
+        udp_transport_flush();
+    }
+}
+#endif
 
-        if (ret == ESP_OK) {
+// One captured frame per I2S frame event
+static void capture_handler(const int16_t *pcm, size_t samples)
+{
 #if DEVICE_TYPE_BASE
-            // Base always transmits partyline audio to the pack
-            int encoded_bytes = audio_opus_encode(pcm_input, SAMPLES_PER_FRAME,
-                                                  opus_data, OPUS_MAX_PACKET_SIZE);
-            if (encoded_bytes > 0) {
-                bool call_active = call_module_is_calling();
-                udp_transport_send(opus_data, encoded_bytes, true, call_active);
-            }
-#elif DEVICE_TYPE_PACK
-            // Pack only transmits when PTT is active
-            if (ptt_control_is_transmitting()) {
-                int encoded_bytes = audio_opus_encode(pcm_input, SAMPLES_PER_FRAME,
-                                                      opus_data, OPUS_MAX_PACKET_SIZE);
-                if (encoded_bytes > 0) {
-                    bool call_active = call_module_is_calling();
-                    udp_transport_send(opus_data, encoded_bytes, true, call_active);
-                }
-            }
+    // Hum, DC and line hiss out before anything is encoded
+    int16_t AUDIO_DSP_ALIGN line_pcm[SAMPLES_PER_FRAME];
+    memcpy(line_pcm, pcm, samples * sizeof(int16_t));
+    clearcom_line_process_input(line_pcm, samples);
 #endif
-        }
+#if DEVICE_TYPE_BASE && JITTER_BUFFER_ENABLE
+    // Base always transmits: party line plus the other packs,
+    // without each talking pack's own voice
+    pack_manager_transmit(line_pcm, samples, call_module_is_calling());
+#elif DEVICE_TYPE_BASE
+    // Base transmits partyline audio to the pack (comfort-noise updates
+    // only while the line is silent)
+    transmit_frame(line_pcm, call_module_is_calling(),
+                   audio_vad_frame(&line_vad, line_pcm, samples, false));
+#elif DEVICE_TYPE_PACK
+    // Pack only transmits when PTT is active (echo already cancelled by
+    // the engine; with LISTEN_CAPTURE_OFF there are no frames otherwise,
+    // and the canceller picks up from the filter it had)
+    if (ptt_control_is_transmitting()) {
+        int16_t AUDIO_DSP_ALIGN mic_pcm[SAMPLES_PER_FRAME];
+        memcpy(mic_pcm, pcm, samples * sizeof(int16_t));
+        audio_processor_limiter_process(&mic_limiter, mic_pcm, samples);
+        transmit_frame(mic_pcm, call_module_is_calling(), AUDIO_DTX_SEND);
+    } else {
+        // Frames still held for a bundle go out now
+        udp_transport_flush();
     }
+#endif
 }
 
-//=============================================================================
-// JITTER BUFFER PLAYBACK TASK
-//=============================================================================
-
 #if JITTER_BUFFER_ENABLE
-static void jitter_playback_task(void *arg)
+#if DEVICE_TYPE_PACK
+static int pull_rx_frame(void *ctx, int16_t *pcm, size_t samples)
 {
-    ESP_LOGI(TAG, "Jitter playback task started");
-
-    TickType_t last_wake = xTaskGetTickCount();
-    int16_t pcm_frame[SAMPLES_PER_FRAME];
-    int64_t last_underrun_log_us = 0;
-
-    while (1) {
-        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(FRAME_SIZE_MS));
+    return jitter_buffer_decode_next(&rx_jitter, NULL, pcm, samples);
+}
+#endif
 
-        if (jitter_buffer_pop(pcm_frame, SAMPLES_PER_FRAME)) {
-            audio_codec_write(pcm_frame, SAMPLES_PER_FRAME);
-        } else {
-            // No frame available - check if we have an active audio stream
-            // If no packets received in the last 500ms, don't write anything
-            // to I2S (avoids amplifying digital noise when disconnected)
-            int64_t now_us = esp_timer_get_time();
-            bool stream_active = (last_audio_rx_time_us > 0) &&
-                                 (now_us - last_audio_rx_time_us < 500000);
-
-            if (stream_active) {
-                // Active stream but missed a frame - use Opus PLC
-                int plc_samples = audio_opus_decode(NULL, 0, pcm_frame, SAMPLES_PER_FRAME, 1);
-                if (plc_samples > 0) {
-                    audio_codec_write(pcm_frame, plc_samples);
-                } else {
-                    memset(pcm_frame, 0, SAMPLES_PER_FRAME * sizeof(int16_t));
-                    audio_codec_write(pcm_frame, SAMPLES_PER_FRAME);
-                }
-
-                if (now_us - last_underrun_log_us > 1000000) {
-                    ESP_LOGW(TAG, "Jitter buffer underrun");
-                    last_underrun_log_us = now_us;
-                }
-            }
-            // else: no active stream, don't write to I2S (silence by omission)
-        }
-    }
+// One played frame per I2S frame event
+static size_t playout_handler(int16_t *pcm, size_t samples)
+{
+#if DEVICE_TYPE_BASE
+    // Sum every connected pack onto the party line
+    return pack_manager_mix(pcm, samples) > 0 ? samples : 0;
+#else
+    // Resampled by the base's measured clock drift
+    int produced = audio_drift_playout(&rx_drift, pull_rx_frame, NULL, pcm, samples);
+    return produced > 0 ? (size_t)produced : 0;
+#endif
 }
 #endif // JITTER_BUFFER_ENABLE
+#endif // !TEST_MODE_ENABLE
 
 //=============================================================================
 // MONITORING TASK
@@ -309,9 +450,33 @@ static void monitor_task(void *arg)
         // Check for remote call signal timeout
         call_module_check_timeout();
 
+#if !TEST_MODE_ENABLE
+        // Exchange link reports and retune the encoder
+        {
+            jitter_buffer_stats_t rx_stats = {0};
+#if JITTER_BUFFER_ENABLE && DEVICE_TYPE_BASE
+            pack_manager_get_worst_stats(&rx_stats);
+#elif JITTER_BUFFER_ENABLE
+            jitter_buffer_get_stats(&rx_jitter, &rx_stats);
+#endif
+            audio_rate_control_tick(&rx_stats);
+            packet_capture_tick(rx_stats.underruns);
+        }
+        latency_tick();
+#if DEVICE_TYPE_BASE
+        // After rate control: it holds the packs' latest loss report
+        channel_manager_tick();
+#endif
+#endif
+
 #if DEVICE_TYPE_PACK && PTT_TIMEOUT_ENABLE
         if (ptt_control_is_transmitting()) {
             ptt_transmit_time++;
+            if (TONE_PTT_TIMEOUT_ENABLE &&
+                ptt_transmit_time == PTT_TIMEOUT_SECONDS - PTT_TIMEOUT_WARN_SECONDS) {
+                ESP_LOGW(TAG, "PTT timeout in %ds", PTT_TIMEOUT_WARN_SECONDS);
+                play_alert(&TONE_PTT_TIMEOUT);
+            }
             if (ptt_transmit_time >= PTT_TIMEOUT_SECONDS) {
                 ESP_LOGE(TAG, "PTT timeout (%ds) - forcing idle", PTT_TIMEOUT_SECONDS);
                 ptt_control_force_idle();
@@ -329,16 +494,99 @@ static void monitor_task(void *arg)
                 device_manager_update_wifi(true, rssi);
             }
             device_manager_print_status();
+#if DEVICE_TYPE_BASE
+            channel_manager_print_status();
+#endif
 
             udp_stats_t stats;
             udp_transport_get_stats(&stats);
-            ESP_LOGI(TAG, "Net: TX=%lu RX=%lu Loss=%.1f%%",
+            ESP_LOGI(TAG, "Net: TX=%lu (compact %lu) RX=%lu (recovered %lu) Loss=%.1f%% resyncs=%lu",
                      (unsigned long)stats.packets_sent,
+                     (unsigned long)stats.packets_compact,
                      (unsigned long)stats.packets_received,
-                     stats.packet_loss_percent);
+                     (unsigned long)stats.frames_recovered,
+                     stats.packet_loss_percent,
+                     (unsigned long)stats.link_resyncs);
 
-            // Status LED: off=good, slow blink=packet loss, fast blink=disconnected, solid=error
-            if (!wifi_manager_is_connected()) {
+#if JITTER_BUFFER_ENABLE
+            jitter_buffer_stats_t jb_stats;
+#if DEVICE_TYPE_BASE
+            pack_manager_print_status();
+            pack_manager_get_worst_stats(&jb_stats);
+#else
+            jitter_buffer_get_stats(&rx_jitter, &jb_stats);
+            latency_note_dwell(rx_stream_addr, jb_stats.dwell_us);
+#endif
+            ESP_LOGI(TAG, "JBuf: depth=%lu/%lu jitter=%lu.%lums dwell=%lu.%lums under=%lu over=%lu qdrop=%lu",
+                     (unsigned long)jb_stats.current_depth,
+                     (unsigned long)jb_stats.target_depth,
+                     (unsigned long)(jb_stats.jitter_us / 1000),
+                     (unsigned long)((jb_stats.jitter_us % 1000) / 100),
+                     (unsigned long)(jb_stats.dwell_us / 1000),
+                     (unsigned long)((jb_stats.dwell_us % 1000) / 100),
+                     (unsigned long)jb_stats.underruns,
+                     (unsigned long)jb_stats.overruns,
+                     (unsigned long)jb_stats.queue_drops);
+#endif
+#if JITTER_BUFFER_ENABLE && OPUS_FEC_ACTIVE
+            ESP_LOGI(TAG, "FEC: expected loss=%d%% missing=%lu recovered=%lu late=%lu",
+                     audio_opus_get_packet_loss_perc(),
+                     (unsigned long)jb_stats.frames_missing,
+                     (unsigned long)jb_stats.fec_recovered,
+                     (unsigned long)jb_stats.late_drops);
+#endif
+
+            audio_engine_stats_t eng;
+            audio_engine_get_stats(&eng);
+#if JITTER_BUFFER_ENABLE && DEVICE_TYPE_PACK
+            float drift_ppm = audio_drift_get_ppm(&rx_drift);
+#else
+            float drift_ppm = 0.0f;  // Per pack on the base (pack status)
+#endif
+            ESP_LOGI(TAG, "Engine: frames=%lu (listen-only %lu, %lu switches) stalls=%lu "
+                     "overruns=%lu peak=%lu us drift=%+.1f ppm",
+                     (unsigned long)eng.frames, (unsigned long)eng.listen_frames,
+                     (unsigned long)eng.capture_switches, (unsigned long)eng.stalls,
+                     (unsigned long)eng.rx_overruns, (unsigned long)audio_engine_take_peak_us(),
+                     drift_ppm);
+            task_map_print_status();
+            trace_print_status();
+#if ENGINE_AEC
+            audio_aec_stats_t aec;
+            audio_aec_get_stats(&echo_canceller, &aec);
+            ESP_LOGI(TAG, "AEC: delay=%lu ms (moved %lu) ERLE=%.1f dB double-talk=%lu "
+                     "worst=%lu us (%s, budget %d us)",
+                     (unsigned long)aec.delay_ms, (unsigned long)aec.delay_changes,
+                     aec.erle_db, (unsigned long)aec.double_talk,
+                     (unsigned long)aec.worst_us,
+                     aec.worst_us < AEC_BUDGET_US ? "ok" : "OVER", AEC_BUDGET_US);
+#endif
+#if DEVICE_TYPE_BASE
+            clearcom_line_status_t line;
+            clearcom_line_get_status(&line);
+            ESP_LOGI(TAG, "Line: in=%.4f noise=%.4f out=%.4f dc=%d%s gate=%s",
+                     line.input_level, line.noise_level, line.output_level,
+                     line.dc_offset, line.dc_offset_detected ? " (FAULT)" : "",
+                     line.gate_open ? "open" : "closed");
+#endif
+
+            rate_control_status_t rc;
+            audio_rate_control_get_status(&rc);
+            ESP_LOGI(TAG, "Rate: %d bps cx=%d enc_peak=%lu us far_loss=%.1f%%%s",
+                     rc.bitrate_bps, rc.complexity,
+                     (unsigned long)rc.peak_encode_us,
+                     rc.remote_loss_percent,
+                     rc.remote_report_fresh ? "" : " (no report)");
+            latency_print_status();
+#if DEVICE_TYPE_BASE && TRACE_QUERY_PEERS
+            trace_query(0);
+#endif
+
+            // Status LED: off=good, slow blink=packet loss, fast blink=disconnected,
+            // solid=error; a self-test fault code has it to itself
+            if (diagnostics_get_fault() != 0) {
+                // Blinked by the self-test task
+            } else if (!wifi_manager_is_connected()) {
                 gpio_control_set_led(LED_STATUS, LED_BLINK_FAST);
             } else if (stats.packet_loss_percent > PACKET_LOSS_WARN_THRESHOLD) {
                 gpio_control_set_led(LED_STATUS, LED_BLINK_SLOW);
@@ -349,14 +597,23 @@ static void monitor_task(void *arg)
         }
 
 #if DEVICE_TYPE_PACK && (BATTERY_MODE != BATTERY_NONE)
-        bool light_sleep, deep_sleep;
-        power_manager_check_timeout(&light_sleep, &deep_sleep);
+        // Talking counts as activity for as long as PTT is held
+        if (ptt_control_is_transmitting()) {
+            power_manager_activity();
+        }
+
+        bool idle, deep_sleep;
+        power_manager_check_timeout(&idle, &deep_sleep);
 
         if (deep_sleep) {
             ESP_LOGW(TAG, "Deep sleep timeout");
             power_manager_enter_deep_sleep();
-        } else if (light_sleep) {
-            power_manager_enter_light_sleep();
+        } else if (idle && !audio_tones_is_playing()) {
+            power_manager_enter_idle();
+        }
+
+        if (stats_counter % 60 == 0) {
+            power_manager_print_status();
         }
 #endif
     }
@@ -366,14 +623,14 @@ static void monitor_task(void *arg)
 // INITIALIZATION
 //=============================================================================
 
-static esp_err_t init_subsystems(void)
+static esp_err_t audio_init_result = ESP_FAIL;
+
+// Audio lane: the whole chain up to the playout buffers, on the audio core
+// so the I2S interrupt lands with the engine
+static esp_err_t init_audio(void)
 {
     esp_err_t ret;
 
-    ESP_LOGI(TAG, "Initializing device manager...");
-    ret = device_manager_init();
-    if (ret != ESP_OK) return ret;
-
     ESP_LOGI(TAG, "Initializing audio...");
     ret = audio_codec_init();
     if (ret != ESP_OK) return ret;
@@ -383,26 +640,113 @@ static esp_err_t init_subsystems(void)
 
     ret = audio_processor_init();
     if (ret != ESP_OK) return ret;
+#if !JITTER_BUFFER_ENABLE
+    audio_processor_limiter_init(&rx_limiter, AUDIO_LIMITER_SHARED, true);
+#endif
+#if DEVICE_TYPE_PACK
+    audio_processor_limiter_init(&mic_limiter, AUDIO_LIMITER_SHARED, true);
+#elif !JITTER_BUFFER_ENABLE
+    audio_vad_init(&line_vad);
+#endif
+#if ENGINE_AEC
+    audio_aec_init(&echo_canceller);
+#endif
 
     ret = audio_tones_init();
     if (ret != ESP_OK) return ret;
 
-#if JITTER_BUFFER_ENABLE
-    ret = jitter_buffer_init();
+#if JITTER_BUFFER_ENABLE && DEVICE_TYPE_BASE
+    ret = pack_manager_init();
+    if (ret != ESP_OK) return ret;
+#if SOAK_MODE_ENABLE
+    ret = soak_test_init();
+    if (ret != ESP_OK) return ret;
+#endif
+#elif JITTER_BUFFER_ENABLE
+    ret = jitter_buffer_init(&rx_jitter);
     if (ret != ESP_OK) return ret;
 #endif
 
+    return ESP_OK;
+}
+
+static void audio_init_task(void *arg)
+{
+    audio_init_result = init_audio();
+    if (audio_init_result != ESP_OK) {
+        ESP_LOGE(TAG, "Audio init failed: %s", esp_err_to_name(audio_init_result));
+    }
+    // Marked either way: the waiter checks the result
+    startup_mark(STARTUP_AUDIO_READY);
+    task_map_exit(TASK_AUDIO_INIT);
+}
+
+static esp_err_t init_subsystems(void)
+{
+    esp_err_t ret;
+
+    ESP_LOGI(TAG, "Initializing device manager...");
+    ret = device_manager_init();
+    if (ret != ESP_OK) return ret;
+
+    // Codec and Opus come up on the audio core while this task brings up
+    // the radio: association runs in the background from wifi_manager_start
+    ret = task_map_create(TASK_AUDIO_INIT, audio_init_task, NULL, NULL);
+    if (ret != ESP_OK) return ret;
+
 #if !TEST_MODE_ENABLE
     ESP_LOGI(TAG, "Initializing network...");
     ret = wifi_manager_init(wifi_event_handler);
     if (ret != ESP_OK) return ret;
 
-    ret = wifi_manager_start();
+    // ESP-NOW needs only the radio; lwIP needs the AP/STA link
+    if (udp_transport_backend_uses_ip()) {
+#if DEVICE_TYPE_BASE
+        // The quietest channel, before the AP goes up on it
+        channel_manager_select_boot();
+#endif
+        ret = wifi_manager_start();
+    } else {
+        ret = wifi_manager_start_radio();
+    }
     if (ret != ESP_OK) return ret;
 
     ret = udp_transport_init(udp_rx_handler);
     if (ret != ESP_OK) return ret;
 
+    ret = control_channel_init();
+    if (ret != ESP_OK) return ret;
+
+    ret = channel_manager_init();
+    if (ret != ESP_OK) return ret;
+
+    ret = latency_init();
+    if (ret != ESP_OK) return ret;
+
+    ret = trace_init();
+    if (ret != ESP_OK) return ret;
+
+    ret = packet_capture_init();
+    if (ret != ESP_OK) return ret;
+
+    startup_mark(STARTUP_NETWORK_READY);
+#endif
+
+    // Everything below feeds or tunes the audio chain
+    startup_wait(STARTUP_AUDIO_READY, STARTUP_WAIT_FOREVER);
+    if (audio_init_result != ESP_OK) return audio_init_result;
+
+#if !TEST_MODE_ENABLE
+    ret = audio_rate_control_init();
+    if (ret != ESP_OK) return ret;
+
+#if DEVICE_TYPE_PACK && DOWNLINK_MULTICAST_ENABLE
+    // Already associated (GOT_IP came before the socket existed)
+    if (wifi_manager_is_connected()) {
+        udp_transport_join_multicast();
+    }
+#endif
+
     ret = udp_transport_start();
     if (ret != ESP_OK) return ret;
 #else
@@ -422,7 +766,7 @@ static esp_err_t init_subsystems(void)
     if (ret != ESP_OK) return ret;
 
 #if DEVICE_TYPE_PACK
-    // battery_init always runs to create the shared ADC1 handle (used by volume control)
+    // Battery and volume pot are channels of the shared ADC scan (adc_service)
 #if (BATTERY_MODE == BATTERY_INTERNAL)
     ret = battery_init(battery_status_handler);
 #else
@@ -435,7 +779,6 @@ static esp_err_t init_subsystems(void)
     if (ret != ESP_OK) return ret;
 #endif
 
-    // Volume pot shares ADC1 with battery -- must init after battery
     ret = volume_control_init();
     if (ret != ESP_OK) return ret;
     ret = volume_control_start();
@@ -485,6 +828,10 @@ void app_main(void)
 
     diagnostics_print_system_info();
 
+    // Start-up splits across tasks from here
+    ESP_ERROR_CHECK(startup_init());
+    mem_arena_init();
+
     // Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -495,6 +842,15 @@ void app_main(void)
 
     esp_log_level_set("*", LOG_LEVEL);
 
+    // Saved settings, before anything reads them
+    settings_init();
+
+#if BENCHMARK_MODE_ENABLE
+    // Nothing else runs, so the audio core is the benchmark's alone
+    benchmark_run();
+    while (1) { vTaskDelay(pdMS_TO_TICKS(1000)); }
+#endif
+
     // Initialize all subsystems
     ret = init_subsystems();
     if (ret != ESP_OK) {
@@ -512,47 +868,89 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_task_wdt_reconfigure(&wdt_config));
     ESP_LOGI(TAG, "Watchdog configured: %ds timeout", WATCHDOG_TIMEOUT_SEC);
 
-    // Self-test
-    diagnostics_result_t diag_results;
-    ret = diagnostics_run_self_test(&diag_results);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Self-test failed!");
+    // The Opus round trip needs the encoder to itself, and the buttons and
+    // LEDs are tested before use; the rest of the self-test runs once
+    // audio is live
+    if (diagnostics_prepare_self_test() != ESP_OK) {
+        ESP_LOGE(TAG, "Opus self-test failed!");
     }
 
-    // Wait for WiFi
-    vTaskDelay(pdMS_TO_TICKS(3000));
-
     // Configure audio path
 #if DEVICE_TYPE_PACK
     audio_codec_set_input(CODEC_INPUT_MIC);
     audio_codec_set_output(CODEC_OUTPUT_SPEAKER);
     audio_codec_set_input_gain(MIC_GAIN_LEVEL);
+    audio_codec_set_sidetone(SIDETONE_ENABLE, SIDETONE_LEVEL);
 #else
     audio_codec_set_input(CODEC_INPUT_LINE);
     audio_codec_set_output(CODEC_OUTPUT_LINE);
     audio_codec_set_input_gain(PARTYLINE_INPUT_GAIN);
 #endif
 
+    // Saved settings over the build defaults just applied; console up
+    settings_start();
+
     gpio_control_set_led(LED_STATUS, LED_OFF);  // Off = all OK
 
     // Start tasks
 #if TEST_MODE_ENABLE
-    // Test mode: skip audio_task to avoid I2S contention
-    ESP_LOGW(TAG, "TEST MODE - audio task disabled");
+    // Test mode: skip the audio engine to avoid I2S contention
+    ESP_LOGW(TAG, "TEST MODE - audio engine disabled");
 #else
-    xTaskCreate(audio_task, "audio", 32768, NULL, 6, NULL);
+    // Audio starts with the link, not after a fixed delay; without an AP
+    // in time it starts anyway so tones and local audio work meanwhile
+    if (!startup_wait(STARTUP_LINK_UP, STARTUP_LINK_TIMEOUT_MS)) {
+        ESP_LOGW(TAG, "No link after %d ms - starting audio without it",
+                 STARTUP_LINK_TIMEOUT_MS);
+    }
+
+    // Capture and playout both run off the I2S frame clock
+    audio_engine_config_t engine_cfg = {
+        .capture = capture_handler,
 #if JITTER_BUFFER_ENABLE
-    xTaskCreate(jitter_playback_task, "jitter_pb", 8192, NULL, 6, NULL);
+        .playout = playout_handler,
+#endif
+#if DEVICE_TYPE_PACK
+        .tones = true,
+#endif
+#if DEVICE_TYPE_BASE
+        .sink = clearcom_line_write,
+#endif
+#if ENGINE_AEC
+        .echo = &echo_canceller,
+#endif
+    };
+    ESP_ERROR_CHECK(audio_engine_start(&engine_cfg));
+#if DEVICE_TYPE_PACK && LISTEN_CAPTURE_OFF
+    // Packs mostly listen: the mic stays powered down until PTT
+    audio_engine_set_capture(ptt_control_is_transmitting());
 #endif
+    startup_mark(STARTUP_AUDIO_LIVE);
 #endif
-    xTaskCreate(monitor_task, "monitor", 4096, NULL, 3, NULL);
+    task_map_create(TASK_MONITOR, monitor_task, NULL, NULL);
+
+    // Every pipeline buffer is placed by now: report and close the arena
+    mem_arena_seal();
+
+    if (diagnostics_start_self_test() != ESP_OK) {
+        ESP_LOGE(TAG, "Self-test not started");
+    }
 
     ESP_LOGI(TAG, "System ready");
+    startup_print();
 
 #if TEST_MODE_ENABLE
+    // Test mode drives the LEDs and codec itself: let the self-test finish
+    startup_wait(STARTUP_SELF_TEST_DONE, STARTUP_WAIT_FOREVER);
     vTaskDelay(pdMS_TO_TICKS(2000));
     test_mode_start();
 #endif
 
+#if SOAK_MODE_ENABLE
+    if (soak_test_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Soak test not started");
+    }
+#endif
+
     device_manager_set_state(DEVICE_STATE_CONNECTED);
 }
@@ -0,0 +1,182 @@
+/**
+ * @file audio_packet.c
+ * @brief Audio Packet Framing Implementation
+ */
+
+#include "audio_packet.h"
+#include "../config.h"
+#include <string.h>
+
+#define FRAME_US           ((uint32_t)FRAME_SIZE_MS * 1000)
+
+_Static_assert(AUDIO_PACKET_REPEAT_WINDOW <= 32, "received_mask is 32 bits");
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+// Full header: recognised by a length that agrees with opus_size
+static bool parse_full(const uint8_t *data, size_t len, audio_packet_frame_t *frame)
+{
+    const audio_packet_t *packet = (const audio_packet_t *)data;
+
+    if (len < AUDIO_PACKET_HEADER_SIZE || packet->opus_size != len - AUDIO_PACKET_HEADER_SIZE ||
+        packet->group >= UDP_MAX_GROUPS) {
+        return false;
+    }
+
+    frame->sequence = packet->sequence;
+    frame->timestamp = packet->timestamp;
+    frame->payload = packet->opus_data;
+    frame->size = packet->opus_size;
+    frame->flags = packet->flags;
+    frame->group = packet->group;
+    frame->compact = false;
+    return true;
+}
+
+static bool parse_compact(const uint8_t *data, size_t len, audio_packet_frame_t *frame)
+{
+    const compact_header_t *header = (const compact_header_t *)data;
+
+    uint8_t type = header->version_group >> 4;
+    if (len < AUDIO_PACKET_COMPACT_SIZE ||
+        (type != UDP_COMPACT_V1 && type != UDP_COMPACT_V1_BUNDLE)) {
+        return false;
+    }
+
+    frame->sequence = header->sequence;
+    frame->timestamp = header->frame;
+    frame->payload = data + AUDIO_PACKET_COMPACT_SIZE;
+    frame->size = (uint16_t)(len - AUDIO_PACKET_COMPACT_SIZE);
+    frame->flags = header->flags_device >> 4;
+    if (type == UDP_COMPACT_V1_BUNDLE) {
+        frame->flags |= PACKET_FLAG_BUNDLE;
+    }
+    frame->group = header->version_group & 0x0F;
+    frame->compact = true;
+    return true;
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+size_t audio_packet_write_full(audio_packet_t *packet, uint32_t sequence, uint32_t timestamp_us,
+                               uint8_t flags, uint8_t group, uint16_t size)
+{
+    packet->sequence = sequence;
+    packet->timestamp = timestamp_us;
+    packet->opus_size = size;
+    packet->flags = flags;
+    packet->group = group;
+    return AUDIO_PACKET_HEADER_SIZE + size;
+}
+
+uint8_t *audio_packet_write_compact(uint8_t *payload, uint32_t sequence, uint32_t frame,
+                                    uint8_t flags, uint8_t group, uint8_t device_id)
+{
+    uint8_t type = (flags & PACKET_FLAG_BUNDLE) ? UDP_COMPACT_V1_BUNDLE : UDP_COMPACT_V1;
+    compact_header_t *header = (compact_header_t *)(payload - AUDIO_PACKET_COMPACT_SIZE);
+
+    header->version_group = (uint8_t)(type << 4 | (group & 0x0F));
+    header->flags_device = (uint8_t)((flags & AUDIO_PACKET_COMPACT_FLAGS) << 4 | (device_id & 0x0F));
+    header->sequence = (uint16_t)sequence;
+    header->frame = (uint16_t)frame;
+    return (uint8_t *)header;
+}
+
+bool audio_packet_parse(const uint8_t *data, size_t len, audio_packet_frame_t *frame)
+{
+    if (!data || !frame) return false;
+
+    return parse_full(data, len, frame) || parse_compact(data, len, frame);
+}
+
+void audio_packet_unwrap(audio_packet_stream_t *stream, audio_packet_frame_t *frame)
+{
+    uint16_t sequence = (uint16_t)frame->sequence;
+    uint16_t frame_low = (uint16_t)frame->timestamp;
+
+    if (stream->valid) {
+        frame->sequence = stream->last_sequence + (int16_t)(sequence - (uint16_t)stream->last_sequence);
+    }
+
+    uint32_t frame_count = frame_low;
+    if (stream->frame_valid) {
+        frame_count = stream->last_frame + (int16_t)(frame_low - (uint16_t)stream->last_frame);
+    }
+    if (!stream->frame_valid || (int32_t)(frame_count - stream->last_frame) > 0) {
+        stream->last_frame = frame_count;
+        stream->frame_valid = true;
+    }
+    frame->timestamp = frame_count * FRAME_US;
+}
+
+int32_t audio_packet_track(audio_packet_stream_t *stream, uint32_t sequence)
+{
+    int32_t lost = 0;
+
+    if (stream->valid) {
+        int32_t behind = (int32_t)(stream->last_sequence - sequence);
+        if (behind >= 0 && behind < AUDIO_PACKET_REPEAT_WINDOW) {
+            uint32_t bit = 1u << behind;
+            if (stream->received_mask & bit) {
+                return -1;
+            }
+            stream->received_mask |= bit;
+            return 0;
+        }
+
+        uint32_t expected_seq = stream->last_sequence + 1;
+        if (sequence > expected_seq) {
+            lost = (int32_t)(sequence - expected_seq);
+        }
+        if (behind < 0 && -behind < AUDIO_PACKET_REPEAT_WINDOW) {
+            stream->received_mask = (stream->received_mask << -behind) | 1u;
+        } else {
+            stream->received_mask = 1u;
+        }
+    } else {
+        stream->received_mask = 1u;
+    }
+    stream->valid = true;
+    stream->last_sequence = sequence;
+    return lost;
+}
+
+size_t audio_packet_split_bundle(const audio_packet_frame_t *bundle,
+                                 audio_packet_frame_t *frames, size_t *redundant)
+{
+    const uint8_t *header = bundle->payload;
+    size_t count = bundle->size > 0 ? (header[0] & 0x0F) : 0;
+
+    if (count == 0 || count > UDP_BUNDLE_MAX_FRAMES || bundle->size < 1 + count) {
+        return 0;
+    }
+    if (redundant) {
+        *redundant = header[0] >> 4;
+    }
+
+    const uint8_t *data = &header[1 + count];
+    size_t remaining = bundle->size - 1 - count;
+
+    for (size_t i = 0; i < count; i++) {
+        size_t size = header[1 + i];
+        if (size > remaining) {
+            return i;
+        }
+
+        uint32_t older = (uint32_t)(count - 1 - i);
+        frames[i] = *bundle;
+        frames[i].sequence -= older;
+        frames[i].timestamp -= older * FRAME_US;
+        frames[i].payload = data;
+        frames[i].size = (uint16_t)size;
+        frames[i].flags &= ~PACKET_FLAG_BUNDLE;
+
+        data += size;
+        remaining -= size;
+    }
+    return count;
+}
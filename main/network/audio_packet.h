@@ -0,0 +1,184 @@
+/**
+ * @file audio_packet.h
+ * @brief Audio Packet Framing
+ *
+ * Wire formats (full and compact headers, frame bundles) and the
+ * per-sender receive state: parsing a datagram in place, extending
+ * compact 16-bit fields, sequence and loss tracking and splitting
+ * bundles. Nothing here touches the network or the OS, so the same code
+ * runs in udp_transport.c and in the host simulator (host/).
+ */
+
+#ifndef AUDIO_PACKET_H
+#define AUDIO_PACKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//=============================================================================
+// PACKET STRUCTURE
+//=============================================================================
+
+#define UDP_MAX_PACKET_SIZE  512
+
+// Group IDs 0..UDP_MAX_GROUPS-1; each has its own TX sequence space
+#define UDP_MAX_GROUPS       16
+
+typedef struct __attribute__((packed)) {
+    uint32_t sequence;           // Incrementing packet number
+    uint32_t timestamp;          // Microsecond timestamp
+    uint16_t opus_size;          // Size of Opus data
+    uint8_t  flags;              // Bit 0: PTT, Bit 1: Call, Bit 2: Mix-minus, Bit 3: DTX
+    uint8_t  group;              // Intercom group (INTERCOM_GROUP_ID)
+    uint8_t  opus_data[256];     // Opus compressed audio
+} audio_packet_t;
+
+// Compact audio header (UDP_FORMAT_COMPACT), sent in place of the
+// audio_packet_t header to peers that announced support for it. The
+// payload size is the rest of the datagram, the sequence and timestamp
+// are the low 16 bits of the full values (the receiver unwraps them per
+// sender) and the timestamp counts frames of the sender's audio clock.
+// Control packets always use audio_packet_t.
+typedef struct __attribute__((packed)) {
+    uint8_t  version_group;      // UDP_COMPACT_V1 (or _BUNDLE) << 4 | group
+    uint8_t  flags_device;       // PTT/Call/Mix-minus/DTX << 4 | device ID (low 4 bits)
+    uint16_t sequence;           // Low 16 bits of the sequence
+    uint16_t frame;              // Sender's frame counter (low 16 bits)
+} compact_header_t;
+
+// Version nibble of compact_header_t. A datagram whose length agrees with
+// its audio_packet_t opus_size is taken as the full header first.
+#define UDP_COMPACT_V1       0xA
+#define UDP_COMPACT_V1_BUNDLE 0xB        // Payload is a frame bundle
+
+// Wire formats a device reads, announced in CONTROL_MSG_HELLO
+#define UDP_FORMAT_LEGACY    (1 << 0)    // audio_packet_t
+#define UDP_FORMAT_COMPACT   (1 << 1)    // compact_header_t v1
+#define UDP_FORMAT_BUNDLE    (1 << 2)    // PACKET_FLAG_BUNDLE payloads
+#define UDP_FORMAT_LOW_LATENCY (1 << 3)  // Sender wants a low-latency link (LINK_LOW_LATENCY)
+
+// Frame bundles (BUNDLE_MODE): payload = one byte of redundant count r
+// << 4 | frame count n, n frame sizes (one byte each), then the frames
+// oldest first. The header's sequence and timestamp are the newest
+// frame's; frame i is n-1-i frames older. The first r frames repeat the
+// end of the previous bundle.
+#define UDP_BUNDLE_MAX_FRAMES 4
+
+// Flag bits
+#define PACKET_FLAG_PTT   (1 << 0)
+#define PACKET_FLAG_CALL  (1 << 1)
+
+// Unicast mix-minus from the base: the party line plus the other packs but
+// not the receiving pack itself. Carries the same sequence number as the
+// broadcast mix for that frame and should be preferred over it.
+#define PACKET_FLAG_MIX_MINUS (1 << 2)
+
+// Comfort-noise update: the sender's line is silent and it sends nothing
+// more until speech resumes (or the next update). Sequence numbers stay
+// contiguous across the gap.
+#define PACKET_FLAG_DTX   (1 << 3)
+
+// Payload is a frame bundle (full header; compact uses UDP_COMPACT_V1_BUNDLE)
+#define PACKET_FLAG_BUNDLE (1 << 4)
+
+// opus_data carries a control message instead of audio. Control packets
+// use their own sequence counter so they never show up as audio loss.
+#define PACKET_FLAG_CONTROL (1 << 7)
+
+// Header in front of opus_data / in front of the payload
+#define AUDIO_PACKET_HEADER_SIZE  (sizeof(audio_packet_t) - sizeof(((audio_packet_t*)0)->opus_data))
+#define AUDIO_PACKET_COMPACT_SIZE sizeof(compact_header_t)
+
+// Compact flag nibble carries the first four PACKET_FLAG_* bits
+#define AUDIO_PACKET_COMPACT_FLAGS (PACKET_FLAG_PTT | PACKET_FLAG_CALL | PACKET_FLAG_MIX_MINUS | PACKET_FLAG_DTX)
+
+// Packets up to this far behind the newest are repeats or reordered,
+// not a sender restart (one bit each in received_mask)
+#define AUDIO_PACKET_REPEAT_WINDOW 32
+
+//=============================================================================
+// RECEIVE STATE
+//=============================================================================
+
+// One received packet, either header format (payload points into the datagram)
+typedef struct {
+    uint32_t sequence;
+    uint32_t timestamp;          // Sender time, microseconds (compact: frames until unwrapped)
+    bool     compact;
+    const uint8_t *payload;
+    uint16_t size;
+    uint8_t  flags;
+    uint8_t  group;
+} audio_packet_frame_t;
+
+// Per-sender sequence and compact frame-counter state
+typedef struct {
+    bool     valid;              // last_sequence holds a received sequence
+    bool     frame_valid;        // last_frame holds a compact timestamp
+    uint32_t last_sequence;
+    uint32_t received_mask;      // Bit n: last_sequence - n has been received
+    uint32_t last_frame;         // Unwrapped compact frame counter
+} audio_packet_stream_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Fill the full header of a packet whose payload is already in opus_data
+ * @return Datagram size (header + payload)
+ */
+size_t audio_packet_write_full(audio_packet_t *packet, uint32_t sequence, uint32_t timestamp_us,
+                               uint8_t flags, uint8_t group, uint16_t size);
+
+/**
+ * @brief Write a compact header in the AUDIO_PACKET_COMPACT_SIZE bytes in front of payload
+ * @param payload   Payload, with header room in front of it
+ * @param frame     Sender's frame counter (audio clock / frame period)
+ * @param flags     PACKET_FLAG_* (PACKET_FLAG_BUNDLE selects the bundle version)
+ * @param device_id Sender's device ID (low 4 bits are sent)
+ * @return Start of the datagram (AUDIO_PACKET_COMPACT_SIZE + size bytes)
+ */
+uint8_t *audio_packet_write_compact(uint8_t *payload, uint32_t sequence, uint32_t frame,
+                                    uint8_t flags, uint8_t group, uint8_t device_id);
+
+/**
+ * @brief Parse a datagram in either header format
+ *
+ * A length that agrees with the full header's opus_size is taken as the
+ * full header first.
+ * @return false if the datagram is neither
+ */
+bool audio_packet_parse(const uint8_t *data, size_t len, audio_packet_frame_t *frame);
+
+/**
+ * @brief Extend a compact frame's 16-bit sequence and frame counter
+ *
+ * Against the sender's newest full values; the timestamp comes out in
+ * microseconds like the full header's.
+ */
+void audio_packet_unwrap(audio_packet_stream_t *stream, audio_packet_frame_t *frame);
+
+/**
+ * @brief Loss accounting for one audio frame
+ *
+ * A second copy of a frame already received (broadcast mix plus unicast
+ * mix-minus, bundle repeats) is not counted again. A reordered frame
+ * that fills a gap within AUDIO_PACKET_REPEAT_WINDOW is taken as new
+ * (its gap was already counted when the newer frame arrived).
+ * @return Frames lost in front of this one, or -1 for such a copy
+ */
+int32_t audio_packet_track(audio_packet_stream_t *stream, uint32_t sequence);
+
+/**
+ * @brief Split a bundle into its frames, oldest first
+ * @param bundle    Parsed PACKET_FLAG_BUNDLE packet
+ * @param frames    UDP_BUNDLE_MAX_FRAMES entries, pointing into the bundle
+ * @param redundant Set to the number of leading frames that repeat the last bundle
+ * @return Frames read (a truncated bundle stops at the cut), 0 if malformed
+ */
+size_t audio_packet_split_bundle(const audio_packet_frame_t *bundle,
+                                 audio_packet_frame_t *frames, size_t *redundant);
+
+#endif // AUDIO_PACKET_H
@@ -0,0 +1,343 @@
+/**
+ * @file channel_manager.c
+ * @brief AP Channel Selection and Hopping Implementation
+ *
+ * A channel's score is the share of the survey dwell taken by frames
+ * heard on it (in percent, from each frame's length and PHY rate) plus
+ * its noise floor above WIFI_SURVEY_NOISE_REF_DBM (in dB); lower is
+ * better. The survey is only taken at boot: once the AP serves packs the
+ * radio cannot leave its channel to listen, so a hop goes to the best
+ * other candidate by the boot scores, skipping channels recently left.
+ *
+ * Link quality is one figure per second: the worse of the loss on the
+ * packs' streams here and the loss the packs report on ours
+ * (audio_rate_control), judged against the weakest pack's RSSI.
+ *
+ * Every move runs on the monitor task: a channel set from the settings
+ * (which may arrive on the RX task) is only recorded, and the next tick
+ * makes the CSA and the NVS write.
+ */
+
+#include "channel_manager.h"
+#include "control_channel.h"
+#include "udp_transport.h"
+#include "wifi_manager.h"
+#include "../audio/audio_rate_control.h"
+#include "../system/settings.h"
+#include "../config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include <string.h>
+
+static const char *TAG = "CHANNEL";
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static bool initialized = false;
+
+#if DEVICE_TYPE_BASE
+static const uint8_t candidates[] = WIFI_CHANNEL_CANDIDATES;
+#define CANDIDATE_COUNT (sizeof(candidates) / sizeof(candidates[0]))
+
+static wifi_channel_survey_t survey[CANDIDATE_COUNT];
+static int scores[CANDIDATE_COUNT];          // -1 = not surveyed
+static int64_t left_us[CANDIDATE_COUNT];     // When the AP last moved off (0 = never)
+
+// Hop state (monitor task)
+static float last_loss = 0.0f;
+static int8_t last_rssi = 0;
+static uint32_t bad_seconds = 0;
+static uint32_t hops = 0;
+static int64_t last_hop_us = 0;
+
+// Set by channel_manager_request, taken by the next tick (0 = none)
+static uint8_t requested_channel = 0;
+#endif
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+#if DEVICE_TYPE_BASE
+static int candidate_index(uint8_t channel)
+{
+    for (size_t i = 0; i < CANDIDATE_COUNT; i++) {
+        if (candidates[i] == channel) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static int score_survey(const wifi_channel_survey_t *s)
+{
+    int noise_db = s->frames ? s->noise_dbm - WIFI_SURVEY_NOISE_REF_DBM : 0;
+    return s->busy_permille / 10 + (noise_db > 0 ? noise_db : 0);
+}
+
+static uint8_t load_channel(void)
+{
+    uint8_t channel = 0;
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        if (nvs_get_u8(nvs, WIFI_CHANNEL_NVS_KEY, &channel) != ESP_OK ||
+            channel < 1 || channel > 13) {
+            channel = 0;
+        }
+        nvs_close(nvs);
+    }
+    return channel;
+}
+
+static void save_channel(uint8_t channel)
+{
+    if (load_channel() == channel) return;
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_set_u8(nvs, WIFI_CHANNEL_NVS_KEY, channel) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+}
+
+// Best candidate other than the current channel; one left within
+// WIFI_CHANNEL_AVOID_S only if every other was
+static uint8_t pick_other(uint8_t current)
+{
+    int64_t now_us = esp_timer_get_time();
+    int best = -1;
+    int best_score = 0;
+    int oldest = -1;
+
+    for (size_t i = 0; i < CANDIDATE_COUNT; i++) {
+        if (candidates[i] == current) continue;
+
+        bool avoided = left_us[i] != 0 &&
+                       now_us - left_us[i] < (int64_t)WIFI_CHANNEL_AVOID_S * 1000000;
+        if (!avoided) {
+            int score = scores[i] < 0 ? 0 : scores[i];
+            if (best < 0 || score < best_score) {
+                best = (int)i;
+                best_score = score;
+            }
+        } else if (oldest < 0 || left_us[i] < left_us[oldest]) {
+            oldest = (int)i;
+        }
+    }
+
+    if (best < 0) best = oldest;
+    return best < 0 ? 0 : candidates[best];
+}
+
+#else
+static void channel_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    if (size < sizeof(control_channel_t)) {
+        return;
+    }
+
+    control_channel_t msg;
+    memcpy(&msg, payload, sizeof(msg));
+    ESP_LOGI(TAG, "Base moving to channel %d in %u ms", msg.channel, msg.switch_ms);
+    wifi_manager_note_ap_channel(msg.channel);
+}
+#endif // DEVICE_TYPE_BASE
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t channel_manager_select_boot(void)
+{
+#if DEVICE_TYPE_BASE
+    uint8_t last = load_channel();
+    uint8_t pinned = (uint8_t)settings_get_int(SETTING_CHANNEL);
+    uint8_t chosen = pinned ? pinned : last ? last : WIFI_CHANNEL;
+
+    for (size_t i = 0; i < CANDIDATE_COUNT; i++) {
+        scores[i] = -1;
+        left_us[i] = 0;
+    }
+
+    if (pinned) {
+        ESP_LOGI(TAG, "Starting on channel %d (set in settings)", chosen);
+    } else if (WIFI_AUTO_CHANNEL_ENABLE) {
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = wifi_manager_survey(candidates, CANDIDATE_COUNT,
+                                            WIFI_CHANNEL_SURVEY_MS, survey);
+        if (ret == ESP_OK) {
+            int best = 0;
+            for (size_t i = 0; i < CANDIDATE_COUNT; i++) {
+                scores[i] = score_survey(&survey[i]);
+                if (scores[i] < scores[best]) {
+                    best = (int)i;
+                }
+                ESP_LOGI(TAG, "Channel %2d: %lu frames, %u.%u%% busy, noise %d dBm, "
+                         "strongest %d dBm -> score %d", survey[i].channel,
+                         (unsigned long)survey[i].frames, survey[i].busy_permille / 10,
+                         survey[i].busy_permille % 10, survey[i].noise_dbm,
+                         survey[i].max_rssi_dbm, scores[i]);
+            }
+
+            // Packs have the last channel cached: stay unless clearly worse
+            int last_index = candidate_index(last);
+            chosen = candidates[best];
+            if (last_index >= 0 && scores[last_index] <= scores[best] + WIFI_CHANNEL_MARGIN) {
+                chosen = last;
+            }
+            ESP_LOGI(TAG, "Starting on channel %d (survey %lu ms)", chosen,
+                     (unsigned long)((esp_timer_get_time() - start_us) / 1000));
+        } else {
+            ESP_LOGW(TAG, "Survey failed (%s) - channel %d", esp_err_to_name(ret), chosen);
+        }
+    }
+
+    wifi_manager_set_ap_channel(chosen);
+    save_channel(chosen);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t channel_manager_init(void)
+{
+    if (initialized) {
+        return ESP_OK;
+    }
+
+#if DEVICE_TYPE_PACK
+    esp_err_t ret = control_channel_register(CONTROL_MSG_CHANNEL, channel_handler);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+#endif
+
+    initialized = true;
+    return ESP_OK;
+}
+
+void channel_manager_tick(void)
+{
+#if DEVICE_TYPE_BASE
+    uint8_t requested = __atomic_exchange_n(&requested_channel, 0, __ATOMIC_ACQ_REL);
+    if (requested && initialized) {
+        esp_err_t ret = channel_manager_switch(requested);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Move to channel %d failed: %s", requested, esp_err_to_name(ret));
+        }
+    }
+#endif
+#if DEVICE_TYPE_BASE && WIFI_CHANNEL_HOP_ENABLE
+    if (!initialized || !udp_transport_backend_uses_ip() ||
+        wifi_manager_get_sta_count() == 0 || settings_get_int(SETTING_CHANNEL) != 0) {
+        bad_seconds = 0;
+        return;
+    }
+
+    // The packs' streams here, as rate control measured them this second
+    rate_control_status_t rc;
+    audio_rate_control_get_status(&rc);
+    if (!rc.local_loss_fresh) {
+        bad_seconds = 0;
+        return;
+    }
+    last_loss = rc.local_loss_percent;
+    if (rc.remote_report_fresh && rc.remote_loss_percent > last_loss) {
+        last_loss = rc.remote_loss_percent;
+    }
+    last_rssi = wifi_manager_get_worst_sta_rssi();
+
+    // Weak RSSI is range: a new channel would not help
+    bool interference = last_loss > WIFI_CHANNEL_HOP_LOSS_PCT &&
+                        last_rssi != 0 && last_rssi >= WIFI_CHANNEL_HOP_RSSI_DBM;
+    bad_seconds = interference ? bad_seconds + 1 : 0;
+
+    bool held = last_hop_us != 0 &&
+                esp_timer_get_time() - last_hop_us < (int64_t)WIFI_CHANNEL_HOP_HOLD_S * 1000000;
+    if (bad_seconds >= WIFI_CHANNEL_HOP_BAD_S && !held) {
+        ESP_LOGW(TAG, "Loss %.1f%% for %lu s at RSSI >= %d dBm - changing channel",
+                 last_loss, (unsigned long)bad_seconds, last_rssi);
+        channel_manager_switch(0);
+    }
+#endif
+}
+
+esp_err_t channel_manager_request(uint8_t channel)
+{
+#if DEVICE_TYPE_BASE
+    if (!udp_transport_backend_uses_ip()) {
+        return ESP_ERR_NOT_SUPPORTED;   // No AP, so no CSA: packs would be stranded
+    }
+    if (channel < 1 || channel > 13) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&requested_channel, channel, __ATOMIC_RELEASE);
+    return ESP_OK;
+#else
+    (void)channel;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t channel_manager_switch(uint8_t channel)
+{
+#if DEVICE_TYPE_BASE
+    if (!udp_transport_backend_uses_ip()) {
+        return ESP_ERR_NOT_SUPPORTED;   // No AP, so no CSA: packs would be stranded
+    }
+
+    uint8_t current = wifi_manager_get_channel();
+    if (channel == 0) {
+        channel = pick_other(current);
+    }
+    if (channel == 0 || channel == current) {
+        return ESP_OK;
+    }
+
+    // Control notice first: it goes out on the old channel, ahead of the
+    // beacons counting down
+    control_channel_t msg = {
+        .channel = channel,
+        .device_id = DEVICE_ID,
+        .switch_ms = (uint16_t)(WIFI_CHANNEL_CSA_COUNT * 1024 / 10),  // 100 TU beacons
+    };
+    control_channel_send(CONTROL_MSG_CHANNEL, &msg, sizeof(msg));
+
+    esp_err_t ret = wifi_manager_set_ap_channel(channel);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    int index = candidate_index(current);
+    if (index >= 0) {
+        left_us[index] = esp_timer_get_time();
+    }
+    hops++;
+    last_hop_us = esp_timer_get_time();
+    bad_seconds = 0;
+    save_channel(channel);
+    return ESP_OK;
+#else
+    (void)channel;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void channel_manager_print_status(void)
+{
+#if DEVICE_TYPE_BASE
+    char line[96];
+    int len = 0;
+    for (size_t i = 0; i < CANDIDATE_COUNT && len < (int)sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, "%s%d=%d", len ? " " : "",
+                        candidates[i], scores[i]);
+    }
+    ESP_LOGI(TAG, "Channel %d, hops=%lu, loss=%.1f%% worst RSSI=%d dBm bad=%lus (scores %s)",
+             wifi_manager_get_channel(), (unsigned long)hops, last_loss, last_rssi,
+             (unsigned long)bad_seconds, len ? line : "-");
+#endif
+}
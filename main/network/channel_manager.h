@@ -0,0 +1,72 @@
+/**
+ * @file channel_manager.h
+ * @brief AP Channel Selection and Hopping
+ *
+ * The base picks its AP channel at boot from a short survey of the
+ * WIFI_CHANNEL_CANDIDATES, and while running moves the network when the
+ * link degrades in a way a new channel can fix: loss while every pack's
+ * RSSI is good, i.e. interference rather than range. A move is announced
+ * twice over - CONTROL_MSG_CHANNEL on the control channel, and the CSA in
+ * the AP's beacons that the packs' WiFi follows - so associations,
+ * sockets and the audio session carry on across it.
+ *
+ * On a pack the module only listens for the announcement and points the
+ * fast-reconnect cache at the new channel.
+ */
+
+#ifndef CHANNEL_MANAGER_H
+#define CHANNEL_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Survey the candidates and set the channel the AP starts on (base)
+ *
+ * Call between wifi_manager_init and wifi_manager_start. A channel set in
+ * the settings (SETTING_CHANNEL) is used as is, and the AP does not hop
+ * off it. Without WIFI_AUTO_CHANNEL_ENABLE, or if the survey fails, the
+ * AP starts on the channel used last time, else on WIFI_CHANNEL.
+ * @return ESP_OK (a failed survey is not fatal)
+ */
+esp_err_t channel_manager_select_boot(void);
+
+/**
+ * @brief Hook the channel announcement into the control channel
+ * @return ESP_OK on success
+ */
+esp_err_t channel_manager_init(void);
+
+/**
+ * @brief Judge the last second of link quality, hop if due (base, monitor task)
+ */
+void channel_manager_tick(void);
+
+/**
+ * @brief Move the AP at the next tick, announced to the packs (base)
+ *
+ * Safe from any task; the CSA and the NVS write run on the monitor task.
+ * A later request before the tick replaces an earlier one.
+ * @param channel New channel (1-13)
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED on the pack or the ESP-NOW backend
+ */
+esp_err_t channel_manager_request(uint8_t channel);
+
+/**
+ * @brief Move the AP now, announced to the packs (base, monitor task)
+ * @param channel New channel, or 0 for the best other candidate
+ * @return ESP_OK, ESP_ERR_NOT_SUPPORTED on the pack or the ESP-NOW backend
+ */
+esp_err_t channel_manager_switch(uint8_t channel);
+
+/**
+ * @brief Log the channel, the survey scores and the hop state
+ */
+void channel_manager_print_status(void);
+
+#endif // CHANNEL_MANAGER_H
@@ -0,0 +1,84 @@
+/**
+ * @file control_channel.c
+ * @brief Control Message Dispatch Implementation
+ */
+
+#include "control_channel.h"
+#include "udp_transport.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "CTRL";
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static bool initialized = false;
+static control_handler_t handlers[CONTROL_MSG_MAX] = {0};
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void control_rx_handler(uint32_t source_addr, const uint8_t *data, uint16_t size)
+{
+    uint8_t type = data[0];
+
+    if (type == 0 || type >= CONTROL_MSG_MAX) {
+        ESP_LOGD(TAG, "Unknown control message type %u", type);
+        return;
+    }
+
+    if (handlers[type]) {
+        handlers[type](source_addr, &data[1], size - 1);
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t control_channel_init(void)
+{
+    if (initialized) {
+        return ESP_OK;
+    }
+
+    udp_transport_set_control_callback(control_rx_handler);
+
+    initialized = true;
+    ESP_LOGI(TAG, "Control channel initialized");
+    return ESP_OK;
+}
+
+esp_err_t control_channel_register(control_msg_type_t type, control_handler_t handler)
+{
+    if (type == 0 || type >= CONTROL_MSG_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    handlers[type] = handler;
+    return ESP_OK;
+}
+
+esp_err_t control_channel_send(control_msg_type_t type, const void *payload, uint16_t size)
+{
+    return control_channel_send_to(0, type, payload, size);
+}
+
+esp_err_t control_channel_send_to(uint32_t dest, control_msg_type_t type,
+                                  const void *payload, uint16_t size)
+{
+    if (!initialized || size > CONTROL_MAX_PAYLOAD) {
+        return ESP_FAIL;
+    }
+
+    uint8_t msg[1 + CONTROL_MAX_PAYLOAD];
+    msg[0] = (uint8_t)type;
+    if (payload && size > 0) {
+        memcpy(&msg[1], payload, size);
+    }
+
+    return udp_transport_send_control(dest, msg, 1 + size);
+}
@@ -0,0 +1,209 @@
+/**
+ * @file control_channel.h
+ * @brief Control Messages Between Base and Pack
+ *
+ * Small out-of-band messages (link reports, etc.) carried in UDP packets
+ * flagged PACKET_FLAG_CONTROL. The first payload byte is the message type;
+ * modules register a handler per type.
+ */
+
+#ifndef CONTROL_CHANNEL_H
+#define CONTROL_CHANNEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+//=============================================================================
+// MESSAGE TYPES
+//=============================================================================
+
+typedef enum {
+    CONTROL_MSG_REPORT = 1,      // Receiver link report (control_report_t)
+    CONTROL_MSG_HELLO,           // Wire format negotiation (control_hello_t),
+                                 // handled inside udp_transport
+    CONTROL_MSG_PING,            // Latency probe (control_ping_t)
+    CONTROL_MSG_PONG,            // Latency probe answer (control_pong_t)
+    CONTROL_MSG_METRICS_QUERY,   // Metrics request (no body)
+    CONTROL_MSG_METRICS,         // Metrics answer (control_metrics_t)
+    CONTROL_MSG_CAPTURE,         // Packet capture request/notice (control_capture_t)
+    CONTROL_MSG_CAPTURE_DATA,    // Packet capture records (control_capture_data_t)
+    CONTROL_MSG_CHANNEL,         // AP channel move notice (control_channel_t)
+    CONTROL_MSG_SETTING,         // Run-time setting read/write (control_setting_t)
+    CONTROL_MSG_MAX
+} control_msg_type_t;
+
+// Receiver report: how the far end's stream looks from here
+typedef struct __attribute__((packed)) {
+    uint16_t loss_percent_x10;   // Audio packet loss over the last interval (0.1 %)
+    int8_t   rssi_dbm;           // Receiver's RSSI (0 = unknown)
+    uint8_t  reserved;
+    uint16_t jitter_ms_x10;      // Jitter buffer's arrival jitter estimate (0.1 ms)
+    uint16_t jitter_depth;       // Jitter buffer target depth (frames)
+} control_report_t;
+
+// Hello: the wire formats the sender reads. Sent unicast to each peer
+// heard from and refreshed periodically; firmware that predates it ignores
+// the message and keeps getting audio_packet_t.
+typedef struct __attribute__((packed)) {
+    uint8_t  formats;            // UDP_FORMAT_* bits
+    uint8_t  device_id;          // Sender's DEVICE_ID
+    uint8_t  reply;              // 1 = answer with a hello of your own
+} control_hello_t;
+
+// Ping: latency probe, answered by the receiver with a pong. Times are the
+// low 32 bits of each side's audio_engine_clock_us().
+#define CONTROL_PING_LOOPBACK   (1 << 0)    // Click test running: hold echo cancelling
+
+typedef struct __attribute__((packed)) {
+    uint8_t  probe;              // Echoed in the pong
+    uint8_t  flags;              // CONTROL_PING_* bits
+    uint32_t t_send;             // Sender's clock at send
+} control_ping_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  probe;
+    uint8_t  device_id;          // Responder's DEVICE_ID
+    uint32_t t_ping;             // control_ping_t.t_send, echoed
+    uint32_t t_receive;          // Responder's clock at ping arrival
+    uint32_t t_reply;            // Responder's clock at pong send
+    uint32_t tx_us;              // Responder's capture-to-send time
+} control_pong_t;
+
+// Metrics: per-stage timing summary (trace.h stage order), in
+// microseconds saturated at 65535
+#define CONTROL_METRICS_STAGES  9
+
+typedef struct __attribute__((packed)) {
+    uint16_t p50_us;
+    uint16_t p99_us;
+    uint16_t max_us;
+} control_metric_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  device_id;          // Responder's DEVICE_ID
+    uint8_t  stack_task;         // Task with the least unused stack (task_id_t)
+    uint16_t stack_free;         // Its unused stack (bytes)
+    uint8_t  jb_p50;             // Jitter-buffer occupancy (frames)
+    uint8_t  jb_p99;
+    uint8_t  jb_max;
+    uint8_t  reserved;
+    control_metric_t stages[CONTROL_METRICS_STAGES];
+} control_metrics_t;
+
+// Packet capture (system/packet_capture.c). The base fetches a frozen
+// capture one chunk per CONTROL_CAPTURE_FETCH, so the transfer goes at
+// the pace its console prints.
+#define CONTROL_CAPTURE_FREEZE  1   // Freeze; answered with CONTROL_CAPTURE_FROZEN
+#define CONTROL_CAPTURE_RESTART 2   // Discard and record again
+#define CONTROL_CAPTURE_REPLAY  3   // Feed the frozen capture through the RX path
+#define CONTROL_CAPTURE_FETCH   4   // Send the chunk starting at index
+#define CONTROL_CAPTURE_FROZEN  5   // Notice: frozen, records from index on
+
+#define CONTROL_CAPTURE_LAST    (1 << 0)    // control_capture_data_t: no records follow
+
+typedef struct __attribute__((packed)) {
+    uint8_t  op;                 // CONTROL_CAPTURE_*
+    uint8_t  device_id;          // Sender's DEVICE_ID
+    uint32_t index;              // FETCH: first record wanted; FROZEN: oldest record
+} control_capture_t;
+
+// One captured datagram; caplen bytes of it follow
+typedef struct __attribute__((packed)) {
+    uint32_t time_us;            // Sender's esp_timer, low 32 bits
+    uint32_t addr;               // Peer (RX: sender, TX: destination, 0 = broadcast)
+    uint16_t size;               // Datagram size
+    uint8_t  dir;                // packet_capture_dir_t
+    uint8_t  caplen;             // Bytes kept (first PACKET_CAPTURE_SNAP_BYTES)
+} control_capture_record_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  device_id;
+    uint8_t  flags;              // CONTROL_CAPTURE_LAST
+    uint8_t  count;              // Records that follow
+    uint8_t  reserved;
+    uint32_t index;              // Index of the first record
+} control_capture_data_t;
+
+// Channel move: broadcast by the base as its AP starts the CSA, so packs
+// that miss the beacons still know where it went
+typedef struct __attribute__((packed)) {
+    uint8_t  channel;            // New AP channel
+    uint8_t  device_id;          // Sender's DEVICE_ID
+    uint16_t switch_ms;          // Time until the AP moves
+} control_channel_t;
+
+// Run-time setting (system/settings.h) on another device. Every request
+// is answered with CONTROL_SETTING_VALUE: the value in effect afterwards
+// and how the request went.
+#define CONTROL_SETTING_GET     1   // Read
+#define CONTROL_SETTING_TRY     2   // Apply until reboot
+#define CONTROL_SETTING_SET     3   // Apply and save
+#define CONTROL_SETTING_RESET   4   // Back to the build default
+#define CONTROL_SETTING_VALUE   5   // Answer
+
+#define CONTROL_SETTING_ALL     0xFF    // target: every device that hears it
+
+typedef struct __attribute__((packed)) {
+    uint8_t  op;                 // CONTROL_SETTING_*
+    uint8_t  device_id;          // Sender's DEVICE_ID
+    uint8_t  target;             // Addressed DEVICE_ID, or CONTROL_SETTING_ALL
+    uint8_t  id;                 // setting_id_t
+    int32_t  value;              // TRY/SET/VALUE; floats as their IEEE-754 bits
+    uint16_t status;             // VALUE: esp_err_t of the request
+} control_setting_t;
+
+// Largest payload after the type byte (fits an ESP-NOW frame)
+#define CONTROL_MAX_PAYLOAD     224
+
+//=============================================================================
+// CALLBACK TYPES
+//=============================================================================
+
+/**
+ * @brief Handler for one control message type
+ * @param source_addr Sender (for control_channel_send_to replies)
+ * @param payload Message body (after the type byte)
+ * @param size Size of body
+ */
+typedef void (*control_handler_t)(uint32_t source_addr, const uint8_t *payload, uint16_t size);
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Initialize control channel and hook it into the UDP transport
+ * @return ESP_OK on success
+ */
+esp_err_t control_channel_init(void);
+
+/**
+ * @brief Register the handler for a message type
+ * @param type Message type
+ * @param handler Called from the UDP RX task - keep it short
+ * @return ESP_OK on success
+ */
+esp_err_t control_channel_register(control_msg_type_t type, control_handler_t handler);
+
+/**
+ * @brief Send a control message
+ * @param type Message type
+ * @param payload Message body
+ * @param size Size of body (max CONTROL_MAX_PAYLOAD)
+ * @return ESP_OK on success
+ */
+esp_err_t control_channel_send(control_msg_type_t type, const void *payload, uint16_t size);
+
+/**
+ * @brief Send a control message to one peer
+ * @param dest Peer address as passed to a handler
+ * @param type Message type
+ * @param payload Message body
+ * @param size Size of body (max CONTROL_MAX_PAYLOAD)
+ * @return ESP_OK on success
+ */
+esp_err_t control_channel_send_to(uint32_t dest, control_msg_type_t type,
+                                  const void *payload, uint16_t size);
+
+#endif // CONTROL_CHANNEL_H
@@ -0,0 +1,69 @@
+/**
+ * @file transport_backend.h
+ * @brief Link Backends Behind the UDP Transport API
+ *
+ * udp_transport.c does framing, sequence numbers and loss accounting; a
+ * backend only moves datagrams. Receive is event driven: the RX task
+ * sleeps in recv() until a datagram arrives and parses it in place in
+ * the backend's buffer. The lwIP backend uses a raw-API UDP pcb for
+ * receive and a socket for send over the associated WiFi link. The
+ * ESP-NOW backend sends raw 802.11 action frames on WIFI_CHANNEL with no
+ * IP stack, DHCP or association.
+ */
+
+#ifndef TRANSPORT_BACKEND_H
+#define TRANSPORT_BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+// Peer address as seen above the backend: IPv4 (network byte order) on
+// lwIP, a small peer handle on ESP-NOW. Never 0 for a real peer.
+typedef uint32_t transport_addr_t;
+
+// Default destination: the group downlink on the base, the base on a pack
+#define TRANSPORT_ADDR_DEFAULT  0
+
+// recv() timeout that never expires
+#define TRANSPORT_WAIT_FOREVER  UINT32_MAX
+
+typedef struct {
+    const char *name;
+    bool uses_ip;                // Needs WiFi association and an IP address
+
+    // Create the endpoint (called once from udp_transport_init)
+    esp_err_t (*open)(void);
+    void (*close)(void);
+
+    // Send one datagram
+    esp_err_t (*send)(transport_addr_t dest, const void *data, size_t size);
+
+    // Wait up to timeout_ms (TRANSPORT_WAIT_FOREVER = no timeout) for one
+    // datagram. *data points into the backend's receive buffer and stays
+    // valid until release(). Returns its size, 0 on timeout or wake(),
+    // negative on error.
+    int (*recv)(const uint8_t **data, transport_addr_t *source, uint32_t timeout_ms);
+
+    // Finished with the datagram returned by recv()
+    void (*release)(void);
+
+    // Make a blocked recv() return (used on stop)
+    void (*wake)(void);
+
+    // Join the downlink multicast group (may be NULL)
+    esp_err_t (*join_multicast)(void);
+
+    // Largest datagram the link can carry
+    size_t max_datagram;
+} transport_backend_t;
+
+extern const transport_backend_t transport_backend_lwip;
+extern const transport_backend_t transport_backend_espnow;
+
+#endif // TRANSPORT_BACKEND_H
@@ -0,0 +1,288 @@
+/**
+ * @file transport_espnow.c
+ * @brief ESP-NOW Backend (raw 802.11, no IP stack)
+ *
+ * Frames go out as ESP-NOW action frames on WIFI_CHANNEL; the radio is
+ * started without an AP or association (wifi_manager_start_radio), so a
+ * pack is talking within a few ms of boot or a brownout.
+ *
+ * Received frames are copied once from the WiFi task into a queue (the
+ * driver's buffer is not ours to keep) and peers are learned in the UDP
+ * RX task, which owns all ESP-NOW peer calls on the receive side. Peer handles carry a generation count so a reused
+ * table entry never looks like the pack that left it.
+ *
+ * Frames are not encrypted: ESP-NOW broadcast cannot be, and the group
+ * downlink is broadcast.
+ */
+
+#include "transport_backend.h"
+#include "../config.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <string.h>
+
+static const char *TAG = "ESPNOW";
+
+// Frames queued between the WiFi task and the RX task
+#define ESPNOW_RX_QUEUE_LEN     8
+
+// A peer silent this long may give its entry to a new one (ms)
+#define ESPNOW_PEER_IDLE_MS     5000
+
+#if DEVICE_TYPE_BASE
+#define ESPNOW_MAX_PEERS        MAX_PACKS
+#else
+#define ESPNOW_MAX_PEERS        1
+#endif
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+typedef struct {
+    uint8_t  mac[ESP_NOW_ETH_ALEN];
+    uint16_t size;
+    uint8_t  data[ESP_NOW_MAX_DATA_LEN];
+} espnow_rx_item_t;
+
+typedef struct {
+    bool     used;
+    uint8_t  mac[ESP_NOW_ETH_ALEN];
+    uint8_t  generation;
+    int64_t  last_rx_us;
+} espnow_peer_t;
+
+static const uint8_t broadcast_mac[ESP_NOW_ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static bool opened = false;
+static QueueHandle_t rx_queue = NULL;
+static espnow_peer_t peers[ESPNOW_MAX_PEERS];
+static portMUX_TYPE peer_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t rx_queue_drops = 0;
+static espnow_rx_item_t rx_current;     // Frame being handled by the RX task
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static inline transport_addr_t peer_handle(size_t index)
+{
+    return ((transport_addr_t)peers[index].generation << 8) | (transport_addr_t)(index + 1);
+}
+
+static esp_err_t add_peer(const uint8_t *mac)
+{
+    if (esp_now_is_peer_exist(mac)) {
+        return ESP_OK;
+    }
+
+    esp_now_peer_info_t peer = {0};
+    memcpy(peer.peer_addr, mac, ESP_NOW_ETH_ALEN);
+    peer.channel = 0;             // Current channel (WIFI_CHANNEL)
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    return esp_now_add_peer(&peer);
+}
+
+// WiFi task context: copy out and return
+static void espnow_recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    if (!rx_queue || !info || !data || len <= 0 || len > ESP_NOW_MAX_DATA_LEN) {
+        return;
+    }
+
+    espnow_rx_item_t item;
+    memcpy(item.mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    item.size = (uint16_t)len;
+    memcpy(item.data, data, len);
+
+    if (xQueueSend(rx_queue, &item, 0) != pdTRUE) {
+        rx_queue_drops++;
+    }
+}
+
+// RX task context: map a sender MAC to its handle, learning new peers
+static transport_addr_t learn_peer(const uint8_t *mac)
+{
+    int64_t now_us = esp_timer_get_time();
+    int free_index = -1;
+    int idle_index = -1;
+    int64_t oldest_rx_us = now_us;
+
+    for (size_t i = 0; i < ESPNOW_MAX_PEERS; i++) {
+        if (peers[i].used && memcmp(peers[i].mac, mac, ESP_NOW_ETH_ALEN) == 0) {
+            peers[i].last_rx_us = now_us;
+            return peer_handle(i);
+        }
+        if (!peers[i].used) {
+            if (free_index < 0) free_index = (int)i;
+        } else if (peers[i].last_rx_us < oldest_rx_us) {
+            oldest_rx_us = peers[i].last_rx_us;
+            idle_index = (int)i;
+        }
+    }
+
+    if (free_index < 0) {
+        if (idle_index < 0 ||
+            now_us - oldest_rx_us < (int64_t)ESPNOW_PEER_IDLE_MS * 1000) {
+            return TRANSPORT_ADDR_DEFAULT;  // Table full of live peers
+        }
+        esp_now_del_peer(peers[idle_index].mac);
+        free_index = idle_index;
+    }
+
+    if (add_peer(mac) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to add peer " MACSTR, MAC2STR(mac));
+        return TRANSPORT_ADDR_DEFAULT;
+    }
+
+    portENTER_CRITICAL(&peer_lock);
+    espnow_peer_t *peer = &peers[free_index];
+    memcpy(peer->mac, mac, ESP_NOW_ETH_ALEN);
+    peer->generation++;
+    peer->last_rx_us = now_us;
+    peer->used = true;
+    portEXIT_CRITICAL(&peer_lock);
+
+    ESP_LOGI(TAG, "Peer %d: " MACSTR, free_index, MAC2STR(mac));
+    return peer_handle(free_index);
+}
+
+static esp_err_t espnow_open(void)
+{
+    if (opened) {
+        return ESP_OK;
+    }
+
+    rx_queue = xQueueCreate(ESPNOW_RX_QUEUE_LEN, sizeof(espnow_rx_item_t));
+    if (!rx_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = esp_now_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_now_init failed: %s", esp_err_to_name(ret));
+        vQueueDelete(rx_queue);
+        rx_queue = NULL;
+        return ret;
+    }
+
+    esp_now_register_recv_cb(espnow_recv_cb);
+
+    ret = add_peer(broadcast_mac);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add broadcast peer");
+        esp_now_deinit();
+        vQueueDelete(rx_queue);
+        rx_queue = NULL;
+        return ret;
+    }
+
+    memset(peers, 0, sizeof(peers));
+    rx_queue_drops = 0;
+    opened = true;
+
+    ESP_LOGI(TAG, "ESP-NOW ready on channel %d (max %d peers)", WIFI_CHANNEL, ESPNOW_MAX_PEERS);
+    return ESP_OK;
+}
+
+static void espnow_close(void)
+{
+    if (!opened) {
+        return;
+    }
+
+    esp_now_deinit();
+    vQueueDelete(rx_queue);
+    rx_queue = NULL;
+    opened = false;
+}
+
+static esp_err_t espnow_send(transport_addr_t dest, const void *data, size_t size)
+{
+    if (!opened || size > ESP_NOW_MAX_DATA_LEN) {
+        return ESP_FAIL;
+    }
+
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    memcpy(mac, broadcast_mac, ESP_NOW_ETH_ALEN);
+
+    portENTER_CRITICAL(&peer_lock);
+    if (dest != TRANSPORT_ADDR_DEFAULT) {
+        size_t index = (dest & 0xFF) - 1;
+        if (index < ESPNOW_MAX_PEERS && peers[index].used && peer_handle(index) == dest) {
+            memcpy(mac, peers[index].mac, ESP_NOW_ETH_ALEN);
+        } else {
+            portEXIT_CRITICAL(&peer_lock);
+            return ESP_ERR_NOT_FOUND;   // Peer has gone
+        }
+    }
+#if DEVICE_TYPE_PACK
+    else if (peers[0].used) {
+        // Once the base is known, talk to it directly (MAC-level ACK/retry)
+        memcpy(mac, peers[0].mac, ESP_NOW_ETH_ALEN);
+    }
+#endif
+    portEXIT_CRITICAL(&peer_lock);
+
+    return esp_now_send(mac, data, size);
+}
+
+static int espnow_recv(const uint8_t **data, transport_addr_t *source, uint32_t timeout_ms)
+{
+    if (!opened) {
+        return -1;
+    }
+
+    TickType_t wait = (timeout_ms == TRANSPORT_WAIT_FOREVER) ? portMAX_DELAY
+                                                             : pdMS_TO_TICKS(timeout_ms);
+    if (xQueueReceive(rx_queue, &rx_current, wait) != pdTRUE || rx_current.size == 0) {
+        return 0;   // Timeout, or wake()
+    }
+
+    transport_addr_t handle = learn_peer(rx_current.mac);
+    if (handle == TRANSPORT_ADDR_DEFAULT) {
+        ESP_LOGD(TAG, "No peer slot for " MACSTR " - frame dropped", MAC2STR(rx_current.mac));
+        return 0;
+    }
+
+    *data = rx_current.data;
+    if (source) {
+        *source = handle;
+    }
+    return rx_current.size;
+}
+
+static void espnow_release(void)
+{
+    // rx_current is reused by the next recv()
+}
+
+static void espnow_wake(void)
+{
+    if (rx_queue) {
+        espnow_rx_item_t wake = {0};
+        xQueueSend(rx_queue, &wake, 0);
+    }
+}
+
+//=============================================================================
+// BACKEND
+//=============================================================================
+
+const transport_backend_t transport_backend_espnow = {
+    .name = "ESP-NOW",
+    .uses_ip = false,
+    .open = espnow_open,
+    .close = espnow_close,
+    .send = espnow_send,
+    .recv = espnow_recv,
+    .release = espnow_release,
+    .wake = espnow_wake,
+    .join_multicast = NULL,
+    .max_datagram = ESP_NOW_MAX_DATA_LEN,
+};
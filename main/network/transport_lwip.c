@@ -0,0 +1,334 @@
+/**
+ * @file transport_lwip.c
+ * @brief lwIP UDP Backend (raw API)
+ *
+ * One raw-API UDP pcb bound to UDP_PORT carries both directions.
+ *
+ * Receive: lwIP hands each datagram's pbuf to a callback in the tcpip
+ * thread, which queues it for the RX task. The RX task blocks on that
+ * queue and parses the payload in place, so a frame is never copied
+ * between the netif and the jitter buffer.
+ *
+ * Send: the caller's packet is wrapped in a PBUF_REF (no copy) and sent
+ * from the tcpip thread. lwIP and the WiFi driver copy anything they
+ * keep past udp_sendto() (ARP queue, TX buffer), so the caller's buffer
+ * is free again as soon as send() returns.
+ *
+ * Base: default destination is the group downlink (broadcast or
+ * multicast). Pack: default destination is BASE_STATION_IP.
+ */
+
+#include "transport_backend.h"
+#include "udp_transport.h"
+#include "../config.h"
+#include "lwip/sockets.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/igmp.h"
+#include "lwip/tcpip.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "UDP_LWIP";
+
+// Datagrams queued between the tcpip thread and the RX task
+#define LWIP_RX_QUEUE_LEN   16
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+typedef struct {
+    struct pbuf *p;             // NULL = wake()
+    uint32_t addr;              // Source IPv4, network byte order
+} lwip_rx_item_t;
+
+// Arguments for calls run in the tcpip thread
+typedef struct {
+    struct tcpip_api_call_data call;    // Must be first
+    struct udp_pcb *pcb;
+    const void *data;
+    size_t size;
+    uint32_t dest;              // IPv4, network byte order
+} lwip_pcb_call_t;
+
+static struct udp_pcb *pcb = NULL;
+static uint32_t default_dest = 0;
+static QueueHandle_t rx_queue = NULL;
+static struct pbuf *rx_current = NULL;      // Held until release()
+static uint8_t rx_linear[UDP_MAX_PACKET_SIZE];  // Only for chained pbufs
+static uint32_t rx_queue_drops = 0;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+// tcpip thread context: hand the pbuf over and return
+static void pcb_recv(void *arg, struct udp_pcb *upcb, struct pbuf *p,
+                     const ip_addr_t *addr, uint16_t port)
+{
+    (void)arg;
+    (void)upcb;
+    (void)port;
+
+    if (!p) {
+        return;
+    }
+
+    lwip_rx_item_t item = {
+        .p = p,
+        .addr = addr ? ip_addr_get_ip4_u32(addr) : 0,
+    };
+    if (xQueueSend(rx_queue, &item, 0) != pdTRUE) {
+        rx_queue_drops++;
+        pbuf_free(p);
+    }
+}
+
+static err_t pcb_open(struct tcpip_api_call_data *call)
+{
+    lwip_pcb_call_t *c = (lwip_pcb_call_t *)call;
+
+    c->pcb = udp_new();
+    if (!c->pcb) {
+        return ERR_MEM;
+    }
+
+    ip_set_option(c->pcb, SOF_BROADCAST);
+    c->pcb->tos = WIFI_AUDIO_DSCP << 2;     // WMM voice access category
+    err_t err = udp_bind(c->pcb, IP_ADDR_ANY, UDP_PORT);
+    if (err != ERR_OK) {
+        udp_remove(c->pcb);
+        c->pcb = NULL;
+        return err;
+    }
+
+#if DEVICE_TYPE_BASE && DOWNLINK_MULTICAST_ENABLE
+    udp_set_multicast_ttl(c->pcb, 1);  // Never leave the intercom's own network
+#endif
+
+    udp_recv(c->pcb, pcb_recv, NULL);
+    return ERR_OK;
+}
+
+static err_t pcb_close(struct tcpip_api_call_data *call)
+{
+    lwip_pcb_call_t *c = (lwip_pcb_call_t *)call;
+    udp_remove(c->pcb);
+    return ERR_OK;
+}
+
+static err_t pcb_send(struct tcpip_api_call_data *call)
+{
+    lwip_pcb_call_t *c = (lwip_pcb_call_t *)call;
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, 0, PBUF_REF);
+    if (!p) {
+        return ERR_MEM;
+    }
+    p->payload = (void *)c->data;
+    p->len = p->tot_len = (uint16_t)c->size;
+
+    ip_addr_t to = IPADDR4_INIT(c->dest);
+    err_t err = udp_sendto(c->pcb, p, &to, UDP_PORT);
+    pbuf_free(p);
+    return err;
+}
+
+#if DEVICE_TYPE_PACK && DOWNLINK_MULTICAST_ENABLE
+static err_t pcb_join(struct tcpip_api_call_data *call)
+{
+    (void)call;
+
+    ip4_addr_t group;
+    ip4addr_aton(DOWNLINK_MULTICAST_ADDR, &group);
+    return igmp_joingroup(IP4_ADDR_ANY4, &group);
+}
+#endif
+
+static void drain_rx_queue(void)
+{
+    lwip_rx_item_t item;
+    while (xQueueReceive(rx_queue, &item, 0) == pdTRUE) {
+        if (item.p) {
+            pbuf_free(item.p);
+        }
+    }
+}
+
+static esp_err_t lwip_open(void)
+{
+    rx_queue = xQueueCreate(LWIP_RX_QUEUE_LEN, sizeof(lwip_rx_item_t));
+    if (!rx_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    lwip_pcb_call_t call = {0};
+    err_t err = tcpip_api_call(pcb_open, &call.call);
+    if (err != ERR_OK) {
+        ESP_LOGE(TAG, "Failed to bind port %d: err %d", UDP_PORT, (int)err);
+        vQueueDelete(rx_queue);
+        rx_queue = NULL;
+        return ESP_FAIL;
+    }
+    pcb = call.pcb;
+    rx_queue_drops = 0;
+
+    ESP_LOGI(TAG, "Bound to port %d", UDP_PORT);
+
+    struct in_addr addr;
+
+#if DEVICE_TYPE_BASE
+    // Destination: one datagram per frame reaches every pack in the group
+#if DOWNLINK_MULTICAST_ENABLE
+    inet_pton(AF_INET, DOWNLINK_MULTICAST_ADDR, &addr);
+    ESP_LOGI(TAG, "Downlink: multicast %s group %d", DOWNLINK_MULTICAST_ADDR, INTERCOM_GROUP_ID);
+#else
+    addr.s_addr = htonl(INADDR_BROADCAST);
+    ESP_LOGI(TAG, "Downlink: broadcast group %d", INTERCOM_GROUP_ID);
+#endif
+
+#else // DEVICE_TYPE_PACK
+    // Destination: base station
+    inet_pton(AF_INET, BASE_STATION_IP, &addr);
+
+    ESP_LOGI(TAG, "Target: %s:%d", BASE_STATION_IP, UDP_PORT);
+#endif
+
+    default_dest = addr.s_addr;
+    return ESP_OK;
+}
+
+static void lwip_close(void)
+{
+    if (pcb) {
+        lwip_pcb_call_t call = { .pcb = pcb };
+        tcpip_api_call(pcb_close, &call.call);
+        pcb = NULL;
+    }
+
+    if (rx_current) {
+        pbuf_free(rx_current);
+        rx_current = NULL;
+    }
+
+    if (rx_queue) {
+        drain_rx_queue();
+        vQueueDelete(rx_queue);
+        rx_queue = NULL;
+    }
+}
+
+static esp_err_t lwip_send(transport_addr_t dest, const void *data, size_t size)
+{
+    if (!pcb) {
+        return ESP_FAIL;
+    }
+
+    lwip_pcb_call_t call = {
+        .pcb = pcb,
+        .data = data,
+        .size = size,
+        .dest = (dest != TRANSPORT_ADDR_DEFAULT) ? dest : default_dest,
+    };
+    err_t err = tcpip_api_call(pcb_send, &call.call);
+
+    if (err != ERR_OK) {
+        // ERR_RTE (no route to host) - WiFi not connected yet or base
+        // station not reachable. Expected during startup/disconnect -
+        // don't spam logs
+        if (err != ERR_RTE) {
+            ESP_LOGE(TAG, "udp_sendto failed: err %d", (int)err);
+        }
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static int lwip_recv(const uint8_t **data, transport_addr_t *source, uint32_t timeout_ms)
+{
+    if (!rx_queue) {
+        return -1;
+    }
+
+    TickType_t wait = (timeout_ms == TRANSPORT_WAIT_FOREVER) ? portMAX_DELAY
+                                                             : pdMS_TO_TICKS(timeout_ms);
+    lwip_rx_item_t item;
+    if (xQueueReceive(rx_queue, &item, wait) != pdTRUE || !item.p) {
+        return 0;   // Timeout, or wake()
+    }
+
+    struct pbuf *p = item.p;
+    if (p->len == p->tot_len) {
+        // Single pbuf (any frame that fits one WiFi RX buffer): use in place
+        *data = (const uint8_t *)p->payload;
+    } else if (p->tot_len <= sizeof(rx_linear)) {
+        pbuf_copy_partial(p, rx_linear, p->tot_len, 0);
+        *data = rx_linear;
+    } else {
+        pbuf_free(p);
+        return 0;   // Larger than any packet we send
+    }
+
+    rx_current = p;
+    if (source) {
+        *source = item.addr;
+    }
+    return p->tot_len;
+}
+
+static void lwip_release(void)
+{
+    if (rx_current) {
+        pbuf_free(rx_current);
+        rx_current = NULL;
+    }
+}
+
+static void lwip_wake(void)
+{
+    if (rx_queue) {
+        lwip_rx_item_t wake = {0};
+        xQueueSend(rx_queue, &wake, 0);
+    }
+}
+
+static esp_err_t lwip_join_multicast(void)
+{
+#if DEVICE_TYPE_PACK && DOWNLINK_MULTICAST_ENABLE
+    if (!pcb) {
+        return ESP_FAIL;
+    }
+
+    lwip_pcb_call_t call = {0};
+    err_t err = tcpip_api_call(pcb_join, &call.call);
+    if (err != ERR_OK) {
+        ESP_LOGW(TAG, "Multicast join failed: err %d", (int)err);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Joined downlink %s", DOWNLINK_MULTICAST_ADDR);
+#endif
+    return ESP_OK;
+}
+
+//=============================================================================
+// BACKEND
+//=============================================================================
+
+const transport_backend_t transport_backend_lwip = {
+    .name = "lwIP UDP",
+    .uses_ip = true,
+    .open = lwip_open,
+    .close = lwip_close,
+    .send = lwip_send,
+    .recv = lwip_recv,
+    .release = lwip_release,
+    .wake = lwip_wake,
+    .join_multicast = lwip_join_multicast,
+    .max_datagram = UDP_MAX_PACKET_SIZE,
+};
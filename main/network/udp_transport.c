@@ -1,16 +1,48 @@
 /**
  * @file udp_transport.c
  * @brief UDP Audio Packet Transport Implementation
+ *
+ * Packet framing, sequence numbers and loss accounting. Datagrams are
+ * moved by a link backend (transport_backend.h) chosen at init.
+ *
+ * Transmit packets live in a small pool of preallocated slots. Encoders
+ * write straight into a slot's payload, the header is filled in place
+ * and the slot itself is handed to the backend, so the audio loop never
+ * copies a frame or builds a packet on its stack.
+ *
+ * Audio goes out with the 6-byte compact_header_t (written just in front
+ * of the payload, inside the full header's space) to peers whose
+ * CONTROL_MSG_HELLO says they read it, and with the full audio_packet_t
+ * header otherwise. The broadcast is compact only when every peer heard
+ * recently reads it. Both formats are recognised on receive.
+ *
+ * With BUNDLE_MODE the encoder path keeps a copy of each frame and sends
+ * several per datagram (new ones plus repeats of the last bundle's) to
+ * peers that read bundles. The receiver splits them back into frames;
+ * copies it already has are dropped by the sequence tracker, frames of a
+ * bundle that arrives behind a newer one are still delivered.
+ *
+ * A low-latency link (LINK_LOW_LATENCY) holds no frames for bundles and
+ * says so in its hello: it drops UDP_FORMAT_BUNDLE, so the far end sends
+ * it single frames, and adds UDP_FORMAT_LOW_LATENCY, so the far end keeps
+ * its jitter buffer for that stream shallow.
  */
 
 #include "udp_transport.h"
+#include "transport_backend.h"
 #include "../config.h"
 #include "../system/device_manager.h"
-#include "lwip/sockets.h"
+#include "../system/task_map.h"
+#include "../system/trace.h"
+#include "../system/packet_capture.h"
+#include "../audio/audio_engine.h"
+#include "control_channel.h"
+#include "nvs.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include <string.h>
 
 static const char *TAG = "UDP";
@@ -21,177 +53,819 @@ static const char *TAG = "UDP";
 
 static bool initialized = false;
 static bool running = false;
-static int sock = -1;
-static struct sockaddr_in dest_addr;
+static const transport_backend_t *backend = NULL;
 static TaskHandle_t rx_task_handle = NULL;
 static udp_rx_callback_t user_rx_callback = NULL;
+static udp_control_callback_t control_callback = NULL;
 
-// Statistics
+// Statistics. The send side is shared by the engine, the RX task (hellos,
+// replies), the monitor and the button task: its counters and sequences
+// only move by atomic add, so two senders never take the same sequence.
+// The receive counters are the RX task's alone.
 static udp_stats_t stats = {0};
-static uint32_t tx_sequence = 0;
-static uint32_t last_rx_sequence = 0;
+static uint32_t tx_sequence[UDP_MAX_GROUPS] = {0};
+static uint32_t tx_control_sequence = 0;
+
+#define TX_STAT_ADD(field, n)  __atomic_fetch_add(&stats.field, (n), __ATOMIC_RELAXED)
+#define NEXT_SEQUENCE(counter) __atomic_fetch_add(&(counter), 1, __ATOMIC_RELAXED)
+
+// Packet capture replay: live datagrams are dropped, injected ones parsed.
+// Injected datagrams are queued to the RX task, so it stays the only
+// writer into the jitter buffers' single-producer rings.
+static volatile bool replaying = false;
+static QueueHandle_t inject_queue = NULL;
+
+// Link came back up: sequence tracking restarts before the next packet
+static volatile bool resync_pending = false;
+
+#if INTERCOM_GROUP_ID >= UDP_MAX_GROUPS
+#error "INTERCOM_GROUP_ID must be below UDP_MAX_GROUPS"
+#endif
+
+// Loss is tracked per sender, since each has its own sequence counter
+#if DEVICE_TYPE_BASE
+#define UDP_MAX_SOURCES  MAX_PACKS
+#else
+#define UDP_MAX_SOURCES  1
+#endif
+
+#define UDP_FRAME_US       ((uint32_t)FRAME_SIZE_MS * 1000)
+
+// Hello is re-requested from a peer this long after its last one, and a
+// peer's compact support lapses if it stops answering (e.g. downgraded)
+#define UDP_HELLO_REFRESH_US  (5 * 1000000LL)
+#define UDP_HELLO_EXPIRE_US   (15 * 1000000LL)
+
+// Peers silent this long no longer hold the broadcast to the full header
+#define UDP_PEER_TIMEOUT_US   (5 * 1000000LL)
+
+#if COMPACT_HEADER_ENABLE
+#define UDP_FORMATS        (UDP_FORMAT_LEGACY | UDP_FORMAT_COMPACT | UDP_FORMAT_BUNDLE)
+#else
+#define UDP_FORMATS        (UDP_FORMAT_LEGACY | UDP_FORMAT_BUNDLE)
+#endif
+
+// Largest frame a bundle carries (one-byte sizes)
+#define UDP_BUNDLE_MAX_FRAME 255
+
+// Injected datagrams waiting for the RX task (a frame from every sender,
+// twice over for reordering)
+#define UDP_INJECT_DEPTH   (UDP_MAX_SOURCES * 2)
+
+// Preallocated transmit packets (audio engine, mix-minus and control
+// senders each hold at most one at a time)
+#define UDP_TX_SLOTS       4
+
+// Written by the RX task; senders only read formats/last_rx_us/hello_rx_us
+typedef struct {
+    bool     in_use;
+    uint8_t  formats;            // UDP_FORMAT_* from the last hello
+    uint32_t addr;
+    audio_packet_stream_t stream;
+    int64_t  last_rx_us;
+    int64_t  hello_rx_us;        // 0 = no hello yet
+    int64_t  hello_tx_us;        // 0 = not asked yet
+} rx_source_t;
+
+typedef struct {
+    audio_packet_t packet;
+    bool in_use;
+} tx_slot_t;
+
+typedef struct {
+    uint32_t source_addr;
+    uint16_t size;
+    uint8_t  data[sizeof(audio_packet_t)];
+} inject_item_t;
+
+typedef struct {
+    uint8_t frames;              // New frames per datagram
+    uint8_t redundant;           // Frames repeated from the previous datagram
+} bundle_mode_t;
+
+static const bundle_mode_t bundle_modes[] = {
+    [BUNDLE_LOW_LATENCY] = { 1, 0 },
+    [BUNDLE_REDUNDANT]   = { 1, 1 },
+    [BUNDLE_AIRTIME]     = { 2, 0 },
+    [BUNDLE_ROBUST]      = { 2, 1 },
+};
+
+typedef struct {
+    uint8_t data[UDP_BUNDLE_MAX_FRAME];
+    uint8_t size;
+} bundle_frame_t;
+
+static rx_source_t rx_sources[UDP_MAX_SOURCES];
+static size_t next_source_evict = 0;
+
+static tx_slot_t tx_slots[UDP_TX_SLOTS];
+static portMUX_TYPE tx_slot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Bundle state, encoder path only (audio engine task). Held frames are
+// consecutive: already sent ones kept for redundancy, then pending ones.
+static bundle_mode_t bundle_mode = { 1, 0 };
+static volatile bool low_latency = LINK_LOW_LATENCY;
+static bundle_frame_t bundle_frames[UDP_BUNDLE_MAX_FRAMES];
+static size_t bundle_held = 0;
+static size_t bundle_pending = 0;
+static uint32_t bundle_sequence = 0;    // Newest held frame
+static uint8_t bundle_flags = 0;        // PTT/Call of the newest held frame
 
 //=============================================================================
 // PRIVATE FUNCTIONS
 //=============================================================================
 
-static void udp_rx_task(void *arg)
+static const transport_backend_t *backend_for(udp_backend_type_t type)
 {
-    ESP_LOGI(TAG, "UDP RX task started");
+    return type == UDP_BACKEND_ESPNOW ? &transport_backend_espnow : &transport_backend_lwip;
+}
 
-    uint8_t rx_buffer[UDP_MAX_PACKET_SIZE];
-    struct sockaddr_in source_addr;
-    socklen_t addr_len = sizeof(source_addr);
+// Largest payload a slot can carry over the selected link
+static size_t tx_capacity(void)
+{
+    size_t capacity = sizeof(((audio_packet_t*)0)->opus_data);
+    if (backend->max_datagram - AUDIO_PACKET_HEADER_SIZE < capacity) {
+        capacity = backend->max_datagram - AUDIO_PACKET_HEADER_SIZE;
+    }
+    return capacity;
+}
 
-    while (running) {
-        // Receive packet
-        int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer), 0,
-                          (struct sockaddr *)&source_addr, &addr_len);
+static tx_slot_t *acquire_slot(void)
+{
+    tx_slot_t *slot = NULL;
+
+    portENTER_CRITICAL(&tx_slot_lock);
+    for (size_t i = 0; i < UDP_TX_SLOTS; i++) {
+        if (!tx_slots[i].in_use) {
+            tx_slots[i].in_use = true;
+            slot = &tx_slots[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&tx_slot_lock);
 
-        if (len < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // Timeout - this is normal
-                vTaskDelay(pdMS_TO_TICKS(1));
-                continue;
+    return slot;
+}
+
+static void release_slot(tx_slot_t *slot)
+{
+    portENTER_CRITICAL(&tx_slot_lock);
+    slot->in_use = false;
+    portEXIT_CRITICAL(&tx_slot_lock);
+}
+
+static tx_slot_t *slot_from_buffer(uint8_t *buffer)
+{
+    for (size_t i = 0; i < UDP_TX_SLOTS; i++) {
+        if (buffer == tx_slots[i].packet.opus_data && tx_slots[i].in_use) {
+            return &tx_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static rx_source_t *lookup_source(uint32_t addr)
+{
+    for (size_t i = 0; i < UDP_MAX_SOURCES; i++) {
+        if (rx_sources[i].in_use && rx_sources[i].addr == addr) {
+            return &rx_sources[i];
+        }
+    }
+    return NULL;
+}
+
+static bool source_reads(const rx_source_t *src, uint8_t format, int64_t now_us)
+{
+    return (src->formats & format) && now_us - src->hello_rx_us < UDP_HELLO_EXPIRE_US;
+}
+
+// Whether audio to dest may use a format beyond the full header. The
+// default destination reaches every peer (the base on a pack), so all of
+// them heard recently must read it.
+static bool dest_reads(transport_addr_t dest, uint8_t format)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    if (dest != TRANSPORT_ADDR_DEFAULT) {
+        const rx_source_t *src = lookup_source(dest);
+        return src && source_reads(src, format, now_us);
+    }
+
+    bool any = false;
+    for (size_t i = 0; i < UDP_MAX_SOURCES; i++) {
+        const rx_source_t *src = &rx_sources[i];
+        if (!src->in_use || now_us - src->last_rx_us > UDP_PEER_TIMEOUT_US) continue;
+        if (!source_reads(src, format, now_us)) return false;
+        any = true;
+    }
+    return any;
+}
+
+// Fill the header in place, send the slot and give it back. The frame
+// is stamped age_us before now on the audio clock (0 for a fresh frame)
+static esp_err_t commit_slot_aged(tx_slot_t *slot, transport_addr_t dest, uint8_t group,
+                                  uint32_t sequence, uint8_t flags, uint16_t size,
+                                  uint32_t age_us)
+{
+    if (size > tx_capacity()) {
+        ESP_LOGE(TAG, "Payload too large: %u bytes", size);
+        release_slot(slot);
+        return ESP_FAIL;
+    }
+
+    // Both formats timestamp on the audio clock, so a switch between them
+    // is no jump to the far end's drift and jitter tracking
+    int64_t clock_us = audio_engine_clock_us() - age_us;
+    audio_packet_t *packet = &slot->packet;
+    const void *datagram;
+    size_t packet_size;
+
+    if (COMPACT_HEADER_ENABLE && !(flags & PACKET_FLAG_CONTROL) &&
+        dest_reads(dest, UDP_FORMAT_COMPACT)) {
+        datagram = audio_packet_write_compact(packet->opus_data, sequence,
+                                              (uint32_t)(clock_us / UDP_FRAME_US),
+                                              flags, group, DEVICE_ID);
+        packet_size = AUDIO_PACKET_COMPACT_SIZE + size;
+        TX_STAT_ADD(packets_compact, 1);
+    } else {
+        datagram = packet;
+        packet_size = audio_packet_write_full(packet, sequence, (uint32_t)clock_us,
+                                              flags, group, size);
+    }
+
+    // The backend is done with the slot when send() returns
+    uint32_t trace_start = trace_begin();
+    esp_err_t ret = backend->send(dest, datagram, packet_size);
+    trace_end(TRACE_SEND, trace_start);
+    if (ret == ESP_OK) {
+        packet_capture_record(PACKET_CAPTURE_TX, datagram, packet_size, dest);
+    }
+    release_slot(slot);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    TX_STAT_ADD(bytes_sent, packet_size);
+    return ESP_OK;
+}
+
+static esp_err_t commit_slot(tx_slot_t *slot, transport_addr_t dest, uint8_t group,
+                             uint32_t sequence, uint8_t flags, uint16_t size)
+{
+    return commit_slot_aged(slot, dest, group, sequence, flags, size, 0);
+}
+
+// Copying send for callers with their own buffer (control, silence)
+static esp_err_t send_packet(transport_addr_t dest, uint8_t group, uint32_t sequence,
+                             uint8_t flags, const uint8_t *data, uint16_t size)
+{
+    if (size > tx_capacity()) {
+        ESP_LOGE(TAG, "Payload too large: %u bytes", size);
+        return ESP_FAIL;
+    }
+
+    tx_slot_t *slot = acquire_slot();
+    if (!slot) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (data && size > 0) {
+        memcpy(slot->packet.opus_data, data, size);
+    }
+    return commit_slot(slot, dest, group, sequence, flags, size);
+}
+
+static esp_err_t send_audio(tx_slot_t *slot, uint8_t group, uint16_t size,
+                            bool ptt_active, bool call_active, uint8_t flags)
+{
+    if (ptt_active) flags |= PACKET_FLAG_PTT;
+    if (call_active) flags |= PACKET_FLAG_CALL;
+
+    uint32_t sequence = NEXT_SEQUENCE(tx_sequence[group]);
+    esp_err_t ret = commit_slot(slot, TRANSPORT_ADDR_DEFAULT, group, sequence, flags, size);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Update statistics
+    TX_STAT_ADD(packets_sent, 1);
+
+    ESP_LOGD(TAG, "TX: group=%u, seq=%lu, size=%u, ptt=%d, call=%d",
+            group, (unsigned long)sequence, size, ptt_active, call_active);
+
+    return ESP_OK;
+}
+
+// Send the pending frames, led by up to bundle_mode.redundant sent ones
+static esp_err_t bundle_send(tx_slot_t *slot)
+{
+    size_t first = bundle_held - bundle_pending;
+    size_t redundant = first < bundle_mode.redundant ? first : bundle_mode.redundant;
+    first -= redundant;
+
+    // Repeats are dropped first if the bundle outgrows the link
+    size_t capacity = tx_capacity();
+    size_t total;
+    for (;;) {
+        total = 1 + (bundle_held - first);
+        for (size_t i = first; i < bundle_held; i++) {
+            total += bundle_frames[i].size;
+        }
+        if (total <= capacity || redundant == 0) break;
+        first++;
+        redundant--;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (total > capacity) {
+        // New frames alone are too large to share a datagram: one each,
+        // stamped with the time it would have carried in the bundle so the
+        // far end's jitter estimate sees no skew
+        for (size_t i = bundle_held - bundle_pending; i < bundle_held; i++) {
+            tx_slot_t *out = slot ? slot : acquire_slot();
+            slot = NULL;
+            if (!out) {
+                ret = ESP_ERR_NO_MEM;
+                break;
             }
-            ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            continue;
+            const bundle_frame_t *frame = &bundle_frames[i];
+            memcpy(out->packet.opus_data, frame->data, frame->size);
+            uint32_t older = (uint32_t)(bundle_held - 1 - i);
+            ret = commit_slot_aged(out, TRANSPORT_ADDR_DEFAULT, INTERCOM_GROUP_ID,
+                                   bundle_sequence - older, bundle_flags, frame->size,
+                                   older * UDP_FRAME_US);
+            if (ret == ESP_OK) {
+                TX_STAT_ADD(packets_sent, 1);
+            }
+        }
+        if (slot) {
+            release_slot(slot);
         }
+        bundle_held = 0;
+        bundle_pending = 0;
+        return ret;
+    }
 
-        if (len == 0) {
-            continue;
+    size_t count = bundle_held - first;
+    uint8_t *out = slot->packet.opus_data;
+    uint8_t *data = &out[1 + count];
+    out[0] = (uint8_t)(redundant << 4 | count);
+    for (size_t i = 0; i < count; i++) {
+        const bundle_frame_t *frame = &bundle_frames[first + i];
+        out[1 + i] = frame->size;
+        memcpy(data, frame->data, frame->size);
+        data += frame->size;
+    }
+
+    ret = commit_slot(slot, TRANSPORT_ADDR_DEFAULT, INTERCOM_GROUP_ID, bundle_sequence,
+                      bundle_flags | PACKET_FLAG_BUNDLE, (uint16_t)total);
+    if (ret == ESP_OK) {
+        TX_STAT_ADD(packets_sent, 1);
+        TX_STAT_ADD(frames_bundled, bundle_pending);
+    }
+    bundle_pending = 0;
+
+    // Keep only what the next bundle repeats
+    size_t keep = bundle_mode.redundant < bundle_held ? bundle_mode.redundant : bundle_held;
+    memmove(&bundle_frames[0], &bundle_frames[bundle_held - keep], keep * sizeof(bundle_frame_t));
+    bundle_held = keep;
+    return ret;
+}
+
+// Send what is pending and start over: the next frame is not consecutive
+static void bundle_flush(void)
+{
+    if (bundle_pending > 0) {
+        tx_slot_t *slot = acquire_slot();
+        if (slot) {
+            bundle_send(slot);
         }
+    }
+    bundle_held = 0;
+    bundle_pending = 0;
+}
 
-        // Parse packet
-        if (len < sizeof(audio_packet_t) - sizeof(((audio_packet_t*)0)->opus_data)) {
-            ESP_LOGW(TAG, "Packet too small: %d bytes", len);
-            continue;
+// Encoder path: hold the frame until a bundle is complete
+static esp_err_t send_bundled(tx_slot_t *slot, uint16_t size, bool ptt_active, bool call_active)
+{
+    bool single = (bundle_mode.frames == 1 && bundle_mode.redundant == 0) || low_latency;
+    if (single || size > UDP_BUNDLE_MAX_FRAME ||
+        !dest_reads(TRANSPORT_ADDR_DEFAULT, UDP_FORMAT_BUNDLE)) {
+        bundle_flush();
+        return send_audio(slot, INTERCOM_GROUP_ID, size, ptt_active, call_active, 0);
+    }
+
+    bundle_frame_t *frame = &bundle_frames[bundle_held++];
+    memcpy(frame->data, slot->packet.opus_data, size);
+    frame->size = (uint8_t)size;
+    bundle_pending++;
+    bundle_sequence = NEXT_SEQUENCE(tx_sequence[INTERCOM_GROUP_ID]);
+    bundle_flags = (ptt_active ? PACKET_FLAG_PTT : 0) | (call_active ? PACKET_FLAG_CALL : 0);
+
+    if (bundle_pending < bundle_mode.frames) {
+        release_slot(slot);
+        return ESP_OK;
+    }
+    return bundle_send(slot);
+}
+
+static esp_err_t send_mix_minus(tx_slot_t *slot, transport_addr_t dest, uint16_t size,
+                                bool call_active)
+{
+    uint8_t flags = PACKET_FLAG_MIX_MINUS;
+    if (call_active) flags |= PACKET_FLAG_CALL;
+
+    // Same sequence as the broadcast that follows, so the listener can
+    // take either copy of this frame
+    uint32_t sequence = __atomic_load_n(&tx_sequence[INTERCOM_GROUP_ID], __ATOMIC_RELAXED);
+    esp_err_t ret = commit_slot(slot, dest, INTERCOM_GROUP_ID, sequence, flags, size);
+    if (ret == ESP_OK) {
+        TX_STAT_ADD(packets_sent, 1);
+    }
+    return ret;
+}
+
+static rx_source_t *find_source(uint32_t addr)
+{
+    rx_source_t *src = lookup_source(addr);
+    if (src) {
+        return src;
+    }
+
+    // New sender: take a free entry, or recycle one round-robin
+    for (size_t i = 0; i < UDP_MAX_SOURCES; i++) {
+        if (!rx_sources[i].in_use) {
+            src = &rx_sources[i];
+            break;
         }
+    }
+    if (!src) {
+        src = &rx_sources[next_source_evict];
+        next_source_evict = (next_source_evict + 1) % UDP_MAX_SOURCES;
+    }
+
+    memset(src, 0, sizeof(*src));
+    src->in_use = true;
+    src->addr = addr;
+    return src;
+}
 
-        audio_packet_t *packet = (audio_packet_t *)rx_buffer;
-
-        // Update statistics
-        stats.packets_received++;
-        stats.bytes_received += len;
-
-        // Check for lost packets
-        if (stats.packets_received > 1) {
-            uint32_t expected_seq = last_rx_sequence + 1;
-            if (packet->sequence > expected_seq) {
-                uint32_t lost = packet->sequence - expected_seq;
-                stats.packets_lost += lost;
-                ESP_LOGD(TAG, "Lost %lu packets (seq %lu -> %lu)",
-                        (unsigned long)lost, (unsigned long)last_rx_sequence,
-                        (unsigned long)packet->sequence);
+static void send_hello(transport_addr_t dest, bool reply)
+{
+    uint8_t msg[1 + sizeof(control_hello_t)];
+    control_hello_t hello = {
+        .formats = low_latency
+            ? (UDP_FORMATS & ~UDP_FORMAT_BUNDLE) | UDP_FORMAT_LOW_LATENCY
+            : UDP_FORMATS,
+        .device_id = DEVICE_ID,
+        .reply = reply ? 1 : 0,
+    };
+
+    msg[0] = CONTROL_MSG_HELLO;
+    memcpy(&msg[1], &hello, sizeof(hello));
+    send_packet(dest, INTERCOM_GROUP_ID, NEXT_SEQUENCE(tx_control_sequence),
+                PACKET_FLAG_CONTROL, msg, sizeof(msg));
+}
+
+static void handle_hello(rx_source_t *src, const uint8_t *payload, uint16_t size,
+                         int64_t now_us)
+{
+    if (size < sizeof(control_hello_t)) {
+        return;
+    }
+
+    control_hello_t hello;
+    memcpy(&hello, payload, sizeof(hello));
+
+    if (hello.formats != src->formats || src->hello_rx_us == 0) {
+        ESP_LOGI(TAG, "Peer %02x reads %s header%s%s", hello.device_id,
+                 (hello.formats & UDP_FORMAT_COMPACT) && COMPACT_HEADER_ENABLE ? "compact" : "full",
+                 (hello.formats & UDP_FORMAT_BUNDLE) ? ", bundles" : "",
+                 (hello.formats & UDP_FORMAT_LOW_LATENCY) ? ", low latency" : "");
+    }
+    src->formats = hello.formats;
+    src->hello_rx_us = now_us;
+
+    if (hello.reply) {
+        send_hello(src->addr, false);
+        src->hello_tx_us = now_us;
+    }
+}
+
+// Loss accounting for one audio frame. Returns false for a second copy
+// of a frame already received (not counted again).
+static bool track_sequence(rx_source_t *src, uint32_t sequence)
+{
+    uint32_t last_sequence = src->stream.last_sequence;
+    int32_t lost = audio_packet_track(&src->stream, sequence);
+    if (lost < 0) {
+        return false;
+    }
+
+    if (lost > 0) {
+        stats.packets_lost += (uint32_t)lost;
+        ESP_LOGD(TAG, "Lost %lu packets (seq %lu -> %lu)",
+                (unsigned long)lost, (unsigned long)last_sequence,
+                (unsigned long)sequence);
+    }
+    stats.packets_received++;
+
+    // Calculate packet loss percentage
+    uint32_t total = stats.packets_received + stats.packets_lost;
+    if (total > 0) {
+        stats.packet_loss_percent = (float)stats.packets_lost / total * 100.0f;
+    }
+    return true;
+}
+
+static void deliver_frame(const audio_packet_frame_t *frame, transport_addr_t source_addr)
+{
+    // Extract flags
+    bool ptt_active = (frame->flags & PACKET_FLAG_PTT) != 0;
+    bool call_active = (frame->flags & PACKET_FLAG_CALL) != 0;
+
+    // Call user callback (the jitter buffer copies the payload out)
+    if (user_rx_callback && frame->size > 0) {
+        bool mix_minus = (frame->flags & PACKET_FLAG_MIX_MINUS) != 0;
+        bool dtx = (frame->flags & PACKET_FLAG_DTX) != 0;
+        user_rx_callback(frame->payload, frame->size,
+                       ptt_active, call_active,
+                       frame->sequence, frame->timestamp,
+                       source_addr, mix_minus, dtx);
+    }
+
+    ESP_LOGD(TAG, "RX: seq=%lu, size=%u, ptt=%d, call=%d",
+            (unsigned long)frame->sequence, frame->size,
+            ptt_active, call_active);
+}
+
+// Split a bundle into its frames, oldest first; copies already received
+// are not delivered again
+static void deliver_bundle(rx_source_t *src, const audio_packet_frame_t *bundle,
+                           transport_addr_t source_addr)
+{
+    audio_packet_frame_t frames[UDP_BUNDLE_MAX_FRAMES];
+    size_t redundant = 0;
+    size_t count = audio_packet_split_bundle(bundle, frames, &redundant);
+
+    if (count == 0) {
+        ESP_LOGW(TAG, "Malformed bundle: %u bytes", bundle->size);
+        return;
+    }
+    if (count < (size_t)(bundle->payload[0] & 0x0F)) {
+        ESP_LOGW(TAG, "Truncated bundle: frame %u of %u", (unsigned)(count + 1),
+                 (unsigned)(bundle->payload[0] & 0x0F));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (track_sequence(src, frames[i].sequence)) {
+            if (i < redundant) {
+                stats.frames_recovered++;
             }
+            deliver_frame(&frames[i], source_addr);
         }
-        last_rx_sequence = packet->sequence;
+    }
+}
 
-        // Calculate packet loss percentage
-        uint32_t total = stats.packets_received + stats.packets_lost;
-        if (total > 0) {
-            stats.packet_loss_percent = (float)stats.packets_lost / total * 100.0f;
+// RX task context: one datagram, parsed in place in the backend's buffer
+// `replayed`: injected by udp_transport_inject, not heard on the link
+static void handle_packet(const uint8_t *data, int len, transport_addr_t source_addr,
+                          bool replayed)
+{
+    if (resync_pending) {
+        resync_pending = false;
+        for (size_t i = 0; i < UDP_MAX_SOURCES; i++) {
+            rx_sources[i].stream.valid = false;
         }
+        stats.link_resyncs++;
+    }
 
-        // Extract flags
-        bool ptt_active = (packet->flags & PACKET_FLAG_PTT) != 0;
-        bool call_active = (packet->flags & PACKET_FLAG_CALL) != 0;
+    // Parse packet
+    if (len < (int)AUDIO_PACKET_COMPACT_SIZE) {
+        ESP_LOGW(TAG, "Packet too small: %d bytes", len);
+        return;
+    }
+
+    audio_packet_frame_t frame;
+    if (!audio_packet_parse(data, (size_t)len, &frame)) {
+        ESP_LOGW(TAG, "Malformed packet: %d bytes", len);
+        return;
+    }
+
+    // Shared downlink: only our group's frames are for us
+    if (frame.group != INTERCOM_GROUP_ID) {
+        stats.packets_filtered++;
+        return;
+    }
 
-        // Notify device manager we received a packet (for sleep timeout)
-        device_manager_packet_received();
+    rx_source_t *src = find_source(source_addr);
+    if (frame.compact) {
+        audio_packet_unwrap(&src->stream, &frame);
+    }
 
-        // Call user callback
-        if (user_rx_callback && packet->opus_size > 0) {
-            user_rx_callback(packet->opus_data, packet->opus_size,
-                           ptt_active, call_active);
+    int64_t now_us = esp_timer_get_time();
+    src->last_rx_us = now_us;
+    stats.bytes_received += len;
+
+    // A replayed capture only feeds the audio path: no replies, and the
+    // control messages it holds are not acted on a second time
+    if (replayed && (frame.flags & PACKET_FLAG_CONTROL)) {
+        return;
+    }
+
+    // Keep each peer's wire format current (answered with a hello)
+    if (!replayed &&
+        (src->hello_rx_us == 0 || now_us - src->hello_rx_us > UDP_HELLO_REFRESH_US) &&
+        (src->hello_tx_us == 0 || now_us - src->hello_tx_us > UDP_HELLO_REFRESH_US)) {
+        send_hello(source_addr, true);
+        src->hello_tx_us = now_us;
+    }
+
+    // Control packets have their own sequence space - keep them out
+    // of the audio loss accounting
+    if (frame.flags & PACKET_FLAG_CONTROL) {
+        if (frame.size > 0 && frame.payload[0] == CONTROL_MSG_HELLO) {
+            handle_hello(src, &frame.payload[1], frame.size - 1, now_us);
+        } else if (control_callback && frame.size > 0) {
+            control_callback(source_addr, frame.payload, frame.size);
         }
+        return;
+    }
+
+    // Notify device manager we received a packet (for sleep timeout)
+    device_manager_packet_received();
+
+    if (frame.flags & PACKET_FLAG_BUNDLE) {
+        deliver_bundle(src, &frame, source_addr);
+        return;
+    }
+
+    // A single frame is delivered even as a second copy: the broadcast and
+    // the mix-minus carry the same sequence, and the jitter buffer keeps
+    // the preferred one
+    track_sequence(src, frame.sequence);
+    deliver_frame(&frame, source_addr);
+}
 
-        ESP_LOGD(TAG, "RX: seq=%lu, size=%u, ptt=%d, call=%d",
-                (unsigned long)packet->sequence, packet->opus_size,
-                ptt_active, call_active);
+// Parses what udp_transport_inject queued, in order
+static void handle_injected(void)
+{
+    static inject_item_t item;
+    while (inject_queue && xQueueReceive(inject_queue, &item, 0) == pdTRUE) {
+        int64_t start_us = esp_timer_get_time();
+        handle_packet(item.data, item.size, item.source_addr, true);
+        task_map_record(TASK_UDP_RX, (uint32_t)(esp_timer_get_time() - start_us));
+    }
+}
+
+static void udp_rx_task(void *arg)
+{
+    ESP_LOGI(TAG, "UDP RX task started (%s)", backend->name);
+
+    while (running) {
+        // Sleeps until a datagram arrives or udp_transport_stop() wakes us;
+        // while replaying, udp_transport_inject() wakes us too, with a
+        // frame's timeout in case the wake was lost to a full queue
+        const uint8_t *data = NULL;
+        transport_addr_t source_addr = 0;
+        int len = backend->recv(&data, &source_addr,
+                                replaying ? FRAME_SIZE_MS : TRANSPORT_WAIT_FOREVER);
+
+        handle_injected();
+
+        if (len < 0) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+
+        if (len == 0) {
+            continue;
+        }
+
+        packet_capture_record(PACKET_CAPTURE_RX, data, (size_t)len, source_addr);
+        if (replaying) {
+            backend->release();
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        handle_packet(data, len, source_addr, false);
+        backend->release();
+        task_map_record(TASK_UDP_RX, (uint32_t)(esp_timer_get_time() - start_us));
     }
 
     ESP_LOGI(TAG, "UDP RX task stopped");
-    vTaskDelete(NULL);
+    rx_task_handle = NULL;
+    task_map_exit(TASK_UDP_RX);
 }
 
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
 
-esp_err_t udp_transport_init(udp_rx_callback_t rx_callback)
+// BUNDLE_MODE, or the one provisioned in NVS
+static void load_bundle_mode(void)
 {
-    if (initialized) {
-        ESP_LOGW(TAG, "UDP transport already initialized");
-        return ESP_OK;
+    uint8_t mode = BUNDLE_MODE;
+
+    nvs_handle_t nvs;
+    if (nvs_open(TRANSPORT_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t value;
+        if (nvs_get_u8(nvs, BUNDLE_NVS_KEY, &value) == ESP_OK &&
+            value < sizeof(bundle_modes) / sizeof(bundle_modes[0])) {
+            mode = value;
+            ESP_LOGI(TAG, "Bundle mode provisioned in NVS: %u", value);
+        }
+        nvs_close(nvs);
     }
 
-    ESP_LOGI(TAG, "Initializing UDP transport...");
+    bundle_mode = bundle_modes[mode];
+    bundle_held = 0;
+    bundle_pending = 0;
+    ESP_LOGI(TAG, "Frames per datagram: %u new + %u repeated",
+             bundle_mode.frames, bundle_mode.redundant);
+}
 
-    user_rx_callback = rx_callback;
+// LINK_LOW_LATENCY, or the one provisioned in NVS
+static void load_low_latency(void)
+{
+    bool enable = LINK_LOW_LATENCY;
+
+    nvs_handle_t nvs;
+    if (nvs_open(TRANSPORT_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t value;
+        if (nvs_get_u8(nvs, LINK_LOW_LATENCY_NVS_KEY, &value) == ESP_OK) {
+            enable = value != 0;
+            ESP_LOGI(TAG, "Low-latency link provisioned in NVS: %u", value);
+        }
+        nvs_close(nvs);
+    }
 
-    // Create UDP socket
-    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sock < 0) {
-        ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
-        return ESP_FAIL;
+    low_latency = enable;
+    if (enable) {
+        ESP_LOGI(TAG, "Low-latency link: no bundling, shallow jitter buffer");
     }
+}
 
-    // Set socket timeout for RX
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 100000;  // 100ms timeout
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+udp_backend_type_t udp_transport_get_backend(void)
+{
+    static bool resolved = false;
+    static udp_backend_type_t selected = TRANSPORT_BACKEND;
 
-#if DEVICE_TYPE_BASE
-    // Base station: bind to UDP port to receive from pack
-    struct sockaddr_in bind_addr;
-    bind_addr.sin_family = AF_INET;
-    bind_addr.sin_port = htons(UDP_PORT);
-    bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-    if (bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0) {
-        ESP_LOGE(TAG, "Failed to bind socket: errno %d", errno);
-        close(sock);
-        sock = -1;
-        return ESP_FAIL;
+    if (resolved) {
+        return selected;
+    }
+    resolved = true;
+
+    // A provisioned choice in NVS overrides the build default
+    nvs_handle_t nvs;
+    if (nvs_open(TRANSPORT_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        uint8_t value;
+        if (nvs_get_u8(nvs, TRANSPORT_NVS_KEY, &value) == ESP_OK &&
+            (value == UDP_BACKEND_LWIP || value == UDP_BACKEND_ESPNOW)) {
+            selected = (udp_backend_type_t)value;
+            ESP_LOGI(TAG, "Link backend provisioned in NVS: %u", value);
+        }
+        nvs_close(nvs);
     }
 
-    ESP_LOGI(TAG, "Bound to port %d", UDP_PORT);
-
-    // Destination: broadcast to connected stations
-    // Will be updated when station connects
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(UDP_PORT);
-    dest_addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    return selected;
+}
 
-#else // DEVICE_TYPE_PACK
-    // Belt pack: bind to any port, send to base station
-    struct sockaddr_in bind_addr;
-    bind_addr.sin_family = AF_INET;
-    bind_addr.sin_port = htons(UDP_PORT);
-    bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+bool udp_transport_backend_uses_ip(void)
+{
+    return backend_for(udp_transport_get_backend())->uses_ip;
+}
 
-    if (bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0) {
-        ESP_LOGE(TAG, "Failed to bind socket: errno %d", errno);
-        close(sock);
-        sock = -1;
-        return ESP_FAIL;
+esp_err_t udp_transport_init(udp_rx_callback_t rx_callback)
+{
+    if (initialized) {
+        ESP_LOGW(TAG, "UDP transport already initialized");
+        return ESP_OK;
     }
 
-    // Destination: base station
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(UDP_PORT);
-    inet_pton(AF_INET, BASE_STATION_IP, &dest_addr.sin_addr);
+    ESP_LOGI(TAG, "Initializing UDP transport...");
 
-    ESP_LOGI(TAG, "Target: %s:%d", BASE_STATION_IP, UDP_PORT);
-#endif
+    user_rx_callback = rx_callback;
+
+    backend = backend_for(udp_transport_get_backend());
+    ESP_LOGI(TAG, "Link backend: %s", backend->name);
+
+    esp_err_t ret = backend->open();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open %s backend", backend->name);
+        backend = NULL;
+        return ret;
+    }
 
     // Reset statistics
     memset(&stats, 0, sizeof(stats));
-    tx_sequence = 0;
-    last_rx_sequence = 0;
+    memset(tx_sequence, 0, sizeof(tx_sequence));
+    tx_control_sequence = 0;
+    memset(rx_sources, 0, sizeof(rx_sources));
+    memset(tx_slots, 0, sizeof(tx_slots));
+    load_bundle_mode();
+    load_low_latency();
 
     initialized = true;
     ESP_LOGI(TAG, "UDP transport initialized");
@@ -216,7 +890,11 @@ esp_err_t udp_transport_start(void)
     running = true;
 
     // Start RX task
-    xTaskCreate(udp_rx_task, "udp_rx", 8192, NULL, 4, &rx_task_handle);
+    esp_err_t ret = task_map_create(TASK_UDP_RX, udp_rx_task, NULL, &rx_task_handle);
+    if (ret != ESP_OK) {
+        running = false;
+        return ret;
+    }
 
     ESP_LOGI(TAG, "UDP transport started");
     return ESP_OK;
@@ -231,11 +909,11 @@ esp_err_t udp_transport_stop(void)
     ESP_LOGI(TAG, "Stopping UDP transport...");
 
     running = false;
+    backend->wake();
 
     // Wait for RX task to finish
-    if (rx_task_handle) {
-        vTaskDelay(pdMS_TO_TICKS(200));  // Give task time to exit
-        rx_task_handle = NULL;
+    for (int i = 0; i < 20 && rx_task_handle; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
     }
 
     ESP_LOGI(TAG, "UDP transport stopped");
@@ -245,56 +923,220 @@ esp_err_t udp_transport_stop(void)
 esp_err_t udp_transport_send(const uint8_t *opus_data, uint16_t opus_size,
                              bool ptt_active, bool call_active)
 {
-    if (!initialized || sock < 0) {
+    return udp_transport_send_group(INTERCOM_GROUP_ID, opus_data, opus_size,
+                                    ptt_active, call_active);
+}
+
+esp_err_t udp_transport_send_group(uint8_t group, const uint8_t *opus_data, uint16_t opus_size,
+                                   bool ptt_active, bool call_active)
+{
+    if (!initialized || group >= UDP_MAX_GROUPS) {
         return ESP_FAIL;
     }
 
-    if (opus_size > sizeof(((audio_packet_t*)0)->opus_data)) {
-        ESP_LOGE(TAG, "Opus data too large: %u bytes", opus_size);
+    if (opus_size > tx_capacity()) {
+        ESP_LOGE(TAG, "Payload too large: %u bytes", opus_size);
         return ESP_FAIL;
     }
 
-    // Build packet
-    audio_packet_t packet;
-    packet.sequence = tx_sequence++;
-    packet.timestamp = esp_timer_get_time();
-    packet.opus_size = opus_size;
-    packet.flags = 0;
-    if (ptt_active) packet.flags |= PACKET_FLAG_PTT;
-    if (call_active) packet.flags |= PACKET_FLAG_CALL;
-    packet.reserved = 0;
+    tx_slot_t *slot = acquire_slot();
+    if (!slot) {
+        return ESP_ERR_NO_MEM;
+    }
 
     if (opus_data && opus_size > 0) {
-        memcpy(packet.opus_data, opus_data, opus_size);
+        memcpy(slot->packet.opus_data, opus_data, opus_size);
     }
+    return send_audio(slot, group, opus_size, ptt_active, call_active, 0);
+}
 
-    // Calculate packet size (header + opus data)
-    size_t packet_size = sizeof(audio_packet_t) - sizeof(packet.opus_data) + opus_size;
+uint8_t *udp_transport_acquire_tx_buffer(size_t *capacity)
+{
+    if (!initialized) {
+        return NULL;
+    }
 
-    // Send packet
-    int sent = sendto(sock, &packet, packet_size, 0,
-                     (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    tx_slot_t *slot = acquire_slot();
+    if (!slot) {
+        ESP_LOGW(TAG, "No free TX slot");
+        return NULL;
+    }
 
-    if (sent < 0) {
-        // errno 118 = EHOSTUNREACH (no route to host) - WiFi not connected yet
-        // errno 113 = EHOSTUNREACH (no route to host) - base station not reachable
-        // These are expected during startup/disconnect - don't spam logs
-        if (errno != 118 && errno != 113) {
-            ESP_LOGE(TAG, "sendto failed: errno %d", errno);
-        }
+    if (capacity) {
+        *capacity = tx_capacity();
+    }
+    return slot->packet.opus_data;
+}
+
+esp_err_t udp_transport_commit_tx_buffer(uint8_t *buffer, uint16_t size,
+                                         bool ptt_active, bool call_active)
+{
+    tx_slot_t *slot = slot_from_buffer(buffer);
+    if (!slot) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return send_bundled(slot, size, ptt_active, call_active);
+}
+
+esp_err_t udp_transport_commit_dtx_update(uint8_t *buffer, uint16_t size, bool call_active)
+{
+    tx_slot_t *slot = slot_from_buffer(buffer);
+    if (!slot) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Held frames come first; the update starts a gap
+    bundle_flush();
+    return send_audio(slot, INTERCOM_GROUP_ID, size, false, call_active, PACKET_FLAG_DTX);
+}
+
+esp_err_t udp_transport_commit_mix_minus(uint32_t dest, uint8_t *buffer, uint16_t size,
+                                         bool call_active)
+{
+    tx_slot_t *slot = slot_from_buffer(buffer);
+    if (!slot) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (dest == TRANSPORT_ADDR_DEFAULT) {
+        release_slot(slot);
         return ESP_FAIL;
     }
 
-    // Update statistics
-    stats.packets_sent++;
-    stats.bytes_sent += sent;
+    return send_mix_minus(slot, dest, size, call_active);
+}
+
+void udp_transport_release_tx_buffer(uint8_t *buffer)
+{
+    tx_slot_t *slot = slot_from_buffer(buffer);
+    if (slot) {
+        release_slot(slot);
+    }
+}
+
+void udp_transport_flush(void)
+{
+    if (!initialized) {
+        return;
+    }
 
-    ESP_LOGD(TAG, "TX: seq=%lu, size=%u, ptt=%d, call=%d",
-            (unsigned long)packet.sequence, opus_size, ptt_active, call_active);
+    bundle_flush();
+}
+
+void udp_transport_set_low_latency(bool enable)
+{
+    if (enable == low_latency) {
+        return;
+    }
+
+    low_latency = enable;
+    ESP_LOGI(TAG, "Low-latency link %s", enable ? "on" : "off");
+
+    // Tell the far end now rather than at its next hello refresh
+    if (initialized && running) {
+        send_hello(TRANSPORT_ADDR_DEFAULT, false);
+    }
+}
+
+bool udp_transport_link_low_latency(uint32_t addr)
+{
+    if (low_latency) {
+        return true;
+    }
+
+    // The peer's side of the link, as its last hello stated
+    const rx_source_t *src = lookup_source(addr);
+    return src && source_reads(src, UDP_FORMAT_LOW_LATENCY, esp_timer_get_time());
+}
+
+esp_err_t udp_transport_join_multicast(void)
+{
+    if (!initialized) {
+        return ESP_FAIL;
+    }
+
+    return backend->join_multicast ? backend->join_multicast() : ESP_OK;
+}
 
+esp_err_t udp_transport_send_mix_minus(uint32_t dest, const uint8_t *opus_data,
+                                       uint16_t opus_size, bool call_active)
+{
+    if (!initialized || dest == TRANSPORT_ADDR_DEFAULT) {
+        return ESP_FAIL;
+    }
+
+    if (opus_size > tx_capacity()) {
+        ESP_LOGE(TAG, "Payload too large: %u bytes", opus_size);
+        return ESP_FAIL;
+    }
+
+    tx_slot_t *slot = acquire_slot();
+    if (!slot) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (opus_data && opus_size > 0) {
+        memcpy(slot->packet.opus_data, opus_data, opus_size);
+    }
+    return send_mix_minus(slot, dest, opus_size, call_active);
+}
+
+esp_err_t udp_transport_send_control(uint32_t dest, const uint8_t *data, uint16_t size)
+{
+    if (!initialized || !data || size == 0) {
+        return ESP_FAIL;
+    }
+
+    return send_packet(dest, INTERCOM_GROUP_ID, NEXT_SEQUENCE(tx_control_sequence),
+                       PACKET_FLAG_CONTROL, data, size);
+}
+
+void udp_transport_set_replay(bool active)
+{
+    if (active && !inject_queue) {
+        // Kept until deinit: the RX task may still be draining it
+        inject_queue = xQueueCreate(UDP_INJECT_DEPTH, sizeof(inject_item_t));
+        if (!inject_queue) {
+            ESP_LOGE(TAG, "No memory for the inject queue");
+            return;
+        }
+    }
+    replaying = active;
+
+    // The RX task picks up its new recv() timeout
+    if (running) {
+        backend->wake();
+    }
+}
+
+esp_err_t udp_transport_inject(const uint8_t *data, uint16_t size, uint32_t source_addr)
+{
+    if (!initialized || !replaying || !inject_queue || !data) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (size > sizeof(((inject_item_t *)0)->data)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    inject_item_t item;
+    item.source_addr = source_addr;
+    item.size = size;
+    memcpy(item.data, data, size);
+
+    // Full means the RX task is a frame behind: hold the sender that long
+    if (xQueueSend(inject_queue, &item, pdMS_TO_TICKS(FRAME_SIZE_MS)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    backend->wake();
     return ESP_OK;
 }
 
+void udp_transport_set_control_callback(udp_control_callback_t callback)
+{
+    control_callback = callback;
+}
+
 void udp_transport_get_stats(udp_stats_t *stats_out)
 {
     if (stats_out) {
@@ -305,8 +1147,13 @@ void udp_transport_get_stats(udp_stats_t *stats_out)
 void udp_transport_reset_stats(void)
 {
     memset(&stats, 0, sizeof(stats));
-    tx_sequence = 0;
-    last_rx_sequence = 0;
+    memset(tx_sequence, 0, sizeof(tx_sequence));
+    memset(rx_sources, 0, sizeof(rx_sources));
+}
+
+void udp_transport_resync(void)
+{
+    resync_pending = true;
 }
 
 bool udp_transport_is_initialized(void)
@@ -324,11 +1171,17 @@ void udp_transport_deinit(void)
 
     udp_transport_stop();
 
-    if (sock >= 0) {
-        close(sock);
-        sock = -1;
+    if (backend) {
+        backend->close();
+        backend = NULL;
+    }
+
+    replaying = false;
+    if (inject_queue) {
+        vQueueDelete(inject_queue);
+        inject_queue = NULL;
     }
 
     initialized = false;
     ESP_LOGI(TAG, "UDP transport deinitialized");
-}
\ No newline at end of file
+}
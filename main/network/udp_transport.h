@@ -2,7 +2,8 @@
  * @file udp_transport.h
  * @brief UDP Audio Packet Transport
  *
- * Handles transmission and reception of Opus-encoded audio packets.
+ * Handles transmission and reception of Opus-encoded audio packets over
+ * the link backend selected by TRANSPORT_BACKEND (lwIP UDP or ESP-NOW).
  */
 
 #ifndef UDP_TRANSPORT_H
@@ -10,26 +11,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
-
-//=============================================================================
-// PACKET STRUCTURE
-//=============================================================================
-
-#define UDP_MAX_PACKET_SIZE  512
-
-typedef struct __attribute__((packed)) {
-    uint32_t sequence;           // Incrementing packet number
-    uint32_t timestamp;          // Microsecond timestamp
-    uint16_t opus_size;          // Size of Opus data
-    uint8_t  flags;              // Bit 0: PTT active, Bit 1: Call active
-    uint8_t  reserved;           // Future use
-    uint8_t  opus_data[256];     // Opus compressed audio
-} audio_packet_t;
-
-// Flag bits
-#define PACKET_FLAG_PTT   (1 << 0)
-#define PACKET_FLAG_CALL  (1 << 1)
+#include "audio_packet.h"
 
 //=============================================================================
 // STATISTICS
@@ -39,8 +23,13 @@ typedef struct {
     uint32_t packets_sent;
     uint32_t packets_received;
     uint32_t packets_lost;
+    uint32_t packets_filtered;   // Dropped: addressed to another group
     uint32_t bytes_sent;
     uint32_t bytes_received;
+    uint32_t packets_compact;    // Audio packets sent with compact_header_t
+    uint32_t frames_bundled;     // Frames sent inside bundles (new ones only)
+    uint32_t frames_recovered;   // Frames first received as a bundle's redundant copy
+    uint32_t link_resyncs;       // Link-ups after which sequence tracking restarted
     float packet_loss_percent;
 } udp_stats_t;
 
@@ -54,14 +43,54 @@ typedef struct {
  * @param opus_size Size of Opus data
  * @param ptt_active Remote PTT state
  * @param call_active Remote call state
+ * @param sequence Sender's packet sequence number
+ * @param timestamp Sender's timestamp (microseconds)
+ * @param source_addr Sender's address (IPv4 in network byte order on the
+ *                    lwIP backend, peer handle on ESP-NOW)
+ * @param mix_minus Packet is this receiver's own mix-minus feed
  */
 typedef void (*udp_rx_callback_t)(const uint8_t *opus_data, uint16_t opus_size,
-                                   bool ptt_active, bool call_active);
+                                   bool ptt_active, bool call_active,
+                                   uint32_t sequence, uint32_t timestamp,
+                                   uint32_t source_addr, bool mix_minus, bool dtx);
+
+/**
+ * @brief Callback when a control packet is received
+ * @param source_addr Sender's address (reply with udp_transport_send_control)
+ * @param data Control message (see control_channel.h)
+ * @param size Size of message
+ */
+typedef void (*udp_control_callback_t)(uint32_t source_addr, const uint8_t *data, uint16_t size);
+
+//=============================================================================
+// LINK BACKEND
+//=============================================================================
+
+// Values match TRANSPORT_LWIP / TRANSPORT_ESPNOW in config_common.h
+typedef enum {
+    UDP_BACKEND_LWIP = 0,        // UDP socket over associated WiFi
+    UDP_BACKEND_ESPNOW = 1,      // ESP-NOW frames, no IP stack
+} udp_backend_type_t;
 
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
 
+/**
+ * @brief Link backend in use
+ *
+ * TRANSPORT_BACKEND unless a provisioned value is stored in NVS
+ * (TRANSPORT_NVS_NAMESPACE / TRANSPORT_NVS_KEY). Valid before init, so
+ * WiFi can be brought up to match.
+ * @return Selected backend
+ */
+udp_backend_type_t udp_transport_get_backend(void);
+
+/**
+ * @brief Whether the selected backend needs WiFi association and an IP
+ */
+bool udp_transport_backend_uses_ip(void);
+
 /**
  * @brief Initialize UDP transport
  * @param rx_callback Callback for received packets
@@ -82,7 +111,7 @@ esp_err_t udp_transport_start(void);
 esp_err_t udp_transport_stop(void);
 
 /**
- * @brief Send audio packet
+ * @brief Send audio packet to INTERCOM_GROUP_ID
  * @param opus_data Opus encoded audio
  * @param opus_size Size of Opus data
  * @param ptt_active Local PTT state
@@ -92,6 +121,163 @@ esp_err_t udp_transport_stop(void);
 esp_err_t udp_transport_send(const uint8_t *opus_data, uint16_t opus_size,
                              bool ptt_active, bool call_active);
 
+/**
+ * @brief Send audio packet to a group
+ *
+ * Uses the group's own sequence counter. On the base this is the single
+ * broadcast/multicast datagram every pack in the group receives.
+ * @param group Group ID (< UDP_MAX_GROUPS)
+ * @param opus_data Opus encoded audio
+ * @param opus_size Size of Opus data
+ * @param ptt_active Local PTT state
+ * @param call_active Local call state
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_send_group(uint8_t group, const uint8_t *opus_data, uint16_t opus_size,
+                                   bool ptt_active, bool call_active);
+
+/**
+ * @brief Take a preallocated transmit slot to encode straight into
+ *
+ * The returned buffer is the payload of a packet the transport already
+ * owns: the header is filled in place on commit and the whole datagram
+ * goes to the link without another copy. Every buffer acquired must be
+ * passed to exactly one commit call or to
+ * udp_transport_release_tx_buffer().
+ * @param capacity Set to the largest payload the slot and link can carry
+ * @return Payload buffer, or NULL if not initialized or no slot is free
+ */
+uint8_t *udp_transport_acquire_tx_buffer(size_t *capacity);
+
+/**
+ * @brief Send an acquired buffer as audio to INTERCOM_GROUP_ID
+ *
+ * Same packet as udp_transport_send(); the slot is released.
+ * @param buffer Buffer from udp_transport_acquire_tx_buffer()
+ * @param size Bytes written to it
+ * @param ptt_active Local PTT state
+ * @param call_active Local call state
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_commit_tx_buffer(uint8_t *buffer, uint16_t size,
+                                         bool ptt_active, bool call_active);
+
+/**
+ * @brief Send an acquired buffer as a comfort-noise update (PACKET_FLAG_DTX)
+ * @param buffer Buffer from udp_transport_acquire_tx_buffer()
+ * @param size Bytes written to it
+ * @param call_active Local call state
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_commit_dtx_update(uint8_t *buffer, uint16_t size, bool call_active);
+
+/**
+ * @brief Send an acquired buffer as one pack's mix-minus frame (base)
+ *
+ * Same packet as udp_transport_send_mix_minus(); the slot is released.
+ * @param dest Pack's address as passed to the RX callback
+ * @param buffer Buffer from udp_transport_acquire_tx_buffer()
+ * @param size Bytes written to it
+ * @param call_active Local call state
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_commit_mix_minus(uint32_t dest, uint8_t *buffer, uint16_t size,
+                                         bool call_active);
+
+/**
+ * @brief Give back an acquired buffer without sending it
+ * @param buffer Buffer from udp_transport_acquire_tx_buffer()
+ */
+void udp_transport_release_tx_buffer(uint8_t *buffer);
+
+/**
+ * @brief Send frames held for a bundle now (BUNDLE_MODE)
+ *
+ * Call from the audio engine whenever a frame is not sent (DTX skip, PTT
+ * released, encode failure), so held frames never wait for audio that
+ * is not coming. No-op with nothing held.
+ */
+void udp_transport_flush(void);
+
+/**
+ * @brief Switch this device's links to low latency (LINK_LOW_LATENCY)
+ *
+ * No frames are held for bundles, and the hello (sent at once) asks the
+ * far end to stop bundling too and to keep its jitter buffer shallow.
+ * @param enable true for low latency
+ */
+void udp_transport_set_low_latency(bool enable);
+
+/**
+ * @brief Whether the link with a peer runs low latency
+ *
+ * True if this device or the peer (in its last hello) asked for it.
+ * Receivers use it to pick the jitter buffer range for that peer's stream.
+ * @param addr Peer address as passed to the RX callback
+ * @return true for a low-latency link
+ */
+bool udp_transport_link_low_latency(uint32_t addr);
+
+/**
+ * @brief Join the downlink multicast group (pack, DOWNLINK_MULTICAST_ENABLE)
+ *
+ * Call once the station has an IP address; repeated calls are harmless.
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_join_multicast(void);
+
+/**
+ * @brief Send one pack its own mix-minus frame (base station)
+ *
+ * Call before udp_transport_send() for the same frame: the packet reuses
+ * the sequence number the group broadcast is about to take.
+ * @param dest Pack's address as passed to the RX callback
+ * @param opus_data Opus encoded audio
+ * @param opus_size Size of Opus data
+ * @param call_active Local call state
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_send_mix_minus(uint32_t dest, const uint8_t *opus_data,
+                                       uint16_t opus_size, bool call_active);
+
+/**
+ * @brief Send a control message to the peer(s)
+ * @param dest Peer address as passed to a callback, or 0 for every peer
+ *             (the base on a pack)
+ * @param data Control message
+ * @param size Size of message
+ * @return ESP_OK on success
+ */
+esp_err_t udp_transport_send_control(uint32_t dest, const uint8_t *data, uint16_t size);
+
+/**
+ * @brief Drop live datagrams so a captured stream can be injected
+ *
+ * Injected datagrams are parsed by the RX task, after any live one it
+ * was handling, so the first udp_transport_inject() may follow at once.
+ */
+void udp_transport_set_replay(bool active);
+
+/**
+ * @brief Parse a captured datagram as if it had just been received
+ *
+ * Replay only (udp_transport_set_replay): the datagram is copied and
+ * queued to the RX task, which stays the only writer into the jitter
+ * buffers. Audio is delivered, control messages are skipped and no
+ * hellos are sent.
+ * @param source_addr Original sender
+ * @return ESP_ERR_INVALID_STATE unless replaying, ESP_ERR_INVALID_SIZE
+ *         above an audio packet, ESP_ERR_TIMEOUT if the RX task stayed
+ *         a frame behind
+ */
+esp_err_t udp_transport_inject(const uint8_t *data, uint16_t size, uint32_t source_addr);
+
+/**
+ * @brief Register the handler for received control packets
+ * @param callback Called from the RX task for each control packet
+ */
+void udp_transport_set_control_callback(udp_control_callback_t callback);
+
 /**
  * @brief Get transport statistics
  * @param stats Pointer to stats structure
@@ -103,6 +289,14 @@ void udp_transport_get_stats(udp_stats_t *stats);
  */
 void udp_transport_reset_stats(void);
 
+/**
+ * @brief Restart sequence tracking for every sender (call on link-up)
+ *
+ * Applied by the RX task before the next packet, so the frames missed
+ * while the link was down are not counted as loss.
+ */
+void udp_transport_resync(void);
+
 /**
  * @brief Check if UDP transport has been initialized
  * @return true if initialized, false otherwise
@@ -1,6 +1,23 @@
 /**
  * @file wifi_manager.c
  * @brief WiFi Management Implementation
+ *
+ * Every start applies the link profile from config_common.h: protocol
+ * set, channel width, optional fixed PHY rate and TX power cap. On the
+ * pack the STA powers up with modem sleep off; the power manager then
+ * moves it between WIFI_PS_NONE and WIFI_PS_MIN_MODEM through
+ * wifi_manager_set_link_idle().
+ *
+ * Pack reconnects are driven by a one-shot esp_timer with a millisecond
+ * backoff, never by blocking the event loop, and go straight to the AP
+ * cached from the last association (see WIFI_FAST_RECONNECT_ENABLE).
+ * The cache lives in RAM; its NVS copy is written on the event loop, so
+ * a channel notice handled by the RX task never waits on flash.
+ *
+ * The base's AP channel is whatever was set last (WIFI_CHANNEL until
+ * then). Before the AP starts the radio can survey channels in
+ * promiscuous mode; once it runs, a new channel is announced to the
+ * stations with a channel switch announcement (CSA) in the beacons.
  */
 
 #include "wifi_manager.h"
@@ -9,6 +26,10 @@
 #include "esp_event.h"
 #include "esp_netif.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include <string.h>
 #include <rom/ets_sys.h>
 
@@ -24,6 +45,221 @@ static wifi_event_callback_t user_callback = NULL;
 static esp_netif_t *netif = NULL;
 static int8_t current_rssi = 0;
 static uint8_t sta_count = 0;
+static bool radio_only = false;      // ESP-NOW: radio up, never associate
+static volatile bool link_idle = false;  // Modem sleep allowed (pack STA)
+static SemaphoreHandle_t ps_mutex = NULL;
+
+#if DEVICE_TYPE_BASE
+static uint8_t ap_channel = WIFI_CHANNEL;
+static bool ap_started = false;          // AP config applied (channel moves by CSA)
+
+// Survey accumulators for the channel being listened to (WiFi task writes)
+static portMUX_TYPE survey_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t survey_frames = 0;
+static uint64_t survey_airtime_us = 0;
+static int32_t survey_noise_sum = 0;
+static int8_t survey_max_rssi = -128;
+#endif
+
+#if DEVICE_TYPE_PACK
+// Last AP associated with, as stored in NVS
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t channel;
+} ap_cache_t;
+
+// ap_cache, ap_cache_valid and ap_cache_dirty under cache_mutex: written
+// from the event loop and from the control message path
+static SemaphoreHandle_t cache_mutex = NULL;
+static ap_cache_t ap_cache;
+static bool ap_cache_valid = false;
+static bool ap_cache_dirty = false;      // RAM copy newer than NVS
+static bool ap_cache_in_use = false;     // STA config currently points at it
+static bool ap_cache_stale = false;      // Cache changed since configure_sta
+static bool sta_running = false;         // Reconnect after a drop
+static uint32_t failed_attempts = 0;
+static uint32_t backoff_ms = WIFI_RECONNECT_MIN_MS;
+static esp_timer_handle_t reconnect_timer = NULL;
+static int64_t link_lost_us = 0;         // 0 = not in an outage
+
+// Posted to the event loop when the AP cache needs storing
+static esp_event_base_t const WIFI_CACHE_EVENT = "WIFI_CACHE_EVENT";
+#endif
+
+//=============================================================================
+// PRIVATE FUNCTIONS - Fast Reconnect (pack)
+//=============================================================================
+
+#if DEVICE_TYPE_PACK
+static void load_ap_cache(void)
+{
+    if (!WIFI_FAST_RECONNECT_ENABLE) return;
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        size_t size = sizeof(ap_cache);
+        ap_cache_valid = nvs_get_blob(nvs, WIFI_CACHE_NVS_KEY, &ap_cache, &size) == ESP_OK &&
+                         size == sizeof(ap_cache) && ap_cache.channel > 0;
+        nvs_close(nvs);
+    }
+}
+
+// RAM only; write_ap_cache() stores it. A NULL bssid keeps the cached one
+// (and needs a valid cache). Returns true if it changed.
+static bool update_ap_cache(const uint8_t *bssid, uint8_t channel)
+{
+    if (!WIFI_FAST_RECONNECT_ENABLE || !cache_mutex) return false;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    bool changed = bssid ? !ap_cache_valid || ap_cache.channel != channel ||
+                           memcmp(ap_cache.bssid, bssid, sizeof(ap_cache.bssid)) != 0
+                         : ap_cache_valid && ap_cache.channel != channel;
+    if (changed) {
+        if (bssid) {
+            memcpy(ap_cache.bssid, bssid, sizeof(ap_cache.bssid));
+        }
+        ap_cache.channel = channel;
+        ap_cache_valid = true;
+        ap_cache_dirty = true;
+    }
+    xSemaphoreGive(cache_mutex);
+    return changed;
+}
+
+// Event loop only: NVS is written from a snapshot, outside cache_mutex,
+// and only when the AP actually changed
+static void write_ap_cache(void)
+{
+    if (!WIFI_FAST_RECONNECT_ENABLE || !cache_mutex) return;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    bool dirty = ap_cache_dirty;
+    ap_cache_t snapshot = ap_cache;
+    ap_cache_dirty = false;
+    xSemaphoreGive(cache_mutex);
+    if (!dirty) {
+        return;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_CACHE_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+        if (nvs_set_blob(nvs, WIFI_CACHE_NVS_KEY, &snapshot, sizeof(snapshot)) == ESP_OK) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    ESP_LOGI(TAG, "Cached AP " MACSTR " on channel %d", MAC2STR(snapshot.bssid),
+             snapshot.channel);
+}
+
+// Station config: the cached AP directly, or a scan for WIFI_SSID.
+// Only BSSID and channel ever change, so the driver's PMK stays valid.
+static void configure_sta(bool use_cache)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = WIFI_SSID,
+            .password = WIFI_PASSWORD,
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {
+                .capable = false,  // Disable PMF to match AP
+                .required = false
+            },
+        },
+    };
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    ap_cache_in_use = use_cache && ap_cache_valid;
+    ap_cache_stale = false;
+    if (ap_cache_in_use) {
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, ap_cache.bssid, sizeof(ap_cache.bssid));
+        wifi_config.sta.channel = ap_cache.channel;
+    }
+    xSemaphoreGive(cache_mutex);
+
+    if (ap_cache_in_use) {
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    } else {
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        wifi_config.sta.sort_method = WIFI_CONNECT_AP_BY_SIGNAL;
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+}
+
+static void reconnect_timer_cb(void *arg)
+{
+    if (sta_running && !connected) {
+        esp_wifi_connect();
+    }
+}
+
+// After a failed attempt or a drop: next try after the backoff, and back
+// to scanning once the cached AP has failed often enough. The STA config
+// only changes here, while not associated.
+static void schedule_reconnect(void)
+{
+    failed_attempts++;
+    if (ap_cache_in_use && failed_attempts >= WIFI_FAST_RECONNECT_TRIES) {
+        ESP_LOGW(TAG, "Cached AP not answering - scanning for %s", WIFI_SSID);
+        configure_sta(false);
+    } else if (ap_cache_stale) {
+        configure_sta(true);    // Found by scan, or the AP announced a new channel
+    }
+
+    uint32_t delay_ms = failed_attempts == 1 ? 0 : backoff_ms;
+    if (failed_attempts > 1) {
+        backoff_ms = backoff_ms * 2 > WIFI_RECONNECT_MAX_MS ? WIFI_RECONNECT_MAX_MS
+                                                            : backoff_ms * 2;
+    }
+
+    esp_timer_stop(reconnect_timer);
+    if (delay_ms == 0) {
+        esp_wifi_connect();
+    } else {
+        esp_timer_start_once(reconnect_timer, (uint64_t)delay_ms * 1000);
+    }
+}
+#endif // DEVICE_TYPE_PACK
+
+//=============================================================================
+// PRIVATE FUNCTIONS - Channel Survey (base)
+//=============================================================================
+
+#if DEVICE_TYPE_BASE
+// Air time of one received frame, from its PHY rate (wifi_phy_rate_t
+// codes for non-HT, HT20 long-GI MCS otherwise)
+static uint32_t frame_airtime_us(const wifi_pkt_rx_ctrl_t *rx)
+{
+    static const uint16_t legacy_kbps[16] = {
+        1000, 2000, 5500, 11000, 1000, 2000, 5500, 11000,
+        48000, 24000, 12000, 6000, 54000, 36000, 18000, 9000,
+    };
+    static const uint16_t ht_kbps[8] = {
+        6500, 13000, 19500, 26000, 39000, 52000, 58500, 65000,
+    };
+
+    uint32_t kbps = rx->sig_mode == 0 ? legacy_kbps[rx->rate & 0x0F] : ht_kbps[rx->mcs & 0x07];
+    return WIFI_SURVEY_PREAMBLE_US + (uint32_t)rx->sig_len * 8 * 1000 / kbps;
+}
+
+// WiFi task context, every frame heard on the surveyed channel
+static void survey_rx_cb(void *buf, wifi_promiscuous_pkt_type_t type)
+{
+    const wifi_promiscuous_pkt_t *pkt = (const wifi_promiscuous_pkt_t *)buf;
+    uint32_t airtime_us = frame_airtime_us(&pkt->rx_ctrl);
+
+    portENTER_CRITICAL(&survey_lock);
+    survey_frames++;
+    survey_airtime_us += airtime_us;
+    survey_noise_sum += pkt->rx_ctrl.noise_floor;
+    if (pkt->rx_ctrl.rssi > survey_max_rssi) {
+        survey_max_rssi = pkt->rx_ctrl.rssi;
+    }
+    portEXIT_CRITICAL(&survey_lock);
+}
+#endif // DEVICE_TYPE_BASE
 
 //=============================================================================
 // PRIVATE FUNCTIONS - Event Handlers
@@ -36,7 +272,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
         switch (event_id) {
 #if DEVICE_TYPE_BASE
             case WIFI_EVENT_AP_START:
-                ESP_LOGI(TAG, "Access Point started");
+                ESP_LOGI(TAG, "Access Point started on channel %d", ap_channel);
                 ESP_LOGI(TAG, "SSID: %s (hidden: %s)", WIFI_SSID,
                          WIFI_HIDDEN_SSID ? "yes" : "no");
                 connected = true;
@@ -66,14 +302,34 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
             }
 #else // DEVICE_TYPE_PACK
             case WIFI_EVENT_STA_START:
-                ESP_LOGI(TAG, "WiFi station started, connecting to %s...", WIFI_SSID);
+                if (radio_only) {
+                    break;
+                }
+                ESP_LOGI(TAG, "WiFi station started, connecting to %s%s...", WIFI_SSID,
+                         ap_cache_in_use ? " (cached AP, no scan)" : "");
                 esp_wifi_connect();
                 break;
 
             case WIFI_EVENT_STA_CONNECTED: {
                 wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
-                ESP_LOGI(TAG, "Connected to AP: %s (channel %d)", event->ssid, event->channel);
+                if (link_lost_us != 0) {
+                    ESP_LOGI(TAG, "Reconnected to AP: %s (channel %d) after %lu ms, %lu attempts",
+                             event->ssid, event->channel,
+                             (unsigned long)((esp_timer_get_time() - link_lost_us) / 1000),
+                             (unsigned long)failed_attempts);
+                } else {
+                    ESP_LOGI(TAG, "Connected to AP: %s (channel %d)", event->ssid, event->channel);
+                }
                 connected = true;
+                link_lost_us = 0;
+                failed_attempts = 0;
+                backoff_ms = WIFI_RECONNECT_MIN_MS;
+                update_ap_cache(event->bssid, event->channel);
+                write_ap_cache();
+                if (!ap_cache_in_use && ap_cache_valid) {
+                    // Found by scan: go direct on the next reconnect
+                    ap_cache_stale = true;
+                }
                 if (user_callback) {
                     user_callback(WIFI_EVENT_CONNECTED, event_data);
                 }
@@ -82,18 +338,24 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
 
             case WIFI_EVENT_STA_DISCONNECTED: {
                 wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
-                ESP_LOGW(TAG, "Disconnected from AP (reason: %d)", event->reason);
+                bool was_connected = connected;
                 connected = false;
                 current_rssi = 0;
 
-                if (user_callback) {
-                    user_callback(WIFI_EVENT_DISCONNECTED, event_data);
+                if (was_connected) {
+                    ESP_LOGW(TAG, "Disconnected from AP (reason: %d)", event->reason);
+                    link_lost_us = esp_timer_get_time();
+                    if (user_callback) {
+                        user_callback(WIFI_EVENT_DISCONNECTED, event_data);
+                    }
+                } else {
+                    ESP_LOGD(TAG, "Connect attempt %lu failed (reason: %d)",
+                             (unsigned long)failed_attempts, event->reason);
                 }
 
-                // Auto-reconnect
-                ESP_LOGI(TAG, "Attempting to reconnect...");
-                vTaskDelay(pdMS_TO_TICKS(WIFI_RECONNECT_DELAY_MS));
-                esp_wifi_connect();
+                if (sta_running) {
+                    schedule_reconnect();
+                }
                 break;
             }
 #endif
@@ -119,8 +381,64 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                 user_callback(WIFI_EVENT_GOT_IP, event_data);
             }
         }
+    } else if (event_base == WIFI_CACHE_EVENT) {
+        write_ap_cache();
+    }
+#endif
+}
+
+//=============================================================================
+// PRIVATE FUNCTIONS - Link Profile
+//=============================================================================
+
+// Before esp_wifi_start(): protocol, width and rate are fixed per start
+static void apply_link_profile(wifi_interface_t ifx)
+{
+    uint8_t protocol = WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N;
+    if (WIFI_LINK_NO_11B) {
+        protocol = WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N;
+    }
+    esp_err_t ret = esp_wifi_set_protocol(ifx, protocol);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Protocol set failed: %s", esp_err_to_name(ret));
+    }
+
+    if (WIFI_LINK_HT20) {
+        ret = esp_wifi_set_bandwidth(ifx, WIFI_BW_HT20);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "HT20 set failed: %s", esp_err_to_name(ret));
+        }
+    }
+
+#if WIFI_LINK_FIXED_RATE_ENABLE
+    ret = esp_wifi_config_80211_tx_rate(ifx, WIFI_LINK_FIXED_RATE);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Fixed rate set failed: %s", esp_err_to_name(ret));
     }
 #endif
+
+    ESP_LOGI(TAG, "Link profile: 802.11%s, %s, %s rate",
+             WIFI_LINK_NO_11B ? "g/n" : "b/g/n",
+             WIFI_LINK_HT20 ? "HT20" : "driver width",
+             WIFI_LINK_FIXED_RATE_ENABLE ? "fixed" : "adaptive");
+}
+
+// After esp_wifi_start(): TX power and the initial power-save mode
+static void apply_link_power(void)
+{
+    if (WIFI_LINK_MAX_TX_POWER > 0) {
+        esp_err_t ret = esp_wifi_set_max_tx_power(WIFI_LINK_MAX_TX_POWER);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "TX power set failed: %s", esp_err_to_name(ret));
+        }
+    }
+
+#if DEVICE_TYPE_PACK
+    // Modem sleep holds downlink frames until the next DTIM beacon: off
+    // until the power manager sees the link go idle
+    link_idle = false;
+    esp_wifi_set_ps(WIFI_PS_NONE);
+#endif
 }
 
 //=============================================================================
@@ -154,12 +472,33 @@ esp_err_t wifi_manager_init(wifi_event_callback_t event_callback)
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
+    ps_mutex = xSemaphoreCreateMutex();
+    if (!ps_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+#if DEVICE_TYPE_PACK
+    cache_mutex = xSemaphoreCreateMutex();
+    if (!cache_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+
+#if DEVICE_TYPE_PACK
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .name = "wifi_reconnect",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &reconnect_timer));
+#endif
+
     // Register event handlers
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID,
                                                &wifi_event_handler, NULL));
 #if DEVICE_TYPE_PACK
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP,
                                                &wifi_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_CACHE_EVENT, ESP_EVENT_ANY_ID,
+                                               &wifi_event_handler, NULL));
 #endif
 
     initialized = true;
@@ -183,12 +522,13 @@ esp_err_t wifi_manager_start(void)
         .ap = {
             .ssid = WIFI_SSID,
             .ssid_len = strlen(WIFI_SSID),
-            .channel = WIFI_CHANNEL,
+            .channel = ap_channel,
             .password = WIFI_PASSWORD,
             .max_connection = MAX_STA_CONN,
             .authmode = WIFI_AUTH_WPA2_PSK,
             .ssid_hidden = WIFI_HIDDEN_SSID,
             .beacon_interval = 100,
+            .csa_count = WIFI_CHANNEL_CSA_COUNT,
             .pmf_cfg = {
                 .capable = false,  // Disable PMF
                 .required = false
@@ -201,32 +541,54 @@ esp_err_t wifi_manager_start(void)
     }
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+    apply_link_profile(WIFI_IF_AP);
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &wifi_config));
+    ap_started = true;
 
 #else // DEVICE_TYPE_PACK
-    // Configure as Station
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = WIFI_SSID,
-            .password = WIFI_PASSWORD,
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-            .pmf_cfg = {
-                .capable = false,  // Disable PMF to match AP
-                .required = false
-            },
-        },
-    };
-
+    // Configure as Station, aimed at the last AP if there is one
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    apply_link_profile(WIFI_IF_STA);
+    load_ap_cache();
+    configure_sta(true);
+    failed_attempts = 0;
+    backoff_ms = WIFI_RECONNECT_MIN_MS;
+    sta_running = true;
 #endif
 
     ESP_ERROR_CHECK(esp_wifi_start());
+    apply_link_power();
 
     ESP_LOGI(TAG, "WiFi started");
     return ESP_OK;
 }
 
+esp_err_t wifi_manager_start_radio(void)
+{
+    if (!initialized) {
+        ESP_LOGE(TAG, "WiFi manager not initialized");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Starting radio on channel %d (no association)", WIFI_CHANNEL);
+
+    radio_only = true;
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    apply_link_profile(WIFI_IF_STA);
+    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(esp_wifi_set_channel(WIFI_CHANNEL, WIFI_SECOND_CHAN_NONE));
+    apply_link_power();
+
+    connected = true;
+    if (user_callback) {
+        user_callback(WIFI_EVENT_CONNECTED, NULL);
+    }
+
+    ESP_LOGI(TAG, "Radio started");
+    return ESP_OK;
+}
+
 esp_err_t wifi_manager_stop(void)
 {
     if (!initialized) {
@@ -234,14 +596,197 @@ esp_err_t wifi_manager_stop(void)
     }
 
     ESP_LOGI(TAG, "Stopping WiFi...");
+#if DEVICE_TYPE_PACK
+    sta_running = false;
+    esp_timer_stop(reconnect_timer);
+    link_lost_us = 0;
+#endif
     esp_wifi_stop();
     connected = false;
     current_rssi = 0;
     sta_count = 0;
+#if DEVICE_TYPE_BASE
+    ap_started = false;
+#endif
 
     return ESP_OK;
 }
 
+void wifi_manager_set_link_idle(bool idle)
+{
+#if DEVICE_TYPE_PACK
+    // Called per received frame: nothing to do unless the mode changes
+    if (link_idle == idle || !initialized || !ps_mutex) {
+        return;
+    }
+    // Modem sleep would make the ESP-NOW radio miss frames between beacons
+    if (radio_only) {
+        return;
+    }
+
+    xSemaphoreTake(ps_mutex, portMAX_DELAY);
+    if (link_idle != idle) {
+        link_idle = idle;
+        esp_wifi_set_ps(idle ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+        ESP_LOGI(TAG, "Power save: %s", idle ? "modem sleep (idle)" : "off (active)");
+    }
+    xSemaphoreGive(ps_mutex);
+#else
+    (void)idle;
+#endif
+}
+
+esp_err_t wifi_manager_survey(const uint8_t *channels, size_t count, uint32_t dwell_ms,
+                              wifi_channel_survey_t *results)
+{
+#if DEVICE_TYPE_BASE
+    if (!initialized || ap_started || !channels || !results) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Station mode, never associating: only there can the channel be set
+    esp_err_t ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (ret == ESP_OK) ret = esp_wifi_start();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    const wifi_promiscuous_filter_t filter = { .filter_mask = WIFI_PROMIS_FILTER_MASK_ALL };
+    esp_wifi_set_promiscuous_filter(&filter);
+    esp_wifi_set_promiscuous_ctrl_filter(&filter);
+    esp_wifi_set_promiscuous_rx_cb(survey_rx_cb);
+    ret = esp_wifi_set_promiscuous(true);
+
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        wifi_channel_survey_t *r = &results[i];
+        memset(r, 0, sizeof(*r));
+        r->channel = channels[i];
+
+        ret = esp_wifi_set_channel(channels[i], WIFI_SECOND_CHAN_NONE);
+        if (ret != ESP_OK) break;
+
+        portENTER_CRITICAL(&survey_lock);
+        survey_frames = 0;
+        survey_airtime_us = 0;
+        survey_noise_sum = 0;
+        survey_max_rssi = -128;
+        portEXIT_CRITICAL(&survey_lock);
+
+        vTaskDelay(pdMS_TO_TICKS(dwell_ms));
+
+        portENTER_CRITICAL(&survey_lock);
+        uint32_t frames = survey_frames;
+        uint64_t airtime_us = survey_airtime_us;
+        int32_t noise_sum = survey_noise_sum;
+        int8_t max_rssi = survey_max_rssi;
+        portEXIT_CRITICAL(&survey_lock);
+
+        r->frames = frames;
+        r->busy_permille = (uint16_t)(airtime_us * 1000 / ((uint64_t)dwell_ms * 1000));
+        if (r->busy_permille > 1000) r->busy_permille = 1000;
+        r->noise_dbm = frames ? (int8_t)(noise_sum / (int32_t)frames) : 0;
+        r->max_rssi_dbm = frames ? max_rssi : 0;
+    }
+
+    esp_wifi_set_promiscuous(false);
+    esp_wifi_set_promiscuous_rx_cb(NULL);
+    esp_wifi_stop();
+    return ret;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t wifi_manager_set_ap_channel(uint8_t channel)
+{
+#if DEVICE_TYPE_BASE
+    if (channel < 1 || channel > 13) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (channel == ap_channel) {
+        return ESP_OK;
+    }
+    if (!ap_started) {
+        ap_channel = channel;     // Used by wifi_manager_start
+        return ESP_OK;
+    }
+
+    // The driver puts the CSA in the next csa_count beacons and then
+    // moves; associated stations follow without disassociating
+    wifi_config_t wifi_config;
+    esp_err_t ret = esp_wifi_get_config(WIFI_IF_AP, &wifi_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    wifi_config.ap.channel = channel;
+    wifi_config.ap.csa_count = WIFI_CHANNEL_CSA_COUNT;
+    ret = esp_wifi_set_config(WIFI_IF_AP, &wifi_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Channel switch to %d failed: %s", channel, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "AP moving from channel %d to %d (CSA over %d beacons)",
+             ap_channel, channel, WIFI_CHANNEL_CSA_COUNT);
+    ap_channel = channel;
+    return ESP_OK;
+#else
+    (void)channel;
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+uint8_t wifi_manager_get_channel(void)
+{
+#if DEVICE_TYPE_BASE
+    return ap_channel;
+#else
+    uint8_t channel = 0;
+    wifi_second_chan_t second;
+    if (!initialized || esp_wifi_get_channel(&channel, &second) != ESP_OK) {
+        return 0;
+    }
+    return channel;
+#endif
+}
+
+void wifi_manager_note_ap_channel(uint8_t channel)
+{
+#if DEVICE_TYPE_PACK
+    // A CSA the pack misses, or a drop right after it, reconnects
+    // straight to the new channel. The STA config is left alone while
+    // associated; the next reconnect picks the channel up. Called on the
+    // RX task, so the NVS write goes to the event loop (if its queue is
+    // full, the next association writes it)
+    if (channel >= 1 && channel <= 13 && update_ap_cache(NULL, channel)) {
+        ap_cache_stale = true;
+        esp_event_post(WIFI_CACHE_EVENT, 0, NULL, 0, 0);
+    }
+#else
+    (void)channel;
+#endif
+}
+
+int8_t wifi_manager_get_worst_sta_rssi(void)
+{
+#if DEVICE_TYPE_BASE
+    wifi_sta_list_t list;
+    if (!initialized || esp_wifi_ap_get_sta_list(&list) != ESP_OK) {
+        return 0;
+    }
+
+    int8_t worst = 0;
+    for (int i = 0; i < list.num; i++) {
+        if (worst == 0 || list.sta[i].rssi < worst) {
+            worst = list.sta[i].rssi;
+        }
+    }
+    return worst;
+#else
+    return 0;
+#endif
+}
+
 bool wifi_manager_is_connected(void)
 {
     return connected;
@@ -307,10 +852,26 @@ void wifi_manager_deinit(void)
     esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler);
 #if DEVICE_TYPE_PACK
     esp_event_handler_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler);
+    esp_event_handler_unregister(WIFI_CACHE_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler);
 #endif
 
     esp_wifi_deinit();
 
+    if (ps_mutex) {
+        vSemaphoreDelete(ps_mutex);
+        ps_mutex = NULL;
+    }
+#if DEVICE_TYPE_PACK
+    if (reconnect_timer) {
+        esp_timer_delete(reconnect_timer);
+        reconnect_timer = NULL;
+    }
+    if (cache_mutex) {
+        vSemaphoreDelete(cache_mutex);
+        cache_mutex = NULL;
+    }
+#endif
+
     if (netif) {
         esp_netif_destroy(netif);
         netif = NULL;
@@ -2,7 +2,9 @@
  * @file wifi_manager.h
  * @brief WiFi Management for Base Station (AP) and Belt Pack (STA)
  *
- * Handles WiFi initialization, connection, and monitoring.
+ * Handles WiFi initialization, connection, and monitoring, and applies
+ * the link profile (protocol, width, rate, TX power, STA power save) from
+ * config_common.h.
  */
 
 #ifndef WIFI_MANAGER_H
@@ -10,6 +12,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 //=============================================================================
@@ -26,6 +29,15 @@ typedef enum {
 
 typedef void (*wifi_event_callback_t)(wifi_event_type_t event, void *data);
 
+// What the radio heard on one channel during a survey
+typedef struct {
+    uint8_t  channel;
+    uint32_t frames;             // Frames received (any BSS, any type)
+    uint16_t busy_permille;      // Their estimated air time, per mille of the dwell
+    int8_t   noise_dbm;          // Mean noise floor (0 = nothing heard)
+    int8_t   max_rssi_dbm;       // Strongest frame (0 = nothing heard)
+} wifi_channel_survey_t;
+
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
@@ -43,12 +55,76 @@ esp_err_t wifi_manager_init(wifi_event_callback_t event_callback);
  */
 esp_err_t wifi_manager_start(void);
 
+/**
+ * @brief Start the radio only, on WIFI_CHANNEL (ESP-NOW link)
+ *
+ * No AP, association or DHCP. Reports WIFI_EVENT_CONNECTED as soon as
+ * the radio is up.
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_manager_start_radio(void);
+
 /**
  * @brief Stop WiFi
  * @return ESP_OK on success
  */
 esp_err_t wifi_manager_stop(void);
 
+/**
+ * @brief Allow or stop STA modem sleep (pack; no-op on the base)
+ *
+ * WIFI_PS_MIN_MODEM when idle, WIFI_PS_NONE otherwise. Cheap when the
+ * mode does not change, so it can be called per received frame.
+ * @param idle true once nothing has been said or heard for a while
+ */
+void wifi_manager_set_link_idle(bool idle);
+
+/**
+ * @brief Listen on each channel before the AP starts (base)
+ *
+ * Brings the radio up as a non-associating station in promiscuous mode,
+ * dwells on each channel in turn and stops it again, so call it between
+ * wifi_manager_init and wifi_manager_start. Blocks for about
+ * count * dwell_ms.
+ * @param channels Channels to listen on
+ * @param count Number of channels
+ * @param dwell_ms Listening time per channel
+ * @param results One entry per channel, in the same order
+ * @return ESP_OK, ESP_ERR_INVALID_STATE once the AP runs,
+ *         ESP_ERR_NOT_SUPPORTED on the pack
+ */
+esp_err_t wifi_manager_survey(const uint8_t *channels, size_t count, uint32_t dwell_ms,
+                              wifi_channel_survey_t *results);
+
+/**
+ * @brief Set the AP channel (base)
+ *
+ * Before wifi_manager_start it only picks the channel the AP starts on.
+ * With the AP running the move is announced in WIFI_CHANNEL_CSA_COUNT
+ * beacons first, and associated stations follow it.
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a channel outside 1-13
+ */
+esp_err_t wifi_manager_set_ap_channel(uint8_t channel);
+
+/**
+ * @brief Current channel (AP channel on the base, 0 if unknown)
+ */
+uint8_t wifi_manager_get_channel(void);
+
+/**
+ * @brief Record a channel the AP announced it is moving to (pack)
+ *
+ * Updates the cached AP, so a pack that misses the switch reconnects on
+ * the new channel without scanning. Safe on the RX task: the NVS write
+ * is left to the event loop.
+ */
+void wifi_manager_note_ap_channel(uint8_t channel);
+
+/**
+ * @brief Weakest RSSI among associated stations (base; 0 if none)
+ */
+int8_t wifi_manager_get_worst_sta_rssi(void);
+
 /**
  * @brief Check if WiFi is connected
  * @return true if connected, false otherwise
@@ -0,0 +1,222 @@
+/**
+ * @file mem_arena.c
+ * @brief Boot-Time Memory Arena Implementation
+ *
+ * One block per region, reserved on the first allocation. Without PSRAM
+ * the bulk region is an alias of the fast one. A request that no longer
+ * fits its block is still served, from the heap with the region's
+ * placement, and counted as overflow so the boot log says how much to
+ * add. Allocation only happens from init code, but the audio and network
+ * lanes of start-up run in parallel, so mem_arena_init() creates a lock
+ * that every allocation takes until the seal.
+ */
+
+#include "mem_arena.h"
+#include "../config.h"
+
+#include <string.h>
+
+static const char *TAG = "ARENA";
+
+#define ARENA_ALIGN             16
+#define ARENA_OWNERS            24
+
+typedef struct {
+    uint8_t *base;
+    mem_arena_usage_t usage;
+} arena_block_t;
+
+typedef struct {
+    const char *name;
+    mem_arena_region_t region;
+    size_t   bytes;
+    uint32_t count;
+} arena_owner_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static platform_mutex_t arena_mutex = NULL;
+static bool reserved = false;
+static bool sealed = false;
+static arena_block_t blocks[MEM_ARENA_REGION_COUNT];
+static bool bulk_shares_fast = false;
+static arena_owner_t owners[ARENA_OWNERS];
+static size_t owner_count = 0;
+
+static const char *region_names[MEM_ARENA_REGION_COUNT] = {
+    [MEM_ARENA_FAST] = "fast",
+    [MEM_ARENA_BULK] = "bulk",
+};
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void reserve(void)
+{
+    reserved = true;
+
+    blocks[MEM_ARENA_FAST].base = platform_malloc_internal(MEM_ARENA_FAST_BYTES);
+    if (blocks[MEM_ARENA_FAST].base) {
+        blocks[MEM_ARENA_FAST].usage.capacity = MEM_ARENA_FAST_BYTES;
+    } else {
+        ESP_LOGE(TAG, "Fast region (%u bytes) not available - allocating from the heap",
+                 (unsigned)MEM_ARENA_FAST_BYTES);
+    }
+
+    blocks[MEM_ARENA_BULK].base = platform_malloc_psram(MEM_ARENA_BULK_BYTES);
+    if (blocks[MEM_ARENA_BULK].base) {
+        blocks[MEM_ARENA_BULK].usage.capacity = MEM_ARENA_BULK_BYTES;
+        blocks[MEM_ARENA_BULK].usage.psram = true;
+    } else {
+        bulk_shares_fast = true;
+    }
+}
+
+static void note_owner(const char *name, mem_arena_region_t region, size_t bytes)
+{
+    for (size_t i = 0; i < owner_count; i++) {
+        if (owners[i].region == region && strcmp(owners[i].name, name) == 0) {
+            owners[i].bytes += bytes;
+            owners[i].count++;
+            return;
+        }
+    }
+    if (owner_count < ARENA_OWNERS) {
+        owners[owner_count++] = (arena_owner_t){ name, region, bytes, 1 };
+    }
+}
+
+// Served from the heap with the region's placement, aligned by hand
+// (never freed)
+static void *overflow_alloc(mem_arena_region_t region, size_t size)
+{
+    uint8_t *raw = NULL;
+    if (region == MEM_ARENA_BULK && blocks[MEM_ARENA_BULK].usage.psram) {
+        raw = platform_malloc_psram(size + ARENA_ALIGN - 1);
+    }
+    if (!raw) {
+        raw = platform_malloc_internal(size + ARENA_ALIGN - 1);
+    }
+    if (!raw) {
+        return NULL;
+    }
+    return (void *)(((uintptr_t)raw + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void *mem_arena_alloc(mem_arena_region_t region, size_t size, const char *owner)
+{
+    if (region >= MEM_ARENA_REGION_COUNT || size == 0) {
+        return NULL;
+    }
+    if (sealed) {
+        ESP_LOGE(TAG, "%s: %u bytes requested after boot - refused",
+                 owner ? owner : "?", (unsigned)size);
+        return NULL;
+    }
+
+    if (arena_mutex) platform_mutex_lock(arena_mutex);
+    if (!reserved) {
+        reserve();
+    }
+
+    mem_arena_region_t placed = (region == MEM_ARENA_BULK && bulk_shares_fast)
+                                ? MEM_ARENA_FAST : region;
+    arena_block_t *block = &blocks[placed];
+    size_t rounded = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+    void *ptr;
+    if (block->base && block->usage.capacity - block->usage.used >= rounded) {
+        ptr = block->base + block->usage.used;
+        block->usage.used += rounded;
+    } else {
+        ptr = overflow_alloc(placed, size);
+        if (!ptr) {
+            if (arena_mutex) platform_mutex_unlock(arena_mutex);
+            ESP_LOGE(TAG, "%s: out of memory (%u bytes)", owner ? owner : "?", (unsigned)size);
+            return NULL;
+        }
+        block->usage.overflow += rounded;
+        ESP_LOGW(TAG, "%s: %u bytes beyond the %s region", owner ? owner : "?",
+                 (unsigned)size, region_names[placed]);
+    }
+
+    block->usage.allocations++;
+    note_owner(owner ? owner : "?", placed, rounded);
+    if (arena_mutex) platform_mutex_unlock(arena_mutex);
+    return ptr;
+}
+
+void mem_arena_init(void)
+{
+    if (!arena_mutex) {
+        arena_mutex = platform_mutex_create();
+    }
+    if (!reserved && !sealed) {
+        reserve();
+    }
+}
+
+bool mem_arena_bulk_is_psram(void)
+{
+    if (!reserved && !sealed) {
+        reserve();
+    }
+    return !bulk_shares_fast;
+}
+
+void mem_arena_seal(void)
+{
+    if (sealed) return;
+
+    if (arena_mutex) platform_mutex_lock(arena_mutex);
+    sealed = true;
+    if (arena_mutex) platform_mutex_unlock(arena_mutex);
+    mem_arena_print();
+}
+
+void mem_arena_get_usage(mem_arena_region_t region, mem_arena_usage_t *usage)
+{
+    if (!usage) return;
+
+    if (region >= MEM_ARENA_REGION_COUNT) {
+        memset(usage, 0, sizeof(*usage));
+        return;
+    }
+    *usage = blocks[region].usage;
+}
+
+void mem_arena_print(void)
+{
+    size_t total = 0;
+
+    for (int r = 0; r < MEM_ARENA_REGION_COUNT; r++) {
+        const mem_arena_usage_t *u = &blocks[r].usage;
+        if (r == MEM_ARENA_BULK && bulk_shares_fast) {
+            ESP_LOGI(TAG, "bulk: no PSRAM - placed in the fast region");
+            continue;
+        }
+        ESP_LOGI(TAG, "%s (%s): %u of %u bytes in %lu allocations%s",
+                 region_names[r], u->psram ? "PSRAM" : "internal",
+                 (unsigned)u->used, (unsigned)u->capacity, (unsigned long)u->allocations,
+                 sealed ? ", sealed" : "");
+        if (u->overflow > 0) {
+            ESP_LOGW(TAG, "%s: %u bytes more taken from the heap - raise its size",
+                     region_names[r], (unsigned)u->overflow);
+        }
+        total += u->used + u->overflow;
+    }
+
+    for (size_t i = 0; i < owner_count; i++) {
+        ESP_LOGI(TAG, "  %-16s %-4s %7u bytes (%lu)", owners[i].name,
+                 region_names[owners[i].region], (unsigned)owners[i].bytes,
+                 (unsigned long)owners[i].count);
+    }
+    ESP_LOGI(TAG, "Total %u bytes", (unsigned)total);
+}
@@ -0,0 +1,88 @@
+/**
+ * @file mem_arena.h
+ * @brief Boot-Time Memory Arena
+ *
+ * Every audio and network pipeline buffer and all codec state is placed
+ * here during init, in a deliberately chosen region: fast (internal SRAM)
+ * for state touched every frame, bulk (PSRAM when the build has it) for
+ * captures and deep buffers. Allocation is a bump pointer in
+ * one block per region, so the layout is the same on every boot and
+ * there is nothing to free. mem_arena_seal() ends the boot phase: later
+ * requests fail, so nothing on the streaming path can reach the heap
+ * through the arena.
+ *
+ * Portable (platform.h only): the host build places the same buffers in
+ * host memory.
+ */
+
+#ifndef MEM_ARENA_H
+#define MEM_ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "platform.h"
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef enum {
+    MEM_ARENA_FAST = 0,          // Internal SRAM: per-frame state, codec state, queues
+    MEM_ARENA_BULK,              // PSRAM (else internal SRAM): captures, deep buffers
+    MEM_ARENA_REGION_COUNT
+} mem_arena_region_t;
+
+typedef struct {
+    size_t   capacity;           // Block reserved at boot (0 = none)
+    size_t   used;               // Bytes handed out from the block
+    size_t   overflow;           // Bytes beyond the block, taken from the heap at boot
+    uint32_t allocations;
+    bool     psram;              // Region is in PSRAM
+} mem_arena_usage_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Reserve the region blocks and create the arena lock
+ *
+ * Call before start-up work splits across tasks; without it the arena is
+ * unlocked (single-threaded users such as the host build).
+ */
+void mem_arena_init(void);
+
+/**
+ * @brief Allocate boot-time storage (init code only, before mem_arena_seal)
+ *
+ * Reserves the region blocks on first use if mem_arena_init() was not called. The memory is 16-byte aligned
+ * (AUDIO_DSP_ALIGN), uninitialised, and held until reboot.
+ * @param region Where the buffer should live
+ * @param size   Bytes
+ * @param owner  Name for the footprint report (a string literal)
+ * @return The buffer, or NULL if sealed or out of memory
+ */
+void *mem_arena_alloc(mem_arena_region_t region, size_t size, const char *owner);
+
+/**
+ * @brief True if the bulk region is in PSRAM
+ */
+bool mem_arena_bulk_is_psram(void);
+
+/**
+ * @brief End the boot phase: log the footprint and refuse later allocations
+ */
+void mem_arena_seal(void);
+
+/**
+ * @brief Get a region's footprint
+ */
+void mem_arena_get_usage(mem_arena_region_t region, mem_arena_usage_t *usage);
+
+/**
+ * @brief Log each region and the bytes each owner took
+ */
+void mem_arena_print(void);
+
+#endif // MEM_ARENA_H
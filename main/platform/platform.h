@@ -0,0 +1,149 @@
+/**
+ * @file platform.h
+ * @brief Thin Platform Layer for the Portable Audio and Packet Core
+ *
+ * The jitter buffer, Opus wrapper, audio processor, DSP kernels, VAD,
+ * packet framing and the boot-time arena (mem_arena.h) reach the OS only
+ * through this header: time, cycle counter, internal/PSRAM allocation,
+ * one mutex type, error codes and ESP_LOGx logging. On the device these are the ESP-IDF calls, inlined.
+ * The host build (host/, PLATFORM_HOST=1) supplies them from
+ * host/platform_host.c, with a simulated clock so a run is deterministic
+ * and faster than real time.
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef PLATFORM_HOST
+#define PLATFORM_HOST 0
+#endif
+
+#if !PLATFORM_HOST
+
+//=============================================================================
+// ESP-IDF
+//=============================================================================
+
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// PIE vector unit available (audio_dsp.c)
+#define PLATFORM_ESP32S3    CONFIG_IDF_TARGET_ESP32S3
+
+typedef SemaphoreHandle_t platform_mutex_t;
+
+static inline int64_t platform_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static inline uint32_t platform_cycle_count(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+static inline void *platform_malloc_internal(size_t size)
+{
+    return heap_caps_malloc(size, MALLOC_CAP_INTERNAL);
+}
+
+// NULL when the build has no PSRAM (CONFIG_SPIRAM)
+static inline void *platform_malloc_psram(size_t size)
+{
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+}
+
+static inline void platform_free(void *ptr)
+{
+    heap_caps_free(ptr);
+}
+
+static inline platform_mutex_t platform_mutex_create(void)
+{
+    return xSemaphoreCreateMutex();
+}
+
+static inline void platform_mutex_lock(platform_mutex_t mutex)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+}
+
+static inline void platform_mutex_unlock(platform_mutex_t mutex)
+{
+    xSemaphoreGive(mutex);
+}
+
+static inline void platform_mutex_delete(platform_mutex_t mutex)
+{
+    vSemaphoreDelete(mutex);
+}
+
+#else
+
+//=============================================================================
+// HOST (host/platform_host.c)
+//=============================================================================
+
+#define PLATFORM_ESP32S3    0
+
+typedef int esp_err_t;
+
+#define ESP_OK                  0
+#define ESP_FAIL                (-1)
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_INVALID_STATE   0x103
+#define ESP_ERR_INVALID_SIZE    0x104
+#define ESP_ERR_NOT_FOUND       0x105
+#define ESP_ERR_TIMEOUT         0x107
+
+typedef struct platform_mutex *platform_mutex_t;
+
+typedef enum {
+    PLATFORM_LOG_ERROR = 1,
+    PLATFORM_LOG_WARN,
+    PLATFORM_LOG_INFO,
+    PLATFORM_LOG_DEBUG,
+} platform_log_level_t;
+
+void platform_log(platform_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) platform_log(PLATFORM_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) platform_log(PLATFORM_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) platform_log(PLATFORM_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) platform_log(PLATFORM_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+
+int64_t platform_time_us(void);
+uint32_t platform_cycle_count(void);
+void *platform_malloc_internal(size_t size);
+void *platform_malloc_psram(size_t size);      // Always NULL
+void platform_free(void *ptr);
+platform_mutex_t platform_mutex_create(void);
+void platform_mutex_lock(platform_mutex_t mutex);
+void platform_mutex_unlock(platform_mutex_t mutex);
+void platform_mutex_delete(platform_mutex_t mutex);
+
+/**
+ * @brief Set the simulated clock returned by platform_time_us()
+ */
+void platform_host_set_time_us(int64_t now_us);
+
+/**
+ * @brief Most verbose level printed (default PLATFORM_LOG_INFO)
+ */
+void platform_host_set_log_level(platform_log_level_t level);
+
+#endif // PLATFORM_HOST
+
+#endif // PLATFORM_H
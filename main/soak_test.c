@@ -0,0 +1,535 @@
+/**
+ * @file soak_test.c
+ * @brief Multi-Pack Soak Test Implementation
+ *
+ * Each virtual pack replays SOAK_CORPUS_FRAMES of synthetic speech,
+ * encoded once at boot, from its own starting frame and on its own clock
+ * (spread over +/-SOAK_DRIFT_PPM). Every frame is dropped with
+ * SOAK_LOSS_PCT probability or delayed by up to SOAK_JITTER_MS (so frames
+ * also reorder), then handed to udp_transport_inject as a datagram from
+ * 127.0.0.(SOAK_ADDR_HOST + n). Everything past the socket is the real
+ * base: parsing, per-pack jitter buffers, decoders and drift, the mix,
+ * the mix-minus encodes and their sends, which go out through lwIP's
+ * loopback and are dropped on the way back in. The packs' own encoding
+ * costs the base nothing, so the load measured is the base's alone.
+ *
+ * A step is judged over SOAK_STEP_S after a SOAK_SETTLE_S start-up. It
+ * fails on any engine deadline miss, stall or jitter-buffer queue drop or
+ * overrun; on missing frames more than SOAK_EXCESS_LOSS_PCT above the
+ * injected loss; on the busiest core above SOAK_CPU_LIMIT_PCT; or on the
+ * lowest free heap seen in the window (sampled every tick) below
+ * SOAK_HEAP_FLOOR_BYTES. The limit is the largest count with every step
+ * up to it passed. The all-time heap minimum is reported, not judged: a
+ * dip at boot would otherwise fail every step after it.
+ *
+ * CPU per core comes from FreeRTOS run-time stats (idle time per core),
+ * which the sdkconfig.soak fragment turns on (see README, Soak Mode);
+ * without them only the audio engine's share of its core is known, and
+ * that is what the CPU check uses.
+ */
+
+#include "soak_test.h"
+
+#if SOAK_MODE_ENABLE
+
+#if !(DEVICE_TYPE_BASE && JITTER_BUFFER_ENABLE) || TEST_MODE_ENABLE
+#error "SOAK_MODE_ENABLE needs a base build with JITTER_BUFFER_ENABLE and TEST_MODE_ENABLE 0"
+#endif
+
+#include "audio/audio_opus.h"
+#include "audio/audio_engine.h"
+#include "network/audio_packet.h"
+#include "network/udp_transport.h"
+#include "system/pack_manager.h"
+#include "system/task_map.h"
+#include "system/diagnostics.h"
+#include "platform/mem_arena.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "SOAK";
+
+#define SOAK_CORPUS_FRAMES      100         // 2 s of speech, looped
+#define SOAK_FRAME_MAX          160         // Encoded bytes per frame (64 kbps)
+#define SOAK_TICK_US            2000        // Send/deliver resolution
+#define SOAK_SETTLE_S           5           // Start-up left out of a step's window
+#define SOAK_EXCESS_LOSS_PCT    1.0f
+#define SOAK_ADDR_HOST          10          // Virtual pack n is 127.0.0.(10 + n)
+#define SOAK_FRAME_US           ((int64_t)FRAME_SIZE_MS * 1000)
+#define SOAK_PENDING            (SOAK_PACKS * (SOAK_JITTER_MS / FRAME_SIZE_MS + 2))
+
+#define SOAK_CPU_STATS          (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && \
+                                 CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER)
+#if !SOAK_CPU_STATS
+#warning "SOAK_MODE_ENABLE: build with sdkconfig.soak for CPU per core (run-time stats, esp_timer clock)"
+#endif
+
+_Static_assert(SOAK_PACKS >= 1 && SOAK_PACKS <= MAX_PACKS, "SOAK_PACKS must be 1..MAX_PACKS");
+_Static_assert(SOAK_FRAME_MAX <= OPUS_MAX_PACKET_SIZE, "corpus frames must fit a packet");
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Step failure reasons
+#define FAIL_DEADLINE           (1 << 0)
+#define FAIL_QUEUE              (1 << 1)
+#define FAIL_LOSS               (1 << 2)
+#define FAIL_CPU                (1 << 3)
+#define FAIL_HEAP               (1 << 4)
+
+typedef struct {
+    uint32_t addr;               // Source address (network byte order)
+    int32_t  ppm;                // Clock offset (+ = fast)
+    uint32_t offset;             // Corpus frame it starts on
+    int64_t  start_us;
+    uint32_t frame;              // Next frame on its clock
+    uint32_t sent;               // Frames generated
+    uint32_t lost;               // Frames dropped on purpose
+} virtual_pack_t;
+
+typedef struct {
+    bool     used;
+    uint8_t  pack;
+    uint32_t frame;
+    int64_t  due_us;
+} pending_t;
+
+// Cumulative counters at the start of a window
+typedef struct {
+    int64_t  at_us;
+    uint64_t engine_busy_us;
+    uint32_t idle_us[portNUM_PROCESSORS];
+    uint32_t engine_misses;
+    uint32_t sent;
+    uint32_t lost;
+    jitter_buffer_stats_t jb;
+} soak_snapshot_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static uint8_t *corpus = NULL;               // SOAK_CORPUS_FRAMES x SOAK_FRAME_MAX
+static uint8_t corpus_size[SOAK_CORPUS_FRAMES];
+
+static virtual_pack_t packs[SOAK_PACKS];
+static pending_t pending[SOAK_PENDING];
+static size_t active = 0;                    // Virtual packs sending
+static uint32_t pool_drops = 0;              // Frames with no delay slot free
+static uint32_t rng = 0x2545F491;
+
+static TaskHandle_t soak_handle = NULL;
+static esp_timer_handle_t tick_timer = NULL;
+
+// Ramp and hold (soak task)
+static soak_snapshot_t window_start;
+static int64_t settle_until_us = 0;
+static int64_t window_end_us = 0;
+static bool ramping = true;
+static size_t limit = 0;
+static int64_t hold_start_us = 0;
+static uint32_t hold_windows = 0;
+static uint32_t hold_unhealthy = 0;
+static uint32_t engine_stalls_seen = 0;
+static size_t window_heap_low = SIZE_MAX;
+static uint32_t window_peak_us = 0;      // Longest engine pass seen in the window
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// One talker: harmonic voice with a pitch glide and 4 Hz syllables, then
+// a fricative burst and a near-silent gap
+static void synth_frame(int16_t *pcm, uint32_t frame, float *phase, uint32_t *seed)
+{
+    const uint32_t voiced_end = SOAK_CORPUS_FRAMES * 7 / 10;
+    const uint32_t noise_end = SOAK_CORPUS_FRAMES * 8 / 10;
+
+    for (size_t i = 0; i < SAMPLES_PER_FRAME; i++) {
+        float t = (float)(frame * SAMPLES_PER_FRAME + i) / SAMPLE_RATE_HZ;
+        float v;
+        if (frame < voiced_end) {
+            float f0 = 140.0f + 40.0f * sinf(2.0f * (float)M_PI * 0.7f * t);
+            *phase += 2.0f * (float)M_PI * f0 / SAMPLE_RATE_HZ;
+            if (*phase > 2.0f * (float)M_PI) *phase -= 2.0f * (float)M_PI;
+            v = 0.0f;
+            for (int k = 1; k <= 6; k++) {
+                v += sinf(*phase * (float)k) / (float)k;
+            }
+            v *= 0.25f * (0.5f - 0.5f * cosf(2.0f * (float)M_PI * 4.0f * t));
+        } else {
+            *seed = *seed * 1664525u + 1013904223u;
+            float white = (float)((int32_t)(*seed >> 16) - 32768) / 32768.0f;
+            v = white * (frame < noise_end ? 0.1f : 0.001f);
+        }
+        pcm[i] = (int16_t)(v * 32767.0f);
+    }
+}
+
+// Sends frame `frame` of a virtual pack into the receive path
+static void inject_frame(size_t index, uint32_t frame)
+{
+    const virtual_pack_t *pack = &packs[index];
+    uint32_t c = (pack->offset + frame) % SOAK_CORPUS_FRAMES;
+
+    audio_packet_t packet;
+    memcpy(packet.opus_data, &corpus[c * SOAK_FRAME_MAX], corpus_size[c]);
+    size_t len = audio_packet_write_full(&packet, frame, (uint32_t)(frame * SOAK_FRAME_US),
+                                         PACKET_FLAG_PTT, INTERCOM_GROUP_ID, corpus_size[c]);
+    udp_transport_inject((const uint8_t *)&packet, (uint16_t)len, pack->addr);
+}
+
+// Frames each pack's clock has reached: dropped, or held for their delay
+static void send_due(int64_t now_us)
+{
+    for (size_t p = 0; p < active; p++) {
+        virtual_pack_t *pack = &packs[p];
+        while (1) {
+            int64_t elapsed_us = (int64_t)pack->frame * SOAK_FRAME_US;
+            int64_t send_us = pack->start_us + elapsed_us - elapsed_us * pack->ppm / 1000000;
+            if (send_us > now_us) break;
+
+            uint32_t frame = pack->frame++;
+            pack->sent++;
+            if (next_random() % 10000 < (uint32_t)(SOAK_LOSS_PCT * 100.0f)) {
+                pack->lost++;
+                continue;
+            }
+
+            int64_t delay_us = SOAK_JITTER_MS > 0 ?
+                (int64_t)(next_random() % (SOAK_JITTER_MS * 1000 + 1)) : 0;
+            size_t slot = 0;
+            while (slot < SOAK_PENDING && pending[slot].used) slot++;
+            if (slot == SOAK_PENDING) {
+                pool_drops++;
+                pack->lost++;
+                continue;
+            }
+            pending[slot] = (pending_t){
+                .used = true, .pack = (uint8_t)p, .frame = frame, .due_us = send_us + delay_us,
+            };
+        }
+    }
+}
+
+// Held frames whose delay is up, earliest first
+static void deliver_due(int64_t now_us)
+{
+    while (1) {
+        int earliest = -1;
+        for (size_t i = 0; i < SOAK_PENDING; i++) {
+            if (pending[i].used && pending[i].due_us <= now_us &&
+                (earliest < 0 || pending[i].due_us < pending[earliest].due_us)) {
+                earliest = (int)i;
+            }
+        }
+        if (earliest < 0) return;
+
+        pending[earliest].used = false;
+        inject_frame(pending[earliest].pack, pending[earliest].frame);
+    }
+}
+
+static void add_pack(int64_t now_us)
+{
+    virtual_pack_t *pack = &packs[active];
+    pack->start_us = now_us;
+    pack->frame = 0;
+    active++;
+    settle_until_us = now_us + (int64_t)SOAK_SETTLE_S * 1000000;
+    window_end_us = settle_until_us + (int64_t)SOAK_STEP_S * 1000000;
+    ESP_LOGI(TAG, "Step: %u virtual pack%s (%d ppm)", (unsigned)active,
+             active == 1 ? "" : "s", (int)pack->ppm);
+}
+
+static void take_snapshot(soak_snapshot_t *s, int64_t now_us)
+{
+    s->at_us = now_us;
+    s->engine_busy_us = audio_engine_busy_us();
+#if SOAK_CPU_STATS
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        s->idle_us[core] = (uint32_t)ulTaskGetIdleRunTimeCounterForCore(core);
+    }
+#endif
+    task_stats_t engine;
+    task_map_get_stats(TASK_AUDIO_ENGINE, &engine);
+    s->engine_misses = engine.misses;
+    s->sent = 0;
+    s->lost = 0;
+    for (size_t p = 0; p < active; p++) {
+        s->sent += packs[p].sent;
+        s->lost += packs[p].lost;
+    }
+    pack_manager_get_total_stats(&s->jb);
+}
+
+// Judge and log the window that ends now; starts the next one
+static bool end_window(int64_t now_us, const char *label)
+{
+    soak_snapshot_t end;
+    take_snapshot(&end, now_us);
+    const soak_snapshot_t *start = &window_start;
+
+    float window_us = (float)(end.at_us - start->at_us);
+    float engine_pct = 100.0f * (float)(end.engine_busy_us - start->engine_busy_us) / window_us;
+    float busiest = engine_pct;
+    char cpu[48];
+#if SOAK_CPU_STATS
+    int len = 0;
+    busiest = 0.0f;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        float load = 100.0f - 100.0f * (float)(end.idle_us[core] - start->idle_us[core]) / window_us;
+        if (load < 0.0f) load = 0.0f;
+        if (load > busiest) busiest = load;
+        len += snprintf(cpu + len, sizeof(cpu) - len, "%score%d %.1f%%", core ? " " : "", core, load);
+    }
+#else
+    snprintf(cpu, sizeof(cpu), "cpu n/a");
+#endif
+
+    audio_engine_stats_t eng;
+    audio_engine_get_stats(&eng);
+    uint32_t stalls = eng.stalls - engine_stalls_seen;
+    engine_stalls_seen = eng.stalls;
+
+    uint32_t misses = end.engine_misses - start->engine_misses;
+    uint32_t sent = end.sent - start->sent;
+    uint32_t lost = end.lost - start->lost;
+    uint32_t missing = end.jb.frames_missing - start->jb.frames_missing;
+    uint32_t queue = (end.jb.queue_drops - start->jb.queue_drops) +
+                     (end.jb.overruns - start->jb.overruns);
+    uint32_t excess = missing > lost ? missing - lost : 0;
+    size_t heap_free = diagnostics_get_free_heap();
+    size_t heap_low = window_heap_low < heap_free ? window_heap_low : heap_free;
+    window_heap_low = SIZE_MAX;
+    uint32_t peak_us = window_peak_us > eng.last_process_us ? window_peak_us : eng.last_process_us;
+    window_peak_us = 0;
+
+    uint32_t fail = 0;
+    if (misses || stalls) fail |= FAIL_DEADLINE;
+    if (queue) fail |= FAIL_QUEUE;
+    if ((float)excess * 100.0f > (float)sent * SOAK_EXCESS_LOSS_PCT) fail |= FAIL_LOSS;
+    if (busiest > SOAK_CPU_LIMIT_PCT) fail |= FAIL_CPU;
+    if (heap_low < SOAK_HEAP_FLOOR_BYTES) fail |= FAIL_HEAP;
+
+    int32_t max_ppm = 0;
+    for (size_t p = 0; p < active; p++) {
+        if (abs(packs[p].ppm) > max_ppm) max_ppm = abs(packs[p].ppm);
+    }
+
+    ESP_LOGI(TAG, "%s %u packs: %s | %s, engine %.1f%% (peak %lu us, %lu misses, %lu stalls) | "
+             "heap %lu low %lu (min since boot %lu)",
+             label, (unsigned)active, fail ? "FAIL" : "pass", cpu, engine_pct,
+             (unsigned long)peak_us, (unsigned long)misses, (unsigned long)stalls,
+             (unsigned long)heap_free, (unsigned long)heap_low,
+             (unsigned long)diagnostics_get_min_free_heap());
+    ESP_LOGI(TAG, "  JB: missing %lu (%lu lost of %lu sent) fec %lu late %lu under %lu "
+             "queue %lu depth %lu/%lu jitter %lu us | drift %+.1f ppm (sent +/-%ld)",
+             (unsigned long)missing, (unsigned long)lost, (unsigned long)sent,
+             (unsigned long)(end.jb.fec_recovered - start->jb.fec_recovered),
+             (unsigned long)(end.jb.late_drops - start->jb.late_drops),
+             (unsigned long)(end.jb.underruns - start->jb.underruns),
+             (unsigned long)queue, (unsigned long)end.jb.current_depth,
+             (unsigned long)end.jb.target_depth, (unsigned long)end.jb.jitter_us,
+             pack_manager_get_worst_drift_ppm(), (long)max_ppm);
+    if (fail) {
+        ESP_LOGW(TAG, "  Failed on:%s%s%s%s%s",
+                 (fail & FAIL_DEADLINE) ? " deadline" : "",
+                 (fail & FAIL_QUEUE) ? " queue" : "",
+                 (fail & FAIL_LOSS) ? " loss" : "",
+                 (fail & FAIL_CPU) ? " cpu" : "",
+                 (fail & FAIL_HEAP) ? " heap" : "");
+    }
+    if (pack_manager_active_count() != active) {
+        ESP_LOGW(TAG, "  Base holds %u pack slots for %u virtual packs",
+                 (unsigned)pack_manager_active_count(), (unsigned)active);
+    }
+
+    window_start = end;
+    return fail == 0;
+}
+
+static void log_limit(void)
+{
+    if (limit == SOAK_PACKS) {
+        ESP_LOGI(TAG, "Scaling limit: at least %u packs (all configured - raise MAX_PACKS "
+                 "and SOAK_PACKS to probe further)", (unsigned)limit);
+    } else {
+        ESP_LOGW(TAG, "Scaling limit: %u packs", (unsigned)limit);
+    }
+}
+
+static void tick(void *arg)
+{
+    xTaskNotifyGive(soak_handle);
+}
+
+static void soak_task(void *arg)
+{
+    ESP_LOGI(TAG, "Soak: up to %d virtual packs, %.1f%% loss, 0-%d ms jitter, "
+             "+/-%d ppm, %d s steps, then %d h", SOAK_PACKS, SOAK_LOSS_PCT,
+             SOAK_JITTER_MS, SOAK_DRIFT_PPM, SOAK_STEP_S, SOAK_DURATION_H);
+    add_pack(esp_timer_get_time());
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now_us = esp_timer_get_time();
+
+        send_due(now_us);
+        deliver_due(now_us);
+        task_map_record(TASK_SOAK, (uint32_t)(esp_timer_get_time() - now_us));
+
+        // Sampled every tick, several per frame: the status log takes the
+        // engine's own peak
+        size_t heap_free = diagnostics_get_free_heap();
+        if (heap_free < window_heap_low) {
+            window_heap_low = heap_free;
+        }
+        audio_engine_stats_t eng;
+        audio_engine_get_stats(&eng);
+        if (eng.last_process_us > window_peak_us) {
+            window_peak_us = eng.last_process_us;
+        }
+
+        if (settle_until_us != 0 && now_us >= settle_until_us) {
+            settle_until_us = 0;
+            take_snapshot(&window_start, now_us);
+            window_heap_low = SIZE_MAX;
+            window_peak_us = 0;
+            engine_stalls_seen = eng.stalls;
+            continue;
+        }
+        if (settle_until_us != 0 || now_us < window_end_us) {
+            continue;
+        }
+
+        if (ramping) {
+            bool healthy = end_window(now_us, "Step");
+            if (healthy && limit == active - 1) {
+                limit = active;
+            }
+            if (active < SOAK_PACKS) {
+                add_pack(now_us);
+                continue;
+            }
+            ramping = false;
+            log_limit();
+            hold_start_us = now_us;
+            window_end_us = now_us + (int64_t)SOAK_REPORT_S * 1000000;
+            ESP_LOGI(TAG, "Holding %d packs", SOAK_PACKS);
+            continue;
+        }
+
+        hold_windows++;
+        if (!end_window(now_us, "Hold")) {
+            hold_unhealthy++;
+        }
+        uint32_t held_s = (uint32_t)((now_us - hold_start_us) / 1000000);
+        window_end_us = now_us + (int64_t)SOAK_REPORT_S * 1000000;
+
+        if (SOAK_DURATION_H > 0 && held_s >= (uint32_t)SOAK_DURATION_H * 3600) {
+            esp_timer_stop(tick_timer);
+            ESP_LOGI(TAG, "Soak done: %lu s at %d packs, %lu of %lu reports unhealthy, "
+                     "%lu frames had no delay slot, heap min %lu",
+                     (unsigned long)held_s, SOAK_PACKS, (unsigned long)hold_unhealthy,
+                     (unsigned long)hold_windows, (unsigned long)pool_drops,
+                     (unsigned long)diagnostics_get_min_free_heap());
+            log_limit();
+            while (1) {
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            }
+        }
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t soak_test_init(void)
+{
+    corpus = mem_arena_alloc(MEM_ARENA_BULK, SOAK_CORPUS_FRAMES * SOAK_FRAME_MAX, "soak");
+    if (!corpus) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The base's own encoder, before it carries anything: like the packs,
+    // expecting the loss it will meet
+    int loss_perc = audio_opus_get_packet_loss_perc();
+    audio_opus_set_packet_loss_perc(SOAK_LOSS_PCT);
+
+    int16_t pcm[SAMPLES_PER_FRAME];
+    float phase = 0.0f;
+    uint32_t seed = 4242;
+    size_t bytes = 0;
+    for (uint32_t f = 0; f < SOAK_CORPUS_FRAMES; f++) {
+        synth_frame(pcm, f, &phase, &seed);
+        int encoded = audio_opus_encode(pcm, SAMPLES_PER_FRAME,
+                                        &corpus[f * SOAK_FRAME_MAX], SOAK_FRAME_MAX);
+        corpus_size[f] = encoded > 0 ? (uint8_t)encoded : 0;
+        bytes += corpus_size[f];
+    }
+    audio_opus_encoder_reset(NULL);
+    audio_opus_set_packet_loss_perc((float)loss_perc);
+
+    for (size_t p = 0; p < SOAK_PACKS; p++) {
+        virtual_pack_t *pack = &packs[p];
+        memset(pack, 0, sizeof(*pack));
+        uint32_t host = SOAK_ADDR_HOST + (uint32_t)p;
+        pack->addr = 127u | (host << 24);
+        pack->ppm = SOAK_PACKS > 1 ?
+            -SOAK_DRIFT_PPM + (int32_t)(2 * SOAK_DRIFT_PPM * p / (SOAK_PACKS - 1)) : SOAK_DRIFT_PPM;
+        pack->offset = (uint32_t)(p * SOAK_CORPUS_FRAMES / SOAK_PACKS);
+    }
+
+    ESP_LOGI(TAG, "Corpus: %d frames, %lu bytes encoded", SOAK_CORPUS_FRAMES,
+             (unsigned long)bytes);
+    return ESP_OK;
+}
+
+esp_err_t soak_test_start(void)
+{
+    if (!corpus) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!udp_transport_backend_uses_ip()) {
+        ESP_LOGW(TAG, "Link backend has no loopback: the base's replies to virtual packs fail");
+    }
+
+    // From here the receive path hears the virtual packs only
+    udp_transport_set_replay(true);
+
+    esp_err_t ret = task_map_create(TASK_SOAK, soak_task, NULL, &soak_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = tick,
+        .name = "soak",
+    };
+    ret = esp_timer_create(&timer_args, &tick_timer);
+    if (ret == ESP_OK) {
+        ret = esp_timer_start_periodic(tick_timer, SOAK_TICK_US);
+    }
+    return ret;
+}
+
+#endif // SOAK_MODE_ENABLE
@@ -0,0 +1,31 @@
+/**
+ * @file soak_test.h
+ * @brief Multi-Pack Soak Test (Base Station)
+ *
+ * Built with SOAK_MODE_ENABLE: the base runs the normal intercom, but its
+ * receive path is fed by up to SOAK_PACKS virtual packs instead of the
+ * radio. They are added one at a time, each step judged on CPU per core,
+ * deadline misses, heap and jitter-buffer health, and the largest count
+ * that held is logged as the scaling limit. The full count then runs for
+ * SOAK_DURATION_H hours with a report every SOAK_REPORT_S.
+ */
+
+#ifndef SOAK_TEST_H
+#define SOAK_TEST_H
+
+#include "esp_err.h"
+#include "config.h"
+
+/**
+ * @brief Encode the virtual packs' corpus (init, before mem_arena_seal)
+ * @return ESP_OK, ESP_ERR_NO_MEM
+ */
+esp_err_t soak_test_init(void);
+
+/**
+ * @brief Stop taking live packets and start the ramp (once the engine runs)
+ * @return ESP_OK on success
+ */
+esp_err_t soak_test_start(void);
+
+#endif // SOAK_TEST_H
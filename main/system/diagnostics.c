@@ -13,6 +13,8 @@
 #include "../hardware/gpio_control.h"
 #include "../network/wifi_manager.h"
 #include "../network/udp_transport.h"
+#include "startup.h"
+#include "task_map.h"
 #include "esp_chip_info.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
@@ -28,6 +30,25 @@
 
 static const char *TAG = "DIAG";
 
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+// Opus round trip, run by diagnostics_prepare_self_test() while the
+// encoder is still idle
+static bool opus_prepared = false;
+static test_result_t prepared_encode = TEST_NOT_RUN;
+static test_result_t prepared_decode = TEST_NOT_RUN;
+
+// Button levels and LED flash, taken by diagnostics_prepare_self_test()
+// before anyone can be pressing PTT and before the LEDs show state
+static bool io_prepared = false;
+static int prepared_ptt_level = 1;
+static int prepared_call_level = 1;
+
+static diagnostics_result_t background_results;
+static volatile uint8_t fault_test = 0;     // First failed test (0 = none)
+
 //=============================================================================
 // PRIVATE FUNCTIONS
 //=============================================================================
@@ -57,6 +78,53 @@ static void blink_fault_code(int test_number)
     vTaskDelay(pdMS_TO_TICKS(1000));
 }
 
+// Flash every LED on together for 100ms as a visual test (one flash, as
+// it sits on the boot path)
+static void flash_leds(void)
+{
+    for (int i = 0; i < LED_COUNT; i++) {
+        gpio_control_set_led((led_id_t)i, LED_ON);
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+    for (int i = 0; i < LED_COUNT; i++) {
+        gpio_control_set_led((led_id_t)i, LED_OFF);
+    }
+}
+
+static void test_opus(test_result_t *encode_result, test_result_t *decode_result)
+{
+    ESP_LOGI(TAG, "Testing Opus encoder...");
+    int16_t test_audio[320] = {0};
+    uint8_t opus_data[256];
+    int encoded = audio_opus_encode(test_audio, 320, opus_data, 256);
+    *encode_result = (encoded > 0) ? TEST_PASS : TEST_FAIL;
+    ESP_LOGI(TAG, "  Opus encoder: %s (%d bytes)",
+             result_to_string(*encode_result), encoded);
+
+    ESP_LOGI(TAG, "Testing Opus decoder...");
+    int16_t decoded_audio[320];
+    int decoded = audio_opus_decode(opus_data, encoded, decoded_audio, 320, 0);
+    *decode_result = (decoded > 0) ? TEST_PASS : TEST_FAIL;
+    ESP_LOGI(TAG, "  Opus decoder: %s (%d samples)",
+             result_to_string(*decode_result), decoded);
+}
+
+static void self_test_task(void *arg)
+{
+    esp_err_t ret = diagnostics_run_self_test(&background_results);
+    startup_mark(STARTUP_SELF_TEST_DONE);
+
+    if (ret == ESP_OK) {
+        task_map_exit(TASK_SELFTEST);
+        return;
+    }
+
+    // Audio stays up; the status LED carries the fault code until reset
+    while (1) {
+        blink_fault_code(fault_test);
+    }
+}
+
 //=============================================================================
 // PUBLIC FUNCTIONS
 //=============================================================================
@@ -117,12 +185,13 @@ esp_err_t diagnostics_run_self_test(diagnostics_result_t *results)
     results->battery_adc = TEST_SKIP;
 #endif
 
-    // Test 4: GPIO buttons (pack only)
+    // Test 4: GPIO buttons (pack only), judged on the levels read at boot:
+    // by now a user may be holding PTT or CALL
 #if DEVICE_TYPE_PACK
     ESP_LOGI(TAG, "Testing button GPIOs...");
     {
-        int ptt_level = gpio_get_level(BUTTON_PTT_PIN);
-        int call_level = gpio_get_level(BUTTON_CALL_PIN);
+        int ptt_level = io_prepared ? prepared_ptt_level : gpio_get_level(BUTTON_PTT_PIN);
+        int call_level = io_prepared ? prepared_call_level : gpio_get_level(BUTTON_CALL_PIN);
         bool ptt_ok = (ptt_level == 1);
         bool call_ok = (call_level == 1);
 
@@ -144,34 +213,25 @@ esp_err_t diagnostics_run_self_test(diagnostics_result_t *results)
 #endif
 
     // Test 5: LED GPIOs
-    // Flash each enabled LED on for 100ms then off as a visual test.
     // Always passes - the operator can visually confirm LED function.
+    // Flashed at boot: once the LEDs show state the flash would hide it.
     ESP_LOGI(TAG, "Testing LED GPIOs...");
-    for (int i = 0; i < LED_COUNT; i++) {
-        gpio_control_set_led((led_id_t)i, LED_ON);
-        vTaskDelay(pdMS_TO_TICKS(100));
-        gpio_control_set_led((led_id_t)i, LED_OFF);
-        vTaskDelay(pdMS_TO_TICKS(50));
+    if (!io_prepared) {
+        flash_leds();
     }
     results->gpio_leds = TEST_PASS;
-    ESP_LOGI(TAG, "  LED GPIOs: PASS (visual check - all LEDs flashed)");
-
-    // Test 6: Opus encoder
-    ESP_LOGI(TAG, "Testing Opus encoder...");
-    int16_t test_audio[320] = {0};
-    uint8_t opus_data[256];
-    int encoded = audio_opus_encode(test_audio, 320, opus_data, 256);
-    results->opus_encode = (encoded > 0) ? TEST_PASS : TEST_FAIL;
-    ESP_LOGI(TAG, "  Opus encoder: %s (%d bytes)",
-             result_to_string(results->opus_encode), encoded);
-
-    // Test 7: Opus decoder
-    ESP_LOGI(TAG, "Testing Opus decoder...");
-    int16_t decoded_audio[320];
-    int decoded = audio_opus_decode(opus_data, encoded, decoded_audio, 320, 0);
-    results->opus_decode = (decoded > 0) ? TEST_PASS : TEST_FAIL;
-    ESP_LOGI(TAG, "  Opus decoder: %s (%d samples)",
-             result_to_string(results->opus_decode), decoded);
+    ESP_LOGI(TAG, "  LED GPIOs: PASS (visual check - all LEDs flashed%s)",
+             io_prepared ? " at boot" : "");
+
+    // Tests 6-7: Opus encoder and decoder
+    if (opus_prepared) {
+        results->opus_encode = prepared_encode;
+        results->opus_decode = prepared_decode;
+        ESP_LOGI(TAG, "  Opus encoder/decoder: %s/%s (run before audio start)",
+                 result_to_string(prepared_encode), result_to_string(prepared_decode));
+    } else {
+        test_opus(&results->opus_encode, &results->opus_decode);
+    }
 
     // Test 8: WiFi
     ESP_LOGI(TAG, "Testing WiFi...");
@@ -271,17 +331,39 @@ esp_err_t diagnostics_run_self_test(diagnostics_result_t *results)
         ESP_LOGE(TAG, "Status LED fault code: %d blinks = Test %d (%s)",
                  first_failed_test, first_failed_test,
                  test_map[first_failed_test - 1].name);
-        ESP_LOGE(TAG, "System halted. Reset to retry.");
+        ESP_LOGE(TAG, "Audio left running. Reset to retry.");
 
-        // Blink status LED with fault code pattern and halt
-        while (1) {
-            blink_fault_code(first_failed_test);
-        }
+        fault_test = (uint8_t)first_failed_test;
     }
 
     return results->all_passed ? ESP_OK : ESP_FAIL;
 }
 
+esp_err_t diagnostics_prepare_self_test(void)
+{
+#if DEVICE_TYPE_PACK
+    prepared_ptt_level = gpio_get_level(BUTTON_PTT_PIN);
+    prepared_call_level = gpio_get_level(BUTTON_CALL_PIN);
+#endif
+    flash_leds();
+    io_prepared = true;
+
+    test_opus(&prepared_encode, &prepared_decode);
+    opus_prepared = true;
+
+    return (prepared_encode == TEST_PASS && prepared_decode == TEST_PASS) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t diagnostics_start_self_test(void)
+{
+    return task_map_create(TASK_SELFTEST, self_test_task, NULL, NULL);
+}
+
+uint8_t diagnostics_get_fault(void)
+{
+    return fault_test;
+}
+
 void diagnostics_print_results(const diagnostics_result_t *results)
 {
     if (!results) return;
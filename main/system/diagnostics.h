@@ -2,8 +2,14 @@
  * @file diagnostics.h
  * @brief System Diagnostics and Self-Test
  *
- * Runs comprehensive self-test on boot to verify all hardware.
- * Halts on failure to prevent operating with faulty hardware.
+ * Runs comprehensive self-test on boot to verify all hardware. The test
+ * runs in its own task once audio is live, so it adds nothing to
+ * boot-to-audio time. The exceptions run in
+ * diagnostics_prepare_self_test() before audio starts: the Opus round
+ * trip (before the engine owns the encoder), the button levels (before a
+ * user can be holding PTT) and the LED flash (before the LEDs show state).
+ * A failure is logged and blinked on the status LED as a fault code,
+ * with audio left running.
  */
 
 #ifndef DIAGNOSTICS_H
@@ -46,14 +52,36 @@ typedef struct {
 //=============================================================================
 
 /**
- * @brief Run full system self-test
+ * @brief Run full system self-test (blocking)
  * @param results Pointer to results structure
  * @return ESP_OK if all critical tests passed, ESP_FAIL otherwise
  *
- * Halts system on critical test failure.
+ * On failure the first failed test becomes the fault code.
  */
 esp_err_t diagnostics_run_self_test(diagnostics_result_t *results);
 
+/**
+ * @brief Read the buttons, flash the LEDs and run the Opus encode/decode
+ * test now, before the audio engine starts
+ * @return ESP_OK if both Opus tests passed
+ */
+esp_err_t diagnostics_prepare_self_test(void);
+
+/**
+ * @brief Run the rest of the self-test in the background (TASK_SELFTEST)
+ *
+ * Marks STARTUP_SELF_TEST_DONE when finished. On failure the task stays
+ * to blink the fault code on the status LED.
+ * @return ESP_OK if the task started
+ */
+esp_err_t diagnostics_start_self_test(void);
+
+/**
+ * @brief Fault code from the last self-test
+ * @return 1-based number of the first failed test, 0 if none failed
+ */
+uint8_t diagnostics_get_fault(void);
+
 /**
  * @brief Print diagnostics results to log
  * @param results Pointer to results structure
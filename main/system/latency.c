@@ -0,0 +1,429 @@
+/**
+ * @file latency.c
+ * @brief End-to-End Latency Measurement Implementation
+ *
+ * Probe times are the low 32 bits of the audio clock on each side. For a
+ * ping sent at t1, received at t2, answered at t3 and back at t4:
+ *   round trip = (t4 - t1) - (t3 - t2)
+ *   offset     = ((t2 - t1) + (t3 - t4)) / 2    (far clock minus ours)
+ * Queueing only ever adds delay, so of the last LATENCY_PROBES probes the
+ * one with the shortest round trip gives the offset.
+ *
+ * Audio packets: arrival less timestamp is the one-way time plus a
+ * constant (the clock offset, and for the compact header the frame count
+ * it was unwrapped from). The fastest packet over the last two windows is
+ * taken to have crossed in half the least round trip; every other packet
+ * adds its extra transit on top.
+ */
+
+#include "latency.h"
+#include "../config.h"
+#include "../audio/audio_engine.h"
+#include "../audio/audio_tones.h"
+#include "../network/control_channel.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "LATENCY";
+
+#if DEVICE_TYPE_BASE
+#define LATENCY_PEERS           MAX_PACKS
+#else
+#define LATENCY_PEERS           1
+#endif
+
+// Probes kept per peer for the least-delay offset
+#define LATENCY_PROBES          8
+
+// Pongs slower than this are dropped (lost in a queue, or a stale probe)
+#define LATENCY_MAX_RTT_US      1000000
+
+// A peer with no pong this long is forgotten
+#define LATENCY_PEER_TIMEOUT_US (10 * 1000000LL)
+
+// Fastest-packet window (ticks); the floor is the least of this window and
+// the one before, so clock drift cannot pull it away for long
+#define LATENCY_FLOOR_TICKS     5
+
+// A far-end loopback test holds our echo canceller this long per ping
+#define LATENCY_ECHO_HOLD_US    (3 * 1000000LL)
+
+// Test click: 4 ms burst at half scale, detected above -20 dBFS; a
+// click not back within a second counts as lost
+#define LATENCY_CLICK_SAMPLES   (SAMPLE_RATE_HZ / 250)
+#define LATENCY_CLICK_LEVEL     0.5f
+#define LATENCY_CLICK_DETECT    3277
+#define LATENCY_CLICK_TIMEOUT_US 1000000LL
+
+// Fixed terms of the estimate: Opus look-ahead and the TX DMA queue
+#if OPUS_LOW_DELAY
+#define LATENCY_CODEC_US        2500
+#else
+#define LATENCY_CODEC_US        6500
+#endif
+#define LATENCY_FRAME_US        ((uint32_t)FRAME_SIZE_MS * 1000)
+#define LATENCY_OUTPUT_US       (I2S_DMA_DESC_NUM * LATENCY_FRAME_US)
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef struct {
+    uint32_t rtt_us;
+    int32_t  offset_us;
+} probe_t;
+
+typedef struct {
+    uint32_t addr;               // 0 = unused
+    uint8_t  device_id;
+    int64_t  last_pong_us;
+    probe_t  probes[LATENCY_PROBES];
+    size_t   probe_count;
+    size_t   probe_head;
+    uint32_t rtt_us;             // Least round trip in the window
+    int32_t  offset_us;          // Its offset
+    bool     have_floor;         // transit_floor/transit_prev hold values
+    bool     floor_restart;      // Next arrival opens a new window
+    uint32_t transit_floor;      // Least arrival-less-timestamp, this window
+    uint32_t transit_prev;       // Same, window before
+    uint32_t net_us;             // Smoothed one-way network time
+    uint32_t net_max_us;         // Worst since the last status
+    uint32_t far_tx_us;          // From its pongs
+    uint32_t dwell_us;           // Our jitter buffer for its stream
+} peer_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static bool initialized = false;
+static portMUX_TYPE peer_lock = portMUX_INITIALIZER_UNLOCKED;
+static peer_t peers[LATENCY_PEERS];
+static uint8_t next_probe = 0;
+static uint32_t ticks = 0;
+
+// Capture-to-send, encoder path only
+static uint32_t tx_us = 0;
+
+static volatile int64_t echo_hold_until_us = 0;
+
+// Loopback test; the click state belongs to the audio engine task
+static volatile bool loopback_on = LATENCY_LOOPBACK_ENABLE;
+static int64_t next_click_us = 0;
+static int64_t click_at_us = 0;              // 0 = no click outstanding
+static volatile uint32_t clicks_sent = 0;
+static volatile uint32_t clicks_lost = 0;
+static volatile uint32_t clicks_back = 0;
+static volatile uint32_t loop_last_us = 0;
+static volatile uint32_t loop_min_us = 0;
+static volatile uint32_t loop_max_us = 0;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static inline uint32_t clock32(void)
+{
+    return (uint32_t)audio_engine_clock_us();
+}
+
+// Call with peer_lock held
+static peer_t *find_peer(uint32_t addr, bool create)
+{
+    peer_t *free_peer = NULL;
+    for (size_t i = 0; i < LATENCY_PEERS; i++) {
+        if (peers[i].addr == addr) return &peers[i];
+        if (!free_peer && peers[i].addr == 0) free_peer = &peers[i];
+    }
+    if (!create || !free_peer) return NULL;
+
+    memset(free_peer, 0, sizeof(*free_peer));
+    free_peer->addr = addr;
+    return free_peer;
+}
+
+static void ping_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    uint32_t t_receive = clock32();
+    if (size < sizeof(control_ping_t)) {
+        return;
+    }
+
+    control_ping_t ping;
+    memcpy(&ping, payload, sizeof(ping));
+    if (ping.flags & CONTROL_PING_LOOPBACK) {
+        echo_hold_until_us = esp_timer_get_time() + LATENCY_ECHO_HOLD_US;
+    }
+
+    control_pong_t pong = {
+        .probe = ping.probe,
+        .device_id = DEVICE_ID,
+        .t_ping = ping.t_send,
+        .t_receive = t_receive,
+        .tx_us = tx_us,
+    };
+    pong.t_reply = clock32();
+    control_channel_send_to(source_addr, CONTROL_MSG_PONG, &pong, sizeof(pong));
+}
+
+static void pong_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    uint32_t t_back = clock32();
+    if (size < sizeof(control_pong_t)) {
+        return;
+    }
+
+    control_pong_t pong;
+    memcpy(&pong, payload, sizeof(pong));
+
+    int32_t rtt = (int32_t)(t_back - pong.t_ping) - (int32_t)(pong.t_reply - pong.t_receive);
+    if (rtt < 0 || rtt > LATENCY_MAX_RTT_US) {
+        return;
+    }
+    int32_t offset = ((int32_t)(pong.t_receive - pong.t_ping) +
+                      (int32_t)(pong.t_reply - t_back)) / 2;
+
+    portENTER_CRITICAL(&peer_lock);
+    peer_t *peer = find_peer(source_addr, true);
+    if (peer) {
+        peer->device_id = pong.device_id;
+        peer->far_tx_us = pong.tx_us;
+        peer->last_pong_us = esp_timer_get_time();
+
+        peer->probes[peer->probe_head] = (probe_t){ (uint32_t)rtt, offset };
+        peer->probe_head = (peer->probe_head + 1) % LATENCY_PROBES;
+        if (peer->probe_count < LATENCY_PROBES) peer->probe_count++;
+
+        const probe_t *best = &peer->probes[0];
+        for (size_t i = 1; i < peer->probe_count; i++) {
+            if (peer->probes[i].rtt_us < best->rtt_us) best = &peer->probes[i];
+        }
+        peer->rtt_us = best->rtt_us;
+        peer->offset_us = best->offset_us;
+    }
+    portEXIT_CRITICAL(&peer_lock);
+}
+
+static uint32_t mouth_to_ear_us(const peer_t *peer)
+{
+    return LATENCY_FRAME_US + LATENCY_CODEC_US + peer->far_tx_us + peer->net_us +
+           peer->dwell_us + LATENCY_OUTPUT_US;
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t latency_init(void)
+{
+    if (!LATENCY_MEASURE_ENABLE || initialized) {
+        return ESP_OK;
+    }
+
+    memset(peers, 0, sizeof(peers));
+    control_channel_register(CONTROL_MSG_PING, ping_handler);
+    control_channel_register(CONTROL_MSG_PONG, pong_handler);
+
+    initialized = true;
+    ESP_LOGI(TAG, "Latency measurement ready%s",
+             loopback_on ? " (loopback click test running)" : "");
+    return ESP_OK;
+}
+
+void latency_tick(void)
+{
+    if (!initialized) return;
+
+    int64_t now_us = esp_timer_get_time();
+    bool new_window = (++ticks % LATENCY_FLOOR_TICKS) == 0;
+
+    portENTER_CRITICAL(&peer_lock);
+    for (size_t i = 0; i < LATENCY_PEERS; i++) {
+        if (peers[i].addr != 0 && now_us - peers[i].last_pong_us > LATENCY_PEER_TIMEOUT_US) {
+            peers[i].addr = 0;
+        }
+        if (new_window) {
+            // A window with no audio leaves nothing current to compare with
+            if (peers[i].floor_restart) peers[i].have_floor = false;
+            peers[i].transit_prev = peers[i].transit_floor;
+            peers[i].floor_restart = true;
+        }
+    }
+    portEXIT_CRITICAL(&peer_lock);
+
+    control_ping_t ping = {
+        .probe = next_probe++,
+        .flags = loopback_on ? CONTROL_PING_LOOPBACK : 0,
+        .t_send = clock32(),
+    };
+    control_channel_send(CONTROL_MSG_PING, &ping, sizeof(ping));
+}
+
+void latency_note_send(void)
+{
+    if (!initialized) return;
+
+    int64_t elapsed = audio_engine_clock_us() - audio_engine_frame_us();
+    if (elapsed < 0) elapsed = 0;
+
+    // 1/16 running average
+    tx_us += ((int32_t)elapsed - (int32_t)tx_us) / 16;
+}
+
+void latency_note_arrival(uint32_t addr, uint32_t timestamp)
+{
+    if (!initialized) return;
+
+    uint32_t now = clock32();
+
+    portENTER_CRITICAL(&peer_lock);
+    peer_t *peer = find_peer(addr, false);
+    if (peer && peer->probe_count > 0) {
+        uint32_t transit = now - timestamp;
+        if (!peer->have_floor) {
+            peer->transit_floor = transit;
+            peer->transit_prev = transit;
+            peer->have_floor = true;
+            peer->floor_restart = false;
+        }
+        if (peer->floor_restart || (int32_t)(transit - peer->transit_floor) < 0) {
+            peer->transit_floor = transit;
+            peer->floor_restart = false;
+        }
+        uint32_t fastest = (int32_t)(peer->transit_prev - peer->transit_floor) < 0
+                           ? peer->transit_prev : peer->transit_floor;
+
+        int32_t extra = (int32_t)(transit - fastest);
+        if (extra < LATENCY_MAX_RTT_US) {
+            uint32_t net = peer->rtt_us / 2 + (uint32_t)extra;
+            peer->net_us += ((int32_t)net - (int32_t)peer->net_us) / 16;
+            if (net > peer->net_max_us) peer->net_max_us = net;
+        }
+    }
+    portEXIT_CRITICAL(&peer_lock);
+}
+
+void latency_note_dwell(uint32_t addr, uint32_t dwell_us)
+{
+    if (!initialized) return;
+
+    portENTER_CRITICAL(&peer_lock);
+    peer_t *peer = find_peer(addr, false);
+    if (peer) {
+        peer->dwell_us = dwell_us;
+    }
+    portEXIT_CRITICAL(&peer_lock);
+}
+
+void latency_loopback_set(bool enable)
+{
+    if (enable == loopback_on) return;
+
+    if (enable) {
+        clicks_sent = 0;
+        clicks_lost = 0;
+        clicks_back = 0;
+        loop_min_us = 0;
+        loop_max_us = 0;
+    }
+    loopback_on = enable;
+    ESP_LOGI(TAG, "Loopback click test %s", enable ? "started" : "stopped");
+}
+
+bool latency_echo_hold(void)
+{
+    return initialized && esp_timer_get_time() < echo_hold_until_us;
+}
+
+void latency_capture_frame(int16_t *pcm, size_t samples)
+{
+    if (!initialized || !pcm) return;
+    if (!loopback_on) {
+        click_at_us = 0;
+        return;
+    }
+
+    // This frame's event marks its last sample
+    int64_t frame_us = audio_engine_frame_us();
+
+    if (click_at_us != 0 && frame_us - click_at_us > LATENCY_CLICK_TIMEOUT_US) {
+        clicks_lost++;
+        click_at_us = 0;
+    }
+    if (click_at_us != 0 || frame_us < next_click_us || samples < LATENCY_CLICK_SAMPLES) {
+        return;
+    }
+
+    audio_tones_generate_click(pcm, LATENCY_CLICK_SAMPLES, LATENCY_CLICK_LEVEL);
+
+    // Timed from where the click itself crosses the detection level
+    size_t onset = 0;
+    while (onset < LATENCY_CLICK_SAMPLES &&
+           pcm[onset] <= LATENCY_CLICK_DETECT && pcm[onset] >= -LATENCY_CLICK_DETECT) {
+        onset++;
+    }
+    click_at_us = frame_us - (int64_t)(samples - onset) * 1000000 / SAMPLE_RATE_HZ;
+    next_click_us = frame_us + (int64_t)LATENCY_LOOPBACK_INTERVAL_MS * 1000;
+    clicks_sent++;
+}
+
+void latency_playout_frame(const int16_t *pcm, size_t samples)
+{
+    if (!initialized || !pcm || click_at_us == 0) return;
+
+    for (size_t i = 0; i < samples; i++) {
+        if (pcm[i] > LATENCY_CLICK_DETECT || pcm[i] < -LATENCY_CLICK_DETECT) {
+            int64_t at_us = audio_engine_frame_us() + (int64_t)i * 1000000 / SAMPLE_RATE_HZ;
+            uint32_t loop_us = (uint32_t)(at_us - click_at_us);
+
+            loop_last_us = loop_us;
+            if (clicks_back == 0 || loop_us < loop_min_us) loop_min_us = loop_us;
+            if (loop_us > loop_max_us) loop_max_us = loop_us;
+            clicks_back++;
+            click_at_us = 0;
+            return;
+        }
+    }
+}
+
+void latency_print_status(void)
+{
+    if (!initialized) return;
+
+    peer_t snapshot[LATENCY_PEERS];
+    portENTER_CRITICAL(&peer_lock);
+    memcpy(snapshot, peers, sizeof(snapshot));
+    for (size_t i = 0; i < LATENCY_PEERS; i++) {
+        peers[i].net_max_us = peers[i].net_us;
+    }
+    portEXIT_CRITICAL(&peer_lock);
+
+    ESP_LOGI(TAG, "Local: capture-to-send=%lu us, fixed: frame %lu + codec %lu + I2S out %lu us",
+             (unsigned long)tx_us, (unsigned long)LATENCY_FRAME_US,
+             (unsigned long)LATENCY_CODEC_US, (unsigned long)LATENCY_OUTPUT_US);
+
+    for (size_t i = 0; i < LATENCY_PEERS; i++) {
+        const peer_t *p = &snapshot[i];
+        if (p->addr == 0 || p->probe_count == 0) continue;
+
+        ESP_LOGI(TAG, "Peer %02x: rtt=%lu us offset=%+ld us | far tx=%lu net=%lu (max %lu) "
+                 "jb=%lu us | mouth-to-ear ~%lu.%lu ms",
+                 p->device_id, (unsigned long)p->rtt_us, (long)p->offset_us,
+                 (unsigned long)p->far_tx_us, (unsigned long)p->net_us, (unsigned long)p->net_max_us,
+                 (unsigned long)p->dwell_us,
+                 (unsigned long)(mouth_to_ear_us(p) / 1000),
+                 (unsigned long)((mouth_to_ear_us(p) % 1000) / 100));
+    }
+
+    if (loopback_on || clicks_sent > 0) {
+        ESP_LOGI(TAG, "Loopback: %lu/%lu clicks back (%lu lost), round trip last=%lu.%lu ms "
+                 "min=%lu.%lu max=%lu.%lu (+ local I2S queues)",
+                 (unsigned long)clicks_back, (unsigned long)clicks_sent,
+                 (unsigned long)clicks_lost,
+                 (unsigned long)(loop_last_us / 1000), (unsigned long)((loop_last_us % 1000) / 100),
+                 (unsigned long)(loop_min_us / 1000), (unsigned long)((loop_min_us % 1000) / 100),
+                 (unsigned long)(loop_max_us / 1000), (unsigned long)((loop_max_us % 1000) / 100));
+    }
+}
@@ -0,0 +1,97 @@
+/**
+ * @file latency.h
+ * @brief End-to-End Latency Measurement
+ *
+ * Ping: once a second each device sends CONTROL_MSG_PING to its peers and
+ * times the pong NTP-style on the audio clock (audio_engine_clock_us, the
+ * clock packet timestamps use). Round trip is less the far end's hold
+ * time; the far clock's offset is taken from the fastest probe in the
+ * window, the one with the least queueing.
+ *
+ * Stages: arrival less timestamp gives each audio packet's one-way time
+ * to within a constant, so the fastest recent packet is put at half the
+ * least round trip and the others add their extra transit (bundle waits
+ * included; works for either header format). The far end reports
+ * its capture-to-send time in its pongs and the jitter buffer owner
+ * reports dwell, so the mouth-to-ear estimate per peer is
+ *   capture frame + codec look-ahead + far capture-to-send + network
+ *   + jitter-buffer dwell + I2S output queue.
+ *
+ * Loopback: with LATENCY_LOOPBACK_ENABLE (or latency_loopback_set) a
+ * click from audio_tones is written into the captured frame every
+ * LATENCY_LOOPBACK_INTERVAL_MS and looked for in the played stream. With
+ * the far end's output looped into its input (earpiece on the mic, line
+ * out to line in) that is the measured round trip through both devices,
+ * less this device's own I2S queues. The far end holds its echo canceller
+ * while the test runs. A pack only sends with PTT down, so run the test
+ * from the base, or latch PTT on the pack.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Register the ping/pong handlers (control channel must be up)
+ * @return ESP_OK on success
+ */
+esp_err_t latency_init(void);
+
+/**
+ * @brief Ping the peers and age out silent ones (call once a second)
+ */
+void latency_tick(void);
+
+/**
+ * @brief Record capture-to-send for the frame just sent (encoder path)
+ */
+void latency_note_send(void);
+
+/**
+ * @brief Record a received audio packet's network time (RX task)
+ * @param addr Sender address as passed to the RX callback
+ * @param timestamp Sender's timestamp (audio_packet_t.timestamp)
+ */
+void latency_note_arrival(uint32_t addr, uint32_t timestamp);
+
+/**
+ * @brief Record the jitter-buffer dwell of a peer's stream
+ * @param addr Sender address
+ * @param dwell_us Mean time frames wait in its jitter buffer
+ */
+void latency_note_dwell(uint32_t addr, uint32_t dwell_us);
+
+/**
+ * @brief Start or stop the loopback click test
+ */
+void latency_loopback_set(bool enable);
+
+/**
+ * @brief Whether a far-end loopback test asks us to hold echo cancelling
+ */
+bool latency_echo_hold(void);
+
+/**
+ * @brief Audio engine: write a pending test click into a captured frame
+ */
+void latency_capture_frame(int16_t *pcm, size_t samples);
+
+/**
+ * @brief Audio engine: look for the returning click in a played frame
+ */
+void latency_playout_frame(const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Log per-peer stages, estimates and loopback results
+ */
+void latency_print_status(void);
+
+#endif // LATENCY_H
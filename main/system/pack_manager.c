@@ -0,0 +1,463 @@
+/**
+ * @file pack_manager.c
+ * @brief Connected Belt Packs Implementation
+ *
+ * Only the RX task claims slots and only the audio engine's playout
+ * stage releases them, so the slot table needs just a spinlock around
+ * state changes; decoding runs without holding it.
+ *
+ * Each pack's stream is resampled by its own measured clock drift
+ * (audio_drift) before mixing, since every pack runs on its own crystal.
+ *
+ * Mix-minus: the playout stage publishes each pack's decoded frame under
+ * tx_lock; the capture stage copies them out, builds one bus (line + all
+ * packs) and takes each talking pack's feed as bus minus its own frame.
+ * Only the capture stage touches the encoders.
+ */
+
+#include "pack_manager.h"
+#include "../config.h"
+
+#if DEVICE_TYPE_BASE && JITTER_BUFFER_ENABLE
+
+#include "../audio/audio_opus.h"
+#include "../audio/audio_processor.h"
+#include "../audio/audio_drift.h"
+#include "../audio/audio_dsp.h"
+#include "../audio/audio_vad.h"
+#include "../network/udp_transport.h"
+#include "latency.h"
+#include "trace.h"
+#include "freertos/semphr.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <math.h>
+#include <string.h>
+
+static const char *TAG = "PACK_MGR";
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+typedef struct {
+    volatile bool    active;
+    uint32_t         addr;
+    volatile int64_t last_rx_us;
+    volatile bool    ptt;
+    volatile bool    call;
+    jitter_buffer_t  jb;
+    audio_opus_decoder_t *decoder;
+    audio_drift_t    drift;
+    int16_t          pcm[SAMPLES_PER_FRAME] AUDIO_DSP_ALIGN;
+
+    // Published for the TX path (under tx_lock)
+    int16_t          tx_pcm[SAMPLES_PER_FRAME];
+    bool             tx_valid;           // pack contributed to the last mix
+    volatile int64_t last_contrib_us;
+
+    // Owned by the capture stage
+    audio_opus_encoder_t *encoder;
+    audio_mix_state_t tx_mix;
+    bool             mix_minus;          // pack currently gets its own feed
+    uint32_t         tx_addr;            // pack the encoder state belongs to
+} pack_slot_t;
+
+static bool initialized = false;
+static pack_slot_t packs[MAX_PACKS];
+static portMUX_TYPE table_lock = portMUX_INITIALIZER_UNLOCKED;
+static audio_mix_state_t mix_state;
+
+// TX path (capture stage)
+static SemaphoreHandle_t tx_lock = NULL;
+static int16_t AUDIO_DSP_ALIGN tx_own[MAX_PACKS][SAMPLES_PER_FRAME];
+static int32_t tx_bus[SAMPLES_PER_FRAME];
+static int16_t AUDIO_DSP_ALIGN tx_pcm[SAMPLES_PER_FRAME];
+static audio_mix_state_t shared_mix_state;
+static audio_vad_t line_vad;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static pack_slot_t *find_or_claim(uint32_t addr)
+{
+    pack_slot_t *free_slot = NULL;
+
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (packs[i].active && packs[i].addr == addr) {
+            return &packs[i];
+        }
+        if (!packs[i].active && !free_slot) {
+            free_slot = &packs[i];
+        }
+    }
+
+    if (!free_slot) {
+        return NULL;
+    }
+
+    // Fresh decoder/buffer state, then publish the slot
+    jitter_buffer_reset(&free_slot->jb);
+    audio_opus_decoder_reset(free_slot->decoder);
+    audio_drift_reset(&free_slot->drift);
+
+    portENTER_CRITICAL(&table_lock);
+    free_slot->addr = addr;
+    free_slot->last_rx_us = esp_timer_get_time();
+    free_slot->ptt = false;
+    free_slot->call = false;
+    free_slot->active = true;
+    portEXIT_CRITICAL(&table_lock);
+
+    ESP_LOGI(TAG, "Pack %u joined from %u.%u.%u.%u",
+             (unsigned)(free_slot - packs),
+             (unsigned)(addr & 0xFF), (unsigned)((addr >> 8) & 0xFF),
+             (unsigned)((addr >> 16) & 0xFF), (unsigned)((addr >> 24) & 0xFF));
+    return free_slot;
+}
+
+static int pull_frame(void *ctx, int16_t *pcm, size_t samples)
+{
+    pack_slot_t *pack = ctx;
+    return jitter_buffer_decode_next(&pack->jb, pack->decoder, pcm, samples);
+}
+
+static void release(pack_slot_t *pack)
+{
+    portENTER_CRITICAL(&table_lock);
+    pack->active = false;
+    pack->ptt = false;
+    pack->call = false;
+    portEXIT_CRITICAL(&table_lock);
+
+    ESP_LOGI(TAG, "Pack %u timed out", (unsigned)(pack - packs));
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t pack_manager_init(void)
+{
+    if (initialized) {
+        return ESP_OK;
+    }
+
+    memset(packs, 0, sizeof(packs));
+
+    tx_lock = xSemaphoreCreateMutex();
+    if (!tx_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        esp_err_t ret = jitter_buffer_init(&packs[i].jb);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        packs[i].decoder = audio_opus_decoder_create();
+        packs[i].encoder = audio_opus_encoder_create();
+        if (!packs[i].decoder || !packs[i].encoder) {
+            ESP_LOGE(TAG, "Failed to create codec for pack %u", (unsigned)i);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    audio_processor_mix_init(&mix_state);
+    audio_processor_mix_init(&shared_mix_state);
+    audio_vad_init(&line_vad);
+
+    initialized = true;
+    ESP_LOGI(TAG, "Pack manager ready: %d packs, mix-minus%s", MAX_PACKS,
+             MIX_MINUS_SHARED_ENCODE ? " (shared encode for listeners)" : "");
+    return ESP_OK;
+}
+
+void pack_manager_receive(uint32_t source_addr, const uint8_t *opus_data, uint16_t opus_size,
+                          uint32_t sequence, uint32_t timestamp,
+                          bool ptt_active, bool call_active)
+{
+    if (!initialized) return;
+
+    pack_slot_t *pack = find_or_claim(source_addr);
+    if (!pack) {
+        ESP_LOGD(TAG, "No free slot - packet dropped");
+        return;
+    }
+
+    pack->last_rx_us = esp_timer_get_time();
+    pack->ptt = ptt_active;
+    pack->call = call_active;
+
+    jitter_buffer_set_low_latency(&pack->jb, udp_transport_link_low_latency(source_addr));
+    jitter_buffer_push(&pack->jb, opus_data, opus_size, sequence, timestamp, false, false);
+    audio_drift_note_arrival(&pack->drift, timestamp);
+}
+
+size_t pack_manager_mix(int16_t *output, size_t samples)
+{
+    if (!initialized || !output) return 0;
+
+    const int16_t *inputs[MAX_PACKS];
+    size_t input_count = 0;
+    int64_t now_us = esp_timer_get_time();
+
+    if (samples > SAMPLES_PER_FRAME) samples = SAMPLES_PER_FRAME;
+
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        pack_slot_t *pack = &packs[i];
+        if (!pack->active) continue;
+
+        int decoded = audio_drift_playout(&pack->drift, pull_frame, pack,
+                                          pack->pcm, samples);
+        if (decoded > 0) {
+            if ((size_t)decoded < samples) {
+                memset(&pack->pcm[decoded], 0, (samples - decoded) * sizeof(int16_t));
+            }
+            inputs[input_count++] = pack->pcm;
+            pack->last_contrib_us = now_us;
+        } else if (now_us - pack->last_rx_us > (int64_t)PACK_TIMEOUT_MS * 1000) {
+            release(pack);
+        }
+    }
+
+    // Publish this frame's contributions for the mix-minus feeds
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        pack_slot_t *pack = &packs[i];
+        pack->tx_valid = false;
+        for (size_t n = 0; n < input_count; n++) {
+            if (inputs[n] == pack->pcm) {
+                memcpy(pack->tx_pcm, pack->pcm, samples * sizeof(int16_t));
+                if (samples < SAMPLES_PER_FRAME) {
+                    memset(&pack->tx_pcm[samples], 0,
+                           (SAMPLES_PER_FRAME - samples) * sizeof(int16_t));
+                }
+                pack->tx_valid = true;
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(tx_lock);
+
+    if (input_count == 0) {
+        return 0;
+    }
+
+    uint32_t trace_start = trace_begin();
+    audio_processor_mix_n(inputs, input_count, output, samples, &mix_state);
+    trace_end(TRACE_MIX, trace_start);
+    return input_count;
+}
+
+void pack_manager_transmit(const int16_t *line_pcm, size_t samples, bool call_active)
+{
+    if (!initialized || !line_pcm) return;
+
+    if (samples > SAMPLES_PER_FRAME) samples = SAMPLES_PER_FRAME;
+
+    const int16_t *inputs[MAX_PACKS + 1];
+    bool own_valid[MAX_PACKS];
+    bool any_talking = false;
+    size_t input_count = 0;
+
+    inputs[input_count++] = line_pcm;
+
+    // Take a private copy so the playout stage can move on to the next frame
+    xSemaphoreTake(tx_lock, portMAX_DELAY);
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        own_valid[i] = packs[i].active && packs[i].tx_valid;
+        if (own_valid[i]) {
+            memcpy(tx_own[i], packs[i].tx_pcm, samples * sizeof(int16_t));
+            inputs[input_count++] = tx_own[i];
+            any_talking = true;
+        }
+    }
+    xSemaphoreGive(tx_lock);
+
+    // Silent line and nobody talking: DTX. Listeners get the broadcast
+    // comfort-noise updates only; no per-pack feed is needed.
+    audio_dtx_action_t action = audio_vad_frame(&line_vad, line_pcm, samples, any_talking);
+
+    // One bus for everyone: line + every talking pack
+    uint32_t trace_start = trace_begin();
+    audio_processor_mix_bus(inputs, input_count, tx_bus, samples);
+    trace_end(TRACE_MIX, trace_start);
+
+    // Per-pack feeds go out first: they take the sequence number the
+    // broadcast below is about to use
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        pack_slot_t *pack = &packs[i];
+        if (!pack->active) {
+            pack->mix_minus = false;
+            continue;
+        }
+        if (action != AUDIO_DTX_SEND) {
+            continue;
+        }
+
+#if MIX_MINUS_SHARED_ENCODE
+        // Listeners have nothing to remove - they share the broadcast feed
+        bool talking = own_valid[i] ||
+                       (esp_timer_get_time() - pack->last_contrib_us < (int64_t)MIX_MINUS_HOLD_MS * 1000);
+        if (!talking) {
+            pack->mix_minus = false;
+            continue;
+        }
+#endif
+
+        if (!pack->mix_minus || pack->tx_addr != pack->addr) {
+            // New feed: start from clean encoder state
+            audio_opus_encoder_reset(pack->encoder);
+            audio_processor_mix_init(&pack->tx_mix);
+            pack->tx_addr = pack->addr;
+            pack->mix_minus = true;
+        }
+
+        audio_processor_mix_minus(tx_bus, own_valid[i] ? tx_own[i] : NULL,
+                                  tx_pcm, samples, &pack->tx_mix);
+
+        // Encode straight into the packet that goes out
+        size_t capacity;
+        uint8_t *payload = udp_transport_acquire_tx_buffer(&capacity);
+        if (!payload) {
+            continue;
+        }
+        int encoded = audio_opus_encoder_encode(pack->encoder, tx_pcm, samples,
+                                                payload, capacity);
+        if (encoded > 0) {
+            udp_transport_commit_mix_minus(pack->tx_addr, payload, encoded, call_active);
+            latency_note_send();
+        } else {
+            udp_transport_release_tx_buffer(payload);
+        }
+    }
+
+    // Broadcast feed: the full bus, for listeners and packs not yet known
+    audio_processor_mix_minus(tx_bus, NULL, tx_pcm, samples, &shared_mix_state);
+
+    size_t capacity;
+    uint8_t *payload = udp_transport_acquire_tx_buffer(&capacity);
+    if (!payload) {
+        return;
+    }
+    // Encoded even when skipped, so the encoder state stays whole
+    int encoded = audio_opus_encode(tx_pcm, samples, payload, capacity);
+    if (encoded > 0 && action == AUDIO_DTX_SEND) {
+        udp_transport_commit_tx_buffer(payload, encoded, true, call_active);
+        latency_note_send();
+    } else if (encoded > 0 && action == AUDIO_DTX_UPDATE) {
+        udp_transport_commit_dtx_update(payload, encoded, call_active);
+    } else {
+        udp_transport_release_tx_buffer(payload);
+        udp_transport_flush();
+    }
+}
+
+bool pack_manager_any_ptt(void)
+{
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (packs[i].active && packs[i].ptt) return true;
+    }
+    return false;
+}
+
+bool pack_manager_any_call(void)
+{
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (packs[i].active && packs[i].call) return true;
+    }
+    return false;
+}
+
+size_t pack_manager_active_count(void)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (packs[i].active) count++;
+    }
+    return count;
+}
+
+void pack_manager_get_worst_stats(jitter_buffer_stats_t *stats)
+{
+    if (!stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (!packs[i].active) continue;
+
+        jitter_buffer_stats_t s;
+        jitter_buffer_get_stats(&packs[i].jb, &s);
+        if (s.jitter_us >= stats->jitter_us) {
+            *stats = s;
+        }
+    }
+}
+
+void pack_manager_get_total_stats(jitter_buffer_stats_t *stats)
+{
+    if (!stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (!packs[i].active) continue;
+
+        jitter_buffer_stats_t s;
+        jitter_buffer_get_stats(&packs[i].jb, &s);
+        if (s.current_depth > stats->current_depth) stats->current_depth = s.current_depth;
+        if (s.target_depth > stats->target_depth) stats->target_depth = s.target_depth;
+        if (s.jitter_us > stats->jitter_us) stats->jitter_us = s.jitter_us;
+        if (s.dwell_us > stats->dwell_us) stats->dwell_us = s.dwell_us;
+        stats->underruns += s.underruns;
+        stats->overruns += s.overruns;
+        stats->frames_stretched += s.frames_stretched;
+        stats->frames_shrunk += s.frames_shrunk;
+        stats->late_drops += s.late_drops;
+        stats->duplicates += s.duplicates;
+        stats->frames_missing += s.frames_missing;
+        stats->fec_recovered += s.fec_recovered;
+        stats->comfort_frames += s.comfort_frames;
+        stats->queue_drops += s.queue_drops;
+    }
+}
+
+float pack_manager_get_worst_drift_ppm(void)
+{
+    float worst = 0.0f;
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (!packs[i].active) continue;
+
+        float ppm = audio_drift_get_ppm(&packs[i].drift);
+        if (fabsf(ppm) > fabsf(worst)) worst = ppm;
+    }
+    return worst;
+}
+
+void pack_manager_print_status(void)
+{
+    for (size_t i = 0; i < MAX_PACKS; i++) {
+        if (!packs[i].active) continue;
+
+        jitter_buffer_stats_t s;
+        jitter_buffer_get_stats(&packs[i].jb, &s);
+        uint32_t addr = packs[i].addr;
+        latency_note_dwell(addr, s.dwell_us);
+        ESP_LOGI(TAG, "Pack %u %u.%u.%u.%u: ptt=%d mix-minus=%d depth=%lu/%lu jitter=%lu us dwell=%lu us missing=%lu fec=%lu drift=%+.1f ppm",
+                 (unsigned)i,
+                 (unsigned)(addr & 0xFF), (unsigned)((addr >> 8) & 0xFF),
+                 (unsigned)((addr >> 16) & 0xFF), (unsigned)((addr >> 24) & 0xFF),
+                 packs[i].ptt, packs[i].mix_minus,
+                 (unsigned long)s.current_depth, (unsigned long)s.target_depth,
+                 (unsigned long)s.jitter_us, (unsigned long)s.dwell_us,
+                 (unsigned long)s.frames_missing,
+                 (unsigned long)s.fec_recovered, audio_drift_get_ppm(&packs[i].drift));
+    }
+}
+
+#endif // DEVICE_TYPE_BASE && JITTER_BUFFER_ENABLE
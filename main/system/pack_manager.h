@@ -0,0 +1,116 @@
+/**
+ * @file pack_manager.h
+ * @brief Connected Belt Packs (Base Station Only)
+ *
+ * Tracks up to MAX_PACKS packs by source address. Each pack gets its own
+ * jitter buffer and Opus decoder, allocated once at init. Every frame the
+ * packs' decoded audio is summed onto the party line bus.
+ *
+ * In the other direction each talking pack gets a mix-minus: party line
+ * plus the other packs, without its own voice. The bus is summed once and
+ * each feed is bus minus one contribution, so the cost is one encode per
+ * talking pack rather than N^2 mixing. With MIX_MINUS_SHARED_ENCODE,
+ * listening packs share the single broadcast encode.
+ */
+
+#ifndef PACK_MANAGER_H
+#define PACK_MANAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "../audio/audio_jitter_buffer.h"
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Allocate per-pack jitter buffers and decoders
+ * @return ESP_OK on success
+ */
+esp_err_t pack_manager_init(void);
+
+/**
+ * @brief Route a received audio packet to its pack's jitter buffer
+ *
+ * Called from the UDP RX task. A new source address claims a free slot.
+ * @param source_addr Sender's IPv4 address (network byte order)
+ * @param opus_data Opus encoded audio
+ * @param opus_size Size of Opus data
+ * @param sequence Sender's packet sequence number
+ * @param timestamp Sender's timestamp (microseconds)
+ * @param ptt_active Sender's PTT state
+ * @param call_active Sender's call state
+ */
+void pack_manager_receive(uint32_t source_addr, const uint8_t *opus_data, uint16_t opus_size,
+                          uint32_t sequence, uint32_t timestamp,
+                          bool ptt_active, bool call_active);
+
+/**
+ * @brief Decode one frame from every pack and mix them
+ *
+ * Called from the audio engine's playout stage once per frame. Each
+ * pack is resampled by its measured clock drift before mixing. Packs
+ * silent for longer than PACK_TIMEOUT_MS release their slot here.
+ * @param output Mixed PCM output
+ * @param samples Number of samples (SAMPLES_PER_FRAME)
+ * @return Number of packs contributing audio (0 = nothing to play)
+ */
+size_t pack_manager_mix(int16_t *output, size_t samples);
+
+/**
+ * @brief Encode and send this frame's feeds to the packs
+ *
+ * Called from the audio engine's capture stage once per frame with the party line input.
+ * Sends a unicast mix-minus to each talking pack, then the full mix as
+ * the broadcast.
+ * @param line_pcm Party line audio for this frame
+ * @param samples Number of samples (SAMPLES_PER_FRAME)
+ * @param call_active Local call state
+ */
+void pack_manager_transmit(const int16_t *line_pcm, size_t samples, bool call_active);
+
+/**
+ * @brief Check whether any connected pack has PTT active
+ */
+bool pack_manager_any_ptt(void);
+
+/**
+ * @brief Check whether any connected pack is signalling call
+ */
+bool pack_manager_any_call(void);
+
+/**
+ * @brief Number of packs currently holding a slot
+ */
+size_t pack_manager_active_count(void);
+
+/**
+ * @brief Jitter statistics of the worst pack stream (highest jitter)
+ * @param stats Pointer to stats structure (zeroed if no pack is active)
+ */
+void pack_manager_get_worst_stats(jitter_buffer_stats_t *stats);
+
+/**
+ * @brief Jitter statistics over every active pack stream
+ *
+ * Counters are summed; depth, jitter and dwell are the worst stream's.
+ * A slot's counters start again when it is reclaimed.
+ * @param stats Pointer to stats structure (zeroed if no pack is active)
+ */
+void pack_manager_get_total_stats(jitter_buffer_stats_t *stats);
+
+/**
+ * @brief Largest clock drift measured on an active pack stream
+ * @return ppm (signed, 0 if no pack is active)
+ */
+float pack_manager_get_worst_drift_ppm(void);
+
+/**
+ * @brief Log one status line per active pack
+ */
+void pack_manager_print_status(void);
+
+#endif // PACK_MANAGER_H
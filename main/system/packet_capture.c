@@ -0,0 +1,612 @@
+/**
+ * @file packet_capture.c
+ * @brief Packet Capture and Replay Implementation
+ *
+ * Writers claim a record index with one atomic add and publish it by
+ * storing index + 1 in the slot's stamp last, so a reader skips a slot
+ * that was being overwritten. Freezing only stops new claims; the dump
+ * and replay task waits a tick for writers already inside before it
+ * reads. Dumps, peer fetches and replays run in TASK_CAPTURE, created
+ * for the job and ended after it, so neither the RX task nor the audio
+ * engine ever waits on the console.
+ *
+ * A pack's capture reaches the base by stop-and-wait: the pack announces
+ * CONTROL_CAPTURE_FROZEN, the base asks for each chunk with
+ * CONTROL_CAPTURE_FETCH once it has printed the previous one, and the
+ * pack answers from its RX task.
+ */
+
+#include "packet_capture.h"
+#include "task_map.h"
+#include "../network/control_channel.h"
+#include "../network/udp_transport.h"
+#include "../network/transport_backend.h"
+#include "../platform/mem_arena.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "CAPTURE";
+
+// pcap framing of each record: raw IPv4 (LINKTYPE_RAW), UDP to UDP_PORT
+#define PCAP_MAGIC              0xA1B2C3D4
+#define PCAP_LINKTYPE_RAW       101
+#define PCAP_IP_HEADER          20
+#define PCAP_UDP_HEADER         8
+#define PCAP_RECORD_HEADER      16
+#define PCAP_FRAME_MAX          (PCAP_RECORD_HEADER + PCAP_IP_HEADER + PCAP_UDP_HEADER + \
+                                 PACKET_CAPTURE_SNAP_BYTES)
+
+#define FETCH_TIMEOUT_MS        500
+#define FETCH_RETRIES           5
+
+_Static_assert(PACKET_CAPTURE_SNAP_BYTES <= 255, "caplen is one byte");
+_Static_assert(sizeof(control_capture_data_t) + sizeof(control_capture_record_t) +
+               PACKET_CAPTURE_SNAP_BYTES <= CONTROL_MAX_PAYLOAD,
+               "a full record must fit one CONTROL_MSG_CAPTURE_DATA chunk");
+
+typedef struct {
+    uint32_t stamp;              // Record index + 1 once written, 0 while writing
+    control_capture_record_t rec;
+    uint8_t data[PACKET_CAPTURE_SNAP_BYTES];
+} capture_slot_t;
+
+typedef enum {
+    JOB_DUMP = 0,                // Print our own ring
+    JOB_NOTIFY,                  // Tell a peer we froze (it fetches)
+    JOB_FETCH,                   // Fetch and print a peer's ring
+    JOB_REPLAY,                  // Inject our received records
+} capture_job_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static bool initialized = false;
+static capture_slot_t *slots = NULL;
+static uint32_t slot_count = 0;
+static uint32_t head = 0;                    // Records claimed (atomic)
+static volatile bool recording = false;
+
+// Underrun trigger (monitor task)
+static uint32_t last_underruns = 0;
+static int64_t freeze_at_us = 0;
+
+// One job at a time
+static portMUX_TYPE job_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool busy = false;
+static capture_job_t job;
+static uint32_t job_addr = 0;
+static uint8_t job_device = 0;
+static uint32_t job_index = 0;
+static TaskHandle_t task_handle = NULL;
+
+// Latest chunk from the peer being fetched (RX task -> capture task)
+static uint8_t chunk[CONTROL_MAX_PAYLOAD];
+static uint16_t chunk_size = 0;
+
+// Console line: "PCAP xx: " + base64 of one pcap record
+static uint8_t frame[PCAP_FRAME_MAX];
+static char line[16 + ((PCAP_FRAME_MAX + 2) / 3) * 4 + 2];
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static uint32_t claimed(void)
+{
+    return __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+}
+
+static uint32_t oldest(uint32_t end)
+{
+    return end > slot_count ? end - slot_count : 0;
+}
+
+// The record at index, or NULL if it was overwritten or never finished
+static const capture_slot_t *slot_at(uint32_t index)
+{
+    const capture_slot_t *slot = &slots[index % slot_count];
+    return __atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) == index + 1 ? slot : NULL;
+}
+
+static void print_base64(uint8_t device_id, const uint8_t *data, size_t size)
+{
+    static const char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    char *out = line + sprintf(line, "PCAP %02x: ", device_id);
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < size) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) v |= data[i + 2];
+        *out++ = alphabet[(v >> 18) & 0x3F];
+        *out++ = alphabet[(v >> 12) & 0x3F];
+        *out++ = i + 1 < size ? alphabet[(v >> 6) & 0x3F] : '=';
+        *out++ = i + 2 < size ? alphabet[v & 0x3F] : '=';
+    }
+    *out = '\0';
+    printf("%s\n", line);
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void print_file_header(uint8_t device_id)
+{
+    uint8_t header[24] = {0};
+    put_le32(&header[0], PCAP_MAGIC);
+    header[4] = 2;                               // Version 2.4
+    header[6] = 4;
+    put_le32(&header[16], PCAP_FRAME_MAX);       // Snap length
+    put_le32(&header[20], PCAP_LINKTYPE_RAW);
+    print_base64(device_id, header, sizeof(header));
+}
+
+// One record as a raw IPv4/UDP frame. RX: sender -> 0.0.0.0,
+// TX: 0.0.0.0 -> destination (broadcast for 0)
+static void print_record(uint8_t device_id, const control_capture_record_t *rec,
+                         const uint8_t *data, int64_t time_us)
+{
+    uint32_t none = 0;
+    uint32_t broadcast = 0xFFFFFFFF;
+    uint32_t peer = rec->addr;
+    const uint32_t *src = &none;
+    const uint32_t *dst = &peer;
+    if (rec->dir == PACKET_CAPTURE_RX) {
+        src = &peer;
+        dst = &none;
+    } else if (peer == 0) {
+        dst = &broadcast;
+    }
+
+    size_t headers = PCAP_IP_HEADER + PCAP_UDP_HEADER;
+    put_le32(&frame[0], (uint32_t)(time_us / 1000000));
+    put_le32(&frame[4], (uint32_t)(time_us % 1000000));
+    put_le32(&frame[8], (uint32_t)(headers + rec->caplen));
+    put_le32(&frame[12], (uint32_t)(headers + rec->size));
+
+    uint8_t *ip = &frame[PCAP_RECORD_HEADER];
+    memset(ip, 0, headers);
+    ip[0] = 0x45;
+    put_be16(&ip[2], (uint16_t)(headers + rec->size));
+    ip[8] = 64;
+    ip[9] = 17;                                  // UDP
+    memcpy(&ip[12], src, 4);
+    memcpy(&ip[16], dst, 4);
+    uint32_t sum = 0;
+    for (size_t i = 0; i < PCAP_IP_HEADER; i += 2) {
+        sum += ((uint32_t)ip[i] << 8) | ip[i + 1];
+    }
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    put_be16(&ip[10], (uint16_t)~sum);
+
+    uint8_t *udp = &ip[PCAP_IP_HEADER];
+    put_be16(&udp[0], UDP_PORT);
+    put_be16(&udp[2], UDP_PORT);
+    put_be16(&udp[4], (uint16_t)(PCAP_UDP_HEADER + rec->size));
+    memcpy(&udp[PCAP_UDP_HEADER], data, rec->caplen);
+
+    print_base64(device_id, frame, PCAP_RECORD_HEADER + headers + rec->caplen);
+}
+
+// Records carry the low 32 bits of esp_timer; pcap wants absolute times
+static int64_t unwrap_time(int64_t *last_us, bool *first, uint32_t time_us)
+{
+    if (*first) {
+        *first = false;
+        *last_us = time_us;
+    } else {
+        *last_us += (uint32_t)(time_us - (uint32_t)*last_us);
+    }
+    return *last_us;
+}
+
+static void dump_local(void)
+{
+    uint32_t end = claimed();
+    uint32_t printed = 0;
+    int64_t last_us = 0;
+    bool first = true;
+
+    ESP_LOGI(TAG, "Dump start (%lu records)", (unsigned long)(end - oldest(end)));
+    print_file_header(DEVICE_ID);
+    for (uint32_t i = oldest(end); i < end; i++) {
+        const capture_slot_t *slot = slot_at(i);
+        if (!slot) continue;
+        print_record(DEVICE_ID, &slot->rec, slot->data,
+                     unwrap_time(&last_us, &first, slot->rec.time_us));
+        printed++;
+    }
+    ESP_LOGI(TAG, "Dump end (%lu records)", (unsigned long)printed);
+}
+
+static void notify_peer(uint32_t addr)
+{
+    uint32_t end = claimed();
+    control_capture_t notice = {
+        .op = CONTROL_CAPTURE_FROZEN,
+        .device_id = DEVICE_ID,
+        .index = oldest(end),
+    };
+    control_channel_send_to(addr, CONTROL_MSG_CAPTURE, &notice, sizeof(notice));
+    ESP_LOGI(TAG, "Frozen (%lu records), announced for fetching",
+             (unsigned long)(end - oldest(end)));
+}
+
+static void fetch_peer(uint32_t addr, uint8_t device_id, uint32_t index)
+{
+    static uint8_t local[CONTROL_MAX_PAYLOAD];
+    uint32_t printed = 0;
+    int64_t last_us = 0;
+    bool first = true;
+    int retries = 0;
+
+    ESP_LOGI(TAG, "Fetching capture from device 0x%02x", device_id);
+    print_file_header(device_id);
+
+    while (retries < FETCH_RETRIES) {
+        portENTER_CRITICAL(&job_lock);
+        chunk_size = 0;
+        portEXIT_CRITICAL(&job_lock);
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        control_capture_t request = {
+            .op = CONTROL_CAPTURE_FETCH,
+            .device_id = DEVICE_ID,
+            .index = index,
+        };
+        control_channel_send_to(addr, CONTROL_MSG_CAPTURE, &request, sizeof(request));
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FETCH_TIMEOUT_MS)) == 0) {
+            retries++;
+            continue;
+        }
+
+        portENTER_CRITICAL(&job_lock);
+        uint16_t size = chunk_size;
+        memcpy(local, chunk, size);
+        portEXIT_CRITICAL(&job_lock);
+
+        const control_capture_data_t *data = (const control_capture_data_t *)local;
+        if (size < sizeof(*data) || data->index < index) {
+            retries++;
+            continue;
+        }
+        retries = 0;
+
+        size_t offset = sizeof(*data);
+        for (uint8_t i = 0; i < data->count; i++) {
+            if (offset + sizeof(control_capture_record_t) > size) break;
+            const control_capture_record_t *rec =
+                (const control_capture_record_t *)&local[offset];
+            offset += sizeof(*rec);
+            if (offset + rec->caplen > size) break;
+            print_record(device_id, rec, &local[offset],
+                         unwrap_time(&last_us, &first, rec->time_us));
+            offset += rec->caplen;
+            printed++;
+        }
+        index = data->index + data->count;
+
+        if (data->flags & CONTROL_CAPTURE_LAST) {
+            ESP_LOGI(TAG, "Fetch from 0x%02x done (%lu records)", device_id,
+                     (unsigned long)printed);
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "Fetch from 0x%02x timed out after %lu records", device_id,
+             (unsigned long)printed);
+}
+
+// Spacing is kept to the tick (10 ms); the jitter buffer absorbs the rest
+static void replay(void)
+{
+    uint32_t end = claimed();
+    uint32_t injected = 0;
+    int64_t start_us = esp_timer_get_time();
+    int64_t first_us = 0;
+    int64_t last_us = 0;
+    bool first = true;
+
+    udp_transport_set_replay(true);
+
+    ESP_LOGI(TAG, "Replay start");
+    for (uint32_t i = oldest(end); i < end; i++) {
+        const capture_slot_t *slot = slot_at(i);
+        if (!slot || slot->rec.dir != PACKET_CAPTURE_RX || slot->rec.caplen != slot->rec.size) {
+            continue;
+        }
+
+        int64_t time_us = unwrap_time(&last_us, &first, slot->rec.time_us);
+        if (injected == 0) first_us = time_us;
+        int64_t wait_us = start_us + (time_us - first_us) - esp_timer_get_time();
+        if (wait_us >= 1000) {
+            vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+        }
+
+        udp_transport_inject(slot->data, slot->rec.size, slot->rec.addr);
+        injected++;
+    }
+
+    udp_transport_set_replay(false);
+    ESP_LOGI(TAG, "Replay end (%lu datagrams)", (unsigned long)injected);
+}
+
+static void capture_task(void *arg)
+{
+    // Writers that claimed a record before the freeze finish first
+    vTaskDelay(1);
+
+    switch (job) {
+    case JOB_DUMP:
+        dump_local();
+        break;
+    case JOB_NOTIFY:
+        notify_peer(job_addr);
+        break;
+    case JOB_FETCH:
+        fetch_peer(job_addr, job_device, job_index);
+        break;
+    case JOB_REPLAY:
+        replay();
+        break;
+    }
+
+    portENTER_CRITICAL(&job_lock);
+    busy = false;
+    task_handle = NULL;
+    portEXIT_CRITICAL(&job_lock);
+    task_map_exit(TASK_CAPTURE);
+}
+
+static esp_err_t start_job(capture_job_t type, uint32_t addr, uint8_t device_id,
+                           uint32_t index)
+{
+    portENTER_CRITICAL(&job_lock);
+    if (busy) {
+        portEXIT_CRITICAL(&job_lock);
+        ESP_LOGW(TAG, "Busy - request dropped");
+        return ESP_ERR_INVALID_STATE;
+    }
+    busy = true;
+    job = type;
+    job_addr = addr;
+    job_device = device_id;
+    job_index = index;
+    portEXIT_CRITICAL(&job_lock);
+
+    esp_err_t ret = task_map_create(TASK_CAPTURE, capture_task, NULL, &task_handle);
+    if (ret != ESP_OK) {
+        portENTER_CRITICAL(&job_lock);
+        busy = false;
+        portEXIT_CRITICAL(&job_lock);
+    }
+    return ret;
+}
+
+// remote: announce to addr for fetching instead of printing here.
+// Already frozen: the same capture is dumped or announced again.
+static void freeze(const char *reason, bool remote, uint32_t addr)
+{
+    if (recording) {
+        recording = false;
+        ESP_LOGW(TAG, "Frozen: %s", reason);
+    }
+    freeze_at_us = 0;
+    start_job(remote ? JOB_NOTIFY : JOB_DUMP, addr, DEVICE_ID, 0);
+}
+
+// RX task: answer a fetch with the records from the requested index on
+static void serve_fetch(uint32_t source_addr, uint32_t index)
+{
+    static uint8_t reply[CONTROL_MAX_PAYLOAD];
+    control_capture_data_t *data = (control_capture_data_t *)reply;
+    memset(data, 0, sizeof(*data));
+    data->device_id = DEVICE_ID;
+
+    size_t size = sizeof(*data);
+    uint32_t end = recording ? index : claimed();
+    if (index < oldest(end)) index = oldest(end);
+    data->index = index;
+
+    uint32_t i = index;
+    for (; i < end; i++) {
+        const capture_slot_t *slot = slot_at(i);
+        if (!slot) {
+            // Only at the start of a chunk, so the indices stay contiguous
+            if (data->count == 0) {
+                data->index = i + 1;
+                continue;
+            }
+            break;
+        }
+        size_t need = sizeof(slot->rec) + slot->rec.caplen;
+        if (size + need > sizeof(reply) || data->count == UINT8_MAX) break;
+        memcpy(&reply[size], &slot->rec, sizeof(slot->rec));
+        memcpy(&reply[size + sizeof(slot->rec)], slot->data, slot->rec.caplen);
+        size += need;
+        data->count++;
+    }
+    if (i >= end) {
+        data->flags |= CONTROL_CAPTURE_LAST;
+    }
+
+    control_channel_send_to(source_addr, CONTROL_MSG_CAPTURE_DATA, reply, (uint16_t)size);
+}
+
+static void capture_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    if (size < sizeof(control_capture_t)) return;
+
+    control_capture_t request;
+    memcpy(&request, payload, sizeof(request));
+
+    switch (request.op) {
+    case CONTROL_CAPTURE_FREEZE:
+        freeze("peer request", true, source_addr);
+        break;
+    case CONTROL_CAPTURE_RESTART:
+        packet_capture_restart();
+        break;
+    case CONTROL_CAPTURE_REPLAY:
+        packet_capture_replay();
+        break;
+    case CONTROL_CAPTURE_FETCH:
+        serve_fetch(source_addr, request.index);
+        break;
+    case CONTROL_CAPTURE_FROZEN:
+        start_job(JOB_FETCH, source_addr, request.device_id, request.index);
+        break;
+    default:
+        break;
+    }
+}
+
+static void data_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    if (size > sizeof(chunk)) return;
+
+    portENTER_CRITICAL(&job_lock);
+    bool wanted = busy && job == JOB_FETCH && source_addr == job_addr;
+    if (wanted) {
+        memcpy(chunk, payload, size);
+        chunk_size = size;
+    }
+    TaskHandle_t task = task_handle;
+    portEXIT_CRITICAL(&job_lock);
+
+    if (wanted && task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+#if PACKET_CAPTURE_ENABLE
+void packet_capture_record(packet_capture_dir_t dir, const void *data, size_t size,
+                           uint32_t addr)
+{
+    if (!recording) return;
+
+    uint32_t index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    capture_slot_t *slot = &slots[index % slot_count];
+    size_t caplen = size < PACKET_CAPTURE_SNAP_BYTES ? size : PACKET_CAPTURE_SNAP_BYTES;
+
+    __atomic_store_n(&slot->stamp, 0, __ATOMIC_RELAXED);
+    slot->rec.time_us = (uint32_t)esp_timer_get_time();
+    slot->rec.addr = addr;
+    slot->rec.size = (uint16_t)size;
+    slot->rec.dir = (uint8_t)dir;
+    slot->rec.caplen = (uint8_t)caplen;
+    memcpy(slot->data, data, caplen);
+    __atomic_store_n(&slot->stamp, index + 1, __ATOMIC_RELEASE);
+}
+#endif
+
+esp_err_t packet_capture_init(void)
+{
+    if (!PACKET_CAPTURE_ENABLE || initialized) {
+        return ESP_OK;
+    }
+
+    bool psram = mem_arena_bulk_is_psram();
+    size_t bytes = psram ? PACKET_CAPTURE_PSRAM_BYTES : PACKET_CAPTURE_INTERNAL_BYTES;
+    slots = mem_arena_alloc(MEM_ARENA_BULK, bytes, "packet_capture");
+    if (!slots) {
+        ESP_LOGE(TAG, "No memory for the capture ring");
+        return ESP_ERR_NO_MEM;
+    }
+    slot_count = bytes / sizeof(capture_slot_t);
+    memset(slots, 0, slot_count * sizeof(capture_slot_t));
+
+    control_channel_register(CONTROL_MSG_CAPTURE, capture_handler);
+    control_channel_register(CONTROL_MSG_CAPTURE_DATA, data_handler);
+
+    initialized = true;
+    recording = true;
+    ESP_LOGI(TAG, "Recording %lu packets in %s", (unsigned long)slot_count,
+             psram ? "PSRAM" : "internal RAM");
+    return ESP_OK;
+}
+
+void packet_capture_freeze(const char *reason)
+{
+    if (!initialized) return;
+
+    // A pack's console is usually not attached: the base prints it
+    freeze(reason, DEVICE_TYPE_PACK, TRANSPORT_ADDR_DEFAULT);
+}
+
+void packet_capture_restart(void)
+{
+    if (!initialized) return;
+
+    portENTER_CRITICAL(&job_lock);
+    bool idle = !busy;
+    portEXIT_CRITICAL(&job_lock);
+    if (!idle) {
+        ESP_LOGW(TAG, "Busy - not restarted");
+        return;
+    }
+
+    freeze_at_us = 0;
+    __atomic_store_n(&head, 0, __ATOMIC_RELEASE);
+    recording = true;
+    ESP_LOGI(TAG, "Recording again");
+}
+
+esp_err_t packet_capture_replay(void)
+{
+    if (!initialized || recording) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return start_job(JOB_REPLAY, 0, DEVICE_ID, 0);
+}
+
+esp_err_t packet_capture_request(uint32_t dest, uint8_t op)
+{
+    if (!initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    control_capture_t request = {
+        .op = op,
+        .device_id = DEVICE_ID,
+    };
+    return control_channel_send_to(dest, CONTROL_MSG_CAPTURE, &request, sizeof(request));
+}
+
+void packet_capture_tick(uint32_t underruns)
+{
+    if (!initialized) return;
+
+    int64_t now_us = esp_timer_get_time();
+    if (PACKET_CAPTURE_FREEZE_ON_UNDERRUN_MS > 0 && recording && freeze_at_us == 0 &&
+        underruns > last_underruns) {
+        freeze_at_us = now_us + (int64_t)PACKET_CAPTURE_FREEZE_ON_UNDERRUN_MS * 1000;
+        ESP_LOGI(TAG, "Underrun - freezing in %d ms", PACKET_CAPTURE_FREEZE_ON_UNDERRUN_MS);
+    }
+    last_underruns = underruns;
+
+    if (freeze_at_us != 0 && now_us >= freeze_at_us) {
+        freeze("jitter-buffer underrun", DEVICE_TYPE_PACK, TRANSPORT_ADDR_DEFAULT);
+    }
+}
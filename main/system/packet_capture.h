@@ -0,0 +1,97 @@
+/**
+ * @file packet_capture.h
+ * @brief Packet Capture and Replay (Flight Recorder)
+ *
+ * With PACKET_CAPTURE_ENABLE every datagram the transport receives or
+ * sends is kept in a ring of fixed-size records (PSRAM when the build
+ * has it): arrival or send time, peer address, direction and the first
+ * PACKET_CAPTURE_SNAP_BYTES of the datagram. Recording a packet claims a
+ * record with one atomic increment and copies the bytes; when compiled
+ * out the hooks are empty inlines.
+ *
+ * The ring is frozen on request or a short while after a jitter-buffer
+ * underrun, so the packets around a glitch are kept. A frozen ring is
+ * printed on the console as base64 pcap lines (the base) or streamed to
+ * the base over the control channel, which prints it the same way (a
+ * pack). Decode with:
+ *
+ *   grep -o 'PCAP [0-9a-f]*: .*' log | cut -d' ' -f3 | \
+ *       while read l; do echo "$l" | base64 -d; done > capture.pcap
+ *
+ * The result opens in Wireshark and replays through host/intercom_sim.
+ * Replay on the device feeds the received records back through the
+ * transport's receive path with their original spacing.
+ */
+
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "../config.h"
+
+typedef enum {
+    PACKET_CAPTURE_RX = 0,
+    PACKET_CAPTURE_TX,
+} packet_capture_dir_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+#if PACKET_CAPTURE_ENABLE
+/**
+ * @brief Record one datagram (any task, either core)
+ * @param addr Sender (RX) or destination (TX, 0 = broadcast)
+ */
+void packet_capture_record(packet_capture_dir_t dir, const void *data, size_t size,
+                           uint32_t addr);
+#else
+static inline void packet_capture_record(packet_capture_dir_t dir, const void *data,
+                                         size_t size, uint32_t addr)
+{
+    (void)dir;
+    (void)data;
+    (void)size;
+    (void)addr;
+}
+#endif
+
+/**
+ * @brief Allocate the ring, register the control messages and start recording
+ * @return ESP_OK on success (or when compiled out)
+ */
+esp_err_t packet_capture_init(void);
+
+/**
+ * @brief Freeze the ring now and dump it (console on the base, to the base on a pack)
+ */
+void packet_capture_freeze(const char *reason);
+
+/**
+ * @brief Discard the ring and record again
+ */
+void packet_capture_restart(void);
+
+/**
+ * @brief Feed the frozen ring's received records back through the RX path
+ * @return ESP_ERR_INVALID_STATE unless frozen and idle
+ */
+esp_err_t packet_capture_replay(void);
+
+/**
+ * @brief Ask a peer to freeze, restart, send or replay its capture
+ * @param dest Peer address (0 = every peer)
+ * @param op   CONTROL_CAPTURE_* operation
+ */
+esp_err_t packet_capture_request(uint32_t dest, uint8_t op);
+
+/**
+ * @brief Once a second: underrun trigger and post-roll
+ * @param underruns Receive jitter-buffer underrun count (worst stream)
+ */
+void packet_capture_tick(uint32_t underruns);
+
+#endif // PACKET_CAPTURE_H
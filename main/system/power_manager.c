@@ -1,42 +1,153 @@
 /**
  * @file power_manager.c
  * @brief Power Management Implementation
+ *
+ * State changes are serialised by one mutex, since activity can come from
+ * the RX task (voice), the button task and the monitor at
+ * once. Each change closes the books on the old state (its time and the
+ * audio engine's busy time since it began) and sets the new CPU ceiling
+ * with esp_pm_configure; light sleep itself is left to ESP-IDF, which
+ * takes it whenever no lock is held. While streaming the I2S and ADC
+ * drivers hold the APB lock, so the chip only actually sleeps in idle,
+ * once both are stopped.
  */
 
 #include "power_manager.h"
 #include "../config.h"
+#include "../network/wifi_manager.h"
 
 #if DEVICE_TYPE_PACK
 
+#include "../audio/audio_engine.h"
+#include "../hardware/adc_service.h"
 #include "esp_sleep.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_pm.h"
 #include "esp_timer.h"
+#include "sdkconfig.h"
 #include "driver/gpio.h"
 #include "driver/rtc_io.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
 
 static const char *TAG = "POWER";
 
-static power_state_t current_state = POWER_STATE_ACTIVE;
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static const char *state_names[POWER_STATE_COUNT] = {
+    [POWER_STATE_LISTEN]     = "listen",
+    [POWER_STATE_TALK]       = "talk",
+    [POWER_STATE_IDLE]       = "idle",
+    [POWER_STATE_DEEP_SLEEP] = "deep sleep",
+};
+
+static const int state_cpu_mhz[POWER_STATE_COUNT] = {
+    [POWER_STATE_LISTEN]     = POWER_LISTEN_CPU_MHZ,
+    [POWER_STATE_TALK]       = POWER_TALK_CPU_MHZ,
+    [POWER_STATE_IDLE]       = POWER_IDLE_CPU_MHZ,
+    [POWER_STATE_DEEP_SLEEP] = POWER_IDLE_CPU_MHZ,
+};
+
+static SemaphoreHandle_t state_mutex = NULL;
+static volatile power_state_t current_state = POWER_STATE_LISTEN;
 static power_state_callback_t user_callback = NULL;
-static int64_t last_activity_time = 0;
+static volatile int64_t last_activity_time = 0;
+static bool talking = false;
+
+// Accounting (under state_mutex)
+static power_stats_t stats = {0};
+static int64_t state_since_us = 0;
+static uint64_t state_busy_from_us = 0;
 
-static void set_state(power_state_t new_state)
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void apply_clock(power_state_t state)
 {
-    if (current_state != new_state) {
-        current_state = new_state;
-        if (user_callback) {
-            user_callback(new_state);
-        }
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = state_cpu_mhz[state],
+        .min_freq_mhz = POWER_MIN_CPU_MHZ,
+        .light_sleep_enable = ENABLE_LIGHT_SLEEP,
+    };
+    esp_err_t ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "DFS %d-%d MHz not applied: %s", POWER_MIN_CPU_MHZ,
+                 state_cpu_mhz[state], esp_err_to_name(ret));
     }
+#else
+    (void)state;
+#endif
 }
 
+// Add the time since the last call to the current state. Called with
+// state_mutex held
+static void account(void)
+{
+    int64_t now_us = esp_timer_get_time();
+    uint64_t busy_us = audio_engine_busy_us();
+
+    power_state_stats_t *s = &stats.state[current_state];
+    s->time_ms += (uint32_t)((now_us - state_since_us) / 1000);
+    s->audio_busy_ms += (uint32_t)((busy_us - state_busy_from_us) / 1000);
+
+    // Keep the sub-millisecond remainders for next time
+    state_since_us = now_us - (now_us - state_since_us) % 1000;
+    state_busy_from_us = busy_us - (busy_us - state_busy_from_us) % 1000;
+}
+
+// Called with state_mutex held. True if the state changed
+static bool set_state(power_state_t new_state)
+{
+    if (current_state == new_state) {
+        return false;
+    }
+
+    account();
+    apply_clock(new_state);
+    current_state = new_state;
+    stats.state[new_state].entries++;
+    return true;
+}
+
+static void notify(power_state_t state)
+{
+    if (user_callback) {
+        user_callback(state);
+    }
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
 esp_err_t power_manager_init(power_state_callback_t callback)
 {
     user_callback = callback;
-    current_state = POWER_STATE_ACTIVE;
     last_activity_time = esp_timer_get_time() / 1000;
 
+    if (!state_mutex) {
+        state_mutex = xSemaphoreCreateMutex();
+        if (!state_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    current_state = POWER_STATE_LISTEN;
+    memset(&stats, 0, sizeof(stats));
+    stats.state[POWER_STATE_LISTEN].entries = 1;
+    state_since_us = esp_timer_get_time();
+    state_busy_from_us = audio_engine_busy_us();
+    apply_clock(POWER_STATE_LISTEN);
+    xSemaphoreGive(state_mutex);
+
     // Configure GPIO wake sources for deep sleep
     // Both PTT and CALL buttons can wake from deep sleep
     // Use ext1 to support multiple GPIO wake sources
@@ -49,8 +160,10 @@ esp_err_t power_manager_init(power_state_callback_t callback)
     esp_sleep_enable_gpio_wakeup();
     esp_sleep_enable_wifi_wakeup();
 
-    ESP_LOGI(TAG, "Power manager initialized (light=%ds, deep=%dmin)",
-             LIGHT_SLEEP_TIMEOUT_SEC, DEEP_SLEEP_TIMEOUT_MIN);
+    ESP_LOGI(TAG, "Power manager initialized (talk/listen/idle %d/%d/%d MHz, min %d, "
+             "idle=%ds, deep=%dmin)", POWER_TALK_CPU_MHZ, POWER_LISTEN_CPU_MHZ,
+             POWER_IDLE_CPU_MHZ, POWER_MIN_CPU_MHZ, LIGHT_SLEEP_TIMEOUT_SEC,
+             DEEP_SLEEP_TIMEOUT_MIN);
 
     return ESP_OK;
 }
@@ -58,20 +171,60 @@ esp_err_t power_manager_init(power_state_callback_t callback)
 void power_manager_activity(void)
 {
     last_activity_time = esp_timer_get_time() / 1000;
+    wifi_manager_set_link_idle(false);
+    power_manager_wake();
+}
+
+void power_manager_wake(void)
+{
+    // Per received frame: only waking from idle costs anything
+    if (current_state != POWER_STATE_IDLE || !state_mutex) {
+        return;
+    }
 
-    if (current_state != POWER_STATE_ACTIVE) {
-        set_state(POWER_STATE_ACTIVE);
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    bool woke = current_state == POWER_STATE_IDLE &&
+                set_state(talking ? POWER_STATE_TALK : POWER_STATE_LISTEN);
+    power_state_t state = current_state;
+    if (woke) {
+        // Playout state is reset by the callback before frames flow again
+        notify(state);
+        adc_service_suspend(false);
+        audio_engine_suspend(false);
     }
+    xSemaphoreGive(state_mutex);
 }
 
-void power_manager_check_timeout(bool *light_sleep, bool *deep_sleep)
+void power_manager_set_talking(bool now_talking)
+{
+    if (!state_mutex) return;
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    talking = now_talking;
+    bool changed = false;
+    if (current_state == POWER_STATE_LISTEN || current_state == POWER_STATE_TALK) {
+        changed = set_state(talking ? POWER_STATE_TALK : POWER_STATE_LISTEN);
+    }
+    power_state_t state = current_state;
+    xSemaphoreGive(state_mutex);
+
+    if (changed) {
+        notify(state);
+    }
+}
+
+void power_manager_check_timeout(bool *idle, bool *deep_sleep)
 {
     int64_t now = esp_timer_get_time() / 1000;
     int64_t idle_time = now - last_activity_time;
 
-    if (light_sleep) {
-        *light_sleep = ENABLE_LIGHT_SLEEP &&
-                       (idle_time >= (int64_t)LIGHT_SLEEP_TIMEOUT_SEC * 1000);
+    if (idle_time >= WIFI_PS_IDLE_MS) {
+        wifi_manager_set_link_idle(true);
+    }
+
+    if (idle) {
+        *idle = ENABLE_LIGHT_SLEEP && current_state != POWER_STATE_IDLE &&
+                (idle_time >= (int64_t)LIGHT_SLEEP_TIMEOUT_SEC * 1000);
     }
     if (deep_sleep) {
         *deep_sleep = ENABLE_DEEP_SLEEP &&
@@ -79,25 +232,39 @@ void power_manager_check_timeout(bool *light_sleep, bool *deep_sleep)
     }
 }
 
-esp_err_t power_manager_enter_light_sleep(void)
+esp_err_t power_manager_enter_idle(void)
 {
-    set_state(POWER_STATE_LIGHT_SLEEP);
-
-    // Light sleep keeps WiFi connected (auto light sleep)
-    // CPU halts but wakes on: button press, WiFi packet, or timer
-    esp_light_sleep_start();
+    if (!state_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    // Woke up
-    set_state(POWER_STATE_ACTIVE);
-    power_manager_activity();
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    bool changed = current_state != POWER_STATE_DEEP_SLEEP && set_state(POWER_STATE_IDLE);
+    if (changed) {
+        // Nothing may hold a lock: I2S, ADC DMA and the radio all let go
+        ESP_LOGI(TAG, "Idle: audio off, light sleep between beacons");
+        audio_engine_suspend(true);
+        adc_service_suspend(true);
+        wifi_manager_set_link_idle(true);
+    }
+    xSemaphoreGive(state_mutex);
 
+    if (changed) {
+        notify(POWER_STATE_IDLE);
+    }
     return ESP_OK;
 }
 
 esp_err_t power_manager_enter_deep_sleep(void)
 {
     ESP_LOGI(TAG, "Entering deep sleep (wake: PTT or CALL button)");
-    set_state(POWER_STATE_DEEP_SLEEP);
+
+    if (state_mutex) {
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        set_state(POWER_STATE_DEEP_SLEEP);
+        xSemaphoreGive(state_mutex);
+    }
+    notify(POWER_STATE_DEEP_SLEEP);
 
     // Deep sleep - device resets on wake
     esp_deep_sleep_start();
@@ -116,4 +283,51 @@ uint32_t power_manager_get_idle_time(void)
     return (uint32_t)(now - last_activity_time);
 }
 
+void power_manager_get_stats(power_stats_t *stats_out)
+{
+    if (!stats_out) return;
+
+    if (!state_mutex) {
+        memset(stats_out, 0, sizeof(*stats_out));
+        return;
+    }
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    account();
+    *stats_out = stats;
+    xSemaphoreGive(state_mutex);
+}
+
+void power_manager_print_status(void)
+{
+    power_stats_t s;
+    power_manager_get_stats(&s);
+
+    uint64_t total_ms = 0;
+    for (int i = 0; i < POWER_STATE_COUNT; i++) {
+        total_ms += s.state[i].time_ms;
+    }
+    if (total_ms == 0) return;
+
+    // Share of uptime per state; audio duty is the engine's busy time
+    // within the state, i.e. how long the CPU sat at that state's ceiling
+    char line[160];
+    int len = 0;
+    for (int i = 0; i < POWER_STATE_IDLE + 1 && len < (int)sizeof(line); i++) {
+        const power_state_stats_t *st = &s.state[i];
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %.1f%% (audio %.1f%%)",
+                        len ? ", " : "", state_names[i],
+                        100.0f * (float)st->time_ms / (float)total_ms,
+                        st->time_ms ? 100.0f * (float)st->audio_busy_ms / (float)st->time_ms
+                                    : 0.0f);
+    }
+    ESP_LOGI(TAG, "Power: %s over %lu s, now %s", line,
+             (unsigned long)(total_ms / 1000), state_names[current_state]);
+
+#if CONFIG_PM_PROFILING
+    // Time actually spent in light sleep and at each clock, per ESP-IDF
+    esp_pm_dump_locks(stdout);
+#endif
+}
+
 #endif // DEVICE_TYPE_PACK
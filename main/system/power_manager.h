@@ -2,9 +2,22 @@
  * @file power_manager.h
  * @brief Power Management and Sleep Modes (Belt Pack)
  *
- * Light sleep: CPU halts, WiFi stays connected, wakes on button or packet.
- *              Invisible to user except possible minor latency.
+ * Built on ESP-IDF power management: dynamic frequency scaling with the
+ * CPU ceiling set per state, and automatic light sleep whenever no
+ * driver holds a lock.
+ *
+ * Talk:        PTT on. Highest CPU ceiling (encode every frame).
+ * Listen:      Receiving. Lower ceiling; the audio engine takes the clock
+ *              up only for its pass in each frame.
+ * Idle:        LIGHT_SLEEP_TIMEOUT_SEC without activity. Audio engine and
+ *              ADC scan stopped, WiFi in modem sleep, so the chip sleeps
+ *              between beacons. Voice, a button or an alert wakes it.
  * Deep sleep:  Full shutdown, device resets on wake (PTT or CALL button).
+ * Modem sleep: WiFi power save only, WIFI_PS_IDLE_MS after the last
+ *              activity; any activity turns it off again.
+ *
+ * Time in each state and the audio engine's busy time within it are
+ * counted, for the duty cycle per state.
  */
 
 #ifndef POWER_MANAGER_H
@@ -15,19 +28,66 @@
 #include "esp_err.h"
 
 typedef enum {
-    POWER_STATE_ACTIVE = 0,
-    POWER_STATE_LIGHT_SLEEP,
-    POWER_STATE_DEEP_SLEEP
+    POWER_STATE_LISTEN = 0,
+    POWER_STATE_TALK,
+    POWER_STATE_IDLE,
+    POWER_STATE_DEEP_SLEEP,
+    POWER_STATE_COUNT
 } power_state_t;
 
+typedef struct {
+    uint32_t entries;            // Times the state was entered
+    uint32_t time_ms;            // Time spent in it
+    uint32_t audio_busy_ms;      // Audio engine passes (CPU at the ceiling) within it
+} power_state_stats_t;
+
+typedef struct {
+    power_state_stats_t state[POWER_STATE_COUNT];
+} power_stats_t;
+
+/**
+ * @brief Called on each state change. Leaving idle, it runs before the
+ *        audio engine restarts
+ */
 typedef void (*power_state_callback_t)(power_state_t state);
 
 esp_err_t power_manager_init(power_state_callback_t callback);
+
+/**
+ * @brief Note user or audio activity (any task); wakes the pack from idle
+ */
 void power_manager_activity(void);
-void power_manager_check_timeout(bool *light_sleep, bool *deep_sleep);
-esp_err_t power_manager_enter_light_sleep(void);
+
+/**
+ * @brief Leave idle without counting as activity (e.g. to play an alert);
+ *        the idle timeout puts the pack back once it is quiet again
+ */
+void power_manager_wake(void);
+
+/**
+ * @brief PTT transmit state, for the talk/listen clock ceiling
+ */
+void power_manager_set_talking(bool talking);
+
+void power_manager_check_timeout(bool *idle, bool *deep_sleep);
+
+/**
+ * @brief Stop audio and let the chip light-sleep until the next activity
+ */
+esp_err_t power_manager_enter_idle(void);
 esp_err_t power_manager_enter_deep_sleep(void);
 power_state_t power_manager_get_state(void);
 uint32_t power_manager_get_idle_time(void);
 
+/**
+ * @brief Time and audio duty per state, including the current one so far
+ */
+void power_manager_get_stats(power_stats_t *stats);
+
+/**
+ * @brief Log time share and audio duty per state (and, with
+ *        CONFIG_PM_PROFILING, ESP-IDF's own lock and mode statistics)
+ */
+void power_manager_print_status(void);
+
 #endif // POWER_MANAGER_H
@@ -0,0 +1,848 @@
+/**
+ * @file settings.c
+ * @brief Run-Time Settings Implementation
+ *
+ * Values live in one table, written under a mutex by the console task and
+ * the UDP RX task (remote requests) and read without it: each is one
+ * aligned 32-bit word. Floats are saved as their bit pattern (u32); the
+ * link options keep the u8 keys udp_transport reads at boot, so a value
+ * saved here is exactly what it will load.
+ *
+ * A change is applied before it is saved; if the module rejects it (e.g.
+ * a jitter floor above the starting depth) the old value stays and
+ * nothing is written. Writes are queued per setting for TASK_SETTINGS:
+ * nvs_commit stalls both cores while the flash is busy, which the RX
+ * task (quarter-frame deadline) must not sit through - least of all for
+ * a CONTROL_SETTING_ALL request that every device takes at once.
+ */
+
+#include "settings.h"
+#include "task_map.h"
+#include "../config.h"
+#include "../audio/audio_codec.h"
+#include "../audio/audio_jitter_buffer.h"
+#include "../audio/audio_processor.h"
+#include "../audio/audio_rate_control.h"
+#include "../hardware/clearcom_line.h"
+#include "../network/channel_manager.h"
+#include "../network/control_channel.h"
+#include "../network/udp_transport.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#if SETTINGS_CONSOLE_ENABLE && CONFIG_ESP_CONSOLE_UART
+#include "esp_console.h"
+#include "driver/uart.h"
+#include "driver/uart_vfs.h"
+#define CONSOLE_ENABLED         1
+#else
+#define CONSOLE_ENABLED         0
+#endif
+
+static const char *TAG = "SETTINGS";
+
+#if DEVICE_TYPE_BASE
+#define INPUT_GAIN_DEFAULT      PARTYLINE_INPUT_GAIN
+#define LINE_OUTPUT_GAIN_DEFAULT PARTYLINE_OUTPUT_GAIN
+#define SIDETONE_DEFAULT        0.0f
+#else
+#define INPUT_GAIN_DEFAULT      MIC_GAIN_LEVEL
+#define LINE_OUTPUT_GAIN_DEFAULT 0
+#define SIDETONE_DEFAULT        (SIDETONE_ENABLE ? SIDETONE_LEVEL : 0.0f)
+#endif
+
+// Longest console line (command and arguments)
+#define CONSOLE_LINE_MAX        96
+
+//=============================================================================
+// TYPES
+//=============================================================================
+
+typedef enum {
+    SETTING_TYPE_INT = 0,
+    SETTING_TYPE_BOOL,
+    SETTING_TYPE_FLOAT,
+} setting_type_t;
+
+typedef union {
+    int32_t i;
+    float   f;
+} setting_value_t;
+
+typedef struct {
+    const char     *name;            // Console name and NVS key (15 chars at most)
+    const char     *nvs_namespace;
+    setting_type_t  type;
+    bool            nvs_u8;          // Saved as a u8 (udp_transport's keys)
+    bool            available;       // Meaningful on this device
+    setting_value_t def;
+    setting_value_t min;
+    setting_value_t max;
+    esp_err_t     (*apply)(void);    // NULL: read once at boot
+    const char     *help;
+} setting_entry_t;
+
+//=============================================================================
+// APPLY
+//=============================================================================
+
+static setting_value_t values[SETTING_COUNT];
+
+static esp_err_t apply_encoder(void)
+{
+    return audio_rate_control_set_limits(values[SETTING_BITRATE].i,
+                                         values[SETTING_COMPLEXITY].i);
+}
+
+static esp_err_t apply_jitter(void)
+{
+    return jitter_buffer_set_depth_range(
+        (size_t)(values[SETTING_JITTER_MIN_MS].i / FRAME_SIZE_MS),
+        (size_t)(values[SETTING_JITTER_START_MS].i / FRAME_SIZE_MS),
+        (size_t)(values[SETTING_JITTER_MAX_MS].i / FRAME_SIZE_MS));
+}
+
+static esp_err_t apply_limiter(void)
+{
+    audio_processor_set_limiter_threshold(values[SETTING_LIMITER].f);
+    return ESP_OK;
+}
+
+static esp_err_t apply_input_gain(void)
+{
+#if DEVICE_TYPE_BASE
+    clearcom_line_set_input_gain((uint8_t)values[SETTING_INPUT_GAIN].i);
+    return ESP_OK;
+#else
+    return audio_codec_set_input_gain((uint8_t)values[SETTING_INPUT_GAIN].i);
+#endif
+}
+
+static esp_err_t apply_line_output_gain(void)
+{
+#if DEVICE_TYPE_BASE
+    clearcom_line_set_output_gain((uint8_t)values[SETTING_LINE_OUTPUT_GAIN].i);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+// 0 hands the channel back to the survey and the hopping, from where it is.
+// The move itself waits for the monitor task (may be applied on the RX task)
+static esp_err_t apply_channel(void)
+{
+    uint8_t channel = (uint8_t)values[SETTING_CHANNEL].i;
+    return channel ? channel_manager_request(channel) : ESP_OK;
+}
+
+static esp_err_t apply_low_latency(void)
+{
+    udp_transport_set_low_latency(values[SETTING_LOW_LATENCY].i != 0);
+    return ESP_OK;
+}
+
+static esp_err_t apply_sidetone(void)
+{
+    float level = values[SETTING_SIDETONE].f;
+    return audio_codec_set_sidetone(level > 0.0f, level);
+}
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static const setting_entry_t entries[SETTING_COUNT] = {
+    [SETTING_BITRATE] = {
+        .name = "bitrate", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = true,
+        .def.i = OPUS_BITRATE, .min.i = RATE_CONTROL_MIN_BITRATE, .max.i = SETTINGS_BITRATE_MAX,
+        .apply = apply_encoder, .help = "Encoder bitrate ceiling (bps)",
+    },
+    [SETTING_COMPLEXITY] = {
+        .name = "complexity", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = true,
+        .def.i = OPUS_COMPLEXITY, .min.i = RATE_CONTROL_MIN_COMPLEXITY, .max.i = 10,
+        .apply = apply_encoder, .help = "Encoder complexity ceiling",
+    },
+    [SETTING_JITTER_MIN_MS] = {
+        .name = "jb_min_ms", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = true,
+        .def.i = JITTER_BUFFER_MIN_MS, .min.i = FRAME_SIZE_MS, .max.i = JITTER_BUFFER_MAX_MS,
+        .apply = apply_jitter, .help = "Jitter buffer floor (ms)",
+    },
+    [SETTING_JITTER_START_MS] = {
+        .name = "jb_ms", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = true,
+        .def.i = JITTER_BUFFER_MS, .min.i = FRAME_SIZE_MS, .max.i = JITTER_BUFFER_MAX_MS,
+        .apply = apply_jitter, .help = "Jitter buffer starting depth (ms, next stream)",
+    },
+    [SETTING_JITTER_MAX_MS] = {
+        .name = "jb_max_ms", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = true,
+        .def.i = JITTER_BUFFER_MAX_MS, .min.i = FRAME_SIZE_MS, .max.i = JITTER_BUFFER_MAX_MS,
+        .apply = apply_jitter, .help = "Jitter buffer ceiling (ms)",
+    },
+    [SETTING_LIMITER] = {
+        .name = "limiter", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_FLOAT, .available = true,
+        .def.f = LIMITER_THRESHOLD, .min.f = 0.1f, .max.f = 1.0f,
+        .apply = apply_limiter, .help = "Limiter ceiling (full scale)",
+    },
+    [SETTING_INPUT_GAIN] = {
+        .name = "in_gain", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = true,
+        .def.i = INPUT_GAIN_DEFAULT, .min.i = 0, .max.i = 31,
+        .apply = apply_input_gain, .help = "Input PGA (0-31, mic or party line)",
+    },
+    [SETTING_LINE_OUTPUT_GAIN] = {
+        .name = "line_out_gain", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = DEVICE_TYPE_BASE,
+        .def.i = LINE_OUTPUT_GAIN_DEFAULT, .min.i = 0, .max.i = 31,
+        .apply = apply_line_output_gain, .help = "Party-line output level (0-31)",
+    },
+    [SETTING_CHANNEL] = {
+        .name = "channel", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .available = DEVICE_TYPE_BASE,
+        .def.i = 0, .min.i = 0, .max.i = 13,
+        .apply = apply_channel, .help = "AP channel (0 = survey and hop)",
+    },
+    [SETTING_LOW_LATENCY] = {
+        .name = LINK_LOW_LATENCY_NVS_KEY, .nvs_namespace = TRANSPORT_NVS_NAMESPACE,
+        .type = SETTING_TYPE_BOOL, .nvs_u8 = true, .available = true,
+        .def.i = LINK_LOW_LATENCY, .min.i = 0, .max.i = 1,
+        .apply = apply_low_latency, .help = "Low-latency link (IFB/cue)",
+    },
+    [SETTING_BUNDLE] = {
+        .name = BUNDLE_NVS_KEY, .nvs_namespace = TRANSPORT_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .nvs_u8 = true, .available = true,
+        .def.i = BUNDLE_MODE, .min.i = BUNDLE_LOW_LATENCY, .max.i = BUNDLE_ROBUST,
+        .apply = NULL, .help = "Frames per datagram (BUNDLE_*)",
+    },
+    [SETTING_BACKEND] = {
+        .name = TRANSPORT_NVS_KEY, .nvs_namespace = TRANSPORT_NVS_NAMESPACE,
+        .type = SETTING_TYPE_INT, .nvs_u8 = true, .available = true,
+        .def.i = TRANSPORT_BACKEND, .min.i = TRANSPORT_LWIP, .max.i = TRANSPORT_ESPNOW,
+        .apply = NULL, .help = "Link backend (0 = UDP, 1 = ESP-NOW)",
+    },
+    [SETTING_SIDETONE] = {
+        .name = "sidetone", .nvs_namespace = SETTINGS_NVS_NAMESPACE,
+        .type = SETTING_TYPE_FLOAT, .available = DEVICE_TYPE_PACK,
+        .def.f = SIDETONE_DEFAULT, .min.f = 0.0f, .max.f = 1.0f,
+        .apply = apply_sidetone, .help = "Sidetone level (0 = off, 3 dB steps)",
+    },
+};
+
+static SemaphoreHandle_t lock = NULL;
+static bool saved[SETTING_COUNT];
+static bool started = false;
+
+// NVS writes not yet made (under lock): one per setting, newest wins
+static TaskHandle_t store_handle = NULL;
+static uint32_t store_pending = 0;
+static uint32_t store_erase = 0;
+static setting_value_t store_values[SETTING_COUNT];
+
+_Static_assert(SETTING_COUNT <= 32, "store_pending is one bit per setting");
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static bool in_range(const setting_entry_t *e, setting_value_t v)
+{
+    if (e->type == SETTING_TYPE_FLOAT) {
+        return v.f >= e->min.f && v.f <= e->max.f;   // false for NaN
+    }
+    return v.i >= e->min.i && v.i <= e->max.i;
+}
+
+static void format_value(const setting_entry_t *e, setting_value_t v, char *buf, size_t size)
+{
+    switch (e->type) {
+    case SETTING_TYPE_FLOAT:
+        snprintf(buf, size, "%.3f", v.f);
+        break;
+    case SETTING_TYPE_BOOL:
+        snprintf(buf, size, "%s", v.i ? "on" : "off");
+        break;
+    default:
+        snprintf(buf, size, "%ld", (long)v.i);
+        break;
+    }
+}
+
+static esp_err_t parse_value(const setting_entry_t *e, const char *text, setting_value_t *out)
+{
+    if (!text || !*text) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (e->type == SETTING_TYPE_BOOL) {
+        if (!strcasecmp(text, "on") || !strcasecmp(text, "true")) {
+            out->i = 1;
+            return ESP_OK;
+        }
+        if (!strcasecmp(text, "off") || !strcasecmp(text, "false")) {
+            out->i = 0;
+            return ESP_OK;
+        }
+    }
+
+    char *end = NULL;
+    if (e->type == SETTING_TYPE_FLOAT) {
+        out->f = strtof(text, &end);
+    } else {
+        out->i = (int32_t)strtol(text, &end, 0);
+    }
+    return (end != text && *end == '\0') ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static esp_err_t nvs_store(const setting_entry_t *e, setting_value_t v, bool erase)
+{
+    nvs_handle_t nvs;
+    esp_err_t ret = nvs_open(e->nvs_namespace, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (erase) {
+        ret = nvs_erase_key(nvs, e->name);
+        if (ret == ESP_ERR_NVS_NOT_FOUND) {
+            ret = ESP_OK;
+        }
+    } else if (e->nvs_u8) {
+        ret = nvs_set_u8(nvs, e->name, (uint8_t)v.i);
+    } else if (e->type == SETTING_TYPE_FLOAT) {
+        uint32_t bits;
+        memcpy(&bits, &v.f, sizeof(bits));
+        ret = nvs_set_u32(nvs, e->name, bits);
+    } else {
+        ret = nvs_set_i32(nvs, e->name, v.i);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return ret;
+}
+
+static bool nvs_load(const setting_entry_t *e, setting_value_t *out)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(e->nvs_namespace, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+
+    esp_err_t ret;
+    if (e->nvs_u8) {
+        uint8_t value;
+        ret = nvs_get_u8(nvs, e->name, &value);
+        out->i = value;
+    } else if (e->type == SETTING_TYPE_FLOAT) {
+        uint32_t bits;
+        ret = nvs_get_u32(nvs, e->name, &bits);
+        memcpy(&out->f, &bits, sizeof(bits));
+    } else {
+        ret = nvs_get_i32(nvs, e->name, &out->i);
+    }
+    nvs_close(nvs);
+    return ret == ESP_OK;
+}
+
+// Called with lock held. Without the writer task the write is made now.
+static esp_err_t queue_store(setting_id_t id, setting_value_t value, bool erase)
+{
+    if (!store_handle) {
+        return nvs_store(&entries[id], value, erase);
+    }
+
+    store_values[id] = value;
+    store_pending |= 1u << id;
+    if (erase) {
+        store_erase |= 1u << id;
+    } else {
+        store_erase &= ~(1u << id);
+    }
+    xTaskNotifyGive(store_handle);
+    return ESP_OK;
+}
+
+static void store_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(lock, portMAX_DELAY);
+        uint32_t pending = store_pending;
+        uint32_t erase = store_erase;
+        setting_value_t snapshot[SETTING_COUNT];
+        memcpy(snapshot, store_values, sizeof(snapshot));
+        store_pending = 0;
+        xSemaphoreGive(lock);
+
+        for (int i = 0; pending != 0; i++, pending >>= 1, erase >>= 1) {
+            if (!(pending & 1)) continue;
+
+            esp_err_t ret = nvs_store(&entries[i], snapshot[i], erase & 1);
+            if (ret != ESP_OK) {
+                ESP_LOGW(TAG, "%s not saved: %s", entries[i].name, esp_err_to_name(ret));
+            }
+        }
+    }
+}
+
+// Apply, then save or forget. Old value kept if the module refuses
+static esp_err_t change(setting_id_t id, setting_value_t value, bool save, bool forget)
+{
+    const setting_entry_t *e = &entries[id];
+    if (!e->available) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!in_range(e, value)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!e->apply && !save && !forget) {
+        return ESP_ERR_NOT_SUPPORTED;   // Read at boot only: nothing to try
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    setting_value_t old = values[id];
+    values[id] = value;
+
+    esp_err_t ret = ESP_OK;
+    if (e->apply && started) {
+        ret = e->apply();
+    }
+    if (ret != ESP_OK) {
+        values[id] = old;
+    } else if (save || forget) {
+        ret = queue_store(id, value, forget);
+        if (ret == ESP_OK) {
+            saved[id] = save;
+        }
+    }
+    xSemaphoreGive(lock);
+
+    char text[16];
+    format_value(e, value, text, sizeof(text));
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "%s = %s%s", e->name, text,
+                 !e->apply ? " (from next boot)" : save ? " (saved)" : forget ? " (default)" : "");
+    } else {
+        ESP_LOGW(TAG, "%s = %s refused: %s", e->name, text, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void setting_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    if (size < sizeof(control_setting_t)) {
+        return;
+    }
+
+    control_setting_t msg;
+    memcpy(&msg, payload, sizeof(msg));
+
+    if (msg.op == CONTROL_SETTING_VALUE) {
+        if (msg.target != DEVICE_ID) {
+            return;
+        }
+        if (msg.id >= SETTING_COUNT) {
+            ESP_LOGW(TAG, "Device 0x%02X: setting %u unknown", msg.device_id, msg.id);
+            return;
+        }
+        char text[16];
+        setting_value_t value = { .i = msg.value };
+        format_value(&entries[msg.id], value, text, sizeof(text));
+        ESP_LOGI(TAG, "Device 0x%02X: %s = %s%s%s", msg.device_id, entries[msg.id].name, text,
+                 msg.status ? " - " : "", msg.status ? esp_err_to_name(msg.status) : "");
+        return;
+    }
+
+    if (msg.target != DEVICE_ID && msg.target != CONTROL_SETTING_ALL) {
+        return;
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (msg.id >= SETTING_COUNT) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else if (!entries[msg.id].available) {
+        ret = ESP_ERR_NOT_SUPPORTED;
+    } else if (msg.op == CONTROL_SETTING_TRY || msg.op == CONTROL_SETTING_SET) {
+        setting_value_t value = { .i = msg.value };
+        ret = change((setting_id_t)msg.id, value, msg.op == CONTROL_SETTING_SET, false);
+    } else if (msg.op == CONTROL_SETTING_RESET) {
+        ret = settings_reset((setting_id_t)msg.id);
+    } else if (msg.op != CONTROL_SETTING_GET) {
+        ret = ESP_ERR_INVALID_ARG;
+    }
+
+    control_setting_t answer = {
+        .op = CONTROL_SETTING_VALUE,
+        .device_id = DEVICE_ID,
+        .target = msg.device_id,
+        .id = msg.id,
+        .value = msg.id < SETTING_COUNT ? values[msg.id].i : 0,
+        .status = (uint16_t)ret,
+    };
+    control_channel_send_to(source_addr, CONTROL_MSG_SETTING, &answer, sizeof(answer));
+}
+
+#if CONSOLE_ENABLED
+
+static int console_error(esp_err_t ret)
+{
+    if (ret != ESP_OK) {
+        printf("%s\n", esp_err_to_name(ret));
+    }
+    return ret == ESP_OK ? 0 : 1;
+}
+
+static int console_find(const char *name, setting_id_t *id)
+{
+    if (settings_find(name, id) != ESP_OK) {
+        printf("No setting \"%s\" (see \"settings\")\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_settings(int argc, char **argv)
+{
+    settings_print();
+    return 0;
+}
+
+static int cmd_get(int argc, char **argv)
+{
+    setting_id_t id;
+    if (argc != 2) {
+        printf("usage: get <name>\n");
+        return 1;
+    }
+    if (console_find(argv[1], &id)) {
+        return 1;
+    }
+
+    char text[16];
+    format_value(&entries[id], values[id], text, sizeof(text));
+    printf("%s = %s\n", entries[id].name, text);
+    return 0;
+}
+
+static int cmd_set(int argc, char **argv)
+{
+    bool save = strcmp(argv[0], "set") == 0;
+    setting_id_t id;
+    if (argc != 3) {
+        printf("usage: %s <name> <value>\n", argv[0]);
+        return 1;
+    }
+    if (console_find(argv[1], &id)) {
+        return 1;
+    }
+    return console_error(settings_set_text(id, argv[2], save));
+}
+
+static int cmd_reset(int argc, char **argv)
+{
+    setting_id_t id;
+    if (argc != 2) {
+        printf("usage: reset <name|all>\n");
+        return 1;
+    }
+
+    if (strcmp(argv[1], "all") == 0) {
+        esp_err_t ret = ESP_OK;
+        for (int i = 0; i < SETTING_COUNT; i++) {
+            if (entries[i].available && settings_reset((setting_id_t)i) != ESP_OK) {
+                ret = ESP_FAIL;
+            }
+        }
+        return console_error(ret);
+    }
+    if (console_find(argv[1], &id)) {
+        return 1;
+    }
+    return console_error(settings_reset(id));
+}
+
+static int cmd_remote(int argc, char **argv)
+{
+    static const char *ops[] = {
+        [CONTROL_SETTING_GET] = "get", [CONTROL_SETTING_TRY] = "try",
+        [CONTROL_SETTING_SET] = "set", [CONTROL_SETTING_RESET] = "reset",
+    };
+
+    if (argc < 4) {
+        printf("usage: remote <device id|all> get|try|set|reset <name> [value]\n");
+        return 1;
+    }
+
+    uint8_t target = CONTROL_SETTING_ALL;
+    if (strcmp(argv[1], "all") != 0) {
+        char *end = NULL;
+        long device = strtol(argv[1], &end, 0);
+        if (end == argv[1] || *end != '\0' || device < 0 || device >= CONTROL_SETTING_ALL) {
+            printf("Bad device id \"%s\"\n", argv[1]);
+            return 1;
+        }
+        target = (uint8_t)device;
+    }
+
+    uint8_t op = 0;
+    for (uint8_t i = CONTROL_SETTING_GET; i <= CONTROL_SETTING_RESET; i++) {
+        if (strcmp(argv[2], ops[i]) == 0) {
+            op = i;
+        }
+    }
+    bool needs_value = op == CONTROL_SETTING_TRY || op == CONTROL_SETTING_SET;
+    if (op == 0 || argc != (needs_value ? 5 : 4)) {
+        printf("usage: remote <device id|all> get|try|set|reset <name> [value]\n");
+        return 1;
+    }
+
+    setting_id_t id;
+    if (console_find(argv[3], &id)) {
+        return 1;
+    }
+    return console_error(settings_request(target, op, id, needs_value ? argv[4] : NULL));
+}
+
+static void console_task(void *arg)
+{
+    char line[CONSOLE_LINE_MAX];
+
+    while (1) {
+        if (!fgets(line, sizeof(line), stdin)) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') {
+            continue;
+        }
+
+        int cmd_ret;
+        if (esp_console_run(line, &cmd_ret) == ESP_ERR_NOT_FOUND) {
+            printf("Unknown command (see \"help\")\n");
+        }
+    }
+}
+
+static esp_err_t console_start(void)
+{
+    // Blocking reads from stdin need the UART driver under it
+    if (!uart_is_driver_installed(CONFIG_ESP_CONSOLE_UART_NUM)) {
+        esp_err_t ret = uart_driver_install(CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    uart_vfs_dev_use_driver(CONFIG_ESP_CONSOLE_UART_NUM);
+
+    esp_console_config_t config = ESP_CONSOLE_CONFIG_DEFAULT();
+    config.max_cmdline_length = CONSOLE_LINE_MAX;
+    config.max_cmdline_args = 6;
+    esp_err_t ret = esp_console_init(&config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    static const esp_console_cmd_t commands[] = {
+        { .command = "settings", .help = "List the settings", .func = cmd_settings },
+        { .command = "get", .help = "Show a setting", .hint = "<name>", .func = cmd_get },
+        { .command = "set", .help = "Change a setting and save it",
+          .hint = "<name> <value>", .func = cmd_set },
+        { .command = "try", .help = "Change a setting until reboot",
+          .hint = "<name> <value>", .func = cmd_set },
+        { .command = "reset", .help = "Back to the build default",
+          .hint = "<name|all>", .func = cmd_reset },
+        { .command = "remote", .help = "Read or change a setting on other devices",
+          .hint = "<device id|all> get|try|set|reset <name> [value]", .func = cmd_remote },
+    };
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        esp_console_cmd_register(&commands[i]);
+    }
+    esp_console_register_help_command();
+
+    return task_map_create(TASK_CONSOLE, console_task, NULL, NULL);
+}
+
+#endif // CONSOLE_ENABLED
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t settings_init(void)
+{
+    if (!lock) {
+        lock = xSemaphoreCreateMutex();
+        if (!lock) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    int loaded = 0;
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        const setting_entry_t *e = &entries[i];
+        setting_value_t value;
+
+        values[i] = e->def;
+        saved[i] = false;
+        if (!e->available || !nvs_load(e, &value)) {
+            continue;
+        }
+        if (!in_range(e, value)) {
+            ESP_LOGW(TAG, "Saved %s out of range - using the default", e->name);
+            continue;
+        }
+        values[i] = value;
+        saved[i] = true;
+        loaded++;
+    }
+
+    ESP_LOGI(TAG, "%d of %d settings saved in NVS", loaded, SETTING_COUNT);
+    return ESP_OK;
+}
+
+esp_err_t settings_start(void)
+{
+    if (started) {
+        return ESP_OK;
+    }
+
+    // Modules came up on the build defaults: apply whatever differs, once
+    // per apply function (several settings share one)
+    xSemaphoreTake(lock, portMAX_DELAY);
+    started = true;
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        const setting_entry_t *e = &entries[i];
+        if (!e->apply || values[i].i == e->def.i) {
+            continue;
+        }
+
+        bool done = false;
+        for (int j = 0; j < i; j++) {
+            done |= entries[j].apply == e->apply && values[j].i != entries[j].def.i;
+        }
+        esp_err_t ret = done ? ESP_OK : e->apply();
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Saved %s not applied: %s", e->name, esp_err_to_name(ret));
+        }
+    }
+    xSemaphoreGive(lock);
+
+    if (task_map_create(TASK_SETTINGS, store_task, NULL, &store_handle) != ESP_OK) {
+        store_handle = NULL;   // Saves are then written by the caller
+        ESP_LOGW(TAG, "Settings writer not started");
+    }
+    control_channel_register(CONTROL_MSG_SETTING, setting_handler);
+
+#if CONSOLE_ENABLED
+    esp_err_t ret = console_start();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Console not started: %s", esp_err_to_name(ret));
+    }
+#endif
+    return ESP_OK;
+}
+
+int32_t settings_get_int(setting_id_t id)
+{
+    return id < SETTING_COUNT ? values[id].i : 0;
+}
+
+float settings_get_float(setting_id_t id)
+{
+    return id < SETTING_COUNT ? values[id].f : 0.0f;
+}
+
+esp_err_t settings_set_text(setting_id_t id, const char *text, bool save)
+{
+    if (id >= SETTING_COUNT) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    setting_value_t value;
+    esp_err_t ret = parse_value(&entries[id], text, &value);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return change(id, value, save, false);
+}
+
+esp_err_t settings_reset(setting_id_t id)
+{
+    if (id >= SETTING_COUNT) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return change(id, entries[id].def, false, true);
+}
+
+esp_err_t settings_find(const char *name, setting_id_t *id)
+{
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        if (name && strcmp(name, entries[i].name) == 0) {
+            if (id) *id = (setting_id_t)i;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+const char *settings_name(setting_id_t id)
+{
+    return id < SETTING_COUNT ? entries[id].name : "?";
+}
+
+esp_err_t settings_request(uint8_t target, uint8_t op, setting_id_t id, const char *text)
+{
+    if (id >= SETTING_COUNT || op < CONTROL_SETTING_GET || op > CONTROL_SETTING_RESET) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    control_setting_t msg = {
+        .op = op,
+        .device_id = DEVICE_ID,
+        .target = target,
+        .id = (uint8_t)id,
+    };
+    if (op == CONTROL_SETTING_TRY || op == CONTROL_SETTING_SET) {
+        setting_value_t value;
+        esp_err_t ret = parse_value(&entries[id], text, &value);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        msg.value = value.i;
+    }
+    return control_channel_send(CONTROL_MSG_SETTING, &msg, sizeof(msg));
+}
+
+void settings_print(void)
+{
+    printf("%-14s %10s %10s  %s\n", "name", "value", "default", "range / notes");
+    for (int i = 0; i < SETTING_COUNT; i++) {
+        const setting_entry_t *e = &entries[i];
+        if (!e->available) {
+            continue;
+        }
+
+        char value[16], def[16], min[16], max[16];
+        format_value(e, values[i], value, sizeof(value));
+        format_value(e, e->def, def, sizeof(def));
+        format_value(e, e->min, min, sizeof(min));
+        format_value(e, e->max, max, sizeof(max));
+        printf("%-14s %10s %10s  %s..%s  %s%s%s\n", e->name, value, def, min, max, e->help,
+               saved[i] ? " [saved]" : "", e->apply ? "" : " [reboot]");
+    }
+}
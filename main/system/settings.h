@@ -0,0 +1,118 @@
+/**
+ * @file settings.h
+ * @brief Run-Time Settings
+ *
+ * A typed registry of the tunables that used to need a rebuild: each has
+ * a name, a range and its build default from the config files. Saved
+ * values are loaded from NVS at boot; a change is range-checked, applied
+ * to the running system and, if asked, saved. Entries marked for reboot
+ * are saved only - the module that reads them does so once at start-up.
+ * Saving is left to a low-priority task, so a remote change applied on
+ * the UDP RX task never waits on a flash write.
+ *
+ * Ids travel in CONTROL_MSG_SETTING, so new entries go at the end.
+ */
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+//=============================================================================
+// SETTINGS
+//=============================================================================
+
+typedef enum {
+    SETTING_BITRATE = 0,         // Encoder bitrate ceiling (bps)
+    SETTING_COMPLEXITY,          // Encoder complexity ceiling
+    SETTING_JITTER_MIN_MS,       // Jitter buffer floor
+    SETTING_JITTER_START_MS,     // Jitter buffer starting (or fixed) depth
+    SETTING_JITTER_MAX_MS,       // Jitter buffer ceiling
+    SETTING_LIMITER,             // Limiter ceiling (0.0-1.0)
+    SETTING_INPUT_GAIN,          // Mic (pack) / party-line (base) input PGA
+    SETTING_LINE_OUTPUT_GAIN,    // Party-line output level (base)
+    SETTING_CHANNEL,             // AP channel, 0 = automatic (base)
+    SETTING_LOW_LATENCY,         // Low-latency link
+    SETTING_BUNDLE,              // Bundle mode [reboot]
+    SETTING_BACKEND,             // Link backend [reboot]
+    SETTING_SIDETONE,            // Sidetone level (0.0-1.0, pack)
+    SETTING_COUNT
+} setting_id_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Load the saved values (call once NVS is up, before anything reads them)
+ * @return ESP_OK (a missing namespace just means all defaults)
+ */
+esp_err_t settings_init(void);
+
+/**
+ * @brief Apply the saved values that differ from the build defaults,
+ *        answer CONTROL_MSG_SETTING and start the console
+ *
+ * Call once the modules the settings drive are up.
+ * @return ESP_OK on success
+ */
+esp_err_t settings_start(void);
+
+/**
+ * @brief Current value of an integer (or on/off) setting
+ */
+int32_t settings_get_int(setting_id_t id);
+
+/**
+ * @brief Current value of a float setting
+ */
+float settings_get_float(setting_id_t id);
+
+/**
+ * @brief Change a setting from text ("24000", "0.9", "on")
+ * @param id Setting
+ * @param text New value
+ * @param save Also save it to NVS (queued; a failed write is logged)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG unparsable or out of range,
+ *         ESP_ERR_NOT_SUPPORTED not on this device, or the apply error
+ *         (the old value is then kept)
+ */
+esp_err_t settings_set_text(setting_id_t id, const char *text, bool save);
+
+/**
+ * @brief Put a setting back to its build default and forget the saved value
+ * @return ESP_OK, or the apply error
+ */
+esp_err_t settings_reset(setting_id_t id);
+
+/**
+ * @brief Look a setting up by name
+ * @return ESP_OK, ESP_ERR_NOT_FOUND
+ */
+esp_err_t settings_find(const char *name, setting_id_t *id);
+
+/**
+ * @brief Name of a setting
+ */
+const char *settings_name(setting_id_t id);
+
+/**
+ * @brief Ask another device to read or change a setting
+ *
+ * The answers (one per device that took the request) are logged.
+ * @param target DEVICE_ID, or CONTROL_SETTING_ALL
+ * @param op CONTROL_SETTING_GET, _TRY, _SET or _RESET
+ * @param id Setting
+ * @param text New value for TRY/SET (NULL otherwise)
+ * @return ESP_OK once sent, ESP_ERR_INVALID_ARG unparsable value
+ */
+esp_err_t settings_request(uint8_t target, uint8_t op, setting_id_t id, const char *text);
+
+/**
+ * @brief Print every setting with its value, default and range
+ */
+void settings_print(void);
+
+#endif // SETTINGS_H
@@ -0,0 +1,103 @@
+/**
+ * @file startup.c
+ * @brief Boot Sequencing and Phase Timing Implementation
+ */
+
+#include "startup.h"
+#include "../config.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "STARTUP";
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static EventGroupHandle_t phase_events = NULL;
+static portMUX_TYPE phase_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t phase_ms[STARTUP_PHASE_COUNT] = {0};
+
+static const char *phase_names[STARTUP_PHASE_COUNT] = {
+    [STARTUP_AUDIO_READY]     = "audio ready",
+    [STARTUP_NETWORK_READY]   = "network ready",
+    [STARTUP_LINK_UP]         = "link up",
+    [STARTUP_AUDIO_LIVE]      = "audio live",
+    [STARTUP_SELF_TEST_DONE]  = "self-test done",
+};
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t startup_init(void)
+{
+    if (phase_events) {
+        return ESP_OK;
+    }
+
+    phase_events = xEventGroupCreate();
+    if (!phase_events) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void startup_mark(startup_phase_t phase)
+{
+    if (phase >= STARTUP_PHASE_COUNT || !phase_events) return;
+
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+
+    portENTER_CRITICAL(&phase_lock);
+    bool first = phase_ms[phase] == 0;
+    if (first) {
+        phase_ms[phase] = now_ms > 0 ? now_ms : 1;
+    }
+    portEXIT_CRITICAL(&phase_lock);
+
+    if (first) {
+        ESP_LOGI(TAG, "%s at %lu ms", phase_names[phase], (unsigned long)now_ms);
+        xEventGroupSetBits(phase_events, (EventBits_t)1 << phase);
+    }
+}
+
+bool startup_wait(startup_phase_t phase, uint32_t timeout_ms)
+{
+    if (phase >= STARTUP_PHASE_COUNT || !phase_events) return false;
+
+    EventBits_t bit = (EventBits_t)1 << phase;
+    TickType_t ticks = timeout_ms == STARTUP_WAIT_FOREVER ? portMAX_DELAY
+                                                          : pdMS_TO_TICKS(timeout_ms);
+    EventBits_t bits = xEventGroupWaitBits(phase_events, bit, pdFALSE, pdTRUE, ticks);
+    return (bits & bit) != 0;
+}
+
+bool startup_is_done(startup_phase_t phase)
+{
+    if (phase >= STARTUP_PHASE_COUNT) return false;
+
+    return phase_ms[phase] != 0;
+}
+
+uint32_t startup_phase_ms(startup_phase_t phase)
+{
+    if (phase >= STARTUP_PHASE_COUNT) return 0;
+
+    return phase_ms[phase];
+}
+
+void startup_print(void)
+{
+    char line[160];
+    int len = 0;
+
+    for (int i = 0; i < STARTUP_PHASE_COUNT && len < (int)sizeof(line); i++) {
+        if (phase_ms[i] == 0) continue;
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %lu", len ? ", " : "",
+                        phase_names[i], (unsigned long)phase_ms[i]);
+    }
+    ESP_LOGI(TAG, "Boot timeline (ms): %s", len ? line : "nothing yet");
+}
@@ -0,0 +1,76 @@
+/**
+ * @file startup.h
+ * @brief Boot Sequencing and Phase Timing
+ *
+ * Start-up is a small dependency graph rather than a fixed sequence:
+ * each phase is a bit in one event group, set once by whoever completes
+ * it, and anything that depends on a phase waits for its bit. The audio
+ * lane (codec, Opus, jitter buffers) and the network lane (WiFi bring-up
+ * and association) run side by side; the audio engine starts when both
+ * are done and the link is up.
+ *
+ * Every phase is stamped on the boot clock (esp_timer time since reset)
+ * and the whole timeline goes to the log, so boot-to-audio time can be
+ * watched as it is cut.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define STARTUP_WAIT_FOREVER    UINT32_MAX
+
+//=============================================================================
+// PHASES
+//=============================================================================
+
+typedef enum {
+    STARTUP_AUDIO_READY = 0,     // Codec, Opus and playout buffers initialized
+    STARTUP_NETWORK_READY,       // WiFi started, transport and control channel up
+    STARTUP_LINK_UP,             // AP started (base), or associated / got IP (pack)
+    STARTUP_AUDIO_LIVE,          // Audio engine running
+    STARTUP_SELF_TEST_DONE,      // Background self-test finished
+    STARTUP_PHASE_COUNT
+} startup_phase_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Create the phase event group (first thing in app_main)
+ * @return ESP_OK on success
+ */
+esp_err_t startup_init(void);
+
+/**
+ * @brief Mark a phase complete (any task; later calls are ignored)
+ */
+void startup_mark(startup_phase_t phase);
+
+/**
+ * @brief Wait for a phase
+ * @param timeout_ms Longest wait (STARTUP_WAIT_FOREVER = no limit)
+ * @return true if the phase completed, false on timeout
+ */
+bool startup_wait(startup_phase_t phase, uint32_t timeout_ms);
+
+/**
+ * @brief Check a phase without waiting
+ */
+bool startup_is_done(startup_phase_t phase);
+
+/**
+ * @brief Boot-clock time a phase completed, in ms (0 = not yet)
+ */
+uint32_t startup_phase_ms(startup_phase_t phase);
+
+/**
+ * @brief Log the timeline of every phase completed so far
+ */
+void startup_print(void);
+
+#endif // STARTUP_H
@@ -0,0 +1,225 @@
+/**
+ * @file task_map.c
+ * @brief Task Cores, Priorities and Deadlines Implementation
+ *
+ * Priority map (higher runs first; IDF tasks shown for reference):
+ *
+ *   Core 1 (audio)                    Core 0 (network)
+ *   ------------------------------    ------------------------------
+ *   I2S ISR                           WiFi            23  (IDF)
+ *   audio       20  deadline 1 frame  tcpip         18  (IDF, sdkconfig)
+ *   bench        5  (benchmark only)
+ *                                     udp_rx        15  deadline 1/4 frame
+ *                                     soak          14  deadline 1/4 frame (soak only)
+ *                                     buttons        5  (pack: PTT/CALL callbacks)
+ *                                     call_mon       4
+ *                                     monitor        3
+ *                                     codec          3
+ *                                     vol_ctrl       3
+ *                                     battery        2
+ *                                     capture        2  (packet capture only)
+ *                                     settings       1  (NVS writes)
+ *
+ * The audio engine is alone on its core so its jitter is only the I2S
+ * ISR. udp_rx stays below WiFi and lwIP (it consumes what they deliver)
+ * but above everything else on core 0, so a received frame reaches the
+ * jitter buffer within a fraction of a frame.
+ */
+
+#include "task_map.h"
+#include "../config.h"
+#include "esp_log.h"
+#include <stdio.h>
+
+static const char *TAG = "TASKS";
+
+#define FRAME_DEADLINE_US   ((uint32_t)FRAME_SIZE_MS * 1000)
+
+typedef struct {
+    const char *name;
+    uint32_t stack;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint32_t deadline_us;        // 0 = not tracked
+} task_entry_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static const task_entry_t task_table[TASK_COUNT] = {
+    [TASK_AUDIO_ENGINE] = { "audio",       32768, 20, TASK_CORE_AUDIO,   FRAME_DEADLINE_US     },
+    [TASK_UDP_RX]       = { "udp_rx",       8192, 15, TASK_CORE_NETWORK, FRAME_DEADLINE_US / 4 },
+    [TASK_MONITOR]      = { "monitor",      4096,  3, TASK_CORE_NETWORK, 0 },
+    [TASK_ADC]          = { "adc",          4096,  4, TASK_CORE_NETWORK, 0 },
+    [TASK_BENCHMARK]    = { "bench",       32768,  5, TASK_CORE_AUDIO,   0 },
+    [TASK_CAPTURE]      = { "capture",      4096,  2, TASK_CORE_NETWORK, 0 },
+    [TASK_AUDIO_INIT]   = { "audio_init",   8192,  5, TASK_CORE_AUDIO,   0 },
+    [TASK_SELFTEST]     = { "selftest",     4096,  1, TASK_CORE_NETWORK, 0 },
+    [TASK_CONSOLE]      = { "console",      4096,  2, TASK_CORE_NETWORK, 0 },
+    [TASK_CODEC]        = { "codec",        3072,  3, TASK_CORE_NETWORK, 0 },
+    [TASK_SOAK]         = { "soak",         4096, 14, TASK_CORE_NETWORK, FRAME_DEADLINE_US / 4 },
+    [TASK_SETTINGS]     = { "settings",     4096,  1, TASK_CORE_NETWORK, 0 },
+    [TASK_BUTTONS]      = { "buttons",      4096,  5, TASK_CORE_NETWORK, 0 },
+};
+
+// Written only by the owning task, read by the monitor
+static task_stats_t task_stats[TASK_COUNT] = {0};
+static TaskHandle_t task_handles[TASK_COUNT] = {0};
+static portMUX_TYPE handle_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+    esp_err_t (*fn)(void);
+    esp_err_t result;
+    TaskHandle_t caller;
+} core_call_t;
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static void core_call_task(void *arg)
+{
+    core_call_t *call = (core_call_t *)arg;
+
+    call->result = call->fn();
+    xTaskNotifyGive(call->caller);
+    vTaskDelete(NULL);
+}
+
+// Unused stack in bytes, 0 if the task is not running
+static uint32_t stack_free(task_id_t id)
+{
+    uint32_t free_bytes = 0;
+
+    portENTER_CRITICAL(&handle_lock);
+    if (task_handles[id]) {
+        free_bytes = (uint32_t)uxTaskGetStackHighWaterMark(task_handles[id]);
+    }
+    portEXIT_CRITICAL(&handle_lock);
+    return free_bytes;
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+esp_err_t task_map_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    if (id >= TASK_COUNT || !fn) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const task_entry_t *entry = &task_table[id];
+    if (xTaskCreatePinnedToCore(fn, entry->name, entry->stack, arg, entry->priority,
+                                &task_handles[id], entry->core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create %s", entry->name);
+        return ESP_ERR_NO_MEM;
+    }
+    if (handle) {
+        *handle = task_handles[id];
+    }
+
+    ESP_LOGD(TAG, "%s: core %d, priority %u", entry->name,
+             (int)entry->core, (unsigned)entry->priority);
+    return ESP_OK;
+}
+
+void task_map_exit(task_id_t id)
+{
+    if (id < TASK_COUNT) {
+        portENTER_CRITICAL(&handle_lock);
+        task_handles[id] = NULL;
+        portEXIT_CRITICAL(&handle_lock);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t task_map_run_on_core(BaseType_t core, esp_err_t (*fn)(void))
+{
+    if (!fn) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    core_call_t call = {
+        .fn = fn,
+        .result = ESP_FAIL,
+        .caller = xTaskGetCurrentTaskHandle(),
+    };
+
+    if (xTaskCreatePinnedToCore(core_call_task, "core_call", 4096, &call,
+                                uxTaskPriorityGet(NULL), NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    return call.result;
+}
+
+void task_map_record(task_id_t id, uint32_t elapsed_us)
+{
+    if (id >= TASK_COUNT) return;
+
+    task_stats_t *stats = &task_stats[id];
+    stats->runs++;
+    if (elapsed_us > stats->worst_us) {
+        stats->worst_us = elapsed_us;
+    }
+    if (task_table[id].deadline_us > 0 && elapsed_us > task_table[id].deadline_us) {
+        stats->misses++;
+    }
+}
+
+void task_map_get_stats(task_id_t id, task_stats_t *stats)
+{
+    if (id >= TASK_COUNT || !stats) return;
+
+    *stats = task_stats[id];
+    stats->stack_free = stack_free(id);
+}
+
+void task_map_least_stack(task_id_t *id, uint32_t *free_bytes)
+{
+    task_id_t least = TASK_AUDIO_ENGINE;
+    uint32_t least_free = UINT32_MAX;
+
+    for (int i = 0; i < TASK_COUNT; i++) {
+        uint32_t free_bytes = stack_free((task_id_t)i);
+        if (free_bytes > 0 && free_bytes < least_free) {
+            least = (task_id_t)i;
+            least_free = free_bytes;
+        }
+    }
+
+    if (id) *id = least;
+    if (free_bytes) *free_bytes = least_free == UINT32_MAX ? 0 : least_free;
+}
+
+void task_map_print_status(void)
+{
+    for (int i = 0; i < TASK_COUNT; i++) {
+        const task_entry_t *entry = &task_table[i];
+        if (entry->deadline_us == 0) continue;
+
+        task_stats_t *stats = &task_stats[i];
+        ESP_LOGI(TAG, "  %-8s core %d prio %2u: %lu runs, %lu misses (> %lu us), worst %lu us",
+                 entry->name, (int)entry->core, (unsigned)entry->priority,
+                 (unsigned long)stats->runs, (unsigned long)stats->misses,
+                 (unsigned long)entry->deadline_us, (unsigned long)stats->worst_us);
+        stats->worst_us = 0;
+    }
+
+    // Stack high-water marks (bytes never used) of every running task
+    char line[160];
+    int len = 0;
+    for (int i = 0; i < TASK_COUNT && len < (int)sizeof(line); i++) {
+        uint32_t free_bytes = stack_free((task_id_t)i);
+        if (free_bytes == 0) continue;
+
+        len += snprintf(&line[len], sizeof(line) - len, " %s %lu",
+                        task_table[i].name, (unsigned long)free_bytes);
+    }
+    if (len > 0) {
+        ESP_LOGI(TAG, "  stack free:%s", line);
+    }
+}
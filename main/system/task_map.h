@@ -0,0 +1,113 @@
+/**
+ * @file task_map.h
+ * @brief Task Cores, Priorities and Deadlines
+ *
+ * Every firmware task is created from one table (task_map.c) that fixes
+ * its core, priority, stack and deadline. The audio engine owns core 1;
+ * WiFi, lwIP, the UDP receive task and all housekeeping stay on core 0,
+ * so nothing but the I2S ISR can preempt encode/decode.
+ *
+ * Tracked tasks record how long each pass took against their deadline;
+ * misses and the worst case are reported by task_map_print_status(),
+ * along with every task's stack high-water mark.
+ */
+
+#ifndef TASK_MAP_H
+#define TASK_MAP_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+//=============================================================================
+// CORES
+//=============================================================================
+
+#define TASK_CORE_NETWORK   0       // WiFi + lwIP (see sdkconfig), UDP RX, housekeeping
+#define TASK_CORE_AUDIO     1       // Audio engine and the I2S interrupt
+
+//=============================================================================
+// TASKS
+//=============================================================================
+
+typedef enum {
+    TASK_AUDIO_ENGINE = 0,
+    TASK_UDP_RX,
+    TASK_MONITOR,
+    TASK_ADC,                    // ADC service: battery, volume pot, call detect
+    TASK_BENCHMARK,              // BENCHMARK_MODE_ENABLE only
+    TASK_CAPTURE,                // PACKET_CAPTURE_ENABLE only, while dumping/replaying
+    TASK_AUDIO_INIT,             // Boot: audio lane of start-up, then exits
+    TASK_SELFTEST,               // Boot: background self-test (stays on failure)
+    TASK_CONSOLE,                // SETTINGS_CONSOLE_ENABLE only: serial commands
+    TASK_CODEC,                  // WM8960 async register writer
+    TASK_SOAK,                   // SOAK_MODE_ENABLE only: virtual packs
+    TASK_SETTINGS,               // Settings NVS writer
+    TASK_BUTTONS,                // Pack: PTT/CALL callbacks, fed by the debounce timers
+    TASK_COUNT
+} task_id_t;
+
+typedef struct {
+    uint32_t runs;               // Passes recorded
+    uint32_t misses;             // Passes longer than the deadline
+    uint32_t worst_us;           // Longest pass since the last status print
+    uint32_t stack_free;         // Least unused stack so far (bytes, 0 = not running)
+} task_stats_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Create a task with the core, priority and stack from the table
+ * @param id Task entry
+ * @param fn Task function
+ * @param arg Task argument
+ * @param handle Optional handle output
+ * @return ESP_OK on success
+ */
+esp_err_t task_map_create(task_id_t id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+/**
+ * @brief End the calling task (instead of vTaskDelete(NULL))
+ * @param id The caller's task entry
+ */
+void task_map_exit(task_id_t id);
+
+/**
+ * @brief Run an init function on a given core and wait for it
+ *
+ * Peripheral drivers allocate their interrupt on the calling core; this
+ * puts e.g. the I2S interrupt on TASK_CORE_AUDIO.
+ * @param core Core to run on
+ * @param fn Function to run
+ * @return fn's result
+ */
+esp_err_t task_map_run_on_core(BaseType_t core, esp_err_t (*fn)(void));
+
+/**
+ * @brief Record one pass of a tracked task
+ * @param id Task entry
+ * @param elapsed_us Time from the pass's release (event/wake) to its end
+ */
+void task_map_record(task_id_t id, uint32_t elapsed_us);
+
+/**
+ * @brief Get a task's deadline statistics
+ */
+void task_map_get_stats(task_id_t id, task_stats_t *stats);
+
+/**
+ * @brief Find the running task closest to overflowing its stack
+ * @param id Task entry output
+ * @param free_bytes Its least unused stack so far
+ */
+void task_map_least_stack(task_id_t *id, uint32_t *free_bytes);
+
+/**
+ * @brief Log one line per tracked task (resets the worst case)
+ */
+void task_map_print_status(void);
+
+#endif // TASK_MAP_H
@@ -0,0 +1,272 @@
+/**
+ * @file trace.c
+ * @brief Per-Stage Timing Traces Implementation
+ *
+ * Recording is a short critical section per sample (stages such as the
+ * send path run on both cores). Percentiles are taken from a sorted copy
+ * of the ring, in the caller's task, under a mutex that only the readers
+ * share.
+ */
+
+#include "trace.h"
+#include "task_map.h"
+#include "../network/control_channel.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_rom_sys.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "TRACE";
+
+// Occupancy series after the stages
+#define TRACE_SERIES        (TRACE_STAGE_COUNT + 1)
+#define TRACE_JB_SERIES     TRACE_STAGE_COUNT
+
+_Static_assert(TRACE_STAGE_COUNT == CONTROL_METRICS_STAGES,
+               "CONTROL_METRICS_STAGES must match trace_stage_t");
+
+typedef struct {
+    uint32_t ring[TRACE_RING_SAMPLES];
+    uint32_t head;               // Samples recorded (wraps the ring)
+    uint32_t max;                // Since the last status print
+} trace_series_t;
+
+//=============================================================================
+// PRIVATE VARIABLES
+//=============================================================================
+
+static const char *stage_names[TRACE_STAGE_COUNT] = {
+    [TRACE_ENGINE_FRAME] = "engine",
+    [TRACE_I2S_READ]     = "i2s_read",
+    [TRACE_AEC]          = "aec",
+    [TRACE_ENCODE]       = "encode",
+    [TRACE_DECODE]       = "decode",
+    [TRACE_MIX]          = "mix",
+    [TRACE_JB_DRAIN]     = "jb_drain",
+    [TRACE_SEND]         = "send",
+    [TRACE_I2S_WRITE]    = "i2s_write",
+};
+
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+static trace_series_t series[TRACE_SERIES];
+
+// Readers' sort buffer
+static SemaphoreHandle_t summary_mutex = NULL;
+static uint32_t sorted[TRACE_RING_SAMPLES];
+
+//=============================================================================
+// PRIVATE FUNCTIONS
+//=============================================================================
+
+static inline void record(size_t index, uint32_t value)
+{
+    trace_series_t *s = &series[index];
+
+    portENTER_CRITICAL(&trace_lock);
+    s->ring[s->head % TRACE_RING_SAMPLES] = value;
+    s->head++;
+    if (value > s->max) s->max = value;
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentiles in raw units (cycles for stages)
+static void summarize(size_t index, trace_summary_t *summary)
+{
+    memset(summary, 0, sizeof(*summary));
+    if (!summary_mutex) return;
+
+    xSemaphoreTake(summary_mutex, portMAX_DELAY);
+
+    portENTER_CRITICAL(&trace_lock);
+    const trace_series_t *s = &series[index];
+    uint32_t count = s->head < TRACE_RING_SAMPLES ? s->head : TRACE_RING_SAMPLES;
+    memcpy(sorted, s->ring, count * sizeof(uint32_t));
+    summary->max = s->max;
+    portEXIT_CRITICAL(&trace_lock);
+
+    if (count > 0) {
+        qsort(sorted, count, sizeof(uint32_t), compare_u32);
+        summary->p50 = sorted[(count - 1) / 2];
+        summary->p99 = sorted[(count - 1) * 99 / 100];
+        summary->samples = count;
+    }
+
+    xSemaphoreGive(summary_mutex);
+}
+
+static inline uint32_t cycles_to_us(uint32_t cycles)
+{
+    return cycles / esp_rom_get_cpu_ticks_per_us();
+}
+
+static inline uint16_t sat16(uint32_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : (uint16_t)value;
+}
+
+static inline uint8_t sat8(uint32_t value)
+{
+    return value > UINT8_MAX ? UINT8_MAX : (uint8_t)value;
+}
+
+static void query_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    (void)payload;
+    (void)size;
+
+    control_metrics_t metrics = {
+        .device_id = DEVICE_ID,
+    };
+
+    task_id_t task;
+    uint32_t stack_free;
+    task_map_least_stack(&task, &stack_free);
+    metrics.stack_task = (uint8_t)task;
+    metrics.stack_free = sat16(stack_free);
+
+    trace_summary_t s;
+    trace_get_jb_summary(&s);
+    metrics.jb_p50 = sat8(s.p50);
+    metrics.jb_p99 = sat8(s.p99);
+    metrics.jb_max = sat8(s.max);
+
+    for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+        trace_get_summary((trace_stage_t)i, &s);
+        metrics.stages[i].p50_us = sat16(s.p50);
+        metrics.stages[i].p99_us = sat16(s.p99);
+        metrics.stages[i].max_us = sat16(s.max);
+    }
+
+    control_channel_send_to(source_addr, CONTROL_MSG_METRICS, &metrics, sizeof(metrics));
+}
+
+static void metrics_handler(uint32_t source_addr, const uint8_t *payload, uint16_t size)
+{
+    (void)source_addr;
+    if (size < sizeof(control_metrics_t)) {
+        return;
+    }
+
+    control_metrics_t metrics;
+    memcpy(&metrics, payload, sizeof(metrics));
+
+    // p99/max of the stages that bound the frame deadline
+    ESP_LOGI(TAG, "Peer %02x: engine %u/%u enc %u/%u dec %u/%u send %u/%u us (p99/max), "
+             "jb %u/%u/%u frames, least stack %u B (task %u)",
+             metrics.device_id,
+             metrics.stages[TRACE_ENGINE_FRAME].p99_us, metrics.stages[TRACE_ENGINE_FRAME].max_us,
+             metrics.stages[TRACE_ENCODE].p99_us, metrics.stages[TRACE_ENCODE].max_us,
+             metrics.stages[TRACE_DECODE].p99_us, metrics.stages[TRACE_DECODE].max_us,
+             metrics.stages[TRACE_SEND].p99_us, metrics.stages[TRACE_SEND].max_us,
+             metrics.jb_p50, metrics.jb_p99, metrics.jb_max,
+             metrics.stack_free, metrics.stack_task);
+}
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+void trace_end(trace_stage_t stage, uint32_t start)
+{
+#if TRACE_ENABLE
+    if (stage >= TRACE_STAGE_COUNT) return;
+    record(stage, platform_cycle_count() - start);
+#else
+    (void)stage;
+    (void)start;
+#endif
+}
+
+void trace_jb_depth(uint32_t depth)
+{
+#if TRACE_ENABLE
+    record(TRACE_JB_SERIES, depth);
+#else
+    (void)depth;
+#endif
+}
+
+esp_err_t trace_init(void)
+{
+    if (!TRACE_ENABLE || summary_mutex) {
+        return ESP_OK;
+    }
+
+    summary_mutex = xSemaphoreCreateMutex();
+    if (!summary_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    control_channel_register(CONTROL_MSG_METRICS_QUERY, query_handler);
+    control_channel_register(CONTROL_MSG_METRICS, metrics_handler);
+
+    ESP_LOGI(TAG, "Tracing %d stages, %d samples each", TRACE_STAGE_COUNT, TRACE_RING_SAMPLES);
+    return ESP_OK;
+}
+
+void trace_get_summary(trace_stage_t stage, trace_summary_t *summary)
+{
+    if (!summary) return;
+    if (stage >= TRACE_STAGE_COUNT) {
+        memset(summary, 0, sizeof(*summary));
+        return;
+    }
+
+    summarize(stage, summary);
+    summary->p50 = cycles_to_us(summary->p50);
+    summary->p99 = cycles_to_us(summary->p99);
+    summary->max = cycles_to_us(summary->max);
+}
+
+void trace_get_jb_summary(trace_summary_t *summary)
+{
+    if (!summary) return;
+
+    summarize(TRACE_JB_SERIES, summary);
+}
+
+esp_err_t trace_query(uint32_t dest)
+{
+    if (!summary_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    return control_channel_send_to(dest, CONTROL_MSG_METRICS_QUERY, NULL, 0);
+}
+
+void trace_print_status(void)
+{
+    if (!summary_mutex) return;
+
+    trace_summary_t s;
+    for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+        trace_get_summary((trace_stage_t)i, &s);
+        if (s.samples == 0) continue;
+
+        ESP_LOGI(TAG, "  %-9s p50 %5lu  p99 %5lu  max %5lu us  (%lu samples)",
+                 stage_names[i], (unsigned long)s.p50, (unsigned long)s.p99,
+                 (unsigned long)s.max, (unsigned long)s.samples);
+    }
+
+    trace_get_jb_summary(&s);
+    if (s.samples > 0) {
+        ESP_LOGI(TAG, "  jb depth  p50 %5lu  p99 %5lu  max %5lu frames",
+                 (unsigned long)s.p50, (unsigned long)s.p99, (unsigned long)s.max);
+    }
+
+    // New maxima from here
+    portENTER_CRITICAL(&trace_lock);
+    for (size_t i = 0; i < TRACE_SERIES; i++) {
+        series[i].max = 0;
+    }
+    portEXIT_CRITICAL(&trace_lock);
+}
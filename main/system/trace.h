@@ -0,0 +1,115 @@
+/**
+ * @file trace.h
+ * @brief Per-Stage Timing Traces
+ *
+ * Each pipeline stage brackets its work with trace_begin()/trace_end(),
+ * which read the CPU cycle counter (a register read, no call into the
+ * OS). Every stage keeps a ring of its last TRACE_RING_SAMPLES durations;
+ * p50/p99 come from that ring and the max from everything since the last
+ * status print. Jitter-buffer occupancy is kept the same way, in frames.
+ *
+ * The summary goes to the status log and is returned to any peer that
+ * sends CONTROL_MSG_METRICS_QUERY (the base can ask its packs with
+ * TRACE_QUERY_PEERS).
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../platform/platform.h"
+#include "../config.h"
+
+//=============================================================================
+// STAGES
+//=============================================================================
+
+typedef enum {
+    TRACE_ENGINE_FRAME = 0,      // Whole audio engine pass
+    TRACE_I2S_READ,              // Captured frame out of DMA
+    TRACE_AEC,                   // Echo canceller
+    TRACE_ENCODE,                // One Opus encode
+    TRACE_DECODE,                // One Opus decode or concealment
+    TRACE_MIX,                   // Base mixer (bus and mix-minus feeds)
+    TRACE_JB_DRAIN,              // Taking in a jitter buffer's queued arrivals
+    TRACE_SEND,                  // Backend send of one datagram
+    TRACE_I2S_WRITE,             // Played frame into DMA
+    TRACE_STAGE_COUNT
+} trace_stage_t;
+
+typedef struct {
+    uint32_t p50;                // Microseconds (frames for occupancy)
+    uint32_t p99;
+    uint32_t max;                // Since the last status print
+    uint32_t samples;            // Samples the percentiles come from
+} trace_summary_t;
+
+//=============================================================================
+// PUBLIC FUNCTIONS
+//=============================================================================
+
+/**
+ * @brief Start timing a stage
+ * @return Cycle count to pass to trace_end()
+ */
+static inline uint32_t trace_begin(void)
+{
+#if TRACE_ENABLE
+    return platform_cycle_count();
+#else
+    return 0;
+#endif
+}
+
+#if !PLATFORM_HOST
+/**
+ * @brief Record a stage that began at start (any task, either core)
+ */
+void trace_end(trace_stage_t stage, uint32_t start);
+
+/**
+ * @brief Record one jitter-buffer occupancy sample (frames)
+ */
+void trace_jb_depth(uint32_t depth);
+#else
+// Host build: stages are profiled with perf instead
+static inline void trace_end(trace_stage_t stage, uint32_t start)
+{
+    (void)stage;
+    (void)start;
+}
+
+static inline void trace_jb_depth(uint32_t depth)
+{
+    (void)depth;
+}
+#endif
+
+/**
+ * @brief Register the metrics query handlers (control channel must be up)
+ * @return ESP_OK on success
+ */
+esp_err_t trace_init(void);
+
+/**
+ * @brief Percentiles of one stage
+ */
+void trace_get_summary(trace_stage_t stage, trace_summary_t *summary);
+
+/**
+ * @brief Percentiles of jitter-buffer occupancy
+ */
+void trace_get_jb_summary(trace_summary_t *summary);
+
+/**
+ * @brief Ask a peer for its metrics (dest 0 = every peer); replies are logged
+ */
+esp_err_t trace_query(uint32_t dest);
+
+/**
+ * @brief Log one line per stage (resets the maxima)
+ */
+void trace_print_status(void);
+
+#endif // TRACE_H
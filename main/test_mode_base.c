@@ -17,7 +17,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "audio/audio_codec.h"
-#include "esp_adc/adc_oneshot.h"
+#include "audio/audio_tones.h"
+#include "hardware/adc_service.h"
 #include <math.h>
 
 static const char *TAG = "TEST_BASE";
@@ -33,18 +34,12 @@ static const char *TAG = "TEST_BASE";
 static volatile bool test_running = false;
 static TaskHandle_t audio_task_handle = NULL;
 static TaskHandle_t call_task_handle = NULL;
-static adc_oneshot_unit_handle_t adc_handle = NULL;
 
-static float phase = 0.0f;
-static const float phase_inc = (2.0f * M_PI * TEST_TONE_FREQ_HZ) / SAMPLE_RATE_HZ;
+static uint32_t phase = 0;
 
 static void generate_tone(int16_t *buf, size_t count)
 {
-    for (size_t i = 0; i < count; i++) {
-        buf[i] = (int16_t)(sinf(phase) * TEST_TONE_AMPLITUDE * 32767.0f);
-        phase += phase_inc;
-        if (phase >= 2.0f * M_PI) phase -= 2.0f * M_PI;
-    }
+    audio_tones_generate_sine(buf, count, TEST_TONE_FREQ_HZ, TEST_TONE_AMPLITUDE, &phase);
 }
 
 static void test_audio_task(void *arg)
@@ -98,9 +93,10 @@ static void test_call_task(void *arg)
     bool call_active = false;
 
     while (test_running) {
-        int adc_value = 0;
-        if (adc_oneshot_read(adc_handle, CALL_RX_ADC_CHANNEL, &adc_value) == ESP_OK) {
-            float voltage = (adc_value / 4095.0f) * 3.3f;
+        // Channel scanned by the call interface (clearcom_line_call_start)
+        int mv = adc_service_read_mv(CALL_RX_ADC_CHANNEL);
+        if (mv >= 0) {
+            float voltage = mv / 1000.0f;
             bool detected = (voltage > CALL_VOLTAGE_THRESHOLD);
 
             if (detected && !call_active) {
@@ -116,19 +112,6 @@ static void test_call_task(void *arg)
 
     vTaskDelete(NULL);
 }
-
-static esp_err_t init_call_adc(void)
-{
-    adc_oneshot_unit_init_cfg_t cfg = { .unit_id = ADC_UNIT_1 };
-    esp_err_t ret = adc_oneshot_new_unit(&cfg, &adc_handle);
-    if (ret != ESP_OK) return ret;
-
-    adc_oneshot_chan_cfg_t ch_cfg = {
-        .bitwidth = ADC_BITWIDTH_12,
-        .atten = ADC_ATTEN_DB_12,
-    };
-    return adc_oneshot_config_channel(adc_handle, CALL_RX_ADC_CHANNEL, &ch_cfg);
-}
 #endif
 
 esp_err_t test_mode_start(void)
@@ -138,8 +121,8 @@ esp_err_t test_mode_start(void)
     ESP_LOGI(TAG, "=== BASE TEST MODE ===");
 
 #if TEST_CALL_MONITORING
-    if (init_call_adc() != ESP_OK) {
-        ESP_LOGE(TAG, "Call ADC init failed");
+    if (!adc_service_has_channel(CALL_RX_ADC_CHANNEL)) {
+        ESP_LOGE(TAG, "Call ADC not scanned");
         return ESP_FAIL;
     }
 #endif
@@ -160,11 +143,6 @@ void test_mode_stop(void)
     test_running = false;
     vTaskDelay(pdMS_TO_TICKS(200));
 
-    if (adc_handle) {
-        adc_oneshot_del_unit(adc_handle);
-        adc_handle = NULL;
-    }
-
     ESP_LOGI(TAG, "Test mode stopped");
 }
 
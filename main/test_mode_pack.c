@@ -20,6 +20,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "audio/audio_codec.h"
+#include "audio/audio_tones.h"
 #include "hardware/gpio_control.h"
 #include <math.h>
 #include <string.h>
@@ -148,20 +149,13 @@ static void test_tone_task(void *arg)
     printf("========================================\n\n");
 
     int16_t tone_buffer[SAMPLES_PER_FRAME];
-    uint32_t sample_index = 0;
+    uint32_t phase = 0;
     uint32_t frame_count = 0;
 
-    // Pre-calculate phase increment
-    // phase_inc = 2*pi*freq/sample_rate
-    const float phase_inc = 2.0f * M_PI * TONE_FREQUENCY_HZ / SAMPLE_RATE_HZ;
-
     while (test_mode_running) {
         // Generate one frame of 440Hz sine
-        for (int i = 0; i < SAMPLES_PER_FRAME; i++) {
-            float sample = sinf(phase_inc * (float)sample_index);
-            tone_buffer[i] = (int16_t)(sample * TONE_AMPLITUDE);
-            sample_index++;
-        }
+        audio_tones_generate_sine(tone_buffer, SAMPLES_PER_FRAME, TONE_FREQUENCY_HZ,
+                                  TONE_AMPLITUDE / 32767.0f, &phase);
 
         audio_codec_write(tone_buffer, SAMPLES_PER_FRAME);
         frame_count++;